@@ -34,17 +34,23 @@
 #include "stdafx.h"
 #include "ZoeCodec.h"
 #include "codecs.h"
+#include "formats.h"
+#include "unpack.h"
+#include "zoe.h"
+
+#include <algorithm>
+#include <new>
 
 //#define LOG_TO_FILE
 //#define LOG_TO_STDOUT
 
-#define VERSION 0x00010100 // 1.1.1
+#define VERSION 0x00010200 // 1.2.0
 
 #if _WIN64
-    TCHAR szDescription[] = TEXT("Zoe Lossless Codec (64 bits) v1.1.1");
+    TCHAR szDescription[] = TEXT("Zoe Lossless Codec (64 bits) v1.2.0");
     TCHAR szName[]        = TEXT("ZoeLosslessCodec64");
 #else
-    TCHAR szDescription[] = TEXT("Zoe Lossless Codec (32 bits) v1.1.1");
+    TCHAR szDescription[] = TEXT("Zoe Lossless Codec (32 bits) v1.2.0");
     TCHAR szName[]        = TEXT("ZoeLosslessCodec32");
 #endif
 
@@ -76,25 +82,35 @@ const char * fourCCStr(DWORD fourcc)
 
 enum eBufferTypes {
     BTYPE_INVALID = 0xFF,
-    BTYPE_NONE = 0,
-    BTYPE_RGB24,
-    BTYPE_RGB32,
-    BTYPE_Y8,
-    BTYPE_Y10,
-    BTYPE_HY8,
-    BTYPE_HY10,
-    BTYPE_HRGB24,
-    BTYPE_HRGB32,
-    BTYPE_HUYVY,
-
-    BTYPE_PY10, // Packed 10 bit grayscale data (16 pixels x 10 bit grouped in 20 bytes)
-
-    BTYPE_Y12,
-    BTYPE_HY12,
-
-    BTYPE_COUNT
+    BTYPE_NONE = ZOE_FORMAT_NONE,
+    BTYPE_RGB24 = ZOE_FORMAT_RGB24,
+    BTYPE_RGB32 = ZOE_FORMAT_RGB32,
+    BTYPE_Y8 = ZOE_FORMAT_Y8,
+    BTYPE_Y10 = ZOE_FORMAT_Y10,
+    BTYPE_HY8 = ZOE_FORMAT_HY8,
+    BTYPE_HY10 = ZOE_FORMAT_HY10,
+    BTYPE_HRGB24 = ZOE_FORMAT_HRGB24,
+    BTYPE_HRGB32 = ZOE_FORMAT_HRGB32,
+    BTYPE_HUYVY = ZOE_FORMAT_HUYVY,
+
+    BTYPE_PY10 = ZOE_FORMAT_PY10, // Packed 10 bit grayscale data (16 pixels x 10 bit grouped in 20 bytes)
+
+    BTYPE_Y12 = ZOE_FORMAT_Y12,
+    BTYPE_HY12 = ZOE_FORMAT_HY12,
+    BTYPE_HY14 = ZOE_FORMAT_HY14,
+    BTYPE_HY16 = ZOE_FORMAT_HY16,
+    BTYPE_HV210 = ZOE_FORMAT_HV210,
+    BTYPE_HRGB48 = ZOE_FORMAT_HRGB48,
+    BTYPE_HRGBA64 = ZOE_FORMAT_HRGBA64,
+    BTYPE_HYUV420 = ZOE_FORMAT_HYUV420,
+
+    BTYPE_COUNT = ZOE_FORMAT_COUNT
 };
 
+// Version 2 streams contain tagged frames (see FrameFlags in huffman.h). Version 1 decoders
+// reject them in DecompressQuery instead of misreading the frames.
+static const unsigned char CurrentHeaderVersion = 2;
+
 struct ZoeCodecHeader
 {
     unsigned char version;
@@ -108,6 +124,11 @@ BOOL IsValidType(int type)
     return type>BTYPE_NONE && type<BTYPE_COUNT;
 }
 
+BOOL IsValidVersion(int version)
+{
+    return version==1 || version==CurrentHeaderVersion;
+}
+
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
 void logMessage(const char * format, ...)
 {
@@ -159,55 +180,237 @@ bool exeRequiresForceRGB()
     return false;
 }
 
+// The DIB formats of the driver: what each one is to the library, and the stream format a frame
+// of it is compressed to (BTYPE_NONE for the formats only produced by the decompressor)
+struct DibFormat
+{
+    DWORD compression;
+    WORD bit_count;
+    zoe_pixel_format pixels;
+    unsigned char buffer_type;
+};
+
+static const DibFormat dib_formats[] =
+{
+    { BI_RGB,                          24, ZOE_PIXEL_RGB24, BTYPE_HRGB24 },
+    { BI_RGB,                          32, ZOE_PIXEL_RGB32, BTYPE_HRGB32 },
+    { mmioFOURCC('Y', '8', ' ', ' '),   8, ZOE_PIXEL_Y8,    BTYPE_HY8 },
+    { mmioFOURCC('Y', '1', '0', ' '),  16, ZOE_PIXEL_Y10,   BTYPE_HY10 },
+    { mmioFOURCC('Y', '1', '2', ' '),  16, ZOE_PIXEL_Y12,   BTYPE_HY12 },
+    { mmioFOURCC('P', 'Y', '1', '0'),  16, ZOE_PIXEL_PY10,  BTYPE_HY10 },
+    { mmioFOURCC('U', 'Y', 'V', 'Y'),  16, ZOE_PIXEL_UYVY,  BTYPE_HUYVY },
+    { mmioFOURCC('Y', '1', '4', ' '),  16, ZOE_PIXEL_Y14,   BTYPE_HY14 },
+    { mmioFOURCC('Y', '1', '6', ' '),  16, ZOE_PIXEL_Y16,   BTYPE_HY16 },
+    { mmioFOURCC('B', 'G', 'R', 48),   48, ZOE_PIXEL_RGB48, BTYPE_HRGB48 },
+    { mmioFOURCC('B', 'R', 'A', 64),   64, ZOE_PIXEL_RGBA64, BTYPE_HRGBA64 },
+    { mmioFOURCC('v', '2', '1', '0'),  20, ZOE_PIXEL_V210,  BTYPE_HV210 },
+    { mmioFOURCC('I', '4', '2', '0'),  12, ZOE_PIXEL_I420,  BTYPE_HYUV420 },
+    { mmioFOURCC('N', 'V', '1', '2'),  12, ZOE_PIXEL_NV12,  BTYPE_HYUV420 },
+};
+
+const DibFormat* FindDibFormat(const BITMAPINFOHEADER* bih)
+{
+    for (size_t i=0;i<sizeof(dib_formats)/sizeof(dib_formats[0]);i++)
+        if (dib_formats[i].compression == bih->biCompression && dib_formats[i].bit_count == bih->biBitCount)
+            return &dib_formats[i];
+    return 0;
+}
+
+const DibFormat* FindDibFormat(zoe_pixel_format pixels)
+{
+    for (size_t i=0;i<sizeof(dib_formats)/sizeof(dib_formats[0]);i++)
+        if (dib_formats[i].pixels == pixels)
+            return &dib_formats[i];
+    return 0;
+}
+
+// Output of DecompressGetFormat for each stream format: the pixels coded, or RGB for the hosts
+// that force it (see ZOE_STREAM_FORMATS)
+struct DefaultOutput
+{
+    unsigned char buffer_type;
+    zoe_pixel_format output;
+    zoe_pixel_format rgb_output;
+};
+
+#define DEFAULT_OUTPUT(format, huffman, paired, bytes_per_pixel, planes, encode_flags, output, rgb_output) \
+    { BTYPE_##format, ZOE_PIXEL_##output, ZOE_PIXEL_##rgb_output },
+static const DefaultOutput default_outputs[] =
+{
+    ZOE_STREAM_FORMATS(DEFAULT_OUTPUT)
+};
+#undef DEFAULT_OUTPUT
+
+const DefaultOutput* FindDefaultOutput(unsigned char buffer_type)
+{
+    for (size_t i=0;i<sizeof(default_outputs)/sizeof(default_outputs[0]);i++)
+        if (default_outputs[i].buffer_type == buffer_type)
+            return &default_outputs[i];
+    return 0;
+}
+
+// Formats supported by the Compressor
 bool IsFormatSupported(LPBITMAPINFOHEADER lpbiIn) 
 {
     if (!lpbiIn)
         return FALSE;
 
-    // Formats supported by the Compressor
-
-    if (lpbiIn->biCompression == BI_RGB && lpbiIn->biBitCount == 24)
-        return TRUE;
-    if (lpbiIn->biCompression == BI_RGB && lpbiIn->biBitCount == 32)
-        return TRUE;
-    if (lpbiIn->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && lpbiIn->biBitCount == 8)
-        return TRUE;
-    if (lpbiIn->biCompression == mmioFOURCC('Y', '1', '0', ' ') && lpbiIn->biBitCount == 16)
-        return TRUE;
-    if (lpbiIn->biCompression == mmioFOURCC('Y', '1', '2', ' ') && lpbiIn->biBitCount == 16)
-        return TRUE;
-    if (lpbiIn->biCompression == mmioFOURCC('P', 'Y', '1', '0') && lpbiIn->biBitCount == 16)
-        return TRUE;
-    if (lpbiIn->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && lpbiIn->biBitCount == 16)
-        return TRUE;
+    const DibFormat* format = FindDibFormat(lpbiIn);
+    if (!format || format->buffer_type == BTYPE_NONE)
+        return FALSE;
 
-    return FALSE;
+    // A chroma sample covers 2x2 pixels, libzoe does not code 4:2:0 frames of odd sizes
+    if (format->buffer_type == BTYPE_HYUV420)
+        return lpbiIn->biWidth % 2 == 0 && lpbiIn->biHeight % 2 == 0;
+
+    return TRUE;
 }
 
 void FillHeaderForInput(const LPBITMAPINFOHEADER lpbiIn, ZoeCodecHeader* header)
 {
-    header->version = 1;
-    header->buffer_type = BTYPE_NONE;
-
-    if (lpbiIn->biCompression == BI_RGB && lpbiIn->biBitCount == 24)
-        header->buffer_type = BTYPE_HRGB24; // BTYPE_RGB24;
-    else if (lpbiIn->biCompression == BI_RGB && lpbiIn->biBitCount == 32)
-        header->buffer_type = BTYPE_HRGB32; // BTYPE_RGB32;
-    else if (lpbiIn->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && lpbiIn->biBitCount == 8)
-        header->buffer_type = BTYPE_HY8; // BTYPE_Y8
-    else if (lpbiIn->biCompression == mmioFOURCC('Y', '1', '0', ' ') && lpbiIn->biBitCount == 16)
-        header->buffer_type = BTYPE_HY10; // BTYPE_Y10
-    else if (lpbiIn->biCompression == mmioFOURCC('Y', '1', '2', ' ') && lpbiIn->biBitCount == 16)
-        header->buffer_type = BTYPE_HY12; // BTYPE_Y12
-    else if (lpbiIn->biCompression == mmioFOURCC('P', 'Y', '1', '0') && lpbiIn->biBitCount == 16)
-        header->buffer_type = BTYPE_HY10; // BTYPE_PY10
-    else if (lpbiIn->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && lpbiIn->biBitCount == 16)
-        header->buffer_type = BTYPE_HUYVY; // Compressed UYVY
+    const DibFormat* format = FindDibFormat(lpbiIn);
 
+    header->version = CurrentHeaderVersion;
+    header->buffer_type = format ? format->buffer_type : (unsigned char)BTYPE_NONE;
     header->pad0 = 0;
     header->pad1 = 0;
 }
 
+// 4:2:0 with 16 bit MSB aligned samples: the luma plane, then a plane of interleaved U V at half
+// the height. Gray frames decode to its luma plane and a neutral chroma plane.
+bool IsP010(const BITMAPINFOHEADER* bih)
+{
+    return bih->biCompression == mmioFOURCC('P', '0', '1', '0') && bih->biBitCount == 24 &&
+        bih->biWidth % 2 == 0 && bih->biHeight % 2 == 0;
+}
+
+zoe_pixel_format PixelFormatOf(const BITMAPINFOHEADER* bih)
+{
+    const DibFormat* format = FindDibFormat(bih);
+    if (format)
+        return format->pixels;
+    if (IsP010(bih))
+        return ZOE_PIXEL_Y16; // the luma plane, Decompress adds the chroma plane
+
+    return ZOE_PIXEL_NONE;
+}
+
+// Rows of uncompressed RGB DIBs are padded to 4 bytes, rows of v210 to 128 bytes, rows of the
+// other YUV formats are packed
+int DibStride(const BITMAPINFOHEADER* bih)
+{
+    if (bih->biCompression == BI_RGB)
+        return ((bih->biWidth * bih->biBitCount + 31) / 32) * 4;
+    if (bih->biCompression == mmioFOURCC('v', '2', '1', '0'))
+        return (int)V210RowBytes(bih->biWidth);
+    return 0;
+}
+
+// Encoder configuration of a frame of this DIB coded to buffer_type
+void FillEncoderConfig(const BITMAPINFOHEADER* bih, unsigned char buffer_type, zoe_encoder_config* config)
+{
+    config->format = (zoe_format)buffer_type;
+    config->input = PixelFormatOf(bih);
+    config->width = bih->biWidth;
+    config->height = abs(bih->biHeight);
+    config->threads = ZOE_THREADS_SHARED_POOL;
+    config->input_stride = DibStride(bih);
+    config->flags = 0;
+    if (config->format == ZOE_FORMAT_HRGB48 || config->format == ZOE_FORMAT_HRGBA64)
+        config->flags |= ZOE_ENCODE_COLOR_TRANSFORM;
+
+    // Frames hold RGB rows bottom-up like a DIB with a positive biHeight, a top-down DIB is read
+    // from its last row (see Decompress)
+    if (bih->biCompression == BI_RGB && bih->biHeight < 0)
+        config->input_stride = -config->input_stride;
+}
+
+DWORD StatusToICERR(zoe_status status)
+{
+    switch (status)
+    {
+    case ZOE_OK:                    return ICERR_OK;
+    case ZOE_ERROR_UNSUPPORTED:     return ICERR_BADFORMAT;
+    case ZOE_ERROR_CORRUPT_FRAME:   return ICERR_BADFORMAT;
+    case ZOE_ERROR_OUT_OF_MEMORY:   return ICERR_MEMORY;
+    default:                        return ICERR_ERROR;
+    }
+}
+
+bool SameConfig(const zoe_encoder_config& a, const zoe_encoder_config& b)
+{
+    return a.format == b.format && a.input == b.input && a.width == b.width && a.height == b.height && a.threads == b.threads &&
+        a.input_stride == b.input_stride && a.flags == b.flags;
+}
+
+bool SameConfig(const zoe_decoder_config& a, const zoe_decoder_config& b)
+{
+    return a.format == b.format && a.output == b.output && a.width == b.width && a.height == b.height && a.threads == b.threads && a.flags == b.flags &&
+        a.output_stride == b.output_stride;
+}
+
+// Encoder of the instance for this frame format, created again when the format changes. Without an
+// instance the encoder only lives for the current frame.
+zoe_status AcquireEncoder(ZoeDriverInstance* instance, const zoe_encoder_config& config, zoe_encoder** encoder)
+{
+    if (!instance)
+        return zoe_encoder_create(&config, encoder);
+
+    if (!instance->encoder || !SameConfig(instance->encoder_config, config))
+    {
+        DestroyEncoder(instance);
+        zoe_status status = zoe_encoder_create(&config, &instance->encoder);
+        if (status != ZOE_OK)
+            return status;
+        instance->encoder_config = config;
+    }
+
+    *encoder = instance->encoder;
+    return ZOE_OK;
+}
+
+void ReleaseEncoder(ZoeDriverInstance* instance, zoe_encoder* encoder)
+{
+    if (!instance)
+        zoe_encoder_destroy(encoder);
+}
+
+void DestroyEncoder(ZoeDriverInstance* instance)
+{
+    zoe_encoder_destroy(instance->encoder);
+    instance->encoder = 0;
+}
+
+zoe_status AcquireDecoder(ZoeDriverInstance* instance, const zoe_decoder_config& config, zoe_decoder** decoder)
+{
+    if (!instance)
+        return zoe_decoder_create(&config, decoder);
+
+    if (!instance->decoder || !SameConfig(instance->decoder_config, config))
+    {
+        DestroyDecoder(instance);
+        zoe_status status = zoe_decoder_create(&config, &instance->decoder);
+        if (status != ZOE_OK)
+            return status;
+        instance->decoder_config = config;
+    }
+
+    *decoder = instance->decoder;
+    return ZOE_OK;
+}
+
+void ReleaseDecoder(ZoeDriverInstance* instance, zoe_decoder* decoder)
+{
+    if (!instance)
+        zoe_decoder_destroy(decoder);
+}
+
+void DestroyDecoder(ZoeDriverInstance* instance)
+{
+    zoe_decoder_destroy(instance->decoder);
+    instance->decoder = 0;
+}
+
 BOOL QueryAbout()
 {
     return FALSE;
@@ -228,14 +431,86 @@ DWORD Configure(HWND hwnd)
     return ICERR_ERROR;
 }
 
-DWORD GetState(LPVOID pv, DWORD dwSize)
+ZoeDriverInstance* OpenInstance(ICOPEN* icopen)
 {
-    return 0; // no state information
+#if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
+    logMessage("OpenInstance");
+#endif
+
+    // Opened without ICOPEN for configuration, otherwise only video is handled
+    if (icopen && icopen->fccType != ICTYPE_VIDEO)
+        return 0;
+
+    ZoeDriverInstance* instance = new (std::nothrow) ZoeDriverInstance;
+    if (!instance)
+    {
+        if (icopen)
+            icopen->dwError = ICERR_MEMORY;
+        return 0;
+    }
+
+    instance->settings.version = ZoeCodecSettings::CurrentVersion;
+    instance->settings.worker_threads = 0;
+    instance->encoder = 0;
+    instance->decoder = 0;
+
+    if (icopen)
+        icopen->dwError = ICERR_OK;
+    return instance;
 }
 
-DWORD SetState(LPVOID pv, DWORD dwSize)
+void CloseInstance(ZoeDriverInstance* instance)
 {
-    return 0; // no state information
+#if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
+    logMessage("CloseInstance");
+#endif
+
+    if (instance)
+    {
+        DestroyEncoder(instance);
+        DestroyDecoder(instance);
+    }
+    delete instance;
+}
+
+DWORD GetState(ZoeDriverInstance* instance, LPVOID pv, DWORD dwSize)
+{
+    if (!instance)
+        return 0;
+
+    if (pv == NULL)
+        return sizeof(ZoeCodecSettings);
+
+    if (dwSize < sizeof(ZoeCodecSettings))
+        return 0;
+
+    memcpy(pv, &instance->settings, sizeof(ZoeCodecSettings));
+    return sizeof(ZoeCodecSettings);
+}
+
+DWORD SetState(ZoeDriverInstance* instance, LPVOID pv, DWORD dwSize)
+{
+    if (!instance)
+        return 0;
+
+    ZoeCodecSettings settings;
+    settings.version = ZoeCodecSettings::CurrentVersion;
+    settings.worker_threads = 0;
+
+    // NULL restores the defaults, unknown versions are ignored
+    if (pv != NULL)
+    {
+        if (dwSize < sizeof(ZoeCodecSettings) || ((const ZoeCodecSettings*)pv)->version != ZoeCodecSettings::CurrentVersion)
+            return 0;
+        memcpy(&settings, pv, sizeof(ZoeCodecSettings));
+    }
+
+    instance->settings = settings;
+
+    // The pool is shared by every instance, the size applies the next time it starts
+    zoe_set_worker_threads((int)settings.worker_threads);
+
+    return (pv != NULL) ? sizeof(ZoeCodecSettings) : 0;
 }
 
 DWORD GetInfo(ICINFO* icinfo, DWORD dwSize)
@@ -310,13 +585,15 @@ DWORD CompressGetFormat(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
     return ICERR_OK;
 }
 
-DWORD CompressBegin(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
+DWORD CompressBegin(ZoeDriverInstance* instance, LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
 {
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
     logMessage("CompressBegin");
 #endif
 
-    // Initialization
+    // Tables of a previous stream are dropped, the first frame allocates the ones of this stream
+    if (instance)
+        DestroyEncoder(instance);
 
     return ICERR_OK;
 }
@@ -327,19 +604,36 @@ DWORD CompressGetSize(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
     logMessage("CompressGetSize width:%d height:%d bits:%d", lpbiIn->biWidth, lpbiIn->biHeight, lpbiIn->biBitCount);
 #endif
 
-    // Worst case scenario is full uncompressed size
-    return (lpbiIn->biWidth * abs(lpbiIn->biHeight) * lpbiIn->biBitCount) / 8;
+    // The result is a byte count, not an ICERR code: 0 when no frame of this format can be coded
+    if (!IsFormatSupported(lpbiIn))
+        return 0;
+
+    // The frame is coded to the type of the output format, or to the default type of the input
+    ZoeCodecHeader header;
+    FillHeaderForInput(lpbiIn, &header);
+    if (lpbiOut && lpbiOut->biSize >= sizeof(BITMAPINFOHEADER) + sizeof(ZoeCodecHeader))
+        header = *(const ZoeCodecHeader*)(&lpbiOut[1]);
+
+    // The bound is the one Compress passes to the encoder: biBitCount is not the coded size of
+    // every format (v210 stored raw takes 4 bytes a pixel, 4:2:0 adds the chroma streams)
+    zoe_encoder_config config;
+    FillEncoderConfig(lpbiIn, header.buffer_type, &config);
+
+    zoe_encoder* encoder = 0;
+    if (zoe_encoder_create(&config, &encoder) != ZOE_OK)
+        return 0;
+
+    const size_t bound = zoe_encoder_max_output_size(encoder);
+    zoe_encoder_destroy(encoder);
+    return (DWORD)bound;
 }
 
-DWORD Compress(ICCOMPRESS* icinfo, DWORD dwSize)
+DWORD Compress(ZoeDriverInstance* instance, ICCOMPRESS* icinfo, DWORD dwSize)
 {
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
     logMessage("Compress");
 #endif
 
-    // TODO, should we flip-y the image before compression if the input biHeight is negative ?
-    // See comment in Decompress
-
     if (!IsFormatSupported(icinfo->lpbiInput))
         return ICERR_BADFORMAT;
 
@@ -348,170 +642,48 @@ DWORD Compress(ICCOMPRESS* icinfo, DWORD dwSize)
     if (icinfo->lpckid)
         *icinfo->lpckid = FOURCC_AZCL;
 
-    if (header->version == 1)
+    if (!IsValidVersion(header->version))
     {
-        const unsigned char* in_frame = (unsigned char*)icinfo->lpInput;
-        unsigned char* out_frame = (unsigned char*)icinfo->lpOutput;
-
-        if (header->buffer_type == BTYPE_RGB24)
-        {
-            if (icinfo->lpbiInput->biCompression != BI_RGB || icinfo->lpbiInput->biBitCount != 24)
-                return ICERR_BADFORMAT;
-
-            *icinfo->lpdwFlags = AVIIF_KEYFRAME;
-
-            DWORD size = Compress_RGB24_To_RGB24(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-            icinfo->lpbiOutput->biSizeImage = size;
-
-            return ICERR_OK;
-        }
-        else if (header->buffer_type == BTYPE_RGB32)
-        {
-            if (icinfo->lpbiInput->biCompression != BI_RGB || icinfo->lpbiInput->biBitCount != 32)
-                return ICERR_BADFORMAT;
-
-            *icinfo->lpdwFlags = AVIIF_KEYFRAME;
-
-            DWORD size = Compress_RGB32_To_RGB32(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-            icinfo->lpbiOutput->biSizeImage = size;
-
-            return ICERR_OK;
-        }
-        else if (header->buffer_type == BTYPE_Y8)
-        {
-            if (icinfo->lpbiInput->biCompression != mmioFOURCC('Y', '8', ' ', ' ') || icinfo->lpbiInput->biBitCount != 8)
-                return ICERR_BADFORMAT;
-
-            *icinfo->lpdwFlags = AVIIF_KEYFRAME;
-
-            DWORD size = Compress_Y8_To_Y8(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-            icinfo->lpbiOutput->biSizeImage = size;
-
-            return ICERR_OK;
-        }
-        else if (header->buffer_type == BTYPE_HY8)
-        {
-            if (icinfo->lpbiInput->biCompression != mmioFOURCC('Y', '8', ' ', ' ') || icinfo->lpbiInput->biBitCount != 8)
-                return ICERR_BADFORMAT;
-
-            *icinfo->lpdwFlags = AVIIF_KEYFRAME;
-
-            DWORD size = Compress_Y8_To_HY8(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-            icinfo->lpbiOutput->biSizeImage = size;
-
-            return ICERR_OK;
-        }
-        else if (header->buffer_type == BTYPE_HY10)
-        {
-            *icinfo->lpdwFlags = AVIIF_KEYFRAME;
-
-            if (icinfo->lpbiInput->biCompression == mmioFOURCC('Y', '1', '0', ' ') && icinfo->lpbiInput->biBitCount == 16)
-            {
-                DWORD size = Compress_Y10_To_HY10(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-                icinfo->lpbiOutput->biSizeImage = size;
-            }
-            else if (icinfo->lpbiInput->biCompression == mmioFOURCC('P', 'Y', '1', '0') && icinfo->lpbiInput->biBitCount == 16)
-            {
-                DWORD size = Compress_PY10_To_HY10(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-                icinfo->lpbiOutput->biSizeImage = size;
-            }
-            else
-                return ICERR_BADFORMAT;
-
-
-            return ICERR_OK;
-        }
-        else if (header->buffer_type == BTYPE_Y10)
-        {
-            if (icinfo->lpbiInput->biCompression != mmioFOURCC('Y', '1', '0', ' ') || icinfo->lpbiInput->biBitCount != 16)
-                return ICERR_BADFORMAT;
-
-            *icinfo->lpdwFlags = AVIIF_KEYFRAME;
-
-            DWORD size = Compress_Y10_To_Y10(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-            icinfo->lpbiOutput->biSizeImage = size;
-
-            return ICERR_OK;
-        }
-        else if (header->buffer_type == BTYPE_HY12)
-        {
-            *icinfo->lpdwFlags = AVIIF_KEYFRAME;
-
-            if (icinfo->lpbiInput->biCompression == mmioFOURCC('Y', '1', '2', ' ') && icinfo->lpbiInput->biBitCount == 16)
-            {
-                DWORD size = Compress_Y12_To_HY12(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-                icinfo->lpbiOutput->biSizeImage = size;
-            }
-            else
-                return ICERR_BADFORMAT;
-
-
-            return ICERR_OK;
-        }
-        else if (header->buffer_type == BTYPE_Y12)
-        {
-            if (icinfo->lpbiInput->biCompression != mmioFOURCC('Y', '1', '2', ' ') || icinfo->lpbiInput->biBitCount != 16)
-                return ICERR_BADFORMAT;
-
-            *icinfo->lpdwFlags = AVIIF_KEYFRAME;
-
-            DWORD size = Compress_Y12_To_Y12(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-            icinfo->lpbiOutput->biSizeImage = size;
-
-            return ICERR_OK;
-        }
-        else if (header->buffer_type == BTYPE_HUYVY)
-        {
-            if (icinfo->lpbiInput->biCompression != mmioFOURCC('U', 'Y', 'V', 'Y') || icinfo->lpbiInput->biBitCount != 16)
-                return ICERR_BADFORMAT;
-
-            *icinfo->lpdwFlags = AVIIF_KEYFRAME;
-
-            DWORD size = Compress_UYVY_To_HUYVY(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-            icinfo->lpbiOutput->biSizeImage = size;
-
-            return ICERR_OK;
-        }
-        else if (header->buffer_type == BTYPE_HRGB24)
-        {
-            if (icinfo->lpbiInput->biCompression != BI_RGB || icinfo->lpbiInput->biBitCount != 24)
-                return ICERR_BADFORMAT;
-
-            *icinfo->lpdwFlags = AVIIF_KEYFRAME;
+#if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
+        logMessage("Compress Failed ICERR_ERROR");
+#endif
+        return ICERR_ERROR;
+    }
 
-            DWORD size = Compress_RGB24_To_HRGB24(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-            icinfo->lpbiOutput->biSizeImage = size;
+    zoe_encoder_config config;
+    FillEncoderConfig(icinfo->lpbiInput, header->buffer_type, &config);
 
-            return ICERR_OK;
-        }
-        else if (header->buffer_type == BTYPE_HRGB32)
+    // The output buffer was sized by CompressGetSize with the bound of an encoder of this config
+    zoe_encoder* encoder = 0;
+    zoe_status status = AcquireEncoder(instance, config, &encoder);
+    if (status == ZOE_OK)
+    {
+        size_t size = 0;
+        status = zoe_encode(encoder, icinfo->lpInput, zoe_encoder_input_size(encoder), icinfo->lpOutput, zoe_encoder_max_output_size(encoder), &size);
+        if (status == ZOE_OK)
         {
-            if (icinfo->lpbiInput->biCompression != BI_RGB || icinfo->lpbiInput->biBitCount != 32)
-                return ICERR_BADFORMAT;
-
             *icinfo->lpdwFlags = AVIIF_KEYFRAME;
-
-            DWORD size = Compress_RGB32_To_HRGB32(icinfo->lpbiInput->biWidth, abs(icinfo->lpbiInput->biHeight), in_frame, out_frame);
-            icinfo->lpbiOutput->biSizeImage = size;
-
-            return ICERR_OK;
+            icinfo->lpbiOutput->biSizeImage = (DWORD)size;
         }
+        ReleaseEncoder(instance, encoder);
     }
 
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
-    logMessage("Compress Failed ICERR_ERROR");
+    if (status != ZOE_OK)
+        logMessage("Compress Failed %s", zoe_status_string(status));
 #endif
 
-    return ICERR_ERROR;
+    return StatusToICERR(status);
 }
 
-DWORD CompressEnd()
+DWORD CompressEnd(ZoeDriverInstance* instance)
 {
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
     logMessage("CompressEnd");
 #endif
 
-    // Cleanup
+    if (instance)
+        DestroyEncoder(instance);
 
     return ICERR_OK;
 }
@@ -550,7 +722,7 @@ DWORD DecompressQuery(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
     logMessage("DecompressQuery version:%d buffer_type:%d", header->version, header->buffer_type);
 #endif
 
-    if (header->version != 1 || !IsValidType(header->buffer_type))
+    if (!IsValidVersion(header->version) || !IsValidType(header->buffer_type))
     {
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
         logMessage("Bad header");
@@ -560,75 +732,13 @@ DWORD DecompressQuery(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
 
     if (lpbiOut)
     {
-        // Decompressing to a different size is not supported
-        if (lpbiIn->biWidth!=lpbiOut->biWidth || lpbiIn->biHeight!=lpbiOut->biHeight)
+        // Decompressing to a different size is not supported, top-down outputs are (biHeight < 0)
+        if (lpbiIn->biWidth!=lpbiOut->biWidth || abs(lpbiIn->biHeight)!=abs(lpbiOut->biHeight))
             return ICERR_BADFORMAT;
 
-        // Identify all possible output formats for each BTYPE
-        switch (header->buffer_type)
-        {
-        case BTYPE_HRGB24:
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==32)
-                return ICERR_OK;
-            // intentional fall-thru to next case
-        case BTYPE_RGB24:
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==24)
-                return ICERR_OK;
-            break;
-        case BTYPE_RGB32:
-        case BTYPE_HRGB32:
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==32)
-                return ICERR_OK;
-            break;
-        case BTYPE_HY8:
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==32)
-                return ICERR_OK;
-            // intentional fall-thru to next case
-        case BTYPE_Y8:
-            if (lpbiOut->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && lpbiOut->biBitCount==8)
-                return ICERR_OK;
-            if (lpbiOut->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && lpbiOut->biBitCount==16)
-                return ICERR_OK;
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==24)
-                return ICERR_OK;
-            break;
-        case BTYPE_HY10:
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==32)
-                return ICERR_OK;
-            // intentional fall-thru to next case
-        case BTYPE_Y10:
-            if (lpbiOut->biCompression == mmioFOURCC('Y', '1', '0', ' ') && lpbiOut->biBitCount==16)
-                return ICERR_OK;
-            if (lpbiOut->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && lpbiOut->biBitCount==16) // lossy (10->8)
-                return ICERR_OK;
-            if (lpbiOut->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && lpbiOut->biBitCount==8) // lossy (10->8)
-                return ICERR_OK;
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==24)
-                return ICERR_OK;
-            break;
-        case BTYPE_HY12:
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==32)
-                return ICERR_OK;
-            // intentional fall-thru to next case
-        case BTYPE_Y12:
-            if (lpbiOut->biCompression == mmioFOURCC('Y', '1', '2', ' ') && lpbiOut->biBitCount==16)
-                return ICERR_OK;
-            if (lpbiOut->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && lpbiOut->biBitCount==16) // lossy (12->8)
-                return ICERR_OK;
-            if (lpbiOut->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && lpbiOut->biBitCount==8) // lossy (12->8)
-                return ICERR_OK;
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==24)
-                return ICERR_OK;
-            break;
-        case BTYPE_HUYVY:
-            if (lpbiOut->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && lpbiOut->biBitCount==16)
-                return ICERR_OK;
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==24) // convert UYVY to RGB24
-                return ICERR_OK;
-            if (lpbiOut->biCompression == BI_RGB && lpbiOut->biBitCount==32) // convert UYVY to RGB32
-                return ICERR_OK;
-            break;
-        }
+        // The outputs of each BTYPE are the decoders of the library
+        if (zoe_decode_supported((zoe_format)header->buffer_type, PixelFormatOf(lpbiOut), 0))
+            return ICERR_OK;
 
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
         logMessage("Output not supported");
@@ -677,82 +787,25 @@ DWORD DecompressGetFormat(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
     logMessage("DecompressGetFormat: Header version:%d type:%d", header->version, header->buffer_type);
 #endif
 
-    if (header->version == 1)
+    if (IsValidVersion(header->version))
     {
-        // Identify default output format for each BTYPE
-
         const bool forceRGBOutput = exeRequiresForceRGB();
 
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)        
         logMessage("DecompressGetFormat: Force RGB format: %s", forceRGBOutput?"YES":"NO");
 #endif
 
-        if (header->buffer_type == BTYPE_RGB24 || header->buffer_type == BTYPE_HRGB24)
-        {
-            lpbiOut->biBitCount = 24;
-            lpbiOut->biCompression = BI_RGB;
-        }
-        else if (header->buffer_type == BTYPE_RGB32 || header->buffer_type == BTYPE_HRGB32)
-        {
-            lpbiOut->biBitCount = 32;
-            lpbiOut->biCompression = BI_RGB;
-        }
-        else if (header->buffer_type == BTYPE_Y8 || header->buffer_type == BTYPE_HY8)
-        {
-            if (forceRGBOutput)
-            {
-                lpbiOut->biBitCount = 24;
-                lpbiOut->biCompression = BI_RGB;
-            }
-            else
-            {
-                lpbiOut->biBitCount = 8;
-                lpbiOut->biCompression = mmioFOURCC('Y', '8', ' ', ' ');
-            }
-        }
-        else if (header->buffer_type == BTYPE_Y10 || header->buffer_type == BTYPE_HY10)
-        {
-            if (forceRGBOutput)
-            {
-                lpbiOut->biBitCount = 24;
-                lpbiOut->biCompression = BI_RGB;
-            }
-            else
-            {
-                lpbiOut->biBitCount = 16;
-                lpbiOut->biCompression = mmioFOURCC('Y', '1', '0', ' ');
-            }
-        }
-        else if (header->buffer_type == BTYPE_Y12 || header->buffer_type == BTYPE_HY12)
-        {
-            if (forceRGBOutput)
-            {
-                lpbiOut->biBitCount = 24;
-                lpbiOut->biCompression = BI_RGB;
-            }
-            else
-            {
-                lpbiOut->biBitCount = 16;
-                lpbiOut->biCompression = mmioFOURCC('Y', '1', '2', ' ');
-            }
-        }
-        else if (header->buffer_type == BTYPE_HUYVY)
-        {
-            if (forceRGBOutput)
-            {
-                lpbiOut->biBitCount = 24;
-                lpbiOut->biCompression = BI_RGB;
-            }
-            else
-            {
-                lpbiOut->biBitCount = 16;
-                lpbiOut->biCompression = mmioFOURCC('U', 'Y', 'V', 'Y');
-            }
-        }
-        else 
+        const DefaultOutput* output = FindDefaultOutput(header->buffer_type);
+        const DibFormat* dib = output ? FindDibFormat(forceRGBOutput ? output->rgb_output : output->output) : 0;
+        if (!dib)
             return ICERR_BADFORMAT;
 
+        lpbiOut->biBitCount = dib->bit_count;
+        lpbiOut->biCompression = dib->compression;
+
         lpbiOut->biSizeImage = (lpbiOut->biWidth * abs(lpbiOut->biHeight) * lpbiOut->biBitCount) / 8;
+        if (lpbiOut->biCompression == mmioFOURCC('v', '2', '1', '0'))
+            lpbiOut->biSizeImage = (DWORD)V210RowBytes(lpbiOut->biWidth) * abs(lpbiOut->biHeight);
 
         return ICERR_OK;
     }
@@ -764,7 +817,7 @@ DWORD DecompressGetFormat(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
     return ICERR_BADFORMAT;
 }
 
-DWORD DecompressBegin(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
+DWORD DecompressBegin(ZoeDriverInstance* instance, LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
 {
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
     logMessage("DecompressBegin");
@@ -775,12 +828,14 @@ DWORD DecompressBegin(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
         logMessage("DecompressBegin out FOURCC:%s bitCount:%d", fourCCStr(lpbiOut->biCompression), lpbiOut->biBitCount);
 #endif
 
-    // Initialization
+    // Tables of a previous stream are dropped, the first frame allocates the ones of this stream
+    if (instance)
+        DestroyDecoder(instance);
 
     return ICERR_OK;
 }
 
-DWORD Decompress(ICDECOMPRESS* icinfo, DWORD dwSize)
+DWORD Decompress(ZoeDriverInstance* instance, ICDECOMPRESS* icinfo, DWORD dwSize)
 {
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
     logMessage("Decompress outW:%d outH:%d outFOURCC:%s outBpp:%d outputsize:%d", icinfo->lpbiOutput->biWidth, icinfo->lpbiOutput->biHeight, fourCCStr(icinfo->lpbiOutput->biCompression), icinfo->lpbiOutput->biBitCount, icinfo->lpbiOutput->biSizeImage);
@@ -789,215 +844,67 @@ DWORD Decompress(ICDECOMPRESS* icinfo, DWORD dwSize)
     if (icinfo->lpbiInput->biCompression != FOURCC_AZCL)
         return ICERR_BADFORMAT;
 
-    // TODO: Verify when image has to be flipped vertically
+    // Orientation of the output:
     // If output is UYVY: Positive biHeight implies top-down image (top line first) [http://www.fourcc.org/yuv.php#UYVY]
     // If output is BI_RGB: For uncompressed RGB bitmaps, if biHeight is positive, the bitmap is a bottom-up DIB with the origin at the lower left corner. If biHeight is negative, the bitmap is a top-down DIB with the origin at the upper left corner.
     // If output is a YUV variant: For YUV bitmaps, the bitmap is always top-down, regardless of the sign of biHeight. Decoders should offer YUV formats with positive biHeight, but for backward compatibility they should accept YUV formats with either positive or negative biHeight.
     // For compressed formats, biHeight must be positive, regardless of image orientation. [http://msdn.microsoft.com/en-us/library/windows/desktop/dd318229%28v=vs.85%29.aspx]
-    
+    // Every decoder writes a bottom-up DIB to BI_RGB outputs, a negative stride turns it top-down for
+    // a negative biHeight, whatever the buffer type. The decoders write each row once either way.
+
     const ZoeCodecHeader* header = (const ZoeCodecHeader*)(&icinfo->lpbiInput[1]);
 
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
     logMessage("version:%d type:%d", header->version, header->buffer_type);
 #endif
 
-    if (header->version == 1)
+    if (!IsValidVersion(header->version))
     {
+#if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)   
+        logMessage("Decompress Failed ICERR_BADFORMAT");
+#endif
+        return ICERR_BADFORMAT;
+    }
+
+    const int output_stride = DibStride(icinfo->lpbiOutput);
+    if (output_stride)
+        icinfo->lpbiOutput->biSizeImage = output_stride * abs(icinfo->lpbiOutput->biHeight);
+    else
         icinfo->lpbiOutput->biSizeImage = (icinfo->lpbiOutput->biWidth * abs(icinfo->lpbiOutput->biHeight) * icinfo->lpbiOutput->biBitCount) >> 3;
 
-        const unsigned char* in_frame = (unsigned char*)icinfo->lpInput;
-        unsigned char* out_frame = (unsigned char*)icinfo->lpOutput;
+    zoe_decoder_config config;
+    config.format = (zoe_format)header->buffer_type;
+    config.output = PixelFormatOf(icinfo->lpbiOutput);
+    config.width = icinfo->lpbiOutput->biWidth;
+    config.height = abs(icinfo->lpbiOutput->biHeight);
+    config.threads = ZOE_THREADS_SHARED_POOL;
+    config.flags = 0;
+    config.output_stride = output_stride;
+    if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biHeight < 0)
+        config.output_stride = -output_stride;
+
+    zoe_decoder* decoder = 0;
+    zoe_status status = AcquireDecoder(instance, config, &decoder);
+    if (status == ZOE_OK)
+    {
+        status = zoe_decode(decoder, icinfo->lpInput, icinfo->lpbiInput->biSizeImage, icinfo->lpOutput, zoe_decoder_output_size(decoder));
+        ReleaseDecoder(instance, decoder);
+    }
 
-        if (header->buffer_type == BTYPE_RGB24)
-        {
-            if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 24)
-            {
-                if (Decompress_RGB24_To_RGB24(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-        }
-        else if (header->buffer_type == BTYPE_RGB32)
-        {
-            if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 32)
-            {
-                if (Decompress_RGB32_To_RGB32(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-        }
-        if (header->buffer_type == BTYPE_HRGB24)
-        {
-            if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 24)
-            {
-                if (Decompress_HRGB24_To_RGB24(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 32)
-            {
-                if (Decompress_HRGB24_To_RGB32(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame, icinfo->lpbiOutput->biHeight<0))
-                    return ICERR_OK;
-            }
-        }
-        else if (header->buffer_type == BTYPE_HRGB32)
-        {
-            if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 32)
-            {
-                if (Decompress_HRGB32_To_RGB32(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-        }
-        else if (header->buffer_type == BTYPE_Y8)
-        {
-            if (icinfo->lpbiOutput->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && icinfo->lpbiOutput->biBitCount == 8)
-            {
-                if (Decompress_Y8_To_Y8(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_Y8_To_UYVY(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-        }
-        else if (header->buffer_type == BTYPE_HY8)
-        {
-            if (icinfo->lpbiOutput->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && icinfo->lpbiOutput->biBitCount == 8)
-            {
-                if (Decompress_HY8_To_Y8(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_HY8_To_UYVY(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 24)
-            {
-                if (Decompress_HY8_To_RGB24(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 32)
-            {
-                if (Decompress_HY8_To_RGB32(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-        }
-        else if (header->buffer_type == BTYPE_HY10)
-        {
-            if (icinfo->lpbiOutput->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && icinfo->lpbiOutput->biBitCount == 8)
-            {
-                if (Decompress_HY10_To_Y8(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == mmioFOURCC('Y', '1', '0', ' ') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_HY10_To_Y10(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_HY10_To_UYVY(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 24)
-            {
-                if (Decompress_HY10_To_RGB24(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 32)
-            {
-                if (Decompress_HY10_To_RGB32(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-        }
-        else if (header->buffer_type == BTYPE_HY12)
-        {
-            if (icinfo->lpbiOutput->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && icinfo->lpbiOutput->biBitCount == 8)
-            {
-                if (Decompress_HY12_To_Y8(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == mmioFOURCC('Y', '1', '2', ' ') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_HY12_To_Y12(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_HY12_To_UYVY(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 24)
-            {
-                if (Decompress_HY12_To_RGB24(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 32)
-            {
-                if (Decompress_HY12_To_RGB32(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-        }
-        else if (header->buffer_type == BTYPE_HUYVY)
-        {
-            if (icinfo->lpbiOutput->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_HUYVY_To_UYVY(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 24)
-            {
-                if (Decompress_HUYVY_To_RGB24(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == BI_RGB && icinfo->lpbiOutput->biBitCount == 32)
-            {
-                if (Decompress_HUYVY_To_RGB32(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-        }
-        else if (header->buffer_type == BTYPE_Y10)
-        {
-            if (icinfo->lpbiOutput->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && icinfo->lpbiOutput->biBitCount == 8)
-            {
-                if (Decompress_Y10_To_Y8(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == mmioFOURCC('Y', '1', '0', ' ') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_Y10_To_Y10(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_Y10_To_UYVY(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-        }
-        else if (header->buffer_type == BTYPE_Y12)
-        {
-            if (icinfo->lpbiOutput->biCompression == mmioFOURCC('Y', '8', ' ', ' ') && icinfo->lpbiOutput->biBitCount == 8)
-            {
-                if (Decompress_Y12_To_Y8(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == mmioFOURCC('Y', '1', '2', ' ') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_Y12_To_Y12(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-            else if (icinfo->lpbiOutput->biCompression == mmioFOURCC('U', 'Y', 'V', 'Y') && icinfo->lpbiOutput->biBitCount == 16)
-            {
-                if (Decompress_Y12_To_UYVY(icinfo->lpbiInput->biSizeImage, icinfo->lpbiOutput->biWidth, abs(icinfo->lpbiOutput->biHeight), in_frame, out_frame))
-                    return ICERR_OK;
-            }
-        }
+    // P010 got its luma plane, the chroma plane after it stays at the neutral 0x8000
+    if (status == ZOE_OK && IsP010(icinfo->lpbiOutput))
+    {
+        unsigned short* chroma = (unsigned short*)icinfo->lpOutput + (size_t)config.width * config.height;
+        std::fill(chroma, chroma + (size_t)config.width * (config.height / 2), (unsigned short)0x8000);
     }
 
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)   
-    logMessage("Decompress Failed ICERR_BADFORMAT");
+    if (status != ZOE_OK)
+        logMessage("Decompress Failed %s", zoe_status_string(status));
 #endif
 
-    return ICERR_BADFORMAT;
+    // Frames that do not decode are reported as a bad format, like before
+    return status == ZOE_ERROR_OUT_OF_MEMORY ? ICERR_MEMORY : (status == ZOE_OK ? ICERR_OK : ICERR_BADFORMAT);
 }
 
 DWORD DecompressGetPalette(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut)
@@ -1009,13 +916,14 @@ DWORD DecompressGetPalette(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut
     return ICERR_BADFORMAT;
 }
 
-DWORD DecompressEnd()
+DWORD DecompressEnd(ZoeDriverInstance* instance)
 {
 #if defined(LOG_TO_FILE) || defined(LOG_TO_STDOUT)
     logMessage("DecompressEnd");
 #endif
 
-    // Cleanup
+    if (instance)
+        DestroyDecoder(instance);
 
     return ICERR_OK;
 }
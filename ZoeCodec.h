@@ -25,30 +25,65 @@
 
 #pragma once
 
+#include "zoe.h"
+
 static const DWORD FOURCC_AZCL = mmioFOURCC('A','Z','C','L');   // Zoe Lossless codec
 
+// Settings returned by ICM_GETSTATE and restored by ICM_SETSTATE
+struct ZoeCodecSettings
+{
+    DWORD version;          // ZoeCodecSettings::CurrentVersion
+    DWORD worker_threads;   // threads of the shared pool, 0 for one per core
+
+    enum { CurrentVersion = 1 };
+};
+
+// One per DRV_OPEN, its address is the driver ID of every following message
+struct ZoeDriverInstance
+{
+    ZoeCodecSettings settings;
+
+    // Created on the first frame after CompressBegin/DecompressBegin and kept until the matching
+    // End, or until the frame format changes
+    zoe_encoder* encoder;
+    zoe_encoder_config encoder_config;
+    zoe_decoder* decoder;
+    zoe_decoder_config decoder_config;
+};
+
+ZoeDriverInstance* OpenInstance(ICOPEN* icopen);
+void CloseInstance(ZoeDriverInstance* instance);
+
+zoe_status AcquireEncoder(ZoeDriverInstance* instance, const zoe_encoder_config& config, zoe_encoder** encoder);
+void ReleaseEncoder(ZoeDriverInstance* instance, zoe_encoder* encoder);
+void DestroyEncoder(ZoeDriverInstance* instance);
+
+zoe_status AcquireDecoder(ZoeDriverInstance* instance, const zoe_decoder_config& config, zoe_decoder** decoder);
+void ReleaseDecoder(ZoeDriverInstance* instance, zoe_decoder* decoder);
+void DestroyDecoder(ZoeDriverInstance* instance);
+
 BOOL QueryAbout();
 DWORD About(HWND hwnd);
 
 BOOL QueryConfigure();
 DWORD Configure(HWND hwnd);
 
-DWORD GetState(LPVOID pv, DWORD dwSize);
-DWORD SetState(LPVOID pv, DWORD dwSize);
+DWORD GetState(ZoeDriverInstance* instance, LPVOID pv, DWORD dwSize);
+DWORD SetState(ZoeDriverInstance* instance, LPVOID pv, DWORD dwSize);
 
 DWORD GetInfo(ICINFO* icinfo, DWORD dwSize);
 
 DWORD CompressQuery(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut);
 DWORD CompressGetFormat(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut);
-DWORD CompressBegin(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut);
+DWORD CompressBegin(ZoeDriverInstance* instance, LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut);
 DWORD CompressGetSize(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut);
-DWORD Compress(ICCOMPRESS* icinfo, DWORD dwSize);
-DWORD CompressEnd();
+DWORD Compress(ZoeDriverInstance* instance, ICCOMPRESS* icinfo, DWORD dwSize);
+DWORD CompressEnd(ZoeDriverInstance* instance);
 
 DWORD DecompressQuery(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut);
 DWORD DecompressGetFormat(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut);
-DWORD DecompressBegin(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut);
-DWORD Decompress(ICDECOMPRESS* icinfo, DWORD dwSize);
+DWORD DecompressBegin(ZoeDriverInstance* instance, LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut);
+DWORD Decompress(ZoeDriverInstance* instance, ICDECOMPRESS* icinfo, DWORD dwSize);
 DWORD DecompressGetPalette(LPBITMAPINFOHEADER lpbiIn, LPBITMAPINFOHEADER lpbiOut);
-DWORD DecompressEnd();
+DWORD DecompressEnd(ZoeDriverInstance* instance);
 
@@ -0,0 +1,323 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "async_encoder.h"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <string.h>
+
+ZoeAsyncEncoder::ZoeAsyncEncoder(ZoeCompressFunc compress, unsigned width, unsigned height, unsigned in_size, unsigned out_size, int frames_in_flight, int worker_threads,
+                                 ZoeThreadPool::Priority priority)
+    : compress_func(compress),
+      image_width(width),
+      image_height(height),
+      input_size(in_size),
+      output_size(out_size),
+      slot_count(std::max(frames_in_flight, 3)),
+      slots(slot_count),
+      enqueue_pos(0),
+      encode_pos(0),
+      complete_pos(0),
+      rejected(0),
+      max_in_flight(0),
+      stopping(false),
+      max_tasks(std::max(std::min(worker_threads, frames_in_flight), 1)),
+      active_tasks(0),
+      task_priority(priority)
+{
+    for (unsigned i=0;i<slot_count;i++)
+        slots[i].encoder = 0;
+    allocateSlots();
+}
+
+ZoeAsyncEncoder::ZoeAsyncEncoder(const zoe_encoder_config& config, int frames_in_flight, int worker_threads, ZoeThreadPool::Priority priority)
+    : ZoeAsyncEncoder(0, config.width, config.height, 0, 0, frames_in_flight, worker_threads, priority)
+{
+    // The object is complete once the delegated constructor returns, the destructor frees the
+    // encoders created before a failure
+    for (unsigned i=0;i<slot_count;i++)
+    {
+        const zoe_status status = zoe_encoder_create(&config, &slots[i].encoder);
+        if (status == ZOE_ERROR_OUT_OF_MEMORY)
+            throw std::bad_alloc();
+        if (status != ZOE_OK)
+            throw std::invalid_argument(zoe_status_string(status));
+    }
+
+    input_size = (unsigned)zoe_encoder_input_size(slots[0].encoder);
+    output_size = (unsigned)zoe_encoder_max_output_size(slots[0].encoder);
+    allocateSlots();
+}
+
+void ZoeAsyncEncoder::allocateSlots()
+{
+    // One allocation for every slot, input and output side by side. The sizes are 0 until the
+    // libzoe constructor knows them, so the buffer is not indexed.
+    buffers.resize((size_t)slot_count * (input_size + output_size));
+
+    for (unsigned i=0;i<slot_count;i++)
+    {
+        slots[i].seq.store(i, std::memory_order_relaxed);
+        slots[i].input = buffers.data() + (size_t)i * (input_size + output_size);
+        slots[i].output = slots[i].input + input_size;
+        slots[i].size = 0;
+    }
+}
+
+ZoeAsyncEncoder::~ZoeAsyncEncoder()
+{
+    // Frames already queued are still encoded, then the pool tasks let go of this object
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    stopping.store(true);
+    slot_freed.notify_all();
+    tasks_idle.wait(lock, [this]() { return active_tasks.load() == 0; });
+
+    for (unsigned i=0;i<slot_count;i++)
+        zoe_encoder_destroy(slots[i].encoder);
+}
+
+bool ZoeAsyncEncoder::tryReserve(unsigned long long& pos)
+{
+    pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Slot& slot = slots[pos % slot_count];
+        const unsigned long long seq = slot.seq.load(std::memory_order_acquire);
+
+        if (seq == pos)
+        {
+            // Slot is free for this lap, try to claim it
+            if (enqueue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                return true;
+        }
+        else if (seq < pos)
+        {
+            // Still owned by the previous lap: every slot is in flight
+            return false;
+        }
+        else
+        {
+            // Another producer claimed it first
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void ZoeAsyncEncoder::noteInFlight()
+{
+    const unsigned in_flight = (unsigned)(enqueue_pos.load(std::memory_order_relaxed) - complete_pos.load(std::memory_order_relaxed));
+    unsigned current = max_in_flight.load(std::memory_order_relaxed);
+    while (in_flight > current && !max_in_flight.compare_exchange_weak(current, in_flight, std::memory_order_relaxed)) {}
+}
+
+ZoeAsyncEncoder::SubmitResult ZoeAsyncEncoder::submit(const unsigned char* frame, bool wait)
+{
+    unsigned long long pos;
+
+    while (!tryReserve(pos))
+    {
+        if (stopping.load())
+            return Stopped;
+
+        if (!wait)
+        {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            return QueueFull;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        slot_freed.wait(lock, [this]() {
+            const unsigned long long pos = enqueue_pos.load();
+            return stopping.load() || slots[pos % slot_count].seq.load() == pos;
+        });
+    }
+
+    memcpy(slots[pos % slot_count].input, frame, input_size);
+    commit(pos);
+
+    return Submitted;
+}
+
+unsigned char* ZoeAsyncEncoder::reserve(unsigned long long* index)
+{
+    unsigned long long pos;
+    if (stopping.load() || !tryReserve(pos))
+    {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    if (index)
+        *index = pos;
+    return slots[pos % slot_count].input;
+}
+
+void ZoeAsyncEncoder::commit(unsigned long long index)
+{
+    slots[index % slot_count].seq.store(index+1);
+    noteInFlight();
+    scheduleEncode();
+}
+
+bool ZoeAsyncEncoder::frameQueued() const
+{
+    const unsigned long long pos = encode_pos.load();
+    return slots[pos % slot_count].seq.load() == pos+1;
+}
+
+void ZoeAsyncEncoder::scheduleEncode()
+{
+    // One pool task per frame being encoded, up to max_tasks. A task keeps going while frames
+    // are queued, so a burst of frames does not cost one task each.
+    int active = active_tasks.load();
+    while (active < max_tasks)
+    {
+        if (active_tasks.compare_exchange_weak(active, active+1))
+        {
+            ZoeThreadPool::instance().submit(task_priority, &ZoeAsyncEncoder::encodeTask, this);
+            return;
+        }
+    }
+}
+
+bool ZoeAsyncEncoder::encodeNext()
+{
+    for (;;)
+    {
+        unsigned long long pos = encode_pos.load(std::memory_order_relaxed);
+        Slot& slot = slots[pos % slot_count];
+
+        if (slot.seq.load(std::memory_order_acquire) != pos+1)
+            return false;
+
+        if (!encode_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+            continue;
+
+        if (slot.encoder)
+        {
+            // The buffers have the sizes of the encoder, it can only fail for lack of memory
+            size_t size = 0;
+            if (zoe_encode(slot.encoder, slot.input, input_size, slot.output, output_size, &size) != ZOE_OK)
+                size = 0;
+            slot.size = (unsigned)size;
+        }
+        else
+            slot.size = compress_func(image_width, image_height, slot.input, slot.output, &slot.context, 0);
+        slot.seq.store(pos+2, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+        }
+        frame_done.notify_all();
+        return true;
+    }
+}
+
+void ZoeAsyncEncoder::encodeTask(void* arg)
+{
+    ZoeAsyncEncoder* encoder = (ZoeAsyncEncoder*)arg;
+
+    for (;;)
+    {
+        while (encoder->encodeNext()) {}
+
+        // Retire under the lock: the destructor cannot complete while we hold it, and a frame
+        // committed after encodeNext() failed is either seen here or schedules a new task.
+        std::lock_guard<std::mutex> lock(encoder->wake_mutex);
+        encoder->active_tasks.fetch_sub(1);
+        if (encoder->frameQueued())
+        {
+            int active = encoder->active_tasks.load();
+            if (active < encoder->max_tasks && encoder->active_tasks.compare_exchange_strong(active, active+1))
+                continue;
+        }
+        encoder->tasks_idle.notify_all();
+        return;
+    }
+}
+
+bool ZoeAsyncEncoder::nextCompleted(ZoeEncodedFrame& frame, bool wait)
+{
+    const unsigned long long pos = complete_pos.load(std::memory_order_relaxed);
+    Slot& slot = slots[pos % slot_count];
+
+    if (slot.seq.load(std::memory_order_acquire) != pos+2)
+    {
+        if (!wait || pos == enqueue_pos.load())
+            return false;
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        frame_done.wait(lock, [&slot, pos]() { return slot.seq.load() == pos+2; });
+    }
+
+    frame.index = pos;
+    frame.data = slot.output;
+    frame.size = slot.size;
+    return true;
+}
+
+void ZoeAsyncEncoder::release()
+{
+    const unsigned long long pos = complete_pos.load(std::memory_order_relaxed);
+    Slot& slot = slots[pos % slot_count];
+
+    if (slot.seq.load(std::memory_order_acquire) != pos+2)
+        return; // nothing to release
+
+    complete_pos.store(pos+1, std::memory_order_relaxed);
+    slot.seq.store(pos+slot_count, std::memory_order_release);
+
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+    }
+    slot_freed.notify_one();
+}
+
+void ZoeAsyncEncoder::flush()
+{
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    frame_done.wait(lock, [this]() {
+        // Workers finish out of order, check every slot that is still owned by the pipeline
+        const unsigned long long end = enqueue_pos.load();
+        for (unsigned long long pos=complete_pos.load();pos<end;pos++)
+            if (slots[pos % slot_count].seq.load() < pos+2)
+                return false;
+        return true;
+    });
+}
+
+ZoeAsyncEncoderStats ZoeAsyncEncoder::stats() const
+{
+    ZoeAsyncEncoderStats s;
+    const unsigned long long submitted = enqueue_pos.load();
+    const unsigned long long completed = complete_pos.load();
+    s.submitted = submitted;
+    s.completed = completed;
+    s.rejected = rejected.load();
+    s.in_flight = (unsigned)(submitted - completed);
+    s.max_in_flight = max_in_flight.load();
+    return s;
+}
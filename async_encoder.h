@@ -0,0 +1,152 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "codec_context.h"
+#include "thread_pool.h"
+#include "zoe.h"
+
+// Same signature as the Compress_X_To_Y functions in codecs.h
+typedef unsigned (*ZoeCompressFunc)(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int in_stride);
+
+struct ZoeEncodedFrame
+{
+    unsigned long long index; // submission order, starts at 0
+    const unsigned char* data;
+    unsigned size;
+};
+
+struct ZoeAsyncEncoderStats
+{
+    unsigned long long submitted;
+    unsigned long long completed;
+    unsigned long long rejected;     // submit() refused because every slot was in flight
+    unsigned in_flight;              // frames submitted but not yet released by the consumer
+    unsigned max_in_flight;          // high-water mark of in_flight
+};
+
+// Pipelined encoder. Frames are copied (or written in place) into a ring of preallocated slots,
+// encoded on the shared ZoeThreadPool, and handed back to the consumer in submission order.
+//
+// Any number of threads may submit frames. A single thread consumes the completed frames.
+// Nothing is allocated after construction, except the codec tables of each slot on its first frame.
+class ZoeAsyncEncoder
+{
+public:
+    enum SubmitResult { Submitted, QueueFull, Stopped };
+
+    // input_size : bytes of one uncompressed frame
+    // output_size : worst case size of one compressed frame
+    // frames_in_flight : slots of the ring, each holding an input and an output buffer. Fewer than
+    //   3 are raised to 3, the smallest ring that tells encoded slots from free ones.
+    // worker_threads : how many frames of this encoder may be encoded at the same time
+    ZoeAsyncEncoder(ZoeCompressFunc compress, unsigned width, unsigned height, unsigned input_size, unsigned output_size, int frames_in_flight, int worker_threads,
+        ZoeThreadPool::Priority priority = ZoeThreadPool::Normal);
+    // Frames encoded through libzoe by one zoe_encoder per slot, sized by zoe_encoder_input_size()
+    // and zoe_encoder_max_output_size(). Throws std::invalid_argument when zoe_encoder_create()
+    // refuses the config, std::bad_alloc when out of memory.
+    ZoeAsyncEncoder(const zoe_encoder_config& config, int frames_in_flight, int worker_threads,
+        ZoeThreadPool::Priority priority = ZoeThreadPool::Normal);
+    ~ZoeAsyncEncoder();
+
+    // Copy a frame into the next free slot and queue it. Returns QueueFull immediately when
+    // all slots are in flight, unless wait is true.
+    SubmitResult submit(const unsigned char* frame, bool wait = false);
+
+    // Zero-copy submission: reserve the next free slot, fill its input buffer, then commit it.
+    // Returns null when all slots are in flight (counted as rejected).
+    unsigned char* reserve(unsigned long long* index = 0);
+    void commit(unsigned long long index);
+
+    // Oldest completed frame, in submission order. The data stays valid until release().
+    bool nextCompleted(ZoeEncodedFrame& frame, bool wait);
+    void release();
+
+    // Block until every submitted frame has been encoded. Reserved slots must be committed first.
+    void flush();
+
+    ZoeAsyncEncoderStats stats() const;
+    int framesInFlight() const { return (int)slot_count; }
+
+private:
+    ZoeAsyncEncoder(const ZoeAsyncEncoder&);
+    ZoeAsyncEncoder& operator=(const ZoeAsyncEncoder&);
+
+    // Each slot walks through the sequence values pos (free), pos+1 (queued), pos+2 (encoded),
+    // and back to pos+slot_count (free for the next lap) when the consumer releases it. There are
+    // at least 3 slots, with 2 an encoded slot would look free for the next lap.
+    struct Slot
+    {
+        std::atomic<unsigned long long> seq;
+        unsigned char* input;
+        unsigned char* output;
+        unsigned size;           // 0 when libzoe ran out of memory
+        ZoeCodecContext context; // codec tables, reused by every frame that goes through the slot
+        zoe_encoder* encoder;    // used instead of compress_func when set, holds its own tables
+    };
+
+    void allocateSlots();
+
+    bool tryReserve(unsigned long long& pos);
+    void noteInFlight();
+    void scheduleEncode();
+    bool encodeNext();
+    bool frameQueued() const;
+    static void encodeTask(void* arg);
+
+    ZoeCompressFunc compress_func;
+    unsigned image_width;
+    unsigned image_height;
+    unsigned input_size;
+    unsigned output_size;
+
+    unsigned slot_count;
+    std::vector<Slot> slots;
+    std::vector<unsigned char> buffers;
+
+    std::atomic<unsigned long long> enqueue_pos;  // next slot handed to a producer
+    std::atomic<unsigned long long> encode_pos;   // next slot picked by a worker
+    std::atomic<unsigned long long> complete_pos; // next slot returned to the consumer
+
+    std::atomic<unsigned long long> rejected;
+    std::atomic<unsigned> max_in_flight;
+    std::atomic<bool> stopping;
+
+    // Pool tasks currently encoding frames of this encoder
+    int max_tasks;
+    std::atomic<int> active_tasks;
+    ZoeThreadPool::Priority task_priority;
+
+    // Only used to sleep when there is nothing to do, the ring itself is lock-free
+    std::mutex wake_mutex;
+    std::condition_variable frame_done;
+    std::condition_variable slot_freed;
+    std::condition_variable tasks_idle;
+};
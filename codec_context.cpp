@@ -0,0 +1,68 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "codec_context.h"
+
+ZoeCodecContext::ZoeCodecContext()
+    : entry_count(0)
+{
+    codec_stats.table_cache_hits = 0;
+    codec_stats.table_cache_misses = 0;
+}
+
+ZoeCodecContext::~ZoeCodecContext()
+{
+    reset();
+}
+
+void ZoeCodecContext::reset()
+{
+    for (int i=0;i<entry_count;i++)
+        if (entries[i].instance)
+            entries[i].destroy(entries[i].instance);
+    entry_count = 0;
+}
+
+ZoeCodecContext::Entry& ZoeCodecContext::find(const char* key)
+{
+    for (int i=0;i<entry_count;i++)
+        if (entries[i].key == key)
+            return entries[i];
+
+    // Full: drop the oldest codec, it is the least likely to be used again
+    if (entry_count == MaxCodecs)
+    {
+        if (entries[0].instance)
+            entries[0].destroy(entries[0].instance);
+        for (int i=1;i<entry_count;i++)
+            entries[i-1] = entries[i];
+        entry_count--;
+    }
+
+    Entry& entry = entries[entry_count++];
+    entry.key = key;
+    entry.instance = 0;
+    entry.destroy = 0;
+    return entry;
+}
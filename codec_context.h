@@ -0,0 +1,183 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stddef.h>
+
+#include "tensor_output.h"
+#include "yuv_to_rgb.h"
+
+// Counters of every codec used through a context, for tuning
+struct ZoeCodecStats
+{
+    unsigned long long table_cache_hits;   // decode tables found in the cache
+    unsigned long long table_cache_misses; // decode tables built from the stored tree
+};
+
+// Decoders given a band output write the frame a few rows at a time instead of all at once. Every
+// band is written at the start of the output buffer, laid out like the same rows of a whole frame
+// would be, then handed to written(). Bands come in decoding order: top of the image first, so
+// decreasing output rows for bottom-up outputs.
+struct ZoeBandOutput
+{
+    int rows;   // rows per band, the last one may be shorter
+    bool (*written)(void* user, int first_row, int row_count); // output rows [first_row, first_row+row_count) are ready, false stops decoding
+    void* user;
+};
+
+// Rectangle of the frame a decoder writes instead of the whole frame, to an output laid out like a
+// frame of width x height (bottom-up outputs keep the region bottom-up). Decoding starts from the
+// closest indexed row above y, so the cost follows the height of the region, not the frame.
+struct ZoeRegion
+{
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Settings of the encodes and decodes of a stream, handed to a codec in one call each time the
+// context gives it out (see the setters of ZoeCodecContext for each one)
+struct ZoeCodecOptions
+{
+    ZoeCodecOptions()
+        : parallel(true),
+          band_output(0),
+          output_region(0),
+          store_thumbnails(false),
+          transform_colors(false),
+          thumbnail_output(false),
+          color_matrix(ZoeColorBT601),
+          tensor_layout(0),
+          flip_output(false)
+    {}
+
+    bool parallel;
+    const ZoeBandOutput* band_output;
+    const ZoeRegion* output_region;
+    bool store_thumbnails;
+    bool transform_colors;
+    bool thumbnail_output;
+    ZoeColorMatrix color_matrix;
+    const ZoeTensorLayout* tensor_layout;
+    bool flip_output;
+};
+
+// State of one stream (one VfW driver instance, one async encoder slot, ...): the codec instances
+// with their tables and scratch buffers. Each codec type is allocated the first time a frame of that
+// type goes through the context, following frames reuse it and do not allocate.
+//
+// A context must only be used by one thread at a time.
+class ZoeCodecContext
+{
+public:
+    ZoeCodecContext();
+    ~ZoeCodecContext();
+
+    // Codec instance of type Codec, set up for a frame of width x height
+    template <typename Codec>
+    Codec& codec(int width, int height)
+    {
+        Entry& entry = find(&TypeKey<Codec>::key);
+        if (!entry.instance)
+        {
+            entry.instance = new Codec(width, height);
+            entry.destroy = &destroyCodec<Codec>;
+            ((Codec*)entry.instance)->setStats(&codec_stats);
+        }
+
+        Codec* instance = (Codec*)entry.instance;
+        instance->setSize(width, height);
+        instance->setOptions(options);
+        return *instance;
+    }
+
+    const ZoeCodecStats& stats() const { return codec_stats; }
+
+    // Whether codecs may spread a frame over the shared thread pool (the default), or must stay on
+    // the calling thread, for callers that run one stream per core themselves
+    void setParallel(bool allow) { options.parallel = allow; }
+
+    // Band output of the following decodes, NULL to decode whole frames (the default)
+    void setBandOutput(const ZoeBandOutput* bands) { options.band_output = bands; }
+
+    // Region of the following decodes, NULL to decode whole frames (the default)
+    void setRegion(const ZoeRegion* region) { options.output_region = region; }
+
+    // Whether encoders store a 1/8 scale thumbnail in each frame, off by default
+    void setThumbnails(bool store) { options.store_thumbnails = store; }
+
+    // Whether encoders of 16 bit RGB(A) frames code blue and red as their difference to green, off
+    // by default
+    void setColorTransform(bool transform) { options.transform_colors = transform; }
+
+    // Whether the following decodes write the thumbnail of the frame instead of the frame
+    void setThumbnailOutput(bool thumbnail) { options.thumbnail_output = thumbnail; }
+
+    // Matrix of the following UYVY to RGB decodes, BT.601 by default
+    void setColorMatrix(ZoeColorMatrix matrix) { options.color_matrix = matrix; }
+
+    // Planes and normalization of the following planar float decodes, NULL for the sample values in
+    // planes back to back (the default)
+    void setTensorLayout(const ZoeTensorLayout* layout) { options.tensor_layout = layout; }
+
+    // Whether the following decodes write their rows in the opposite order of their output format,
+    // off by default: top-down outputs bottom-up, and RGB from gray, UYVY or 16 bit RGB top-down
+    void setFlipOutput(bool flip) { options.flip_output = flip; }
+
+    // Free every codec instance, for instance when the stream format changes
+    void reset();
+
+private:
+    ZoeCodecContext(const ZoeCodecContext&);
+    ZoeCodecContext& operator=(const ZoeCodecContext&);
+
+    // One writable variable per type; unlike functions, these are never merged by the linker
+    template <typename Codec>
+    struct TypeKey { static char key; };
+
+    template <typename Codec>
+    static void destroyCodec(void* instance) { delete (Codec*)instance; }
+
+    struct Entry
+    {
+        const char* key;
+        void* instance;
+        void (*destroy)(void* instance);
+    };
+
+    Entry& find(const char* key);
+
+    // A stream rarely sees more than one codec type, a handful of entries is plenty
+    static const int MaxCodecs = 8;
+    Entry entries[MaxCodecs];
+    int entry_count;
+
+    ZoeCodecStats codec_stats;
+    ZoeCodecOptions options;
+};
+
+template <typename Codec>
+char ZoeCodecContext::TypeKey<Codec>::key;
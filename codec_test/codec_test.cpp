@@ -23,11 +23,20 @@
 // ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <vector>
+#include <algorithm>
 #include <cstdlib>
+#include <stdexcept>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 
 #include "../codecs.h"
 #include "../huffman.h"
+#include "../async_encoder.h"
+#include "../codec_context.h"
+#include "../thread_pool.h"
+#include "../yuv_to_rgb.h"
+#include "../zoe.h"
 
 
 class TestBitPacker
@@ -136,11 +145,575 @@ void print_binary(T b)
         printf("%c", (b&(1<<i))?'1':'0');
 }
 
+// Encode and decode one frame through padded and bottom-up rows, the compressed frame and the
+// decoded rows must match the ones of tightly packed buffers. Returns false on error.
+bool checkStrides(zoe_format format, zoe_pixel_format input, zoe_pixel_format output, unsigned flags, unsigned width, unsigned height, bool noise)
+{
+    zoe_encoder_config encoder_config = { format, input, width, height, ZOE_THREADS_SHARED_POOL, 0 };
+    zoe_decoder_config decoder_config = { format, output, width, height, ZOE_THREADS_SHARED_POOL, flags, 0 };
+    zoe_encoder* encoder = 0;
+    zoe_decoder* decoder = 0;
+    zoe_encoder_create(&encoder_config, &encoder);
+    zoe_decoder_create(&decoder_config, &decoder);
+    if (!encoder || !decoder)
+    {
+        printf("Error, cannot create format %d\n", format);
+        return false;
+    }
+
+    // Packed reference
+    const unsigned in_row = (unsigned)zoe_encoder_input_size(encoder) / height;
+    const unsigned out_row = (unsigned)zoe_decoder_output_size(decoder) / height;
+    std::vector<unsigned char> input_data(zoe_encoder_input_size(encoder));
+    if (noise)
+        for (size_t i=0;i<input_data.size();i++)
+            input_data[i] = rand()&0xFF;
+    else
+        fillSemiRandom(&input_data[0], (unsigned)input_data.size());
+    std::vector<unsigned char> reference(zoe_encoder_max_output_size(encoder));
+    std::vector<unsigned char> reference_output(zoe_decoder_output_size(decoder));
+    size_t reference_size = 0;
+    zoe_encode(encoder, &input_data[0], input_data.size(), &reference[0], reference.size(), &reference_size);
+    zoe_decode(decoder, &reference[0], reference_size, &reference_output[0], reference_output.size());
+    zoe_encoder_destroy(encoder);
+    zoe_decoder_destroy(decoder);
+
+    const int pads[] = { 12, 2 };
+    for (int p=0;p<2;p++)
+    {
+        for (int sign=1;sign>=-1;sign-=2)
+        {
+            const int in_stride = sign * (int)(in_row + pads[p]);
+            const int out_stride = sign * (int)(out_row + pads[p]);
+            encoder_config.input_stride = in_stride;
+            decoder_config.output_stride = out_stride;
+            if (zoe_encoder_create(&encoder_config, &encoder) != ZOE_OK || zoe_decoder_create(&decoder_config, &decoder) != ZOE_OK)
+            {
+                printf("Error, stride %d refused\n", in_stride);
+                return false;
+            }
+
+            // Row y of a buffer with a negative stride is counted from the end of the buffer
+            std::vector<unsigned char> strided_input(zoe_encoder_input_size(encoder), 0xCD);
+            for (unsigned y=0;y<height;y++)
+            {
+                const unsigned row = sign > 0 ? y : height-1-y;
+                memcpy(&strided_input[row*(in_row + pads[p])], &input_data[y*in_row], in_row);
+            }
+
+            std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+            size_t size = 0;
+            zoe_encode(encoder, &strided_input[0], strided_input.size(), &compressed[0], compressed.size(), &size);
+            if (size != reference_size || memcmp(&compressed[0], &reference[0], size) != 0)
+            {
+                printf("Error, format %d frame coded from stride %d differs\n", format, in_stride);
+                return false;
+            }
+
+            std::vector<unsigned char> strided_output(zoe_decoder_output_size(decoder), 0xCD);
+            zoe_decode(decoder, &compressed[0], size, &strided_output[0], strided_output.size());
+            for (unsigned y=0;y<height;y++)
+            {
+                const unsigned row = sign > 0 ? y : height-1-y;
+                const unsigned char* dest_row = &strided_output[row*(out_row + pads[p])];
+                if (memcmp(dest_row, &reference_output[y*out_row], out_row) != 0)
+                {
+                    printf("Error, format %d row %d decoded to stride %d differs\n", format, y, out_stride);
+                    return false;
+                }
+                for (int x=0;x<pads[p] && y+1<height;x++)
+                    if (strided_output[(sign > 0 ? row : row-1)*(out_row + pads[p]) + out_row + x] != 0xCD)
+                    {
+                        printf("Error, format %d wrote in the padding of row %d\n", format, y);
+                        return false;
+                    }
+            }
+
+            zoe_encoder_destroy(encoder);
+            zoe_decoder_destroy(decoder);
+        }
+    }
+
+    return true;
+}
+
+// Bands of zoe_decode_bands put back together into a packed frame
+struct BandCollector
+{
+    std::vector<unsigned char> frame;
+    std::vector<int> row_writes;
+    unsigned row_size;
+    unsigned band_rows;
+    int stride;
+    unsigned calls;
+    unsigned stop_after; // 0 to take every band
+};
+
+int collectBand(void* user, const void* band, unsigned first_row, unsigned row_count)
+{
+    BandCollector* collector = (BandCollector*)user;
+    const unsigned pitch = collector->stride ? abs(collector->stride) : collector->row_size;
+    for (unsigned i=0;i<row_count;i++)
+    {
+        // Row 0 of a bottom-up band buffer is at its end
+        const unsigned row = collector->stride < 0 ? collector->band_rows-1-i : i;
+        memcpy(&collector->frame[(first_row+i)*collector->row_size], (const unsigned char*)band + row*pitch, collector->row_size);
+        collector->row_writes[first_row+i]++;
+    }
+    return ++collector->calls != collector->stop_after;
+}
+
+// Decode one frame in bands of band_rows rows, every output row must come exactly once and match
+// the whole frame decode. pad < 0 for bottom-up bands with rows of |pad| extra bytes.
+bool checkBands(zoe_format format, zoe_pixel_format input, zoe_pixel_format output, unsigned flags, unsigned width, unsigned height, unsigned band_rows, int pad, bool noise)
+{
+    zoe_encoder_config encoder_config = { format, input, width, height, ZOE_THREADS_SHARED_POOL, 0 };
+    zoe_decoder_config decoder_config = { format, output, width, height, ZOE_THREADS_SHARED_POOL, flags, 0 };
+    zoe_encoder* encoder = 0;
+    zoe_decoder* decoder = 0;
+    zoe_encoder_create(&encoder_config, &encoder);
+    zoe_decoder_create(&decoder_config, &decoder);
+    if (!encoder || !decoder)
+    {
+        printf("Error, cannot create format %d\n", format);
+        return false;
+    }
+
+    std::vector<unsigned char> input_data(zoe_encoder_input_size(encoder));
+    if (noise)
+        for (size_t i=0;i<input_data.size();i++)
+            input_data[i] = rand()&0xFF;
+    else
+        fillSemiRandom(&input_data[0], (unsigned)input_data.size());
+    std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+    std::vector<unsigned char> reference(zoe_decoder_output_size(decoder));
+    size_t size = 0;
+    zoe_encode(encoder, &input_data[0], input_data.size(), &compressed[0], compressed.size(), &size);
+    zoe_decode(decoder, &compressed[0], size, &reference[0], reference.size());
+    zoe_encoder_destroy(encoder);
+    zoe_decoder_destroy(decoder);
+
+    BandCollector collector;
+    collector.row_size = (unsigned)reference.size() / height;
+    collector.band_rows = band_rows;
+    collector.stride = pad ? -(int)(collector.row_size - pad) : 0;
+    collector.calls = 0;
+    collector.stop_after = 0;
+    collector.frame.assign(reference.size(), 0xCD);
+    collector.row_writes.assign(height, 0);
+
+    decoder_config.output_stride = collector.stride;
+    if (zoe_decoder_create(&decoder_config, &decoder) != ZOE_OK)
+    {
+        printf("Error, format %d refused stride %d\n", format, collector.stride);
+        return false;
+    }
+
+    std::vector<unsigned char> band(zoe_decoder_band_size(decoder, band_rows));
+    if (zoe_decode_bands(decoder, &compressed[0], size, &band[0], band.size()-1, band_rows, collectBand, &collector) != ZOE_ERROR_BUFFER_TOO_SMALL ||
+        zoe_decode_bands(decoder, &compressed[0], size, &band[0], band.size(), band_rows, collectBand, &collector) != ZOE_OK)
+    {
+        printf("Error, format %d band decode failed\n", format);
+        return false;
+    }
+
+    const unsigned band_count = (height + band_rows - 1) / band_rows;
+    if (collector.calls != band_count || collector.frame != reference ||
+        std::count(collector.row_writes.begin(), collector.row_writes.end(), 1) != (int)height)
+    {
+        printf("Error, format %d decoded in bands of %d rows differs (%d bands)\n", format, band_rows, collector.calls);
+        return false;
+    }
+
+    // The callback stops the frame
+    collector.calls = 0;
+    collector.stop_after = 2;
+    if (band_count > 2 && (zoe_decode_bands(decoder, &compressed[0], size, &band[0], band.size(), band_rows, collectBand, &collector) != ZOE_OK || collector.calls != 2))
+    {
+        printf("Error, format %d did not stop after 2 bands\n", format);
+        return false;
+    }
+
+    zoe_decoder_destroy(decoder);
+    return true;
+}
+
+// Decode a region of a frame, it must match the same pixels of the whole frame decode. pad < 0 for a
+// bottom-up region buffer with rows of |pad| extra bytes.
+bool checkRegion(zoe_format format, zoe_pixel_format input, zoe_pixel_format output, unsigned flags, bool bottom_up,
+                 unsigned width, unsigned height, unsigned x, unsigned y, unsigned region_width, unsigned region_height, int pad, bool noise)
+{
+    zoe_encoder_config encoder_config = { format, input, width, height, ZOE_THREADS_SHARED_POOL, 0 };
+    zoe_decoder_config decoder_config = { format, output, width, height, ZOE_THREADS_SHARED_POOL, flags, 0 };
+    zoe_encoder* encoder = 0;
+    zoe_decoder* decoder = 0;
+    zoe_encoder_create(&encoder_config, &encoder);
+    zoe_decoder_create(&decoder_config, &decoder);
+    if (!encoder || !decoder)
+    {
+        printf("Error, cannot create format %d\n", format);
+        return false;
+    }
+
+    std::vector<unsigned char> input_data(zoe_encoder_input_size(encoder));
+    if (noise)
+        for (size_t i=0;i<input_data.size();i++)
+            input_data[i] = rand()&0xFF;
+    else
+        fillSemiRandom(&input_data[0], (unsigned)input_data.size());
+    std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+    std::vector<unsigned char> reference(zoe_decoder_output_size(decoder));
+    size_t size = 0;
+    zoe_encode(encoder, &input_data[0], input_data.size(), &compressed[0], compressed.size(), &size);
+    zoe_decode(decoder, &compressed[0], size, &reference[0], reference.size());
+    zoe_encoder_destroy(encoder);
+    zoe_decoder_destroy(decoder);
+
+    const unsigned pixel_size = (unsigned)reference.size() / (width * height);
+    const unsigned row_size = region_width * pixel_size;
+    const int stride = pad ? -(int)(width * pixel_size - pad) : 0;
+    decoder_config.output_stride = stride;
+    if (zoe_decoder_create(&decoder_config, &decoder) != ZOE_OK)
+    {
+        printf("Error, format %d refused stride %d\n", format, stride);
+        return false;
+    }
+
+    std::vector<unsigned char> region(zoe_decoder_region_size(decoder, region_width, region_height), 0xCD);
+    if (zoe_decode_region(decoder, &compressed[0], size, x, y, region_width, region_height, &region[0], region.size()) != ZOE_OK)
+    {
+        printf("Error, format %d region decode failed\n", format);
+        return false;
+    }
+
+    // Rows in memory order, the region of a bottom-up output is bottom-up too
+    const unsigned first_row = bottom_up ? height - y - region_height : y;
+    const unsigned pitch = stride ? (unsigned)-stride : row_size;
+    for (unsigned r=0;r<region_height;r++)
+    {
+        const unsigned memory_row = stride < 0 ? region_height-1-r : r;
+        const unsigned char* region_row = &region[memory_row * pitch];
+        if (memcmp(region_row, &reference[((first_row + r) * width + x) * pixel_size], row_size) != 0)
+        {
+            printf("Error, format %d region row %d differs\n", format, r);
+            return false;
+        }
+        if (stride && memory_row+1<region_height && region_row[pitch-1] != 0xCD)
+        {
+            printf("Error, format %d wrote past region row %d\n", format, r);
+            return false;
+        }
+    }
+
+    if (zoe_decode_region(decoder, &compressed[0], size, x, y, width, region_height, &region[0], region.size()) != ZOE_ERROR_INVALID_ARGUMENT && x > 0)
+    {
+        printf("Error, format %d accepted a region past the frame\n", format);
+        return false;
+    }
+
+    zoe_decoder_destroy(decoder);
+    return true;
+}
+
+// Encode one frame with a thumbnail, zoe_decode_thumbnail must give the 8x8 block averages of the
+// frame, decoded like a frame of the thumbnail size. The full frame decode must not change.
+bool checkThumbnail(zoe_format format, zoe_pixel_format input, zoe_pixel_format output, unsigned flags, unsigned width, unsigned height, bool noise)
+{
+    zoe_encoder_config encoder_config = { format, input, width, height, ZOE_THREADS_SHARED_POOL, 0, ZOE_ENCODE_THUMBNAIL };
+    zoe_decoder_config decoder_config = { format, output, width, height, ZOE_THREADS_SHARED_POOL, flags, 0 };
+    zoe_encoder* encoder = 0;
+    zoe_decoder* decoder = 0;
+    zoe_encoder_create(&encoder_config, &encoder);
+    zoe_decoder_create(&decoder_config, &decoder);
+    if (!encoder || !decoder)
+    {
+        printf("Error, cannot create format %d\n", format);
+        return false;
+    }
+
+    std::vector<unsigned char> input_data(zoe_encoder_input_size(encoder));
+    if (noise)
+        for (size_t i=0;i<input_data.size();i++)
+            input_data[i] = rand()&0xFF;
+    else
+        fillSemiRandom(&input_data[0], (unsigned)input_data.size());
+    std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+    std::vector<unsigned char> output_data(zoe_decoder_output_size(decoder));
+    size_t size = 0;
+    zoe_encode(encoder, &input_data[0], input_data.size(), &compressed[0], compressed.size(), &size);
+    zoe_encoder_destroy(encoder);
+    zoe_decode(decoder, &compressed[0], size, &output_data[0], output_data.size());
+
+    // Same frame without the thumbnail
+    encoder_config.flags = 0;
+    zoe_encoder_create(&encoder_config, &encoder);
+    std::vector<unsigned char> plain(zoe_encoder_max_output_size(encoder));
+    std::vector<unsigned char> plain_output(output_data.size());
+    size_t plain_size = 0;
+    zoe_encode(encoder, &input_data[0], input_data.size(), &plain[0], plain.size(), &plain_size);
+    zoe_encoder_destroy(encoder);
+    zoe_decode(decoder, &plain[0], plain_size, &plain_output[0], plain_output.size());
+    if (plain_output != output_data)
+    {
+        printf("Error, format %d frame with a thumbnail decoded differently\n", format);
+        return false;
+    }
+
+    unsigned thumbnail_width = 0, thumbnail_height = 0;
+    std::vector<unsigned char> thumbnail(zoe_decoder_thumbnail_size(decoder, &thumbnail_width, &thumbnail_height), 0xCD);
+    if (thumbnail.empty() || thumbnail_height != (height+7)/8 ||
+        zoe_decode_thumbnail(decoder, &compressed[0], size, &thumbnail[0], thumbnail.size()-1) != ZOE_ERROR_BUFFER_TOO_SMALL ||
+        zoe_decode_thumbnail(decoder, &compressed[0], size, &thumbnail[0], thumbnail.size()) != ZOE_OK)
+    {
+        printf("Error, format %d thumbnail decode failed\n", format);
+        return false;
+    }
+
+    // Frames stored raw have their thumbnail computed, the others have none without the flag
+    const bool plain_raw = (plain[3] & 0x80) && (plain[0] & 0x02);
+    const zoe_status plain_status = zoe_decode_thumbnail(decoder, &plain[0], plain_size, &output_data[0], output_data.size());
+    if (plain_status != (plain_raw ? ZOE_OK : ZOE_ERROR_NO_THUMBNAIL) || (noise && !plain_raw))
+    {
+        printf("Error, format %d thumbnail of a frame without one: %s\n", format, zoe_status_string(plain_status));
+        return false;
+    }
+
+    // Block averages of the coded samples, HUYVY blocks average the U, V and Y of each parity apart
+    const unsigned sample_size = (input == ZOE_PIXEL_Y10 || input == ZOE_PIXEL_Y12 || input == ZOE_PIXEL_Y14 || input == ZOE_PIXEL_Y16 ||
+                                  input == ZOE_PIXEL_RGB48 || input == ZOE_PIXEL_RGBA64) ? 2 : 1;
+    const unsigned channels = (unsigned)(input_data.size() / ((size_t)width * height * sample_size));
+    const unsigned mask = format == ZOE_FORMAT_HY10 ? 0x3FF : format == ZOE_FORMAT_HY12 ? 0xFFF :
+        format == ZOE_FORMAT_HY14 ? 0x3FFF : sample_size == 2 ? 0xFFFF : 0xFF;
+    const unsigned period = format == ZOE_FORMAT_HUYVY ? 2 : 1;
+    std::vector<unsigned char> expected((size_t)thumbnail_width * thumbnail_height * channels * sample_size);
+    for (unsigned ty=0;ty<thumbnail_height;ty++)
+        for (unsigned tx=0;tx<thumbnail_width;tx++)
+            for (unsigned c=0;c<channels;c++)
+            {
+                unsigned sum = 0, count = 0;
+                for (unsigned y=ty*8;y<ty*8+8 && y<height;y++)
+                    for (unsigned x=(tx/period)*8*period + tx%period;x<(tx/period+1)*8*period && x<width;x+=period)
+                    {
+                        const size_t i = ((size_t)y*width + x)*channels + c;
+                        sum += (sample_size == 2 ? input_data[i*2] | (input_data[i*2+1] << 8) : input_data[i]) & mask;
+                        count++;
+                    }
+                const unsigned average = (sum + count/2) / count;
+                const size_t i = ((size_t)ty*thumbnail_width + tx)*channels + c;
+                if (sample_size == 2)
+                {
+                    expected[i*2] = average & 0xFF;
+                    expected[i*2+1] = average >> 8;
+                }
+                else
+                    expected[i] = average;
+            }
+
+    // The expected thumbnail as a frame of its own, through the same output conversion
+    zoe_encoder_config small_encoder_config = { format, input, thumbnail_width, thumbnail_height, ZOE_THREADS_CALLER, 0 };
+    zoe_decoder_config small_decoder_config = { format, output, thumbnail_width, thumbnail_height, ZOE_THREADS_CALLER, flags, 0 };
+    zoe_decoder* small_decoder = 0;
+    zoe_encoder_create(&small_encoder_config, &encoder);
+    zoe_decoder_create(&small_decoder_config, &small_decoder);
+    std::vector<unsigned char> small(zoe_encoder_max_output_size(encoder));
+    std::vector<unsigned char> reference(zoe_decoder_output_size(small_decoder));
+    size_t small_size = 0;
+    zoe_encode(encoder, &expected[0], expected.size(), &small[0], small.size(), &small_size);
+    zoe_decode(small_decoder, &small[0], small_size, &reference[0], reference.size());
+    zoe_encoder_destroy(encoder);
+    zoe_decoder_destroy(small_decoder);
+    if (reference != thumbnail)
+    {
+        printf("Error, format %d thumbnail differs\n", format);
+        return false;
+    }
+
+    zoe_decoder_destroy(decoder);
+    return true;
+}
+
+float halfToFloat(unsigned short h)
+{
+    const int exponent = (h >> 10) & 0x1F;
+    const int mantissa = h & 0x3FF;
+    float value;
+    if (exponent == 0)
+        value = ldexpf((float)mantissa, -24);
+    else if (exponent == 31)
+        value = mantissa ? NAN : INFINITY;
+    else
+        value = ldexpf((float)(mantissa | 0x400), exponent - 25);
+    return (h & 0x8000) ? -value : value;
+}
+
+// Sample of plane p at (x, y) of a frame encoded from input, before normalization. RGB planes of
+// UYVY are not samples, they are checked apart.
+unsigned tensorSample(zoe_format format, const std::vector<unsigned char>& input, unsigned width, unsigned p, unsigned x, unsigned y)
+{
+    const size_t pixel = (size_t)y*width + x;
+    switch (format)
+    {
+    case ZOE_FORMAT_HY10:   return ((const unsigned short*)&input[0])[pixel] & 0x3FF;
+    case ZOE_FORMAT_HY12:   return ((const unsigned short*)&input[0])[pixel] & 0xFFF;
+    case ZOE_FORMAT_HRGB24: return input[pixel*3 + 2-p];
+    case ZOE_FORMAT_HRGB32: return input[pixel*4 + (p<3 ? 2-p : p)];
+    case ZOE_FORMAT_HUYVY:
+        if (p == 0)
+            return input[pixel*2 + 1];
+        return input[(((size_t)y*width + (x&~1u)) + p-1)*2];
+    default:                return input[pixel];
+    }
+}
+
+// Frame decoded to float planes: the plain decode gives the samples, zoe_decode_tensor normalizes them
+// into padded rows then into interleaved rows, and a region decode gives the same values
+bool checkTensor(zoe_format format, zoe_pixel_format input, zoe_pixel_format output, unsigned width, unsigned height, bool noise)
+{
+    zoe_encoder_config encoder_config = { format, input, width, height, ZOE_THREADS_SHARED_POOL, 0, 0 };
+    zoe_decoder_config decoder_config = { format, output, width, height, ZOE_THREADS_SHARED_POOL, 0, 0 };
+    zoe_encoder* encoder = 0;
+    zoe_decoder* decoder = 0;
+    zoe_encoder_create(&encoder_config, &encoder);
+    zoe_decoder_create(&decoder_config, &decoder);
+    if (!encoder || !decoder)
+    {
+        printf("Error, cannot create format %d\n", format);
+        return false;
+    }
+
+    std::vector<unsigned char> input_data(zoe_encoder_input_size(encoder));
+    if (input == ZOE_PIXEL_Y10)
+        fillSemiRandom10((unsigned short*)&input_data[0], width*height);
+    else if (input == ZOE_PIXEL_Y12)
+        fillSemiRandom12((unsigned short*)&input_data[0], width*height);
+    else if (noise)
+        for (size_t i=0;i<input_data.size();i++)
+            input_data[i] = rand()&0xFF;
+    else
+        fillSemiRandom(&input_data[0], (unsigned)input_data.size());
+    std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+    size_t size = 0;
+    zoe_encode(encoder, &input_data[0], input_data.size(), &compressed[0], compressed.size(), &size);
+    zoe_encoder_destroy(encoder);
+
+    const bool half = output == ZOE_PIXEL_F16_PLANAR;
+    const unsigned value_size = half ? 2 : 4;
+    const unsigned planes = zoe_decoder_planes(decoder);
+    const float max_sample = (format == ZOE_FORMAT_HY10) ? 1023.0f : (format == ZOE_FORMAT_HY12) ? 4095.0f : 255.0f;
+    if (planes != (format == ZOE_FORMAT_HRGB32 ? 4u : (format == ZOE_FORMAT_HRGB24 || format == ZOE_FORMAT_HUYVY) ? 3u : 1u) ||
+        zoe_decoder_output_size(decoder) != (size_t)planes*width*height*value_size)
+    {
+        printf("Error, format %d has %u planes of %d bytes\n", format, planes, (int)zoe_decoder_output_size(decoder));
+        return false;
+    }
+
+    std::vector<unsigned char> output_data(zoe_decoder_output_size(decoder));
+    if (zoe_decode(decoder, &compressed[0], size, &output_data[0], output_data.size()) != ZOE_OK)
+    {
+        printf("Error, format %d planar decode failed\n", format);
+        return false;
+    }
+
+    // Row pitch and plane stride in values: padded rows, planes apart, then the rows of the planes interleaved
+    const unsigned pitches[3] = { width, width + 5, width*planes + 3 };
+    const size_t plane_strides[3] = { (size_t)width*height, (size_t)(width + 5)*height + 7, width };
+    const float scales[3] = { 1.0f, 1.0f/max_sample, 2.0f/max_sample };
+    const float offsets[3] = { 0.0f, 0.0f, -1.0f };
+    for (int l=0;l<3;l++)
+    {
+        std::vector<unsigned char> tensor;
+        if (l == 0)
+            tensor = output_data;
+        else
+        {
+            const zoe_tensor_layout layout = { scales[l], offsets[l], (int)(pitches[l]*value_size), plane_strides[l]*value_size };
+            tensor.assign(zoe_decoder_tensor_size(decoder, &layout), 0xCD);
+            if (tensor.size() != ((planes-1)*plane_strides[l] + (height-1)*pitches[l] + width)*value_size ||
+                zoe_decode_tensor(decoder, &compressed[0], size, &layout, &tensor[0], tensor.size()-1) != ZOE_ERROR_BUFFER_TOO_SMALL ||
+                zoe_decode_tensor(decoder, &compressed[0], size, &layout, &tensor[0], tensor.size()) != ZOE_OK)
+            {
+                printf("Error, format %d tensor layout %d refused\n", format, l);
+                return false;
+            }
+        }
+
+        std::vector<bool> written(tensor.size() / value_size, false);
+        for (unsigned p=0;p<planes;p++)
+            for (unsigned y=0;y<height;y++)
+                for (unsigned x=0;x<width;x++)
+                {
+                    const size_t index = p*plane_strides[l] + (size_t)y*pitches[l] + x;
+                    const float expected = (float)tensorSample(format, input_data, width, p, x, y) * scales[l] + offsets[l];
+                    const float value = half ? halfToFloat(((const unsigned short*)&tensor[0])[index]) : ((const float*)&tensor[0])[index];
+                    const float tolerance = half ? fabsf(expected) / 2048 + 1.0f/16777216 : fabsf(expected) / 8388608;
+                    if (!(fabsf(value - expected) <= tolerance))
+                    {
+                        printf("Error, format %d layout %d plane %u (%u, %u): %g instead of %g\n", format, l, p, x, y, value, expected);
+                        return false;
+                    }
+                    written[index] = true;
+                }
+        for (size_t i=0;i<written.size();i++)
+            if (!written[i] && (tensor[i*value_size] != 0xCD || tensor[i*value_size + value_size-1] != 0xCD))
+            {
+                printf("Error, format %d layout %d wrote between rows or planes\n", format, l);
+                return false;
+            }
+    }
+
+    // Region planes are as large as the region
+    const unsigned rx = 2, ry = height/3, rw = width/2 & ~1u, rh = height/2;
+    std::vector<unsigned char> region(zoe_decoder_region_size(decoder, rw, rh));
+    if (region.size() != (size_t)planes*rw*rh*value_size ||
+        zoe_decode_region(decoder, &compressed[0], size, rx, ry, rw, rh, &region[0], region.size()) != ZOE_OK)
+    {
+        printf("Error, format %d planar region decode failed\n", format);
+        return false;
+    }
+    for (unsigned p=0;p<planes;p++)
+        for (unsigned y=0;y<rh;y++)
+            if (memcmp(&region[((size_t)p*rh + y)*rw*value_size], &output_data[(((size_t)p*height + ry+y)*width + rx)*value_size], rw*value_size) != 0)
+            {
+                printf("Error, format %d planar region differs in plane %u row %u\n", format, p, y);
+                return false;
+            }
+
+    // Bands would hold rows of every plane
+    std::vector<unsigned char> band(zoe_decoder_band_size(decoder, 8) + 1);
+    if (zoe_decode_bands(decoder, &compressed[0], size, &band[0], band.size(), 8, collectBand, 0) != ZOE_ERROR_UNSUPPORTED)
+    {
+        printf("Error, format %d planar band decode accepted\n", format);
+        return false;
+    }
+
+    zoe_decoder_destroy(decoder);
+    return true;
+}
+
+// Legacy frame decoded in bands through a codec context
+struct LegacyBands
+{
+    const unsigned char* band;
+    unsigned char* frame;
+    int calls;
+};
+
+bool copyLegacyBand(void* user, int first_row, int row_count)
+{
+    LegacyBands* bands = (LegacyBands*)user;
+    memcpy(bands->frame + first_row * 4 * 3, bands->band, row_count * 4 * 3);
+    bands->calls++;
+    return true;
+}
+
 int main(int argc, char **argv)
 {
 
     printf("Zoe Codec Test\n\n");
 
+    // Force a few workers so the parallel paths run even on single core machines
+    ZoeThreadPool::configure(3);
+
     static const int test_width = 64;
     static const int test_height = 64;
 
@@ -455,6 +1028,1686 @@ int main(int argc, char **argv)
         printf("  Passed\n");
     }
 
+    printf("Test 10 and 12 bit gray decoded MSB aligned to Y16 and RGB48\n");
+    {
+        const zoe_format formats[] = { ZOE_FORMAT_HY10, ZOE_FORMAT_HY12 };
+        const zoe_pixel_format inputs[] = { ZOE_PIXEL_Y10, ZOE_PIXEL_Y12 };
+        for (int f=0;f<2;f++)
+        {
+            const int used_bits = f == 0 ? 10 : 12;
+            std::vector<unsigned short> input_data(test_width * test_height);
+            srand(4200 + f);
+            if (f == 0)
+                fillSemiRandom10(&input_data[0], test_width * test_height);
+            else
+                fillSemiRandom12(&input_data[0], test_width * test_height);
+            input_data[0] = (unsigned short)((1<<used_bits)-1); // full scale ends at 0xFFxx
+
+            zoe_encoder_config encoder_config = { formats[f], inputs[f], test_width, test_height, ZOE_THREADS_SHARED_POOL, 0, 0 };
+            zoe_encoder* encoder;
+            zoe_encoder_create(&encoder_config, &encoder);
+            std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+            size_t compressed_size;
+            zoe_encode(encoder, &input_data[0], input_data.size()*2, &compressed[0], compressed.size(), &compressed_size);
+            zoe_encoder_destroy(encoder);
+
+            for (int rgb=0;rgb<2;rgb++)
+            {
+                zoe_decoder_config decoder_config = { formats[f], rgb ? ZOE_PIXEL_RGB48 : ZOE_PIXEL_Y16, test_width, test_height, ZOE_THREADS_SHARED_POOL, 0, 0 };
+                zoe_decoder* decoder;
+                if (zoe_decoder_create(&decoder_config, &decoder) != ZOE_OK)
+                {
+                    printf("Error, format %d has no %s output\n", formats[f], rgb ? "RGB48" : "Y16");
+                    return 1;
+                }
+                const int channels = rgb ? 3 : 1;
+                std::vector<unsigned short> output_data(test_width * test_height * channels);
+                zoe_decode(decoder, &compressed[0], compressed_size, &output_data[0], output_data.size()*2);
+                zoe_decoder_destroy(decoder);
+
+                // Top-down, every channel of a pixel holds the sample in its upper bits
+                for (int i=0;i<test_width * test_height;i++)
+                    for (int c=0;c<channels;c++)
+                        if (output_data[i*channels+c] != (unsigned short)((input_data[i]&((1<<used_bits)-1)) << (16-used_bits)))
+                        {
+                            printf("Error, %d bit to %s at offset %d: %04X from %04X\n", used_bits, rgb ? "RGB48" : "Y16", i, output_data[i*channels+c], input_data[i]);
+                            return 1;
+                        }
+            }
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test grayscale 14 and 16 bit (magnitude class of each residual, then its bits)\n");
+    {
+        for (int used_bits=14;used_bits<=16;used_bits+=2)
+        {
+            const unsigned mask = (1u<<used_bits)-1;
+            const unsigned half = 1u<<(used_bits-1);
+
+            // Slopes with some noise, like a thermal camera, wrapping around the top of the range
+            std::vector<unsigned short> input_data(test_width * test_height);
+            srand(4600 + used_bits);
+            for (int y=0;y<test_height;y++)
+                for (int x=0;x<test_width;x++)
+                    input_data[y*test_width+x] = (unsigned short)((x*397 + y*211 + (rand()&0x3F)) & mask);
+
+            // Largest residuals both ways: half the range up and down, full scale to 0 and back
+            const unsigned short extremes[] = { 0, (unsigned short)half, 0, (unsigned short)mask, 0, (unsigned short)mask, (unsigned short)(half-1), (unsigned short)mask, (unsigned short)(mask-half) };
+            memcpy(&input_data[0], extremes, sizeof(extremes));
+
+            std::vector<unsigned char> compressed(HuffmanFrameBound(test_width, test_height, 2));
+            const unsigned size = used_bits == 14
+                ? Compress_Y14_To_HY14(test_width, test_height, (const unsigned char *)&input_data[0], &compressed[0])
+                : Compress_Y16_To_HY16(test_width, test_height, (const unsigned char *)&input_data[0], &compressed[0]);
+            if (size >= test_width * test_height * 2)
+            {
+                printf("Error, %d bit frame not compressed (%u bytes)\n", used_bits, size);
+                return 1;
+            }
+
+            std::vector<unsigned short> output_data(test_width * test_height);
+            std::vector<unsigned short> msb_data(test_width * test_height);
+            std::vector<unsigned char> gray_data(test_width * test_height);
+            const bool decoded = used_bits == 14
+                ? Decompress_HY14_To_Y14(size, test_width, test_height, &compressed[0], (unsigned char *)&output_data[0]) &&
+                  Decompress_HY14_To_Y16(size, test_width, test_height, &compressed[0], (unsigned char *)&msb_data[0]) &&
+                  Decompress_HY14_To_Y8(size, test_width, test_height, &compressed[0], &gray_data[0])
+                : Decompress_HY16_To_Y16(size, test_width, test_height, &compressed[0], (unsigned char *)&output_data[0]) &&
+                  Decompress_HY16_To_Y16(size, test_width, test_height, &compressed[0], (unsigned char *)&msb_data[0]) &&
+                  Decompress_HY16_To_Y8(size, test_width, test_height, &compressed[0], &gray_data[0]);
+            if (!decoded)
+            {
+                printf("Error, %d bit frame not decoded\n", used_bits);
+                return 1;
+            }
+
+            for (int i=0;i<test_width * test_height;i++)
+            {
+                if (output_data[i] != input_data[i] || msb_data[i] != (unsigned short)(input_data[i] << (16-used_bits)) ||
+                    gray_data[i] != (unsigned char)(input_data[i] >> (used_bits-8)))
+                {
+                    printf("Error, %d bit at offset %d: %04X %04X %02X from %04X\n", used_bits, i, output_data[i], msb_data[i], gray_data[i], input_data[i]);
+                    return 1;
+                }
+            }
+        }
+
+        // The tables follow the alphabet, not the range of the samples
+        if (sizeof(ZoeHuffmanCodec<short, 16, 1>) > sizeof(ZoeHuffmanCodec<short, 12, 1>))
+        {
+            printf("Error, 16 bit codec larger than the 12 bit one (%u bytes)\n", (unsigned)sizeof(ZoeHuffmanCodec<short, 16, 1>));
+            return 1;
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test effective bit depth (constant low bits, narrow and sparse values)\n");
+    {
+        // 8 bit content, coded as Y8 for reference
+        std::vector<unsigned char> base(test_width * test_height);
+        srand(4700);
+        for (int y=0;y<test_height;y++)
+            for (int x=0;x<test_width;x++)
+                base[y*test_width+x] = (unsigned char)((x*3 + y*5 + (rand()&0x0F)) & 0xFF);
+
+        std::vector<unsigned char> compressed(HuffmanFrameBound(test_width, test_height, 2));
+        const unsigned base_size = Compress_Y8_To_HY8(test_width, test_height, &base[0], &compressed[0]);
+
+        // 0: shifted up to 10 bits, 1: scaled to 10 bits, 2: 12 bits in the top of 16, 3: the same
+        // 12 bits in the bottom, 4: constant odd value
+        unsigned sizes[5];
+        for (int test_case=0;test_case<5;test_case++)
+        {
+            const int used_bits = (test_case<2) ? 10 : (test_case<4) ? 16 : 12;
+            std::vector<unsigned short> input_data(test_width * test_height);
+            for (size_t i=0;i<input_data.size();i++)
+            {
+                const unsigned value12 = base[i]*16 + (base[(i+1)%base.size()]&0x0F);
+                input_data[i] = (unsigned short)(test_case==0 ? base[i]<<2 : test_case==1 ? base[i]*1023/255 :
+                    test_case==2 ? value12<<4 : test_case==3 ? value12 : 0x5A5);
+            }
+
+            const unsigned char * input = (const unsigned char *)&input_data[0];
+            const unsigned size = sizes[test_case] = used_bits == 10 ? Compress_Y10_To_HY10(test_width, test_height, input, &compressed[0])
+                : used_bits == 12 ? Compress_Y12_To_HY12(test_width, test_height, input, &compressed[0])
+                : Compress_Y16_To_HY16(test_width, test_height, input, &compressed[0]);
+
+            std::vector<unsigned short> output_data(test_width * test_height);
+            std::vector<unsigned short> msb_data(test_width * test_height);
+            std::vector<unsigned char> gray_data(test_width * test_height);
+            unsigned char * output = (unsigned char *)&output_data[0];
+            unsigned char * msb = (unsigned char *)&msb_data[0];
+            const bool decoded = used_bits == 10
+                ? Decompress_HY10_To_Y10(size, test_width, test_height, &compressed[0], output) &&
+                  Decompress_HY10_To_Y16(size, test_width, test_height, &compressed[0], msb) &&
+                  Decompress_HY10_To_Y8(size, test_width, test_height, &compressed[0], &gray_data[0])
+                : used_bits == 12
+                ? Decompress_HY12_To_Y12(size, test_width, test_height, &compressed[0], output) &&
+                  Decompress_HY12_To_Y16(size, test_width, test_height, &compressed[0], msb) &&
+                  Decompress_HY12_To_Y8(size, test_width, test_height, &compressed[0], &gray_data[0])
+                : Decompress_HY16_To_Y16(size, test_width, test_height, &compressed[0], output) &&
+                  Decompress_HY16_To_Y16(size, test_width, test_height, &compressed[0], msb) &&
+                  Decompress_HY16_To_Y8(size, test_width, test_height, &compressed[0], &gray_data[0]);
+            if (!decoded)
+            {
+                printf("Error, case %d not decoded\n", test_case);
+                return 1;
+            }
+
+            for (int i=0;i<test_width * test_height;i++)
+            {
+                if (output_data[i] != input_data[i] || msb_data[i] != (unsigned short)(input_data[i] << (16-used_bits)) ||
+                    gray_data[i] != (unsigned char)(input_data[i] >> (used_bits-8)))
+                {
+                    printf("Error, case %d at offset %d: %04X %04X %02X from %04X\n", test_case, i, output_data[i], msb_data[i], gray_data[i], input_data[i]);
+                    return 1;
+                }
+            }
+        }
+
+        // Dropped and remapped bits cost about nothing: shifted or scaled 8 bit content codes like
+        // the 8 bit frame, plus its sample map (and the table of values when scaled). A constant
+        // frame is down to its one bit code per sample.
+        if (sizes[0] > base_size + 64 || sizes[1] > base_size + 256*2 + 64 || sizes[2] > sizes[3] + 64 ||
+            sizes[4] > test_width*test_height/8 + 128)
+        {
+            printf("Error, reduced frames too large: %u %u %u %u %u (8 bit %u)\n", sizes[0], sizes[1], sizes[2], sizes[3], sizes[4], base_size);
+            return 1;
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test bulk unpacking of packed 10 and 12 bit data (odd starts and counts)\n");
+    {
+        for (int bits=10;bits<=12;bits+=2)
+        {
+            std::vector<unsigned short> input_data(1000);
+            for (size_t i=0;i<input_data.size();i++)
+                input_data[i] = (unsigned short)(rand() & ((1<<bits)-1));
+
+            std::vector<unsigned char> packed_buffer(input_data.size()*2);
+            if (bits==10)
+                pack10Bits(input_data, &packed_buffer[0]);
+            else
+                pack12Bits(input_data, &packed_buffer[0]);
+
+            const size_t starts[] = {0, 1, 3, 4, 7};
+            const size_t counts[] = {0, 1, 5, 8, 17, 64, 333, 990};
+            for (int s=0;s<5;s++)
+            {
+                for (int n=0;n<8;n++)
+                {
+                    std::vector<unsigned short> output_data(counts[n]+1, 0xABCD);
+                    if (bits==10)
+                    {
+                        UnpackBitReader<10, unsigned short> reader((const unsigned short *)&packed_buffer[0]);
+                        reader.seek(starts[s]);
+                        reader.read(&output_data[0], counts[n]);
+                        if (counts[n]<990 && reader.next()!=input_data[starts[s]+counts[n]])
+                        {
+                            printf("Error after %d values from %d\n", (int)counts[n], (int)starts[s]);
+                            return 1;
+                        }
+                    }
+                    else
+                    {
+                        UnpackBitReader<12, unsigned short> reader((const unsigned short *)&packed_buffer[0]);
+                        reader.seek(starts[s]);
+                        reader.read(&output_data[0], counts[n]);
+                        if (counts[n]<990 && reader.next()!=input_data[starts[s]+counts[n]])
+                        {
+                            printf("Error after %d values from %d\n", (int)counts[n], (int)starts[s]);
+                            return 1;
+                        }
+                    }
+
+                    if (output_data[counts[n]] != 0xABCD || !std::equal(output_data.begin(), output_data.begin()+counts[n], input_data.begin()+starts[s]))
+                    {
+                        printf("Error unpacking %d values of %d bits from %d\n", (int)counts[n], bits, (int)starts[s]);
+                        return 1;
+                    }
+                }
+            }
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test v210 4:2:2 10 bit (unpacking, HV210 to v210 and to planes)\n");
+    {
+        // Rows ending within a group and on a group boundary, the second half of a group padded
+        const size_t counts[] = {0, 2, 4, 6, 12, 34, 96, 128, 1000};
+        for (int n=0;n<9;n++)
+        {
+            std::vector<unsigned short> samples(counts[n]);
+            for (size_t i=0;i<samples.size();i++)
+                samples[i] = (unsigned short)(rand() & 0x3FF);
+
+            std::vector<unsigned char> packed(V210RowBytes(counts[n]/2) + 16, 0xCD);
+            PackV210(counts[n] ? &samples[0] : 0, &packed[0], counts[n]);
+            std::vector<unsigned short> unpacked(counts[n]+1, 0xABCD);
+            UnpackV210(&packed[0], &unpacked[0], counts[n]);
+
+            if (unpacked[counts[n]] != 0xABCD || !std::equal(samples.begin(), samples.end(), unpacked.begin()) ||
+                packed[packed.size()-16] != 0xCD)
+            {
+                printf("Error packing %d v210 samples\n", (int)counts[n]);
+                return 1;
+            }
+            for (size_t i=(counts[n]+2)/3*4;i<packed.size()-16;i++)
+            {
+                if (packed[i] != 0)
+                {
+                    printf("Error, v210 padding not cleared at byte %d of %d samples\n", (int)i, (int)counts[n]);
+                    return 1;
+                }
+            }
+        }
+
+        // Smooth luma, chroma of a few flat areas. 64 pixels end 4 pixels into a group.
+        const size_t row_bytes = V210RowBytes(test_width);
+        std::vector<unsigned short> samples(test_width * 2 * test_height);
+        srand(4800);
+        for (int y=0;y<test_height;y++)
+        {
+            for (int x=0;x<test_width;x++)
+            {
+                unsigned short * pair = &samples[(y*test_width + x)*2];
+                pair[0] = (unsigned short)((x&1) ? 512 + (y/16)*37 : 480 - (x/32)*91);
+                pair[1] = (unsigned short)((64 + x*7 + y*5 + (rand()&0x0F)) & 0x3FF);
+            }
+        }
+        std::vector<unsigned char> input(row_bytes * test_height);
+        for (int y=0;y<test_height;y++)
+            PackV210(&samples[y*test_width*2], &input[y*row_bytes], test_width*2);
+
+        std::vector<unsigned char> compressed(HuffmanFrameBound(test_width, test_height, 4));
+        const unsigned size = Compress_V210_To_HV210(test_width, test_height, &input[0], &compressed[0]);
+        if (size >= input.size() / 2)
+        {
+            printf("Error, v210 frame not compressed (%u bytes)\n", size);
+            return 1;
+        }
+
+        std::vector<unsigned char> output(input.size(), 0xCD);
+        std::vector<unsigned short> planes(test_width * test_height * 2);
+        if (!Decompress_HV210_To_V210(size, test_width, test_height, &compressed[0], &output[0]) ||
+            !Decompress_HV210_To_YUV422P10(size, test_width, test_height, &compressed[0], (unsigned char *)&planes[0]))
+        {
+            printf("Error, v210 frame not decoded\n");
+            return 1;
+        }
+        if (output != input)
+        {
+            printf("Error, v210 frame decoded to other bytes\n");
+            return 1;
+        }
+
+        const unsigned short * u_plane = &planes[test_width * test_height];
+        const unsigned short * v_plane = u_plane + test_width * test_height / 2;
+        for (int y=0;y<test_height;y++)
+        {
+            for (int x=0;x<test_width;x++)
+            {
+                const unsigned short * pair = &samples[(y*test_width + x)*2];
+                const unsigned short chroma = (x&1) ? v_plane[y*test_width/2 + x/2] : u_plane[y*test_width/2 + x/2];
+                if (planes[y*test_width + x] != pair[1] || chroma != pair[0])
+                {
+                    printf("Error, v210 planes at %d,%d: %03X %03X from %03X %03X\n", x, y, planes[y*test_width + x], chroma, pair[1], pair[0]);
+                    return 1;
+                }
+            }
+        }
+
+        // Regions keep whole U Y V Y pairs
+        const zoe_decoder_config config = { ZOE_FORMAT_HV210, ZOE_PIXEL_YUV422P10, test_width, test_height, ZOE_THREADS_CALLER, 0, 0 };
+        zoe_decoder* decoder = 0;
+        if (zoe_decoder_create(&config, &decoder) != ZOE_OK)
+        {
+            printf("Error, no YUV422P10 decoder\n");
+            return 1;
+        }
+        std::vector<unsigned short> region(8 * 4 * 2);
+        const zoe_status odd_x = zoe_decode_region(decoder, &compressed[0], size, 3, 2, 8, 4, &region[0], region.size()*2);
+        const zoe_status even_x = zoe_decode_region(decoder, &compressed[0], size, 10, 2, 8, 4, &region[0], region.size()*2);
+        zoe_decoder_destroy(decoder);
+        if (odd_x != ZOE_ERROR_INVALID_ARGUMENT || even_x != ZOE_OK || region[0] != planes[2*test_width + 10] ||
+            region[8*4] != u_plane[2*test_width/2 + 5] || region[8*4 + 4*4 + 3*4 + 3] != v_plane[5*test_width/2 + 8])
+        {
+            printf("Error, YUV422P10 region decode %d %d\n", odd_x, even_x);
+            return 1;
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test 16 bit RGB and RGBA (colour transform, constant alpha, RGB32 previews)\n");
+    {
+        const int test_width = 96, test_height = 40;
+        // Shared texture in all channels, as in rendered images
+        std::vector<unsigned short> rgb(test_width * test_height * 3);
+        std::vector<unsigned short> rgba(test_width * test_height * 4);
+        for (int y=0;y<test_height;y++)
+        {
+            for (int x=0;x<test_width;x++)
+            {
+                const int base = 9000 + x*300 + y*200 + (rand()&0x3FF);
+                const unsigned short pixel[4] = { (unsigned short)(base - 700 + (rand()&3)), (unsigned short)base,
+                                                  (unsigned short)(base + 1500 + (rand()&3)), 0xFFFF };
+                std::copy(pixel, pixel + 3, &rgb[(y*test_width + x)*3]);
+                std::copy(pixel, pixel + 4, &rgba[(y*test_width + x)*4]);
+            }
+        }
+        // Blue and red wrapping around below green
+        rgb[5] = 0xFFF0; rgb[3] = 0x0002; rgb[4] = 0xFFFE;
+
+        ZoeCodecContext plain_ctx;
+        ZoeCodecContext transform_ctx;
+        transform_ctx.setColorTransform(true);
+        std::vector<unsigned char> plain(HuffmanFrameBound(test_width, test_height, 6));
+        std::vector<unsigned char> transformed(HuffmanFrameBound(test_width, test_height, 6));
+        std::vector<unsigned char> alpha(HuffmanFrameBound(test_width, test_height, 8));
+        const unsigned plain_size = Compress_RGB48_To_HRGB48(test_width, test_height, (const unsigned char *)&rgb[0], &plain[0], &plain_ctx);
+        const unsigned transformed_size = Compress_RGB48_To_HRGB48(test_width, test_height, (const unsigned char *)&rgb[0], &transformed[0], &transform_ctx);
+        const unsigned alpha_size = Compress_RGBA64_To_HRGBA64(test_width, test_height, (const unsigned char *)&rgba[0], &alpha[0], &transform_ctx);
+        if (plain_size == 0 || transformed_size >= plain_size * 3/4)
+        {
+            printf("Error, colour transform coded %u bytes against %u\n", transformed_size, plain_size);
+            return 1;
+        }
+        if (alpha_size == 0 || alpha_size > transformed_size + 64)
+        {
+            printf("Error, constant alpha costs %u bytes\n", alpha_size - transformed_size);
+            return 1;
+        }
+
+        std::vector<unsigned short> rgb_out(rgb.size(), 0xCDCD);
+        std::vector<unsigned short> rgba_out(rgba.size(), 0xCDCD);
+        if (!Decompress_HRGB48_To_RGB48(plain_size, test_width, test_height, &plain[0], (unsigned char *)&rgb_out[0]) || rgb_out != rgb)
+        {
+            printf("Error, RGB48 frame decoded to other samples\n");
+            return 1;
+        }
+        std::fill(rgb_out.begin(), rgb_out.end(), 0xCDCD);
+        if (!Decompress_HRGB48_To_RGB48(transformed_size, test_width, test_height, &transformed[0], (unsigned char *)&rgb_out[0]) || rgb_out != rgb)
+        {
+            printf("Error, colour transformed RGB48 frame decoded to other samples\n");
+            return 1;
+        }
+        if (!Decompress_HRGBA64_To_RGBA64(alpha_size, test_width, test_height, &alpha[0], (unsigned char *)&rgba_out[0]) || rgba_out != rgba)
+        {
+            printf("Error, RGBA64 frame decoded to other samples\n");
+            return 1;
+        }
+
+        // Previews hold the top 8 bits, bottom-up
+        std::vector<unsigned char> preview(test_width * test_height * 4);
+        const unsigned char * sources[2] = { &transformed[0], &alpha[0] };
+        const unsigned sizes[2] = { transformed_size, alpha_size };
+        for (int n=0;n<2;n++)
+        {
+            const bool decoded = n == 0 ? Decompress_HRGB48_To_RGB32(sizes[n], test_width, test_height, sources[n], &preview[0])
+                                        : Decompress_HRGBA64_To_RGB32(sizes[n], test_width, test_height, sources[n], &preview[0]);
+            if (!decoded)
+            {
+                printf("Error, 16 bit RGB frame %d not decoded to RGB32\n", n);
+                return 1;
+            }
+            for (int y=0;y<test_height;y++)
+            {
+                for (int x=0;x<test_width;x++)
+                {
+                    const unsigned char * out = &preview[((test_height-1-y)*test_width + x)*4];
+                    const unsigned short * in = &rgba[(y*test_width + x)*4];
+                    const unsigned short * rgb_in = &rgb[(y*test_width + x)*3];
+                    for (int c=0;c<4;c++)
+                    {
+                        const unsigned short sample = (c < 3 && n == 0) ? rgb_in[c] : in[c];
+                        if (out[c] != sample >> 8)
+                        {
+                            printf("Error, RGB32 preview of frame %d at %d,%d channel %d: %02X from %04X\n", n, x, y, c, out[c], sample);
+                            return 1;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Older decoders of 16 bit RGB cannot undo the transform
+        const zoe_encoder_config config = { ZOE_FORMAT_HY16, ZOE_PIXEL_Y16, test_width, test_height, ZOE_THREADS_CALLER, 0, ZOE_ENCODE_COLOR_TRANSFORM };
+        zoe_encoder* encoder = 0;
+        if (zoe_encoder_create(&config, &encoder) != ZOE_ERROR_UNSUPPORTED)
+        {
+            printf("Error, colour transform accepted for gray frames\n");
+            return 1;
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test 4:2:0 (I420 and NV12 planes, Y and chroma coded apart, fused RGB32)\n");
+    {
+        const int test_width = 96, test_height = 40;
+        const int chroma_width = test_width/2, chroma_height = test_height/2;
+        const int luma_bytes = test_width * test_height, chroma_bytes = chroma_width * chroma_height;
+        // Textured luma, smooth chroma
+        std::vector<unsigned char> i420(luma_bytes + chroma_bytes*2);
+        std::vector<unsigned char> nv12(i420.size());
+        srand(5000);
+        fillSemiRandom(&i420[0], luma_bytes);
+        for (int y=0;y<chroma_height;y++)
+        {
+            for (int x=0;x<chroma_width;x++)
+            {
+                i420[luma_bytes + y*chroma_width + x] = (unsigned char)(90 + x + (y/4)*9);
+                i420[luma_bytes + chroma_bytes + y*chroma_width + x] = (unsigned char)(180 - x/2 - y);
+            }
+        }
+        std::copy(i420.begin(), i420.begin() + luma_bytes, nv12.begin());
+        for (int i=0;i<chroma_bytes;i++)
+        {
+            nv12[luma_bytes + i*2] = i420[luma_bytes + i];
+            nv12[luma_bytes + i*2 + 1] = i420[luma_bytes + chroma_bytes + i];
+        }
+
+        std::vector<unsigned char> from_i420(HuffmanYuv420FrameBound(test_width, test_height));
+        std::vector<unsigned char> from_nv12(from_i420.size());
+        const unsigned size = Compress_I420_To_HYUV420(test_width, test_height, &i420[0], &from_i420[0]);
+        const unsigned nv12_size = Compress_NV12_To_HYUV420(test_width, test_height, &nv12[0], &from_nv12[0]);
+        if (size == 0 || size % 4 != 0 || nv12_size != size || memcmp(&from_i420[0], &from_nv12[0], size) != 0)
+        {
+            printf("Error, I420 and NV12 frames coded to %u and %u bytes\n", size, nv12_size);
+            return 1;
+        }
+
+        std::vector<unsigned char> output(i420.size(), 0xCD);
+        if (!Decompress_HYUV420_To_I420(size, test_width, test_height, &from_i420[0], &output[0]) || output != i420)
+        {
+            printf("Error, I420 frame decoded to other bytes\n");
+            return 1;
+        }
+        std::fill(output.begin(), output.end(), 0xCD);
+        if (!Decompress_HYUV420_To_NV12(size, test_width, test_height, &from_i420[0], &output[0]) || output != nv12)
+        {
+            printf("Error, NV12 frame decoded to other bytes\n");
+            return 1;
+        }
+
+        // Padded rows, the chroma planes of I420 at half the stride
+        const int stride = test_width + 8;
+        std::vector<unsigned char> strided(stride * test_height * 3/2, 0xCD);
+        if (!Decompress_HYUV420_To_I420(size, test_width, test_height, &from_i420[0], &strided[0], 0, stride))
+        {
+            printf("Error, I420 frame not decoded to stride %d\n", stride);
+            return 1;
+        }
+        for (int y=0;y<test_height;y++)
+        {
+            const unsigned char * chroma_row = &strided[stride*test_height + (y/2)*(stride/2) + (y&1)*(stride/2)*chroma_height];
+            const unsigned char * expected = &i420[luma_bytes + (y/2)*chroma_width + (y&1)*chroma_bytes];
+            if (memcmp(&strided[y*stride], &i420[y*test_width], test_width) != 0 || memcmp(chroma_row, expected, chroma_width) != 0 ||
+                strided[y*stride + test_width] != 0xCD)
+            {
+                printf("Error, I420 row %d decoded to stride %d differs\n", y, stride);
+                return 1;
+            }
+        }
+        std::vector<unsigned char> recoded(from_i420.size());
+        if (Compress_I420_To_HYUV420(test_width, test_height, &strided[0], &recoded[0], 0, stride) != size ||
+            memcmp(&recoded[0], &from_i420[0], size) != 0)
+        {
+            printf("Error, I420 frame coded from stride %d differs\n", stride);
+            return 1;
+        }
+
+        // RGB32 is the UYVY conversion of the frame with each U V pair repeated over 2x2 pixels,
+        // smaller coded as 4:2:0
+        std::vector<unsigned char> uyvy(luma_bytes * 2);
+        for (int y=0;y<test_height;y++)
+        {
+            for (int x=0;x<test_width;x++)
+            {
+                uyvy[(y*test_width + x)*2] = nv12[luma_bytes + (y/2)*test_width + (x&~1) + (x&1)];
+                uyvy[(y*test_width + x)*2 + 1] = i420[y*test_width + x];
+            }
+        }
+        std::vector<unsigned char> uyvy_compressed(HuffmanFrameBound(test_width, test_height, 2));
+        const unsigned uyvy_size = Compress_UYVY_To_HUYVY(test_width, test_height, &uyvy[0], &uyvy_compressed[0]);
+        std::vector<unsigned char> expected_rgb(luma_bytes * 4);
+        std::vector<unsigned char> rgb(luma_bytes * 4, 0xCD);
+        Decompress_HUYVY_To_RGB32(uyvy_size, test_width, test_height, &uyvy_compressed[0], &expected_rgb[0]);
+        if (!Decompress_HYUV420_To_RGB32(size, test_width, test_height, &from_i420[0], &rgb[0]) || rgb != expected_rgb)
+        {
+            printf("Error, 4:2:0 frame decoded to other RGB32 pixels\n");
+            return 1;
+        }
+        if (size >= uyvy_size)
+        {
+            printf("Error, 4:2:0 frame of %u bytes against %u as UYVY\n", size, uyvy_size);
+            return 1;
+        }
+
+        // Regions of whole 2x2 blocks, planes packed at the region size
+        const zoe_decoder_config config = { ZOE_FORMAT_HYUV420, ZOE_PIXEL_NV12, test_width, test_height, ZOE_THREADS_CALLER, 0, 0 };
+        zoe_decoder* decoder = 0;
+        if (zoe_decoder_create(&config, &decoder) != ZOE_OK)
+        {
+            printf("Error, no NV12 decoder\n");
+            return 1;
+        }
+        std::vector<unsigned char> region(16 * 6 * 3/2, 0xCD);
+        std::vector<unsigned char> band(zoe_decoder_band_size(decoder, 8));
+        const zoe_status odd_y = zoe_decode_region(decoder, &from_i420[0], size, 4, 3, 16, 6, &region[0], region.size());
+        const zoe_status even = zoe_decode_region(decoder, &from_i420[0], size, 4, 10, 16, 6, &region[0], region.size());
+        const zoe_status bands = zoe_decode_bands(decoder, &from_i420[0], size, &band[0], band.size(), 8, collectBand, 0);
+        zoe_decoder_destroy(decoder);
+        if (odd_y != ZOE_ERROR_INVALID_ARGUMENT || even != ZOE_OK || bands != ZOE_ERROR_UNSUPPORTED)
+        {
+            printf("Error, NV12 region decode %d %d, bands %d\n", odd_y, even, bands);
+            return 1;
+        }
+        for (int y=0;y<6;y++)
+        {
+            if (memcmp(&region[y*16], &nv12[(10 + y)*test_width + 4], 16) != 0 ||
+                (y < 3 && memcmp(&region[16*6 + y*16], &nv12[luma_bytes + (5 + y)*test_width + 4], 16) != 0))
+            {
+                printf("Error, NV12 region row %d differs\n", y);
+                return 1;
+            }
+        }
+
+        // Odd sizes and thumbnails are refused
+        const zoe_encoder_config odd = { ZOE_FORMAT_HYUV420, ZOE_PIXEL_I420, test_width, test_height - 1, ZOE_THREADS_CALLER, 0, 0 };
+        const zoe_encoder_config thumbnail = { ZOE_FORMAT_HYUV420, ZOE_PIXEL_NV12, test_width, test_height, ZOE_THREADS_CALLER, 0, ZOE_ENCODE_THUMBNAIL };
+        zoe_encoder* encoder = 0;
+        if (zoe_encoder_create(&odd, &encoder) == ZOE_OK || zoe_encoder_create(&thumbnail, &encoder) == ZOE_OK)
+        {
+            printf("Error, 4:2:0 encoder of an odd height or with thumbnails\n");
+            return 1;
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test RGB24 frame written by version 1.1 (single interleaved bitstream)\n");
+    {
+        static const unsigned char legacy_frame[] = {
+            0x03, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x54, 0x00, 0xA8, 0x00, 0x00, 0x80, 0x00, 0x00,
+            0x15, 0x00, 0x01, 0x80, 0x03, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x2F, 0x00, 0xD7, 0x00,
+            0x00, 0x80, 0x83, 0x00, 0x15, 0x00, 0x01, 0x80, 0x03, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+            0x5E, 0x00, 0x06, 0x00, 0x00, 0x80, 0xB2, 0x00, 0x15, 0x00, 0x01, 0x80, 0x00, 0x4F, 0x00, 0xE4,
+            0x00, 0x00, 0x40, 0x5B };
+
+        std::vector<unsigned char> output_data(4 * 3 * 3);
+        Decompress_HRGB24_To_RGB24(sizeof(legacy_frame), 4, 3, legacy_frame, &output_data[0]);
+
+        for (int i=0;i<4 * 3 * 3;i++)
+        {
+            const unsigned char expected = (unsigned char)(i*7 + (i%3)*40);
+            if (output_data[i] != expected)
+            {
+                printf("Error at offset %d, %02X != %02X\n", i, expected, output_data[i]);
+                return 1;
+            }
+        }
+
+        // Same frame into bottom-up rows of 16 bytes
+        std::vector<unsigned char> strided_output(16 * 3, 0xCD);
+        Decompress_HRGB24_To_RGB24(sizeof(legacy_frame), 4, 3, legacy_frame, &strided_output[16 * 2], 0, -16);
+        for (int y=0;y<3;y++)
+        {
+            if (memcmp(&strided_output[16 * (2-y)], &output_data[y * 4 * 3], 4 * 3) != 0 || strided_output[16 * (2-y) + 12] != 0xCD)
+            {
+                printf("Error in row %d decoded with a negative stride\n", y);
+                return 1;
+            }
+        }
+
+        // Same frame in bands of 2 rows
+        std::vector<unsigned char> band(4 * 3 * 2);
+        std::vector<unsigned char> banded_output(4 * 3 * 3, 0xCD);
+        LegacyBands legacy_bands = { &band[0], &banded_output[0], 0 };
+        ZoeBandOutput band_output = { 2, copyLegacyBand, &legacy_bands };
+        ZoeCodecContext band_context;
+        band_context.setBandOutput(&band_output);
+        Decompress_HRGB24_To_RGB24(sizeof(legacy_frame), 4, 3, legacy_frame, &band[0], &band_context);
+        if (legacy_bands.calls != 2 || banded_output != output_data)
+        {
+            printf("Error in the frame decoded in bands\n");
+            return 1;
+        }
+
+        // Pixels 1 to 2 of rows 1 to 2
+        std::vector<unsigned char> region_output(2 * 3 * 2);
+        ZoeRegion region = { 1, 1, 2, 2 };
+        ZoeCodecContext region_context;
+        region_context.setRegion(&region);
+        Decompress_HRGB24_To_RGB24(sizeof(legacy_frame), 4, 3, legacy_frame, &region_output[0], &region_context);
+        for (int y=0;y<2;y++)
+        {
+            if (memcmp(&region_output[y * 2 * 3], &output_data[((y+1) * 4 + 1) * 3], 2 * 3) != 0)
+            {
+                printf("Error in row %d of the region\n", y);
+                return 1;
+            }
+        }
+
+        // Truncated copies: the three trees (60 bytes) must be whole, the bitstream reads zeros past its end
+        for (size_t size=1;size<sizeof(legacy_frame);size++)
+        {
+            std::vector<unsigned char> truncated(legacy_frame, legacy_frame + size);
+            if (Decompress_HRGB24_To_RGB24((unsigned)size, 4, 3, &truncated[0], &output_data[0]) != (size >= 60))
+            {
+                printf("Error, frame truncated to %d bytes\n", (int)size);
+                return 1;
+            }
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test 10 bit gray frame written by version 1.1 decoded to Y16 and RGB48\n");
+    {
+        // One tree of a single node: bit 0 is the residual -1, bit 1 is 0x100
+        static const unsigned char legacy_frame[] = {
+            0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0xE4 };
+        static const unsigned short expected[] = { 0x100, 0x200, 0x300, 0x2FF, 0x3FF, 0x0FF, 0x0FE, 0x0FD };
+
+        for (int rgb=0;rgb<2;rgb++)
+        {
+            zoe_decoder_config decoder_config = { ZOE_FORMAT_HY10, rgb ? ZOE_PIXEL_RGB48 : ZOE_PIXEL_Y16, 4, 2, ZOE_THREADS_SHARED_POOL, 0, 0 };
+            zoe_decoder* decoder;
+            zoe_decoder_create(&decoder_config, &decoder);
+            const int channels = rgb ? 3 : 1;
+            std::vector<unsigned short> output_data(4 * 2 * channels, 0xCDCD);
+            const zoe_status status = zoe_decode(decoder, legacy_frame, sizeof(legacy_frame), &output_data[0], output_data.size()*2);
+            zoe_decoder_destroy(decoder);
+
+            for (int i=0;i<4 * 2 * channels;i++)
+                if (status != ZOE_OK || output_data[i] != (unsigned short)(expected[i/channels] << 6))
+                {
+                    printf("Error, version 1.1 frame to %s at offset %d: %04X\n", rgb ? "RGB48" : "Y16", i, output_data[i]);
+                    return 1;
+                }
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test RGB32 with a constant channel, large enough to code channels in parallel\n");
+    {
+        static const int width = 640;
+        static const int height = 480;
+        static const int nb_channels = 4;
+        std::vector<unsigned char> input_data(width * height * nb_channels, 0);
+        srand(2501);
+        for (int c=0;c<3;c++)
+            fillSemiRandom(&input_data[c], width * height, nb_channels); // alpha stays 0
+
+        std::vector<unsigned char> compressed(width * height * nb_channels * 2);
+        unsigned int compressed_size = Compress_RGB32_To_HRGB32(width, height, &input_data[0], &compressed[0]);
+
+        printf("  Compressed size %d/%d\n", compressed_size, width * height * nb_channels);
+
+        std::vector<unsigned char> output_data(width * height * nb_channels, 0xCC);
+        Decompress_HRGB32_To_RGB32(compressed_size, width, height, &compressed[0], &output_data[0]);
+
+        if (output_data != input_data)
+        {
+            printf("Error, RGB32 output differs\n");
+            return 1;
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test UYVY decoded directly to RGB32\n");
+    {
+        static const int nb_channels = 2;
+        std::vector<unsigned char> input_data(test_width * test_height * nb_channels);
+        srand(2501);
+        for (int c=0;c<nb_channels;c++)
+            fillSemiRandom(&input_data[c], test_width * test_height, nb_channels);
+
+        std::vector<unsigned char> compressed(test_width * test_height * nb_channels * 2);
+        unsigned int compressed_size = Compress_UYVY_To_HUYVY(test_width, test_height, &input_data[0], &compressed[0]);
+
+        std::vector<unsigned char> output_data(test_width * test_height * 4);
+        Decompress_HUYVY_To_RGB32(compressed_size, test_width, test_height, &compressed[0], &output_data[0]);
+
+        for (int y=0;y<test_height;y++)
+        {
+            // RGB output is bottom-up
+            const unsigned char * uyvy = &input_data[y * test_width * 2];
+            const unsigned char * rgb = &output_data[(test_height-1-y) * test_width * 4];
+            for (int x=0;x<test_width;x++)
+            {
+                const int luma = uyvy[x*2+1] - 16;
+                const int cb = uyvy[(x&~1)*2] - 128;
+                const int cr = uyvy[(x&~1)*2+2] - 128;
+                const int b = std::min(std::max((298 * luma + 516 * cb + 128) >> 8, 0), 255);
+                const int r = std::min(std::max((298 * luma + 409 * cr + 128) >> 8, 0), 255);
+                if (rgb[x*4+0] != b || rgb[x*4+2] != r || rgb[x*4+3] != 0xFF)
+                {
+                    printf("Error at pixel %d,%d\n", x, y);
+                    return 1;
+                }
+            }
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test UYVY to RGB conversion with the BT.601 and BT.709 matrices\n");
+    {
+        // Reference formulas, 8 fraction bits: Y' scale, Cb to B, Cb and Cr to G, Cr to R
+        static const int coefficients[2][5] = { { 298, 516, 100, 208, 409 }, { 298, 541, 55, 136, 459 } };
+        static const ZoeColorMatrix matrices[2] = { ZoeColorBT601, ZoeColorBT709 };
+        static const int guard_size = 16;
+
+        // Every byte value, for the clipping on both ends, and every width around the 8 pixel steps
+        std::vector<unsigned char> uyvy(64 * 2);
+        srand(4102);
+        for (int m=0;m<2;m++)
+            for (int bytes=3;bytes<=4;bytes++)
+                for (int width=2;width<=64;width+=2)
+                    for (int pass=0;pass<8;pass++)
+                    {
+                        for (size_t i=0;i<uyvy.size();i++)
+                            uyvy[i] = (unsigned char)(pass == 0 ? i*2 : rand());
+                        std::vector<unsigned char> rgb(width * bytes + guard_size, 0xCD);
+                        ConvertUYVYToRGB(&uyvy[0], &rgb[0], width, bytes == 4, matrices[m]);
+
+                        const int* k = coefficients[m];
+                        for (int x=0;x<width;x++)
+                        {
+                            const int luma = k[0] * (uyvy[x*2+1] - 16) + 128;
+                            const int cb = uyvy[(x&~1)*2] - 128;
+                            const int cr = uyvy[(x&~1)*2+2] - 128;
+                            const int expected[4] = {
+                                std::min(std::max((luma + k[1] * cb) >> 8, 0), 255),
+                                std::min(std::max((luma - k[2] * cb - k[3] * cr) >> 8, 0), 255),
+                                std::min(std::max((luma + k[4] * cr) >> 8, 0), 255),
+                                0xFF };
+                            for (int c=0;c<bytes;c++)
+                                if (rgb[x*bytes+c] != expected[c])
+                                {
+                                    printf("Error, matrix %d, %d bytes, width %d, pixel %d channel %d: %d instead of %d\n", m, bytes, width, x, c, rgb[x*bytes+c], expected[c]);
+                                    return 1;
+                                }
+                        }
+                        for (int i=0;i<guard_size;i++)
+                            if (rgb[width * bytes + i] != 0xCD)
+                            {
+                                printf("Error, matrix %d, %d bytes, width %d: written past the row\n", m, bytes, width);
+                                return 1;
+                            }
+                    }
+
+        // The decoder flag selects the matrix
+        std::vector<unsigned char> input_data(test_width * test_height * 2);
+        fillSemiRandom(&input_data[0], test_width * test_height * 2);
+        zoe_encoder_config encoder_config = { ZOE_FORMAT_HUYVY, ZOE_PIXEL_UYVY, test_width, test_height, ZOE_THREADS_SHARED_POOL, 0, 0 };
+        zoe_decoder_config decoder_config = { ZOE_FORMAT_HUYVY, ZOE_PIXEL_RGB24, test_width, test_height, ZOE_THREADS_SHARED_POOL, ZOE_DECODE_BT709, 0 };
+        zoe_encoder* encoder;
+        zoe_decoder* decoder;
+        if (zoe_encoder_create(&encoder_config, &encoder) != ZOE_OK || zoe_decoder_create(&decoder_config, &decoder) != ZOE_OK)
+        {
+            printf("Error, cannot create the BT.709 decoder\n");
+            return 1;
+        }
+
+        std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+        size_t compressed_size;
+        std::vector<unsigned char> output_data(zoe_decoder_output_size(decoder));
+        std::vector<unsigned char> expected(test_width * 3);
+        zoe_encode(encoder, &input_data[0], input_data.size(), &compressed[0], compressed.size(), &compressed_size);
+        zoe_decode(decoder, &compressed[0], compressed_size, &output_data[0], output_data.size());
+        for (int y=0;y<test_height;y++)
+        {
+            ConvertUYVYToRGB(&input_data[y * test_width * 2], &expected[0], test_width, false, ZoeColorBT709);
+            if (memcmp(&output_data[(test_height-1-y) * test_width * 3], &expected[0], expected.size()) != 0)
+            {
+                printf("Error, BT.709 output differs at row %d\n", y);
+                return 1;
+            }
+        }
+        zoe_encoder_destroy(encoder);
+        zoe_decoder_destroy(decoder);
+        printf("  Passed\n");
+    }
+
+    printf("Test planar float32 and float16 outputs (tensors for data loaders)\n");
+    {
+        // Known halves, rounded to nearest even, on both sides of the 8 value SIMD steps
+        static const float values[10] = { 1.0f, -2.0f, 0.1f, 65504.0f, 65520.0f, 1.0f/16777216, 1e-9f, 1.00048828125f, 1.00146484375f, -INFINITY };
+        static const unsigned short halves[10] = { 0x3C00, 0xC000, 0x2E66, 0x7BFF, 0x7C00, 0x0001, 0x0000, 0x3C00, 0x3C02, 0xFC00 };
+        for (int count=1;count<=30;count++)
+        {
+            std::vector<float> in(count);
+            std::vector<unsigned short> out(count + 1, 0xCDCD);
+            for (int i=0;i<count;i++)
+                in[i] = values[(i*7) % 10];
+            ConvertFloatToHalf(&in[0], count, &out[0]);
+            for (int i=0;i<count;i++)
+                if (out[i] != halves[(i*7) % 10])
+                {
+                    printf("Error, %g converted to half 0x%04X instead of 0x%04X\n", in[i], out[i], halves[(i*7) % 10]);
+                    return 1;
+                }
+            if (out[count] != 0xCDCD)
+            {
+                printf("Error, half conversion of %d values written past the end\n", count);
+                return 1;
+            }
+        }
+
+        struct { zoe_format format; zoe_pixel_format input; bool noise; } cases[] = {
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    true },   // stored raw
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_Y10,   false },
+            { ZOE_FORMAT_HY12,   ZOE_PIXEL_Y12,   false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, true },
+            { ZOE_FORMAT_HRGB32, ZOE_PIXEL_RGB32, false },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  false },
+        };
+        srand(4301);
+        for (size_t i=0;i<sizeof(cases)/sizeof(cases[0]);i++)
+            if (!checkTensor(cases[i].format, cases[i].input, ZOE_PIXEL_F32_PLANAR, 70, 45, cases[i].noise) ||
+                !checkTensor(cases[i].format, cases[i].input, ZOE_PIXEL_F16_PLANAR, 70, 45, cases[i].noise) ||
+                !checkTensor(cases[i].format, cases[i].input, ZOE_PIXEL_F32_PLANAR, 6, 40, cases[i].noise))
+                return 1;
+
+        // UYVY to R G B planes: the matrix in float, within rounding of the 8 bit conversion
+        std::vector<unsigned char> input_data(test_width * test_height * 2);
+        fillSemiRandom(&input_data[0], (unsigned)input_data.size());
+        zoe_encoder_config encoder_config = { ZOE_FORMAT_HUYVY, ZOE_PIXEL_UYVY, test_width, test_height, ZOE_THREADS_SHARED_POOL, 0, 0 };
+        zoe_encoder* encoder;
+        zoe_encoder_create(&encoder_config, &encoder);
+        std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+        size_t compressed_size;
+        zoe_encode(encoder, &input_data[0], input_data.size(), &compressed[0], compressed.size(), &compressed_size);
+        zoe_encoder_destroy(encoder);
+
+        static const float coefficients[2][5] = { { 298, 516, 100, 208, 409 }, { 298, 541, 55, 136, 459 } };
+        const unsigned flags[2] = { ZOE_DECODE_PLANAR_RGB, ZOE_DECODE_PLANAR_RGB | ZOE_DECODE_BT709 };
+        std::vector<unsigned char> rgb(test_width * 3);
+        for (int m=0;m<2;m++)
+            for (int half=0;half<2;half++)
+            {
+                zoe_decoder_config decoder_config = { ZOE_FORMAT_HUYVY, half ? ZOE_PIXEL_F16_PLANAR : ZOE_PIXEL_F32_PLANAR,
+                                                      test_width, test_height, ZOE_THREADS_SHARED_POOL, flags[m], 0 };
+                zoe_decoder* decoder;
+                if (zoe_decoder_create(&decoder_config, &decoder) != ZOE_OK)
+                {
+                    printf("Error, cannot create the planar RGB decoder\n");
+                    return 1;
+                }
+                const zoe_tensor_layout layout = { 1.0f/255, 0.0f, 0, 0 };
+                std::vector<unsigned char> tensor(zoe_decoder_tensor_size(decoder, &layout));
+                zoe_decode_tensor(decoder, &compressed[0], compressed_size, &layout, &tensor[0], tensor.size());
+                zoe_decoder_destroy(decoder);
+
+                const size_t plane = (size_t)test_width * test_height;
+                for (int y=0;y<test_height;y++)
+                {
+                    ConvertUYVYToRGB(&input_data[y * test_width * 2], &rgb[0], test_width, false, m ? ZoeColorBT709 : ZoeColorBT601);
+                    for (int x=0;x<test_width;x++)
+                    {
+                        const float* k = coefficients[m];
+                        const unsigned char* pair = &input_data[(y * test_width + (x&~1)) * 2];
+                        const float luma = k[0] * (input_data[(y * test_width + x) * 2 + 1] - 16);
+                        const float cb = pair[0] - 128.0f;
+                        const float cr = pair[2] - 128.0f;
+                        const float expected[3] = { luma + k[4] * cr, luma - k[2] * cb - k[3] * cr, luma + k[1] * cb };
+                        for (int p=0;p<3;p++)
+                        {
+                            const size_t index = p*plane + (size_t)y * test_width + x;
+                            const float value = (half ? halfToFloat(((const unsigned short*)&tensor[0])[index]) : ((const float*)&tensor[0])[index]) * 255;
+                            const float reference = std::min(std::max(expected[p] / 256, 0.0f), 255.0f);
+                            if (fabsf(value - reference) > (half ? reference / 1024 + 0.001f : 0.001f) || fabsf(value - rgb[x*3 + 2-p]) > 1.0f)
+                            {
+                                printf("Error, matrix %d plane %d (%d, %d): %g instead of %g\n", m, p, x, y, value, reference);
+                                return 1;
+                            }
+                        }
+                    }
+                }
+            }
+
+        printf("  Passed\n");
+    }
+
+    printf("Test incompressible frames stored raw, within the size bound\n");
+    {
+        static const int guard_size = 16;
+        const unsigned pixel_count = test_width * test_height;
+
+        // Noise for every pixel size, packed 10 bit input included
+        std::vector<unsigned char> noise(pixel_count * 4);
+        srand(3101);
+        for (size_t i=0;i<noise.size();i++)
+            noise[i] = (unsigned char)(rand()&0xFF);
+
+        const int bytes_per_pixel[] = { 1, 2, 3, 2 };
+        for (int t=0;t<4;t++)
+        {
+            const unsigned bound = HuffmanFrameBound(test_width, test_height, bytes_per_pixel[t]);
+            std::vector<unsigned char> compressed(bound + guard_size, 0xCD);
+            std::vector<unsigned char> output_data(pixel_count * 4);
+            std::vector<unsigned char> expected(noise.begin(), noise.begin() + pixel_count * bytes_per_pixel[t]);
+            unsigned compressed_size = 0;
+            bool ok = false;
+
+            if (t==0)
+            {
+                compressed_size = Compress_Y8_To_HY8(test_width, test_height, &noise[0], &compressed[0]);
+                ok = Decompress_HY8_To_Y8(compressed_size, test_width, test_height, &compressed[0], &output_data[0]);
+            }
+            else if (t==1)
+            {
+                compressed_size = Compress_UYVY_To_HUYVY(test_width, test_height, &noise[0], &compressed[0]);
+                ok = Decompress_HUYVY_To_UYVY(compressed_size, test_width, test_height, &compressed[0], &output_data[0]);
+            }
+            else if (t==2)
+            {
+                compressed_size = Compress_RGB24_To_HRGB24(test_width, test_height, &noise[0], &compressed[0]);
+                ok = Decompress_HRGB24_To_RGB24(compressed_size, test_width, test_height, &compressed[0], &output_data[0]);
+            }
+            else
+            {
+                compressed_size = Compress_PY10_To_HY10(test_width, test_height, &noise[0], &compressed[0]);
+                ok = Decompress_HY10_To_Y10(compressed_size, test_width, test_height, &compressed[0], &output_data[0]);
+
+                UnpackBitReader<10, unsigned short> reader((const unsigned short *)&noise[0]);
+                for (unsigned i=0;i<pixel_count;i++)
+                    ((unsigned short*)&expected[0])[i] = reader.next();
+            }
+
+            if (compressed_size != bound || std::count(compressed.begin() + bound, compressed.end(), (unsigned char)0xCD) != guard_size)
+            {
+                printf("Error, frame type %d is %d bytes for a bound of %d\n", t, compressed_size, bound);
+                return 1;
+            }
+            if (!ok || memcmp(&output_data[0], &expected[0], expected.size()) != 0)
+            {
+                printf("Error in frame type %d\n", t);
+                return 1;
+            }
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test stream context (codec reused across frames of different sizes)\n");
+    {
+        ZoeCodecContext encode_ctx;
+        ZoeCodecContext decode_ctx;
+
+        // Shrink then grow again, the context must follow the frame size
+        static const int sizes[][2] = { {64, 64}, {16, 8}, {64, 64}, {130, 33} };
+        for (int f=0;f<4;f++)
+        {
+            const unsigned width = sizes[f][0];
+            const unsigned height = sizes[f][1];
+            const unsigned frame_size = width * height * 2;
+
+            std::vector<unsigned char> input_data(frame_size);
+            std::vector<unsigned char> compressed(HuffmanFrameBound(width, height, 2));
+            std::vector<unsigned char> reference(HuffmanFrameBound(width, height, 2));
+            std::vector<unsigned char> output_data(frame_size);
+            srand(3100 + f);
+            fillSemiRandom(&input_data[0], frame_size);
+
+            unsigned size = Compress_UYVY_To_HUYVY(width, height, &input_data[0], &compressed[0], &encode_ctx);
+            unsigned reference_size = Compress_UYVY_To_HUYVY(width, height, &input_data[0], &reference[0]);
+            if (size != reference_size || memcmp(&compressed[0], &reference[0], size) != 0)
+            {
+                printf("Error, frame %d differs from the one coded without context\n", f);
+                return 1;
+            }
+
+            Decompress_HUYVY_To_UYVY(size, width, height, &compressed[0], &output_data[0], &decode_ctx);
+            if (memcmp(&output_data[0], &input_data[0], frame_size) != 0)
+            {
+                printf("Error in frame %d\n", f);
+                return 1;
+            }
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test decode table cache (repeated codebooks)\n");
+    {
+        const unsigned frame_size = test_width * test_height * 3;
+
+        std::vector<unsigned char> frame_a(frame_size);
+        std::vector<unsigned char> frame_b(frame_size);
+        std::vector<unsigned char> compressed_a(frame_size * 2 + 4096);
+        std::vector<unsigned char> compressed_b(frame_size * 2 + 4096);
+        std::vector<unsigned char> output_data(frame_size);
+        srand(3000);
+        for (int c=0;c<3;c++)
+        {
+            fillSemiRandom(&frame_a[c], frame_size / 3, 3);
+            fillSemiRandom(&frame_b[c], frame_size / 3, 3);
+        }
+
+        const unsigned size_a = Compress_RGB24_To_HRGB24(test_width, test_height, &frame_a[0], &compressed_a[0]);
+        const unsigned size_b = Compress_RGB24_To_HRGB24(test_width, test_height, &frame_b[0], &compressed_b[0]);
+
+        // A B A A: the last two frames only reuse tables
+        ZoeCodecContext ctx;
+        const unsigned char* sequence[] = { &compressed_a[0], &compressed_b[0], &compressed_a[0], &compressed_a[0] };
+        const unsigned char* expected[] = { &frame_a[0], &frame_b[0], &frame_a[0], &frame_a[0] };
+        for (int f=0;f<4;f++)
+        {
+            Decompress_HRGB24_To_RGB24(f==1 ? size_b : size_a, test_width, test_height, sequence[f], &output_data[0], &ctx);
+            if (memcmp(&output_data[0], expected[f], frame_size) != 0)
+            {
+                printf("Error in frame %d\n", f);
+                return 1;
+            }
+        }
+
+        const ZoeCodecStats& stats = ctx.stats();
+        printf("  Hits %d, misses %d\n", (int)stats.table_cache_hits, (int)stats.table_cache_misses);
+        if (stats.table_cache_hits != 6 || stats.table_cache_misses != 6)
+        {
+            printf("Error, unexpected cache behavior\n");
+            return 1;
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test C API (encoder and decoder objects)\n");
+    {
+        const unsigned frame_size = test_width * test_height * 2;
+
+        std::vector<unsigned short> input_data(test_width * test_height);
+        srand(3200);
+        fillSemiRandom10(&input_data[0], test_width * test_height);
+
+        std::vector<unsigned char> reference(HuffmanFrameBound(test_width, test_height, 2));
+        const unsigned reference_size = Compress_Y10_To_HY10(test_width, test_height, (const unsigned char *)&input_data[0], &reference[0]);
+
+        // Same frames whether the encoder uses the shared pool or only the calling thread
+        for (int threads=ZOE_THREADS_SHARED_POOL;threads<=ZOE_THREADS_CALLER;threads++)
+        {
+            zoe_encoder_config encoder_config = { ZOE_FORMAT_HY10, ZOE_PIXEL_Y10, test_width, test_height, threads };
+            zoe_decoder_config decoder_config = { ZOE_FORMAT_HY10, ZOE_PIXEL_Y10, test_width, test_height, threads, 0 };
+            zoe_encoder* encoder = 0;
+            zoe_decoder* decoder = 0;
+            if (zoe_encoder_create(&encoder_config, &encoder) != ZOE_OK || zoe_decoder_create(&decoder_config, &decoder) != ZOE_OK)
+            {
+                printf("Error, cannot create the encoder or decoder\n");
+                return 1;
+            }
+            if (zoe_encoder_input_size(encoder) != frame_size || zoe_decoder_output_size(decoder) != frame_size ||
+                zoe_encoder_max_output_size(encoder) != reference.size())
+            {
+                printf("Error, bad buffer sizes\n");
+                return 1;
+            }
+
+            std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+            std::vector<unsigned char> output_data(frame_size);
+            for (int f=0;f<2;f++)
+            {
+                size_t size = 0;
+                zoe_status status = zoe_encode(encoder, &input_data[0], frame_size, &compressed[0], compressed.size(), &size);
+                if (status != ZOE_OK || size != reference_size || memcmp(&compressed[0], &reference[0], size) != 0)
+                {
+                    printf("Error, frame %d differs from Compress_Y10_To_HY10 (%s)\n", f, zoe_status_string(status));
+                    return 1;
+                }
+
+                status = zoe_decode(decoder, &compressed[0], size, &output_data[0], output_data.size());
+                if (status != ZOE_OK || memcmp(&output_data[0], &input_data[0], frame_size) != 0)
+                {
+                    printf("Error in frame %d (%s)\n", f, zoe_status_string(status));
+                    return 1;
+                }
+            }
+
+            // Buffers that cannot hold the worst case are refused before anything is written
+            size_t size = 0;
+            if (zoe_encode(encoder, &input_data[0], frame_size - 1, &compressed[0], compressed.size(), &size) != ZOE_ERROR_BUFFER_TOO_SMALL ||
+                zoe_encode(encoder, &input_data[0], frame_size, &compressed[0], compressed.size() - 1, &size) != ZOE_ERROR_BUFFER_TOO_SMALL ||
+                zoe_decode(decoder, &compressed[0], reference_size, &output_data[0], frame_size - 1) != ZOE_ERROR_BUFFER_TOO_SMALL ||
+                zoe_decode(decoder, &compressed[0], 2, &output_data[0], frame_size) != ZOE_ERROR_CORRUPT_FRAME)
+            {
+                printf("Error, bad buffer sizes accepted\n");
+                return 1;
+            }
+
+            zoe_encoder_destroy(encoder);
+            zoe_decoder_destroy(decoder);
+        }
+
+        // Conversions the codecs do not have
+        zoe_encoder_config encoder_config = { ZOE_FORMAT_HY12, ZOE_PIXEL_PY10, test_width, test_height, ZOE_THREADS_SHARED_POOL };
+        zoe_decoder_config decoder_config = { ZOE_FORMAT_HRGB32, ZOE_PIXEL_RGB24, test_width, test_height, ZOE_THREADS_SHARED_POOL, 0 };
+        zoe_encoder* encoder = 0;
+        zoe_decoder* decoder = 0;
+        if (zoe_encoder_create(&encoder_config, &encoder) != ZOE_ERROR_UNSUPPORTED || encoder ||
+            zoe_decoder_create(&decoder_config, &decoder) != ZOE_ERROR_UNSUPPORTED || decoder)
+        {
+            printf("Error, unsupported conversion accepted\n");
+            return 1;
+        }
+
+        // The queries answer like creating the encoder or decoder, for every pair and flag
+        for (int f=ZOE_FORMAT_NONE;f<ZOE_FORMAT_COUNT;f++)
+            for (int p=ZOE_PIXEL_NONE;p<ZOE_PIXEL_COUNT;p++)
+            {
+                for (unsigned flags=0;flags<=ZOE_ENCODE_THUMBNAIL;flags++)
+                {
+                    zoe_encoder_config query_config = { (zoe_format)f, (zoe_pixel_format)p, test_width, test_height, ZOE_THREADS_CALLER, 0, flags };
+                    const bool created = zoe_encoder_create(&query_config, &encoder) == ZOE_OK;
+                    zoe_encoder_destroy(encoder);
+                    if (created != (zoe_encode_supported((zoe_format)f, (zoe_pixel_format)p, flags) != 0))
+                    {
+                        printf("Error, zoe_encode_supported differs for format %d, input %d, flags %u\n", f, p, flags);
+                        return 1;
+                    }
+                }
+                for (unsigned flags=0;flags<=(ZOE_DECODE_FLIP | ZOE_DECODE_BT709 | ZOE_DECODE_PLANAR_RGB);flags++)
+                {
+                    zoe_decoder_config query_config = { (zoe_format)f, (zoe_pixel_format)p, test_width, test_height, ZOE_THREADS_CALLER, flags };
+                    const bool created = zoe_decoder_create(&query_config, &decoder) == ZOE_OK;
+                    zoe_decoder_destroy(decoder);
+                    if (created != (zoe_decode_supported((zoe_format)f, (zoe_pixel_format)p, flags) != 0))
+                    {
+                        printf("Error, zoe_decode_supported differs for format %d, output %d, flags %u\n", f, p, flags);
+                        return 1;
+                    }
+                }
+            }
+        printf("  Passed\n");
+    }
+
+    printf("Test damaged frames (truncated frames and invalid Huffman trees)\n");
+    {
+        // Every section of the tagged layout: thumbnail, sample maps, trees, row index, bitstreams,
+        // and the two frames of HYUV420. Frames are copied to buffers of their exact size.
+        struct { zoe_format format; zoe_pixel_format pixels; unsigned flags; } cases[] = {
+            { ZOE_FORMAT_HY8, ZOE_PIXEL_Y8, ZOE_ENCODE_THUMBNAIL },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, 0 },
+            { ZOE_FORMAT_HY16, ZOE_PIXEL_Y16, 0 },
+            { ZOE_FORMAT_HYUV420, ZOE_PIXEL_I420, 0 },
+        };
+        const unsigned width = 64;
+        const unsigned height = 48;
+
+        for (size_t i=0;i<sizeof(cases)/sizeof(cases[0]);i++)
+        {
+            zoe_encoder_config encoder_config = { cases[i].format, cases[i].pixels, width, height, ZOE_THREADS_CALLER, 0, cases[i].flags };
+            zoe_decoder_config decoder_config = { cases[i].format, cases[i].pixels, width, height, ZOE_THREADS_CALLER, 0, 0 };
+            zoe_encoder* encoder = 0;
+            zoe_decoder* decoder = 0;
+            if (zoe_encoder_create(&encoder_config, &encoder) != ZOE_OK || zoe_decoder_create(&decoder_config, &decoder) != ZOE_OK)
+            {
+                printf("Error, cannot create the encoder or decoder\n");
+                return 1;
+            }
+
+            std::vector<unsigned char> input_data(zoe_encoder_input_size(encoder));
+            srand(3201);
+            if (cases[i].pixels == ZOE_PIXEL_Y16)
+            {
+                // 10 bit samples in the MSB, stored with a sample map
+                unsigned short * samples = (unsigned short *)&input_data[0];
+                fillSemiRandom10(samples, width * height);
+                for (unsigned s=0;s<width * height;s++)
+                    samples[s] <<= 6;
+            }
+            else if (cases[i].pixels == ZOE_PIXEL_RGB24)
+            {
+                for (int c=0;c<3;c++)
+                    fillSemiRandom(&input_data[c], width * height, 3);
+            }
+            else
+                fillSemiRandom(&input_data[0], (unsigned)input_data.size());
+
+            std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+            std::vector<unsigned char> output_data(zoe_decoder_output_size(decoder));
+            size_t size = 0;
+            zoe_encode(encoder, &input_data[0], input_data.size(), &compressed[0], compressed.size(), &size);
+
+            for (size_t truncated_size=1;truncated_size<size;truncated_size++)
+            {
+                std::vector<unsigned char> truncated(compressed.begin(), compressed.begin() + truncated_size);
+                const zoe_status status = zoe_decode(decoder, &truncated[0], truncated_size, &output_data[0], output_data.size());
+                if (status != ZOE_ERROR_CORRUPT_FRAME)
+                {
+                    printf("Error, format %d frame truncated to %d of %d bytes gives %s\n", (int)cases[i].format, (int)truncated_size, (int)size, zoe_status_string(status));
+                    return 1;
+                }
+            }
+
+            // Each byte of the first tables replaced: decoded or refused, never read out of the frame
+            std::vector<unsigned char> damaged(compressed.begin(), compressed.begin() + size);
+            for (size_t offset=0;offset<std::min<size_t>(size, 512);offset++)
+            {
+                const unsigned char original = damaged[offset];
+                for (int value=0;value<256;value+=51)
+                {
+                    damaged[offset] = (unsigned char)(original ^ (value | 1));
+                    const zoe_status status = zoe_decode(decoder, &damaged[0], size, &output_data[0], output_data.size());
+                    if (status != ZOE_OK && status != ZOE_ERROR_CORRUPT_FRAME)
+                    {
+                        printf("Error, format %d frame damaged at byte %d gives %s\n", (int)cases[i].format, (int)offset, zoe_status_string(status));
+                        return 1;
+                    }
+                }
+                damaged[offset] = original;
+            }
+
+            zoe_encoder_destroy(encoder);
+            zoe_decoder_destroy(decoder);
+        }
+
+        // Trees of an RGB24 frame whose root or a child points past the nodes, or a child that
+        // would loop back. The frame starts with the flags, then the node count, root and nodes of
+        // the first channel.
+        zoe_encoder_config encoder_config = { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, width, height, ZOE_THREADS_CALLER };
+        zoe_decoder_config decoder_config = { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, width, height, ZOE_THREADS_CALLER, 0 };
+        zoe_encoder* encoder = 0;
+        zoe_decoder* decoder = 0;
+        zoe_encoder_create(&encoder_config, &encoder);
+        zoe_decoder_create(&decoder_config, &decoder);
+        std::vector<unsigned char> input_data(zoe_encoder_input_size(encoder));
+        for (int c=0;c<3;c++)
+            fillSemiRandom(&input_data[c], width * height, 3);
+        std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+        std::vector<unsigned char> output_data(zoe_decoder_output_size(decoder));
+        size_t size = 0;
+        zoe_encode(encoder, &input_data[0], input_data.size(), &compressed[0], compressed.size(), &size);
+
+        unsigned tree_used;
+        memcpy(&tree_used, &compressed[4], 4);
+        // Words at byte 8 (root) and 12 (first node, left then right child)
+        const struct { size_t offset; unsigned value; } bad_trees[] = {
+            { 8, tree_used },               // root past the nodes
+            { 12, 0x8000 + tree_used },     // child past the nodes
+            { 12, 0x8000 + tree_used - 1 }, // first node pointing at the root, a loop
+            { 12, 256 },                    // symbol past the alphabet
+        };
+        for (int b=0;b<4;b++)
+        {
+            std::vector<unsigned char> damaged(compressed.begin(), compressed.begin() + size);
+            memcpy(&damaged[bad_trees[b].offset], &bad_trees[b].value, 4);
+            if (zoe_decode(decoder, &damaged[0], size, &output_data[0], output_data.size()) != ZOE_ERROR_CORRUPT_FRAME)
+            {
+                printf("Error, invalid tree %d accepted\n", b);
+                return 1;
+            }
+        }
+        zoe_encoder_destroy(encoder);
+        zoe_decoder_destroy(decoder);
+        printf("  Passed\n");
+    }
+
+    printf("Test flipped outputs (rows in the other order, every Huffman route)\n");
+    {
+        struct { zoe_format format; zoe_pixel_format input; zoe_pixel_format output; unsigned flags; bool noise; } cases[] = {
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_Y8,    0, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_Y8,    0, true },    // stored raw
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_UYVY,  0, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_RGB24, 0, false },   // bottom-up unless flipped
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_Y10,   ZOE_PIXEL_Y10,   0, false },
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_PY10,  ZOE_PIXEL_RGB32, 0, true },
+            { ZOE_FORMAT_HY12,   ZOE_PIXEL_Y12,   ZOE_PIXEL_Y16,   0, false },
+            { ZOE_FORMAT_HY12,   ZOE_PIXEL_Y12,   ZOE_PIXEL_RGB48, 0, false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB32, 0, false },
+            { ZOE_FORMAT_HRGB32, ZOE_PIXEL_RGB32, ZOE_PIXEL_RGB32, 0, true },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_UYVY,  0, false },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_RGB32, ZOE_DECODE_BT709, false },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_F32_PLANAR, ZOE_DECODE_PLANAR_RGB, false },
+            { ZOE_FORMAT_HRGB32, ZOE_PIXEL_RGB32, ZOE_PIXEL_F16_PLANAR, 0, false },
+        };
+        const unsigned width = 38, height = 27;
+        srand(4401);
+        for (size_t i=0;i<sizeof(cases)/sizeof(cases[0]);i++)
+        {
+            zoe_encoder_config encoder_config = { cases[i].format, cases[i].input, width, height, ZOE_THREADS_SHARED_POOL, 0, 0 };
+            zoe_decoder_config decoder_config = { cases[i].format, cases[i].output, width, height, ZOE_THREADS_SHARED_POOL, cases[i].flags, 0 };
+            zoe_encoder* encoder = 0;
+            zoe_decoder* decoder = 0;
+            zoe_decoder* flipped = 0;
+            zoe_encoder_create(&encoder_config, &encoder);
+            zoe_decoder_create(&decoder_config, &decoder);
+            decoder_config.flags |= ZOE_DECODE_FLIP;
+            if (!encoder || !decoder || zoe_decoder_create(&decoder_config, &flipped) != ZOE_OK)
+            {
+                printf("Error, format %d to %d cannot be flipped\n", cases[i].format, cases[i].output);
+                return 1;
+            }
+
+            std::vector<unsigned char> input_data(zoe_encoder_input_size(encoder));
+            if (cases[i].input == ZOE_PIXEL_Y10 || cases[i].input == ZOE_PIXEL_Y12)
+                fillSemiRandom10((unsigned short*)&input_data[0], width * height);
+            else if (cases[i].noise)
+                for (size_t j=0;j<input_data.size();j++)
+                    input_data[j] = rand()&0xFF;
+            else
+                fillSemiRandom(&input_data[0], (unsigned)input_data.size());
+            std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+            size_t size = 0;
+            zoe_encode(encoder, &input_data[0], input_data.size(), &compressed[0], compressed.size(), &size);
+
+            std::vector<unsigned char> output_data(zoe_decoder_output_size(decoder));
+            std::vector<unsigned char> flipped_data(zoe_decoder_output_size(flipped), 0xCD);
+            zoe_decode(decoder, &compressed[0], size, &output_data[0], output_data.size());
+            zoe_decode(flipped, &compressed[0], size, &flipped_data[0], flipped_data.size());
+
+            // Planar outputs flip each plane
+            const unsigned planes = std::max(zoe_decoder_planes(decoder), 1u);
+            const size_t row_size = output_data.size() / (planes * height);
+            for (unsigned p=0;p<planes;p++)
+                for (unsigned y=0;y<height;y++)
+                    if (memcmp(&flipped_data[(p*height + height-1-y) * row_size], &output_data[(p*height + y) * row_size], row_size) != 0)
+                    {
+                        printf("Error, format %d to %d flipped row %d differs\n", cases[i].format, cases[i].output, y);
+                        return 1;
+                    }
+
+            zoe_encoder_destroy(encoder);
+            zoe_decoder_destroy(decoder);
+            zoe_decoder_destroy(flipped);
+        }
+
+        // Uncompressed frames are copied, their rows can be flipped with a negative stride
+        zoe_decoder_config decoder_config = { ZOE_FORMAT_RGB24, ZOE_PIXEL_RGB24, width, height, ZOE_THREADS_SHARED_POOL, ZOE_DECODE_FLIP, 0 };
+        zoe_decoder* decoder = 0;
+        if (zoe_decoder_create(&decoder_config, &decoder) != ZOE_ERROR_UNSUPPORTED || decoder)
+        {
+            printf("Error, flipped uncompressed output accepted\n");
+            return 1;
+        }
+        printf("  Passed\n");
+    }
+
+    printf("Test row strides (padded and bottom-up rows, every path)\n");
+    {
+        struct { zoe_format format; zoe_pixel_format input; zoe_pixel_format output; unsigned flags; bool noise; } cases[] = {
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_Y8,    0, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_RGB24, 0, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_UYVY,  0, true },   // stored raw
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_PY10,  ZOE_PIXEL_Y10,   0, false },
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_PY10,  ZOE_PIXEL_RGB32, 0, true },
+            { ZOE_FORMAT_HY12,   ZOE_PIXEL_PY12,  ZOE_PIXEL_Y8,    0, false },
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_PY10,  ZOE_PIXEL_Y16,   0, false },
+            { ZOE_FORMAT_HY12,   ZOE_PIXEL_Y12,   ZOE_PIXEL_RGB48, 0, true },
+            { ZOE_FORMAT_HY14,   ZOE_PIXEL_Y14,   ZOE_PIXEL_Y16,   0, false },
+            { ZOE_FORMAT_HY16,   ZOE_PIXEL_Y16,   ZOE_PIXEL_Y16,   0, false },
+            { ZOE_FORMAT_HY16,   ZOE_PIXEL_Y16,   ZOE_PIXEL_RGB32, 0, true },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB32, ZOE_DECODE_FLIP, false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB32, 0, true },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_Y8,    ZOE_DECODE_FLIP, true },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_RGB24, ZOE_DECODE_FLIP, false },
+            { ZOE_FORMAT_HRGB32, ZOE_PIXEL_RGB32, ZOE_PIXEL_RGB32, 0, false },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_UYVY,  0, false },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_RGB32, 0, false },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_RGB24, 0, true },
+            { ZOE_FORMAT_RGB24,  ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, false },
+            { ZOE_FORMAT_Y10,    ZOE_PIXEL_Y10,   ZOE_PIXEL_UYVY,  0, false },
+            { ZOE_FORMAT_Y12,    ZOE_PIXEL_Y12,   ZOE_PIXEL_Y8,    0, false },
+        };
+        srand(3300);
+        for (size_t i=0;i<sizeof(cases)/sizeof(cases[0]);i++)
+            if (!checkStrides(cases[i].format, cases[i].input, cases[i].output, cases[i].flags, 36, 24, cases[i].noise))
+                return 1;
+
+        // Large enough for the parallel bands
+        if (!checkStrides(ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, 300, 260, false))
+            return 1;
+
+        printf("  Passed\n");
+    }
+
+    printf("Test band decode (frames streamed a few rows at a time)\n");
+    {
+        struct { zoe_format format; zoe_pixel_format input; zoe_pixel_format output; unsigned flags; int pad; bool noise; } cases[] = {
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_Y8,    0, 0, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_RGB24, 0, 0, false },   // bottom-up
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_UYVY,  0, 0, true },    // stored raw
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_PY10,  ZOE_PIXEL_Y10,   0, -4, false },
+            { ZOE_FORMAT_HY12,   ZOE_PIXEL_Y12,   ZOE_PIXEL_RGB32, 0, 0, true },
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_Y10,   ZOE_PIXEL_RGB48, 0, -4, false },
+            { ZOE_FORMAT_HY12,   ZOE_PIXEL_PY12,  ZOE_PIXEL_Y16,   0, 0, true },
+            { ZOE_FORMAT_HY14,   ZOE_PIXEL_Y14,   ZOE_PIXEL_Y14,   0, -4, false },
+            { ZOE_FORMAT_HY16,   ZOE_PIXEL_Y16,   ZOE_PIXEL_RGB24, 0, 0, false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB32, ZOE_DECODE_FLIP, -3, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_RGB24, ZOE_DECODE_FLIP, 0, false },   // top-down
+            { ZOE_FORMAT_HRGB32, ZOE_PIXEL_RGB32, ZOE_PIXEL_RGB32, ZOE_DECODE_FLIP, -2, true },
+            { ZOE_FORMAT_HRGB32, ZOE_PIXEL_RGB32, ZOE_PIXEL_RGB32, 0, 0, false },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_RGB32, 0, 0, false },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_RGB24, 0, -1, true },
+            { ZOE_FORMAT_HYUV420, ZOE_PIXEL_I420, ZOE_PIXEL_RGB32, 0, 0, false },
+            { ZOE_FORMAT_HYUV420, ZOE_PIXEL_NV12, ZOE_PIXEL_RGB32, ZOE_DECODE_FLIP, -2, true },
+            { ZOE_FORMAT_Y10,    ZOE_PIXEL_Y10,   ZOE_PIXEL_UYVY,  0, 0, false },   // uncompressed
+            { ZOE_FORMAT_RGB24,  ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, -5, false },
+        };
+        srand(3500);
+        for (size_t i=0;i<sizeof(cases)/sizeof(cases[0]);i++)
+            if (!checkBands(cases[i].format, cases[i].input, cases[i].output, cases[i].flags, 36, 50, 16, cases[i].pad, cases[i].noise))
+                return 1;
+
+        // Band taller than the frame, single row bands, and channels decoded in parallel
+        if (!checkBands(ZOE_FORMAT_HY8, ZOE_PIXEL_Y8, ZOE_PIXEL_Y8, 0, 36, 50, 64, 0, false) ||
+            !checkBands(ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, 36, 50, 1, 0, false) ||
+            !checkBands(ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, 300, 260, 32, 0, false))
+            return 1;
+
+        printf("  Passed\n");
+    }
+
+    printf("Test region decode (rows and columns of a frame, every path)\n");
+    {
+        struct { zoe_format format; zoe_pixel_format input; zoe_pixel_format output; unsigned flags; bool bottom_up; int pad; bool noise; } cases[] = {
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_Y8,    0, false, 0, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_RGB24, 0, true,  0, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_UYVY,  0, false, 0, true },    // stored raw
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_PY10,  ZOE_PIXEL_Y10,   0, false, -4, false },
+            { ZOE_FORMAT_HY12,   ZOE_PIXEL_Y12,   ZOE_PIXEL_RGB32, 0, true,  0, true },
+            { ZOE_FORMAT_HY12,   ZOE_PIXEL_PY12,  ZOE_PIXEL_Y16,   0, false, 0, false },
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_Y10,   ZOE_PIXEL_RGB48, 0, false, -4, true },
+            { ZOE_FORMAT_HY14,   ZOE_PIXEL_Y14,   ZOE_PIXEL_RGB48, 0, false, 0, false },
+            { ZOE_FORMAT_HY16,   ZOE_PIXEL_Y16,   ZOE_PIXEL_Y16,   ZOE_DECODE_FLIP, true, -2, false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB32, ZOE_DECODE_FLIP, true, -3, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_RGB24, ZOE_DECODE_FLIP, false, 0, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_Y8,    ZOE_DECODE_FLIP, true, 0, true },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_UYVY,  ZOE_DECODE_FLIP, true, -1, false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, false, 0, false },
+            { ZOE_FORMAT_HRGB32, ZOE_PIXEL_RGB32, ZOE_PIXEL_RGB32, 0, false, 0, true },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_UYVY,  0, false, 0, false },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_RGB32, 0, true,  -1, false },
+            { ZOE_FORMAT_Y10,    ZOE_PIXEL_Y10,   ZOE_PIXEL_UYVY,  0, false, 0, false },   // uncompressed
+            { ZOE_FORMAT_RGB24,  ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, false, -5, false },
+        };
+        const unsigned regions[][4] = { { 6, 17, 20, 21 }, { 0, 0, 36, 1 }, { 0, 49, 2, 1 }, { 34, 0, 2, 50 }, { 0, 32, 36, 18 } };
+        srand(3600);
+        for (size_t i=0;i<sizeof(cases)/sizeof(cases[0]);i++)
+            for (size_t r=0;r<sizeof(regions)/sizeof(regions[0]);r++)
+                if (!checkRegion(cases[i].format, cases[i].input, cases[i].output, cases[i].flags, cases[i].bottom_up, 36, 50,
+                        regions[r][0], regions[r][1], regions[r][2], regions[r][3], cases[i].pad, cases[i].noise))
+                    return 1;
+
+        // Channels decoded in parallel
+        if (!checkRegion(ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, false, 300, 260, 41, 133, 100, 70, 0, false))
+            return 1;
+
+        printf("  Passed\n");
+    }
+
+    printf("Test thumbnails (1/8 scale images stored with the frames)\n");
+    {
+        struct { zoe_format format; zoe_pixel_format input; zoe_pixel_format output; unsigned flags; bool noise; } cases[] = {
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_Y8,    0, false },
+            { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8,    ZOE_PIXEL_RGB24, 0, true },    // stored raw
+            { ZOE_FORMAT_HY10,   ZOE_PIXEL_Y10,   ZOE_PIXEL_Y10,   0, false },
+            { ZOE_FORMAT_HY12,   ZOE_PIXEL_Y12,   ZOE_PIXEL_UYVY,  0, false },
+            { ZOE_FORMAT_HY14,   ZOE_PIXEL_Y14,   ZOE_PIXEL_Y14,   0, false },
+            { ZOE_FORMAT_HY16,   ZOE_PIXEL_Y16,   ZOE_PIXEL_Y16,   0, false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, false },
+            { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB32, ZOE_DECODE_FLIP, false },
+            { ZOE_FORMAT_HRGB32, ZOE_PIXEL_RGB32, ZOE_PIXEL_RGB32, 0, true },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_UYVY,  0, false },
+            { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY,  ZOE_PIXEL_RGB32, 0, false },
+            { ZOE_FORMAT_HRGB48, ZOE_PIXEL_RGB48, ZOE_PIXEL_RGB48, 0, false },
+            { ZOE_FORMAT_HRGBA64, ZOE_PIXEL_RGBA64, ZOE_PIXEL_RGB32, 0, true },
+        };
+        srand(3700);
+        for (size_t i=0;i<sizeof(cases)/sizeof(cases[0]);i++)
+            if (!checkThumbnail(cases[i].format, cases[i].input, cases[i].output, cases[i].flags, 140, 90, cases[i].noise) ||
+                !checkThumbnail(cases[i].format, cases[i].input, cases[i].output, cases[i].flags, 64, 8, cases[i].noise))
+                return 1;
+
+        // Statistics summed in parallel bands
+        if (!checkThumbnail(ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24, ZOE_PIXEL_RGB24, 0, 300, 260, false))
+            return 1;
+
+        // Region decode skips the thumbnail
+        zoe_encoder_config encoder_config = { ZOE_FORMAT_HY8, ZOE_PIXEL_Y8, 36, 50, ZOE_THREADS_CALLER, 0, ZOE_ENCODE_THUMBNAIL };
+        zoe_decoder_config decoder_config = { ZOE_FORMAT_HY8, ZOE_PIXEL_Y8, 36, 50, ZOE_THREADS_CALLER, 0, 0 };
+        zoe_encoder* encoder = 0;
+        zoe_decoder* decoder = 0;
+        zoe_encoder_create(&encoder_config, &encoder);
+        zoe_decoder_create(&decoder_config, &decoder);
+        std::vector<unsigned char> input_data(36*50);
+        fillSemiRandom(&input_data[0], (unsigned)input_data.size());
+        std::vector<unsigned char> compressed(zoe_encoder_max_output_size(encoder));
+        std::vector<unsigned char> region(zoe_decoder_region_size(decoder, 20, 21));
+        size_t size = 0;
+        zoe_encode(encoder, &input_data[0], input_data.size(), &compressed[0], compressed.size(), &size);
+        zoe_decode_region(decoder, &compressed[0], size, 6, 17, 20, 21, &region[0], region.size());
+        for (unsigned r=0;r<21;r++)
+            if (memcmp(&region[r*20], &input_data[(17+r)*36+6], 20) != 0)
+            {
+                printf("Error, region row %d of a frame with a thumbnail differs\n", r);
+                return 1;
+            }
+        zoe_encoder_destroy(encoder);
+        zoe_decoder_destroy(decoder);
+
+        // Thumbnails need a Huffman format
+        encoder_config.format = ZOE_FORMAT_Y8;
+        if (zoe_encoder_create(&encoder_config, &encoder) != ZOE_ERROR_UNSUPPORTED)
+        {
+            printf("Error, thumbnail accepted for an uncompressed format\n");
+            return 1;
+        }
+
+        printf("  Passed\n");
+    }
+
+    printf("Test thread pool (nested parallel loops)\n");
+    {
+        static const int outer_count = 8;
+        static const int inner_count = 100;
+        std::vector<int> visits(outer_count * inner_count, 0);
+
+        ZoeThreadPool::instance().parallelFor(outer_count, ZoeThreadPool::Normal, [&](int i) {
+            ZoeThreadPool::instance().parallelFor(inner_count, ZoeThreadPool::High, [&](int j) {
+                visits[i * inner_count + j]++;
+            });
+        });
+
+        if (std::count(visits.begin(), visits.end(), 1) != outer_count * inner_count)
+        {
+            printf("Error, iterations run more or less than once\n");
+            return 1;
+        }
+        printf("  %d workers\n", ZoeThreadPool::instance().workerCount());
+        printf("  Passed\n");
+    }
+
+    printf("Test asynchronous encoder (frames completed in submission order)\n");
+    {
+        static const int frame_count = 12;
+        const unsigned frame_size = test_width * test_height;
+
+        std::vector<unsigned char> input_data(frame_size * frame_count);
+        srand(2501);
+        fillSemiRandom(&input_data[0], frame_size * frame_count);
+
+        // A ring of 2 is raised to 3, the smallest that tells encoded slots from free ones
+        const int ring_sizes[] = { 4, 2 };
+        for (int ring=0;ring<2;ring++)
+        {
+            ZoeAsyncEncoder encoder(Compress_Y8_To_HY8, test_width, test_height, frame_size, frame_size * 2, ring_sizes[ring], 3);
+
+            std::vector<unsigned char> output_data(frame_size);
+            int submitted = 0;
+            unsigned long long received = 0;
+            while (received < frame_count)
+            {
+                // Submit until the ring pushes back, then drain what is ready
+                while (submitted < frame_count && encoder.submit(&input_data[frame_size * submitted]) == ZoeAsyncEncoder::Submitted)
+                    submitted++;
+
+                ZoeEncodedFrame frame;
+                if (!encoder.nextCompleted(frame, true))
+                    continue;
+
+                if (frame.index != received)
+                {
+                    printf("Error, received frame %d instead of %d\n", (int)frame.index, (int)received);
+                    return 1;
+                }
+
+                Decompress_HY8_To_Y8(frame.size, test_width, test_height, frame.data, &output_data[0]);
+                if (memcmp(&output_data[0], &input_data[frame_size * received], frame_size) != 0)
+                {
+                    printf("Error in frame %d\n", (int)received);
+                    return 1;
+                }
+
+                encoder.release();
+                received++;
+            }
+
+            ZoeAsyncEncoderStats stats = encoder.stats();
+            printf("  Submitted %d, max in flight %d, rejected %d\n", (int)stats.submitted, stats.max_in_flight, (int)stats.rejected);
+            if (stats.in_flight != 0 || stats.max_in_flight > (unsigned)std::max(ring_sizes[ring], 3))
+            {
+                printf("Error, bad frame accounting\n");
+                return 1;
+            }
+        }
+
+        // Frames encoded through libzoe, with the buffer sizes of its encoder
+        const zoe_encoder_config config = { ZOE_FORMAT_HY8, ZOE_PIXEL_Y8, test_width, test_height, ZOE_THREADS_SHARED_POOL };
+        ZoeAsyncEncoder zoe_ring(config, 4, 2);
+        for (int f=0;f<4;f++)
+            zoe_ring.submit(&input_data[frame_size * f], true);
+        std::vector<unsigned char> output_data(frame_size);
+        for (int f=0;f<4;f++)
+        {
+            ZoeEncodedFrame frame;
+            zoe_ring.nextCompleted(frame, true);
+            Decompress_HY8_To_Y8(frame.size, test_width, test_height, frame.data, &output_data[0]);
+            if (frame.index != (unsigned)f || memcmp(&output_data[0], &input_data[frame_size * f], frame_size) != 0)
+            {
+                printf("Error in frame %d encoded through libzoe\n", f);
+                return 1;
+            }
+            zoe_ring.release();
+        }
+
+        // Configs libzoe refuses
+        const zoe_encoder_config odd_config = { ZOE_FORMAT_HYUV420, ZOE_PIXEL_I420, 33, 20, ZOE_THREADS_SHARED_POOL };
+        try
+        {
+            ZoeAsyncEncoder refused(odd_config, 4, 2);
+            printf("Error, odd 4:2:0 frames accepted\n");
+            return 1;
+        }
+        catch (const std::invalid_argument&)
+        {
+        }
+        printf("  Passed\n");
+    }
+
+    ZoeThreadPool::shutdown();
+
     return 0;
 }
 
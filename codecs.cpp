@@ -26,349 +26,310 @@
 //  2014-03-28 E. Danvoye    Initial Release
 //
 
-#include "stdafx.h"
 #include "codecs.h"
+#include "codec_context.h"
 #include "huffman.h"
 
-unsigned Compress_RGB24_To_RGB24(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+#include <string.h>
+
+// Codec instance from the stream context, callers without a context get one for this call only
+template <typename Codec>
+class StreamCodec
 {
-    unsigned len = width * height * 3;
-    memcpy(out_frame, in_frame, len); // uncompressed
-    return len;
-}
+public:
+    StreamCodec(ZoeCodecContext* ctx, unsigned width, unsigned height)
+        : codec((ctx ? *ctx : local_ctx).codec<Codec>(width, height))
+    {}
+    Codec* operator->() { return &codec; }
+private:
+    ZoeCodecContext local_ctx;
+    Codec& codec;
+};
 
-unsigned Compress_RGB32_To_RGB32(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+unsigned HuffmanFrameBound(unsigned width, unsigned height, unsigned bytes_per_pixel)
 {
-    unsigned len = width * height * 4;
-    memcpy(out_frame, in_frame, len); // uncompressed
-    return len;
+    // Raw fallback: flags word then the samples (see FrameFlags::Raw)
+    return 4 + width * height * bytes_per_pixel;
 }
 
-bool Decompress_RGB24_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+void HuffmanThumbnailSize(unsigned width, unsigned height, unsigned channel_count, unsigned* thumbnail_width, unsigned* thumbnail_height)
 {
-    unsigned len = width * height * 3;
-
-    if (inSize != len)
-        return false;
-
-    memcpy(out_frame, in_frame, len);
-    return true;
+    if (channel_count == 2)
+        *thumbnail_width = ZoeHuffmanCodec<char, 8, 2>::thumbnailWidth(width);
+    else
+        *thumbnail_width = ZoeHuffmanCodec<char, 8, 1>::thumbnailWidth(width);
+    *thumbnail_height = ZoeHuffmanCodec<char, 8, 1>::thumbnailHeight(height);
 }
 
-bool Decompress_RGB32_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool HuffmanFrameHasThumbnail(unsigned size, const unsigned char* frame)
 {
-    unsigned len = width * height * 4;
-
-    if (inSize != len)
+    if (size < 4)
         return false;
-
-    memcpy(out_frame, in_frame, len);
-    return true;
+    const unsigned flags = *((const unsigned int*)frame);
+    return (flags & FrameFlags::Tagged) && (flags & (FrameFlags::Thumbnail | FrameFlags::Raw));
 }
 
-unsigned Compress_Y8_To_Y8(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+// Row y of a frame, rows are row_bytes apart when stride is 0
+template <typename Byte>
+static Byte* FrameRow(Byte* frame, int stride, unsigned row_bytes, unsigned y)
 {
-    unsigned len = width * height * 1;
-    memcpy(out_frame, in_frame, len); // uncompressed
-    return len;
+    return frame + (ptrdiff_t)y * (stride ? stride : (ptrdiff_t)row_bytes);
 }
 
-unsigned Compress_Y8_To_HY8(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+static void CopyRows(const unsigned char* in_frame, int in_stride, unsigned char* out_frame, int out_stride, unsigned row_bytes, unsigned height)
 {
-    ZoeHuffmanCodec<char, 8, 1> huff(width, height);
-    unsigned len = huff.encode<TrivialBitReader<char> >((const char *)in_frame, (char*)out_frame);
-    return len;
+    if ((in_stride == 0 || in_stride == (int)row_bytes) && (out_stride == 0 || out_stride == (int)row_bytes))
+    {
+        memcpy(out_frame, in_frame, (size_t)row_bytes * height);
+        return;
+    }
+
+    for (unsigned y=0;y<height;y++)
+        memcpy(FrameRow(out_frame, out_stride, row_bytes, y), FrameRow(in_frame, in_stride, row_bytes, y), row_bytes);
 }
 
-unsigned Compress_Y10_To_HY10(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+// Gray samples of shift+8 bits reduced to 8 bits, to Y8 or to UYVY with neutral chroma
+template <typename Sample>
+static void GrayToY8(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, int out_stride, int shift)
 {
-    ZoeHuffmanCodec<short, 10, 1> huff(width, height);
-    unsigned len = huff.encode<TrivialBitReader<short> >((const short *)in_frame, (char*)out_frame);
-    return len;
+    for (unsigned y=0;y<height;y++)
+    {
+        const Sample* in_row = (const Sample*)FrameRow(in_frame, 0, width * sizeof(Sample), y);
+        unsigned char* out_row = FrameRow(out_frame, out_stride, width, y);
+        for (unsigned x=0;x<width;x++)
+            out_row[x] = (in_row[x]>>shift)&0x00FF;
+    }
 }
 
-unsigned Compress_PY10_To_HY10(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+template <typename Sample>
+static void GrayToUYVY(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, int out_stride, int shift)
 {
-    ZoeHuffmanCodec<short, 10, 1> huff(width, height);
-    unsigned len = huff.encode<UnpackBitReader<10, short> >((const short *)in_frame, (char*)out_frame);
-    return len;
+    for (unsigned y=0;y<height;y++)
+    {
+        const Sample* in_row = (const Sample*)FrameRow(in_frame, 0, width * sizeof(Sample), y);
+        unsigned char* destination = FrameRow(out_frame, out_stride, width * 2, y);
+        for (unsigned x=0;x<width;x++)
+        {
+            destination[x*2+0] = 0x80;
+            destination[x*2+1] = (in_row[x]>>shift)&0x00FF;
+        }
+    }
 }
 
-unsigned Compress_PY12_To_HY12(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+unsigned Compress_RGB24_To_RGB24(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int in_stride)
 {
-    ZoeHuffmanCodec<short, 12, 1> huff(width, height);
-    unsigned len = huff.encode<UnpackBitReader<12, short> >((const short *)in_frame, (char*)out_frame);
+    unsigned len = width * height * 3;
+    CopyRows(in_frame, in_stride, out_frame, 0, width * 3, height); // uncompressed
     return len;
 }
 
-unsigned Compress_Y10_To_Y10(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+unsigned Compress_RGB32_To_RGB32(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int in_stride)
 {
-    unsigned len = width * height * 2;
-    memcpy(out_frame, in_frame, len); // uncompressed
+    unsigned len = width * height * 4;
+    CopyRows(in_frame, in_stride, out_frame, 0, width * 4, height); // uncompressed
     return len;
 }
 
-bool Decompress_Y8_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_RGB24_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    unsigned len = width * height * 1;
+    unsigned len = width * height * 3;
 
     if (inSize != len)
         return false;
 
-    memcpy(out_frame, in_frame, len);
+    CopyRows(in_frame, 0, out_frame, out_stride, width * 3, height);
     return true;
 }
 
-bool Decompress_HY8_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    ZoeHuffmanCodec<char, 8, 1> huff(width, height);
-    return huff.decode<char, OutputProcessing::Default>((const char *)in_frame, (char*)out_frame);
-}
-
-bool Decompress_HY8_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_RGB32_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    ZoeHuffmanCodec<char, 8, 1> huff(width, height);
-    return huff.decode<char, OutputProcessing::gray_to_rgb24>((const char *)in_frame, (char*)out_frame);
-}
-
-bool Decompress_HY10_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    ZoeHuffmanCodec<short, 10, 1> huff(width, height);
-    return huff.decode<char, OutputProcessing::gray_to_rgb24>((const char *)in_frame, (char*)out_frame);
-}
+    unsigned len = width * height * 4;
 
-bool Decompress_HY10_To_Y10(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    ZoeHuffmanCodec<short, 10, 1> huff(width, height);
-    return huff.decode<short, OutputProcessing::Default>((const char *)in_frame, (short*)out_frame);
-}
+    if (inSize != len)
+        return false;
 
-bool Decompress_HY8_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    ZoeHuffmanCodec<char, 8, 1> huff(width, height);
-    return huff.decode<char, OutputProcessing::interleave_yuyv>((const char *)in_frame, (char*)out_frame);
+    CopyRows(in_frame, 0, out_frame, out_stride, width * 4, height);
+    return true;
 }
 
-bool Decompress_HY10_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+unsigned Compress_Y8_To_Y8(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int in_stride)
 {
-    ZoeHuffmanCodec<short, 10, 1> huff(width, height);
-    return huff.decode<short, OutputProcessing::interleave_yuyv>((const char *)in_frame, (short*)out_frame);
+    unsigned len = width * height * 1;
+    CopyRows(in_frame, in_stride, out_frame, 0, width * 1, height); // uncompressed
+    return len;
 }
 
-bool Decompress_HY10_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+unsigned Compress_Y10_To_Y10(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int in_stride)
 {
-    ZoeHuffmanCodec<short, 10, 1> huff(width, height);
-    return huff.decode<char, OutputProcessing::Default>((const char *)in_frame, (char*)out_frame);
+    unsigned len = width * height * 2;
+    CopyRows(in_frame, in_stride, out_frame, 0, width * 2, height); // uncompressed
+    return len;
 }
 
-bool Decompress_Y10_To_Y10(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_Y8_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    unsigned len = width * height * 2;
+    unsigned len = width * height * 1;
 
     if (inSize != len)
         return false;
 
-    memcpy(out_frame, in_frame, len);
+    CopyRows(in_frame, 0, out_frame, out_stride, width * 1, height);
     return true;
 }
 
-bool Decompress_Y10_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_Y10_To_Y10(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
     unsigned len = width * height * 2;
 
     if (inSize != len)
         return false;
 
-    const unsigned short* in_values = (const unsigned short*)(in_frame);
-
-    for (unsigned i=0;i<len;i++)
-        out_frame[i] = (in_values[i]>>2)&0x00FF;
-
+    CopyRows(in_frame, 0, out_frame, out_stride, width * 2, height);
     return true;
 }
 
-bool Decompress_Y8_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_Y10_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    int* destination = (int *)(out_frame);
+    unsigned len = width * height * 2;
 
-    // Convert MONO to YUV422 (U and V will be zero)
-    for (unsigned i=0;i<width*height/2;i++)
-    {
-        unsigned char pixel1 = in_frame[i*2+0];
-        unsigned char pixel2 = in_frame[i*2+1];
-        unsigned int yuv = (pixel1<<8) | (pixel2<<24) | 0x00800080;
-        destination[i] = yuv;
-    }
+    if (inSize != len)
+        return false;
 
+    GrayToY8<unsigned short>(width, height, in_frame, out_frame, out_stride, 2);
     return true;
 }
 
-bool Decompress_Y10_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_Y8_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    // LOSSY, we drop the two LSB of the Y10 data
+    unsigned len = width * height;
 
-    const unsigned short * img_16bit = (const unsigned short *)(in_frame);
-    int* destination = (int *)(out_frame);
-
-    for (unsigned i=0;i<width*height/2;i++)
-    {
-        unsigned char pixel1 = img_16bit[i*2+0]>>2;
-        unsigned char pixel2 = img_16bit[i*2+1]>>2;
-        unsigned int yuv = (pixel1<<8) | (pixel2<<24) | 0x00800080;
-        destination[i] = yuv;
-    }
+    if (inSize != len)
+        return false;
 
+    // Convert MONO to YUV422 (U and V will be zero)
+    GrayToUYVY<unsigned char>(width, height, in_frame, out_frame, out_stride, 0);
     return true;
 }
 
-unsigned Compress_RGB24_To_HRGB24(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_Y10_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    ZoeHuffmanCodec<char, 8, 3> huff(width, height);
-    unsigned len = huff.encode<TrivialBitReader<char> >((const char *)in_frame, (char*)out_frame);
-    return len;
-}
-
-bool Decompress_HRGB24_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    ZoeHuffmanCodec<char, 8, 3> huff(width, height);
-    return huff.decode<char, OutputProcessing::Default>((const char *)in_frame, (char*)out_frame);
-}
+    unsigned len = width * height * 2;
 
-unsigned Compress_RGB32_To_HRGB32(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    ZoeHuffmanCodec<char, 8, 4> huff(width, height);
-    unsigned len = huff.encode<TrivialBitReader<char> >((const char *)in_frame, (char*)out_frame);
-    return len;
-}
+    if (inSize != len)
+        return false;
 
-bool Decompress_HRGB32_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    ZoeHuffmanCodec<char, 8, 4> huff(width, height);
-    return huff.decode<char, OutputProcessing::Default>((const char *)in_frame, (char*)out_frame);
+    // LOSSY, we drop the two LSB of the Y10 data
+    GrayToUYVY<unsigned short>(width, height, in_frame, out_frame, out_stride, 2);
+    return true;
 }
 
-unsigned Compress_UYVY_To_HUYVY(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+unsigned Compress_Y12_To_Y12(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int in_stride)
 {
-    ZoeHuffmanCodec<char, 8, 2> huff(width, height);
-    unsigned len = huff.encode<TrivialBitReader<char> >((const char *)in_frame, (char*)out_frame);
+    unsigned len = width * height * 2;
+    CopyRows(in_frame, in_stride, out_frame, 0, width * 2, height); // uncompressed
     return len;
 }
 
-bool Decompress_HUYVY_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_Y12_To_Y12(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    ZoeHuffmanCodec<char, 8, 2> huff(width, height);
-    return huff.decode<char, OutputProcessing::Default>((const char *)in_frame, (char*)out_frame);
-}
+    unsigned len = width * height * 2;
 
-bool Decompress_HUYVY_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    ZoeHuffmanCodec<char, 8, 2> huff(width, height);
-    return huff.decode<char, OutputProcessing::uyvy_to_rgb24>((const char *)in_frame, (char*)out_frame);
-}
+    if (inSize != len)
+        return false;
 
-bool Decompress_HRGB24_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, bool reverse_y)
-{
-    ZoeHuffmanCodec<char, 8, 3> huff(width, height);
-    if (reverse_y)
-        return huff.decode<char, OutputProcessing::rgb24_to_rgb32_revY>((const char *)in_frame, (char*)out_frame);
-    else
-        return huff.decode<char, OutputProcessing::rgb24_to_rgb32>((const char *)in_frame, (char*)out_frame);
+    CopyRows(in_frame, 0, out_frame, out_stride, width * 2, height);
+    return true;
 }
 
-bool Decompress_HY8_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_Y12_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    ZoeHuffmanCodec<char, 8, 1> huff(width, height);
-    return huff.decode<char, OutputProcessing::gray_to_rgb32>((const char *)in_frame, (char*)out_frame);
-}
+    unsigned len = width * height * 2;
 
-bool Decompress_HY10_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    ZoeHuffmanCodec<short, 10, 1> huff(width, height);
-    return huff.decode<char, OutputProcessing::gray_to_rgb32>((const char *)in_frame, (char*)out_frame);
-}
+    if (inSize != len)
+        return false;
 
-bool Decompress_HUYVY_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    ZoeHuffmanCodec<char, 8, 2> huff(width, height);
-    return huff.decode<char, OutputProcessing::uyvy_to_rgb32>((const char *)in_frame, (char*)out_frame);
+    // LOSSY, we drop the four LSB of the Y12 data
+    GrayToUYVY<unsigned short>(width, height, in_frame, out_frame, out_stride, 4);
+    return true;
 }
 
-unsigned Compress_Y12_To_Y12(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    unsigned len = width * height * 2;
-    memcpy(out_frame, in_frame, len); // uncompressed
-    return len;
-}
-bool Decompress_Y12_To_Y12(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_Y12_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
     unsigned len = width * height * 2;
 
     if (inSize != len)
         return false;
 
-    memcpy(out_frame, in_frame, len);
+    GrayToY8<unsigned short>(width, height, in_frame, out_frame, out_stride, 4);
     return true;
 }
-bool Decompress_Y12_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+
+// Stride of the input frames given without one: rows back to back, v210 rows padded (see V210RowBytes)
+template <typename Reader>
+static int DefaultStride(unsigned)
 {
-    // LOSSY, we drop the four LSB of the Y12 data
+    return 0;
+}
 
-    const unsigned short * img_16bit = (const unsigned short *)(in_frame);
-    int* destination = (int *)(out_frame);
+template <>
+int DefaultStride<V210Reader>(unsigned width)
+{
+    return (int)V210RowBytes(width);
+}
 
-    for (unsigned i=0;i<width*height/2;i++)
-    {
-        unsigned char pixel1 = img_16bit[i*2+0]>>4;
-        unsigned char pixel2 = img_16bit[i*2+1]>>4;
-        unsigned int yuv = (pixel1<<8) | (pixel2<<24) | 0x00800080;
-        destination[i] = yuv;
+// Huffman encoders and decoders, one function per row of the tables in formats.h
+#define IGNORE_CUSTOM(...)
+#define DEFINE_ENCODER(format, input, Reader) \
+    unsigned Compress_##input##_To_##format(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int in_stride) \
+    { \
+        StreamCodec<ZoeHuffmanCodec<ZOE_HUFFMAN_CODEC_##format> > huff(ctx, width, height); \
+        if (in_stride == 0) \
+            in_stride = DefaultStride<Reader>(width); \
+        return huff->encode<Reader>((const Reader::typeT *)in_frame, (char*)out_frame, in_stride); \
     }
+#define DEFINE_DECODER(format, output, options, To, op) \
+    bool Decompress_##format##_To_##output(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride) \
+    { \
+        StreamCodec<ZoeHuffmanCodec<ZOE_HUFFMAN_CODEC_##format> > huff(ctx, width, height); \
+        return huff->decode<To, OutputProcessing::op>((const char *)in_frame, inSize, (To*)out_frame, out_stride); \
+    }
+ZOE_ENCODERS(IGNORE_CUSTOM, DEFINE_ENCODER)
+ZOE_DECODERS(IGNORE_CUSTOM, DEFINE_DECODER)
+#undef IGNORE_CUSTOM
+#undef DEFINE_ENCODER
+#undef DEFINE_DECODER
 
-    return true;
-}
-unsigned Compress_Y12_To_HY12(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+unsigned HuffmanYuv420FrameBound(unsigned width, unsigned height)
 {
-    ZoeHuffmanCodec<short, 12, 1> huff(width, height);
-    unsigned len = huff.encode<TrivialBitReader<short> >((const short *)in_frame, (char*)out_frame);
-    return len;
+    return ZoeYuv420Codec::maxEncodedSize(width, height);
 }
-bool Decompress_HY12_To_Y12(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+
+unsigned Compress_I420_To_HYUV420(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int in_stride)
 {
-    ZoeHuffmanCodec<short, 12, 1> huff(width, height);
-    return huff.decode<short, OutputProcessing::Default>((const char *)in_frame, (short*)out_frame);
+    StreamCodec<ZoeYuv420Codec> huff(ctx, width, height);
+    return huff->encode((const char *)in_frame, ZoeYuv420Codec::I420, (char*)out_frame, in_stride);
 }
-bool Decompress_HY12_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+
+unsigned Compress_NV12_To_HYUV420(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int in_stride)
 {
-    ZoeHuffmanCodec<short, 12, 1> huff(width, height);
-    return huff.decode<short, OutputProcessing::interleave_yuyv>((const char *)in_frame, (short*)out_frame);
+    StreamCodec<ZoeYuv420Codec> huff(ctx, width, height);
+    return huff->encode((const char *)in_frame, ZoeYuv420Codec::NV12, (char*)out_frame, in_stride);
 }
-bool Decompress_HY12_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+
+bool Decompress_HYUV420_To_I420(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    ZoeHuffmanCodec<short, 12, 1> huff(width, height);
-    return huff.decode<char, OutputProcessing::gray_to_rgb24>((const char *)in_frame, (char*)out_frame);
+    StreamCodec<ZoeYuv420Codec> huff(ctx, width, height);
+    return huff->decode((const char *)in_frame, inSize, ZoeYuv420Codec::I420, (char*)out_frame, out_stride);
 }
-bool Decompress_Y12_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
-{
-    unsigned len = width * height * 2;
-
-    if (inSize != len)
-        return false;
-
-    const unsigned short* in_values = (const unsigned short*)(in_frame);
-
-    for (unsigned i=0;i<len;i++)
-        out_frame[i] = (in_values[i]>>4)&0x00FF;
 
-    return true;
-}
-bool Decompress_HY12_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+bool Decompress_HYUV420_To_NV12(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    ZoeHuffmanCodec<short, 12, 1> huff(width, height);
-    return huff.decode<char, OutputProcessing::Default>((const char *)in_frame, (char*)out_frame);
+    StreamCodec<ZoeYuv420Codec> huff(ctx, width, height);
+    return huff->decode((const char *)in_frame, inSize, ZoeYuv420Codec::NV12, (char*)out_frame, out_stride);
 }
-bool Decompress_HY12_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame)
+
+bool Decompress_HYUV420_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride)
 {
-    ZoeHuffmanCodec<short, 12, 1> huff(width, height);
-    return huff.decode<char, OutputProcessing::gray_to_rgb32>((const char *)in_frame, (char*)out_frame);
+    StreamCodec<ZoeYuv420Codec> huff(ctx, width, height);
+    return huff->decodeToRGB32((const char *)in_frame, inSize, (char*)out_frame, out_stride);
 }
-
@@ -25,58 +25,54 @@
 
 #pragma once
 
-unsigned Compress_RGB24_To_RGB24(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_RGB24_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
+#include "formats.h"
 
-unsigned Compress_RGB32_To_RGB32(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_RGB32_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
+class ZoeCodecContext;
 
-unsigned Compress_Y8_To_Y8(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_Y8_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_Y8_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-
-unsigned Compress_Y10_To_Y10(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_Y10_To_Y10(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_Y10_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-
-// Huffman
-unsigned Compress_Y8_To_HY8(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY8_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY8_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY8_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-
-unsigned Compress_Y10_To_HY10(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-unsigned Compress_PY10_To_HY10(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY10_To_Y10(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY10_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY10_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-
-bool Decompress_Y10_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY10_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
+// Compress and decompress functions take an optional stream context (see codec_context.h). Passing
+// the same context for each frame of a stream keeps the codec tables allocated between frames.
+//
+// in_stride and out_stride are the byte distances between the rows of the uncompressed frame, 0
+// for tightly packed rows. The frame pointer is on row 0; a negative stride reads or writes a
+// bottom-up image (its last row in memory first). Packed inputs (PY10/PY12) with a stride start
+// each row on a byte boundary. Compressed frames are always contiguous.
 
-unsigned Compress_RGB24_To_HRGB24(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HRGB24_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
+// Largest frame produced by the Huffman encoders for width x height pixels of bytes_per_pixel each
+// (unpacked size, 2 for PY10/PY12). Frames that would be larger are stored raw.
+unsigned HuffmanFrameBound(unsigned width, unsigned height, unsigned bytes_per_pixel);
 
-unsigned Compress_RGB32_To_HRGB32(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HRGB32_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
+// Size of the thumbnail of a width x height frame (ZoeCodecContext::setThumbnails), 1/8 of the frame
+// rounded up; channel_count is 2 for HUYVY, whose thumbnail keeps whole U Y V Y groups.
+void HuffmanThumbnailSize(unsigned width, unsigned height, unsigned channel_count, unsigned* thumbnail_width, unsigned* thumbnail_height);
 
-unsigned Compress_UYVY_To_HUYVY(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HUYVY_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HUYVY_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
+// Whether a Huffman frame of size bytes has a thumbnail to decode: stored by the encoder, or
+// computed from the samples of a raw frame
+bool HuffmanFrameHasThumbnail(unsigned size, const unsigned char* frame);
 
-bool Decompress_HRGB24_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, bool reverse_y);
-bool Decompress_HY8_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY10_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HUYVY_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
+// One Compress function per row of ZOE_ENCODERS and one Decompress function per row of ZOE_DECODERS
+// (formats.h), e.g. Compress_Y8_To_HY8 and Decompress_HY8_To_RGB24. The layouts are the ones of
+// zoe_pixel_format (zoe.h). Gray outputs narrower than the samples keep their top bits, Y16 and
+// RGB48 outputs of HY10/HY12/HY14 have them in the MSB. Float outputs are normalized by the
+// tensor layout of the context (ZoeTensorLayout). v210 rows of width pixels (even) are
+// V210RowBytes(width) bytes apart when the stride is 0. HRGB48/HRGBA64 code each channel like
+// HY16 (see ZoeCodecContext::setColorTransform), their RGB32 outputs keep the top 8 bits of each
+// sample, for previews, bottom-up like a DIB and with alpha 0xFF for HRGB48 frames.
+#define DECLARE_ENCODER(format, input) \
+    unsigned Compress_##input##_To_##format(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx = 0, int in_stride = 0);
+#define DECLARE_HUFFMAN_ENCODER(format, input, reader) DECLARE_ENCODER(format, input)
+#define DECLARE_DECODER(format, output, options) \
+    bool Decompress_##format##_To_##output(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx = 0, int out_stride = 0);
+#define DECLARE_HUFFMAN_DECODER(format, output, options, type, op) DECLARE_DECODER(format, output, options)
+ZOE_ENCODERS(DECLARE_ENCODER, DECLARE_HUFFMAN_ENCODER)
+ZOE_DECODERS(DECLARE_DECODER, DECLARE_HUFFMAN_DECODER)
+#undef DECLARE_ENCODER
+#undef DECLARE_HUFFMAN_ENCODER
+#undef DECLARE_DECODER
+#undef DECLARE_HUFFMAN_DECODER
 
-unsigned Compress_Y12_To_Y12(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_Y12_To_Y12(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_Y12_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-unsigned Compress_Y12_To_HY12(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-unsigned Compress_PY12_To_HY12(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY12_To_Y12(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY12_To_UYVY(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY12_To_RGB24(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_Y12_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY12_To_Y8(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
-bool Decompress_HY12_To_RGB32(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame);
+// Largest HYUV420 frame: 4:2:0 8 bit, even width and height (see ZoeYuv420Codec), the Y plane
+// coded like HY8 and the U and V planes as one frame of half the size. I420 is the Y plane, then
+// the U and V planes with rows half the stride apart; NV12 is the Y plane, then one plane of U V
+// pairs with rows the stride apart. Strides are positive. RGB32 outputs are bottom-up, each U V
+// pair shared by 2x2 pixels.
+unsigned HuffmanYuv420FrameBound(unsigned width, unsigned height);
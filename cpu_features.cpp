@@ -0,0 +1,95 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "cpu_features.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ZOE_CPU_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(ZOE_CPU_X86) && defined(_MSC_VER)
+
+// Feature bits of cpuid leaf 1, ecx then edx
+static bool CpuidBit(int reg, int bit)
+{
+    int info[4];
+    __cpuid(info, 1);
+    return (info[reg] & (1<<bit)) != 0;
+}
+
+bool CpuHasSSE2()
+{
+    return CpuidBit(3, 26);
+}
+
+bool CpuHasSSSE3()
+{
+    return CpuidBit(2, 9);
+}
+
+bool CpuHasF16C()
+{
+    // F16C, OSXSAVE and AVX, then XCR0 bits 1 and 2 (SSE and AVX state)
+    return CpuidBit(2, 29) && CpuidBit(2, 27) && CpuidBit(2, 28) && (_xgetbv(0) & 6) == 6;
+}
+
+#elif defined(ZOE_CPU_X86)
+
+// The GCC and clang builtins check the OS support of AVX state for the VEX coded features
+bool CpuHasSSE2()
+{
+    return __builtin_cpu_supports("sse2") != 0;
+}
+
+bool CpuHasSSSE3()
+{
+    return __builtin_cpu_supports("ssse3") != 0;
+}
+
+bool CpuHasF16C()
+{
+    return __builtin_cpu_supports("avx") != 0 && __builtin_cpu_supports("f16c") != 0;
+}
+
+#else
+
+bool CpuHasSSE2()
+{
+    return false;
+}
+
+bool CpuHasSSSE3()
+{
+    return false;
+}
+
+bool CpuHasF16C()
+{
+    return false;
+}
+
+#endif
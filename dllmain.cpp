@@ -30,6 +30,7 @@
 
 #include "dllmain.h"
 #include "ZoeCodec.h"
+#include "zoe.h"
 
 BOOL WINAPI DllMain( HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReserved)
 {
@@ -44,20 +45,24 @@ BOOL WINAPI DllMain( HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReserv
 	return TRUE;
 }
 
-ZOECODEC_API LRESULT WINAPI DriverProc(DWORD dwDriverID, HDRVR hDriver, UINT uiMessage, LPARAM lParam1, LPARAM lParam2) 
+ZOECODEC_API LRESULT WINAPI DriverProc(DWORD_PTR dwDriverID, HDRVR hDriver, UINT uiMessage, LPARAM lParam1, LPARAM lParam2) 
 {
+    // The driver ID is the value returned by DRV_OPEN, 0 for messages sent before it
+    ZoeDriverInstance* instance = (ZoeDriverInstance*)dwDriverID;
 
     switch (uiMessage) {
     case DRV_LOAD:
         return (LRESULT)1L;
 
     case DRV_FREE:
+        zoe_shutdown();
         return (LRESULT)1L;
 
     case DRV_OPEN:
-        return (LRESULT)1L;
+        return (LRESULT)OpenInstance((ICOPEN*)lParam2);
 
     case DRV_CLOSE:
+        CloseInstance(instance);
         return (LRESULT)1L;
 
     case DRV_QUERYCONFIGURE:
@@ -82,10 +87,10 @@ ZOECODEC_API LRESULT WINAPI DriverProc(DWORD dwDriverID, HDRVR hDriver, UINT uiM
             return About((HWND)lParam1);
 
     case ICM_GETSTATE:
-        return GetState((LPVOID)lParam1, (DWORD)lParam2);
+        return GetState(instance, (LPVOID)lParam1, (DWORD)lParam2);
 
     case ICM_SETSTATE:
-        return SetState((LPVOID)lParam1, (DWORD)lParam2);
+        return SetState(instance, (LPVOID)lParam1, (DWORD)lParam2);
 
     case ICM_GETINFO:
         return GetInfo((ICINFO*)lParam1, (DWORD)lParam2);
@@ -98,13 +103,13 @@ ZOECODEC_API LRESULT WINAPI DriverProc(DWORD dwDriverID, HDRVR hDriver, UINT uiM
         break;
 
     case ICM_COMPRESS:
-        return Compress((ICCOMPRESS*)lParam1, (DWORD)lParam2);
+        return Compress(instance, (ICCOMPRESS*)lParam1, (DWORD)lParam2);
 
     case ICM_COMPRESS_QUERY:
         return CompressQuery((LPBITMAPINFOHEADER)lParam1, (LPBITMAPINFOHEADER)lParam2);
 
     case ICM_COMPRESS_BEGIN:
-        return CompressBegin((LPBITMAPINFOHEADER)lParam1, (LPBITMAPINFOHEADER)lParam2);
+        return CompressBegin(instance, (LPBITMAPINFOHEADER)lParam1, (LPBITMAPINFOHEADER)lParam2);
 
     case ICM_COMPRESS_GET_FORMAT:
         return CompressGetFormat((LPBITMAPINFOHEADER)lParam1, (LPBITMAPINFOHEADER)lParam2);
@@ -113,17 +118,17 @@ ZOECODEC_API LRESULT WINAPI DriverProc(DWORD dwDriverID, HDRVR hDriver, UINT uiM
         return CompressGetSize((LPBITMAPINFOHEADER)lParam1, (LPBITMAPINFOHEADER)lParam2);
 
     case ICM_COMPRESS_END:
-        return CompressEnd();
+        return CompressEnd(instance);
 
     case ICM_DECOMPRESS_QUERY:
         // The ICM_DECOMPRESS_QUERY message queries a video decompression driver to determine if it supports a specific input format or if it can decompress a specific input format to a specific output format.
         return DecompressQuery((LPBITMAPINFOHEADER)lParam1, (LPBITMAPINFOHEADER)lParam2);
 
     case ICM_DECOMPRESS:
-        return Decompress((ICDECOMPRESS*)lParam1, (DWORD)lParam2);
+        return Decompress(instance, (ICDECOMPRESS*)lParam1, (DWORD)lParam2);
 
     case ICM_DECOMPRESS_BEGIN:
-        return DecompressBegin((LPBITMAPINFOHEADER)lParam1, (LPBITMAPINFOHEADER)lParam2);
+        return DecompressBegin(instance, (LPBITMAPINFOHEADER)lParam1, (LPBITMAPINFOHEADER)lParam2);
 
     case ICM_DECOMPRESS_GET_FORMAT:
         // The ICM_DECOMPRESS_GET_FORMAT message requests the output format of the decompressed data from a video decompression driver.
@@ -133,7 +138,7 @@ ZOECODEC_API LRESULT WINAPI DriverProc(DWORD dwDriverID, HDRVR hDriver, UINT uiM
         return DecompressGetPalette((LPBITMAPINFOHEADER)lParam1, (LPBITMAPINFOHEADER)lParam2);
 
     case ICM_DECOMPRESS_END:
-        return DecompressEnd();
+        return DecompressEnd(instance);
 
         // Driver messages
 
@@ -28,4 +28,4 @@
 #define ZOECODEC_API //extern "C" __declspec(dllexport)
 
 // Single point of entry for VFW codec
-ZOECODEC_API LRESULT WINAPI DriverProc(DWORD dwDriverID, HDRVR hDriver, UINT uiMessage, LPARAM lParam1, LPARAM lParam2);
+ZOECODEC_API LRESULT WINAPI DriverProc(DWORD_PTR dwDriverID, HDRVR hDriver, UINT uiMessage, LPARAM lParam1, LPARAM lParam2);
@@ -0,0 +1,175 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+// The stream formats and the encoders and decoders between them and the pixel layouts, as
+// X-macro tables: each list expands its macro arguments once per row, the including file defines
+// them for the job at hand and undefines them after. The Compress/Decompress functions (codecs.h,
+// codecs.cpp), the kernels instantiated by huffman.cpp, the routes and format checks of libzoe
+// (zoe.cpp) and the default decompressor output of the VfW driver (ZoeCodec.cpp) all expand from
+// these rows, so a new output is one row of ZOE_DECODERS and a new format one row of
+// ZOE_STREAM_FORMATS plus its codec and routes. Names are the zoe_format and zoe_pixel_format
+// constants without their prefix. Rows must not use // comments, they would swallow the line
+// continuations.
+
+// Stream formats:
+//   format, Huffman coded (1) or stored (0), pixels in U Y V Y pairs (1), bytes per pixel of the
+//   coded samples (unpacked, 4:2:0 rounded up), planes of the float outputs (0 without any),
+//   flags accepted by the encoder, output of the VfW decompressor, its output for the hosts that
+//   require RGB
+#define ZOE_STREAM_FORMATS(X) \
+    X(RGB24,   0, 0, 3, 0, 0,                                                  RGB24,  RGB24) \
+    X(RGB32,   0, 0, 4, 0, 0,                                                  RGB32,  RGB32) \
+    X(Y8,      0, 0, 1, 0, 0,                                                  Y8,     RGB24) \
+    X(Y10,     0, 0, 2, 0, 0,                                                  Y10,    RGB24) \
+    X(Y12,     0, 0, 2, 0, 0,                                                  Y12,    RGB24) \
+    X(HY8,     1, 0, 1, 1, ZOE_ENCODE_THUMBNAIL,                               Y8,     RGB24) \
+    X(HY10,    1, 0, 2, 1, ZOE_ENCODE_THUMBNAIL,                               Y10,    RGB24) \
+    X(HY12,    1, 0, 2, 1, ZOE_ENCODE_THUMBNAIL,                               Y12,    RGB24) \
+    X(HY14,    1, 0, 2, 1, ZOE_ENCODE_THUMBNAIL,                               Y14,    RGB24) \
+    X(HY16,    1, 0, 2, 1, ZOE_ENCODE_THUMBNAIL,                               Y16,    RGB24) \
+    X(HRGB24,  1, 0, 3, 3, ZOE_ENCODE_THUMBNAIL,                               RGB24,  RGB24) \
+    X(HRGB32,  1, 0, 4, 4, ZOE_ENCODE_THUMBNAIL,                               RGB32,  RGB32) \
+    X(HUYVY,   1, 1, 2, 3, ZOE_ENCODE_THUMBNAIL,                               UYVY,   RGB24) \
+    X(HV210,   1, 1, 4, 0, ZOE_ENCODE_THUMBNAIL,                               V210,   V210) \
+    X(HRGB48,  1, 0, 6, 0, ZOE_ENCODE_THUMBNAIL | ZOE_ENCODE_COLOR_TRANSFORM,  RGB48,  RGB32) \
+    X(HRGBA64, 1, 0, 8, 0, ZOE_ENCODE_THUMBNAIL | ZOE_ENCODE_COLOR_TRANSFORM,  RGBA64, RGB32) \
+    X(HYUV420, 1, 0, 2, 0, 0,                                                  NV12,   RGB32)
+
+// ZoeHuffmanCodec of each Huffman format but HYUV420 (see ZoeYuv420Codec): sample type, bits per
+// sample, channels
+#define ZOE_HUFFMAN_CODEC_HY8       char, 8, 1
+#define ZOE_HUFFMAN_CODEC_HY10      short, 10, 1
+#define ZOE_HUFFMAN_CODEC_HY12      short, 12, 1
+#define ZOE_HUFFMAN_CODEC_HY14      short, 14, 1
+#define ZOE_HUFFMAN_CODEC_HY16      short, 16, 1
+#define ZOE_HUFFMAN_CODEC_HRGB24    char, 8, 3
+#define ZOE_HUFFMAN_CODEC_HRGB32    char, 8, 4
+#define ZOE_HUFFMAN_CODEC_HUYVY     char, 8, 2
+#define ZOE_HUFFMAN_CODEC_HV210     short, 10, 2
+#define ZOE_HUFFMAN_CODEC_HRGB48    short, 16, 3
+#define ZOE_HUFFMAN_CODEC_HRGBA64   short, 16, 4
+
+// Encoders, Compress_<input>_To_<format>:
+//   CUSTOM(format, input): written out in codecs.cpp
+//   HUFFMAN(format, input, reader): the codec of the format reading the input with reader
+#define ZOE_ENCODERS(CUSTOM, HUFFMAN) \
+    CUSTOM(RGB24,      RGB24) \
+    CUSTOM(RGB32,      RGB32) \
+    CUSTOM(Y8,         Y8) \
+    CUSTOM(Y10,        Y10) \
+    CUSTOM(Y12,        Y12) \
+    HUFFMAN(HY8,       Y8,     TrivialBitReader<char>) \
+    HUFFMAN(HY10,      Y10,    TrivialBitReader<short>) \
+    HUFFMAN(HY10,      PY10,   PY10Reader) \
+    HUFFMAN(HY12,      Y12,    TrivialBitReader<short>) \
+    HUFFMAN(HY12,      PY12,   PY12Reader) \
+    HUFFMAN(HY14,      Y14,    TrivialBitReader<short>) \
+    HUFFMAN(HY16,      Y16,    TrivialBitReader<short>) \
+    HUFFMAN(HRGB24,    RGB24,  TrivialBitReader<char>) \
+    HUFFMAN(HRGB32,    RGB32,  TrivialBitReader<char>) \
+    HUFFMAN(HUYVY,     UYVY,   TrivialBitReader<char>) \
+    HUFFMAN(HV210,     V210,   V210Reader) \
+    HUFFMAN(HRGB48,    RGB48,  TrivialBitReader<short>) \
+    HUFFMAN(HRGBA64,   RGBA64, TrivialBitReader<short>) \
+    CUSTOM(HYUV420,    I420) \
+    CUSTOM(HYUV420,    NV12)
+
+// Decoders, Decompress_<format>_To_<output>. options are the ZOE_DECODE_xxx flags the decoder
+// also accepts, besides ZOE_DECODE_FLIP for every Huffman format:
+//   CUSTOM(format, output, options): written out in codecs.cpp
+//   HUFFMAN(format, output, options, type, op): the codec of the format writing samples of type
+//   through OutputProcessing::op
+#define ZOE_DECODERS(CUSTOM, HUFFMAN) \
+    CUSTOM(RGB24,      RGB24,      0) \
+    CUSTOM(RGB32,      RGB32,      0) \
+    CUSTOM(Y8,         Y8,         0) \
+    CUSTOM(Y8,         UYVY,       0) \
+    CUSTOM(Y10,        Y8,         0) \
+    CUSTOM(Y10,        Y10,        0) \
+    CUSTOM(Y10,        UYVY,       0) \
+    CUSTOM(Y12,        Y8,         0) \
+    CUSTOM(Y12,        Y12,        0) \
+    CUSTOM(Y12,        UYVY,       0) \
+    HUFFMAN(HY8,       Y8,         0, char,            Default) \
+    HUFFMAN(HY8,       UYVY,       0, char,            interleave_yuyv) \
+    HUFFMAN(HY8,       RGB24,      0, char,            gray_to_rgb24) \
+    HUFFMAN(HY8,       RGB32,      0, char,            gray_to_rgb32) \
+    HUFFMAN(HY8,       F32_PLANAR, 0, float,           planar_f32) \
+    HUFFMAN(HY8,       F16_PLANAR, 0, unsigned short,  planar_f16) \
+    HUFFMAN(HY10,      Y8,         0, char,            Default) \
+    HUFFMAN(HY10,      Y10,        0, short,           Default) \
+    HUFFMAN(HY10,      UYVY,       0, short,           interleave_yuyv) \
+    HUFFMAN(HY10,      RGB24,      0, char,            gray_to_rgb24) \
+    HUFFMAN(HY10,      RGB32,      0, char,            gray_to_rgb32) \
+    HUFFMAN(HY10,      Y16,        0, short,           gray_to_y16) \
+    HUFFMAN(HY10,      RGB48,      0, short,           gray_to_rgb48) \
+    HUFFMAN(HY10,      F32_PLANAR, 0, float,           planar_f32) \
+    HUFFMAN(HY10,      F16_PLANAR, 0, unsigned short,  planar_f16) \
+    HUFFMAN(HY12,      Y8,         0, char,            Default) \
+    HUFFMAN(HY12,      Y12,        0, short,           Default) \
+    HUFFMAN(HY12,      UYVY,       0, short,           interleave_yuyv) \
+    HUFFMAN(HY12,      RGB24,      0, char,            gray_to_rgb24) \
+    HUFFMAN(HY12,      RGB32,      0, char,            gray_to_rgb32) \
+    HUFFMAN(HY12,      Y16,        0, short,           gray_to_y16) \
+    HUFFMAN(HY12,      RGB48,      0, short,           gray_to_rgb48) \
+    HUFFMAN(HY12,      F32_PLANAR, 0, float,           planar_f32) \
+    HUFFMAN(HY12,      F16_PLANAR, 0, unsigned short,  planar_f16) \
+    HUFFMAN(HY14,      Y8,         0, char,            Default) \
+    HUFFMAN(HY14,      Y14,        0, short,           Default) \
+    HUFFMAN(HY14,      RGB24,      0, char,            gray_to_rgb24) \
+    HUFFMAN(HY14,      RGB32,      0, char,            gray_to_rgb32) \
+    HUFFMAN(HY14,      Y16,        0, short,           gray_to_y16) \
+    HUFFMAN(HY14,      RGB48,      0, short,           gray_to_rgb48) \
+    HUFFMAN(HY14,      F32_PLANAR, 0, float,           planar_f32) \
+    HUFFMAN(HY14,      F16_PLANAR, 0, unsigned short,  planar_f16) \
+    HUFFMAN(HY16,      Y8,         0, char,            Default) \
+    HUFFMAN(HY16,      Y16,        0, short,           Default) \
+    HUFFMAN(HY16,      RGB24,      0, char,            gray_to_rgb24) \
+    HUFFMAN(HY16,      RGB32,      0, char,            gray_to_rgb32) \
+    HUFFMAN(HY16,      RGB48,      0, short,           gray_to_rgb48) \
+    HUFFMAN(HY16,      F32_PLANAR, 0, float,           planar_f32) \
+    HUFFMAN(HY16,      F16_PLANAR, 0, unsigned short,  planar_f16) \
+    HUFFMAN(HRGB24,    RGB24,      0, char,            Default) \
+    HUFFMAN(HRGB24,    RGB32,      0, char,            rgb24_to_rgb32) \
+    HUFFMAN(HRGB24,    F32_PLANAR, 0, float,           planar_f32) \
+    HUFFMAN(HRGB24,    F16_PLANAR, 0, unsigned short,  planar_f16) \
+    HUFFMAN(HRGB32,    RGB32,      0, char,            Default) \
+    HUFFMAN(HRGB32,    F32_PLANAR, 0, float,           planar_f32) \
+    HUFFMAN(HRGB32,    F16_PLANAR, 0, unsigned short,  planar_f16) \
+    HUFFMAN(HUYVY,     UYVY,       0, char,            Default) \
+    HUFFMAN(HUYVY,     RGB24,      ZOE_DECODE_BT709, char, uyvy_to_rgb24) \
+    HUFFMAN(HUYVY,     RGB32,      ZOE_DECODE_BT709, char, uyvy_to_rgb32) \
+    HUFFMAN(HUYVY,     F32_PLANAR, ZOE_DECODE_PLANAR_RGB | ZOE_DECODE_BT709, float, planar_f32) \
+    HUFFMAN(HUYVY,     F16_PLANAR, ZOE_DECODE_PLANAR_RGB | ZOE_DECODE_BT709, unsigned short, planar_f16) \
+    HUFFMAN(HV210,     V210,       0, char,            uyvy_to_v210) \
+    HUFFMAN(HV210,     YUV422P10,  0, short,           uyvy_to_yuv422p) \
+    HUFFMAN(HRGB48,    RGB48,      0, short,           rgb16_to_rgb16) \
+    HUFFMAN(HRGB48,    RGB32,      0, char,            rgb16_to_rgb32) \
+    HUFFMAN(HRGBA64,   RGBA64,     0, short,           rgb16_to_rgb16) \
+    HUFFMAN(HRGBA64,   RGB32,      0, char,            rgb16_to_rgb32) \
+    CUSTOM(HYUV420,    I420,       0) \
+    CUSTOM(HYUV420,    NV12,       0) \
+    CUSTOM(HYUV420,    RGB32,      ZOE_DECODE_BT709)
@@ -26,12 +26,16 @@
 //  2014-03-28 E. Danvoye    Initial Release
 //
 
-#include "stdafx.h"
-
 #include "huffman.h"
+#include "codec_context.h"
+#include "formats.h"
+#include "thread_pool.h"
 
 #include <algorithm>
 #include <assert.h>
+#include <mutex>
+#include <string.h>
+#include <type_traits>
 
 // Manual instantiation of template
 template class ZoeHuffmanCodec<char, 8, 1>;
@@ -39,21 +43,12 @@ template class ZoeHuffmanCodec<char, 8, 2>;
 template class ZoeHuffmanCodec<char, 8, 3>;
 template class ZoeHuffmanCodec<char, 8, 4>;
 template class ZoeHuffmanCodec<short, 10, 1>;
+template class ZoeHuffmanCodec<short, 10, 2>;
 template class ZoeHuffmanCodec<short, 12, 1>;
-
-struct HuffNode {
-	unsigned freq;
-	unsigned left;
-	unsigned right;
-};
-
-struct StoredTreeNode
-{
-    StoredTreeNode() : left(-1), right(-1) {}
-
-    unsigned short left;
-    unsigned short right;
-};
+template class ZoeHuffmanCodec<short, 14, 1>;
+template class ZoeHuffmanCodec<short, 16, 1>;
+template class ZoeHuffmanCodec<short, 16, 3>;
+template class ZoeHuffmanCodec<short, 16, 4>;
 
 static void buildHuffFromNode(unsigned* huff_bits, unsigned* huff_length, const HuffNode& node, const HuffNode* nodes, unsigned depth, unsigned code)
 {
@@ -84,12 +79,25 @@ static void buildHuffFromNode(unsigned* huff_bits, unsigned* huff_length, const
 	}
 }
 
+// Returns the total number of bits needed to code all the symbols counted in char_count
 template <typename T, int UsedBits>
-void buildHuffmanTables(std::pair<int, unsigned>* char_count, int& char_count_used, unsigned* huff_bits, unsigned* huff_length, int& storedTreeUsed, StoredTreeNode* storedTree)
+unsigned long long buildHuffmanTables(std::pair<int, unsigned>* char_count, int& char_count_used, unsigned* huff_bits, unsigned* huff_length, HuffNode* huffNodes, int& storedTreeUsed, StoredTreeNode* storedTree)
 {
 	// Build Huffmann tree
-	HuffNode huffNodes[(1<<UsedBits) * 2]; // TODO verify if we could use less... maybe the limit is 1<<UsedBits ?
 	int usedHuffNodes = 0;
+	unsigned long long totalBits = 0; // each symbol gets one bit for every node above it
+
+	if (char_count_used==1)
+	{
+		// Single symbol (constant channel), give it a one bit code so the tree has a root
+		HuffNode * newNode = &huffNodes[usedHuffNodes++];
+		newNode->freq = char_count[0].second;
+		newNode->left = char_count[0].first;
+		newNode->right = char_count[0].first;
+		totalBits = newNode->freq;
+		char_count[0] = std::make_pair(0x8000, newNode->freq);
+	}
+
 	while (char_count_used>1)
 	{
 		int rootCount = char_count_used;
@@ -100,6 +108,7 @@ void buildHuffmanTables(std::pair<int, unsigned>* char_count, int& char_count_us
 		newNode->freq = char_count[rootCount-2].second + char_count[rootCount-1].second;
 		newNode->left = char_count[rootCount-2].first;
 		newNode->right =char_count[rootCount-1].first; 
+		totalBits += newNode->freq;
 
 		// remove two items that have just been parented under the node
 		char_count_used-=2;
@@ -131,108 +140,680 @@ void buildHuffmanTables(std::pair<int, unsigned>* char_count, int& char_count_us
 		int rootHuffNodeIndex = char_count[0].first - 0x8000;
 		buildHuffFromNode(huff_bits, huff_length, huffNodes[rootHuffNodeIndex], huffNodes, 0, 0);
 	}
+
+	return totalBits;
+}
+
+// Frames smaller than this are coded on the calling thread only
+static const int ParallelMinSamples = 256*256;
+
+// Run job(i) for i in [0,count), spread over the shared thread pool when parallel is set
+template <typename Job>
+static void runParallel(int count, bool parallel, ZoeThreadPool::Priority priority, const Job& job)
+{
+    if (!parallel || count==1)
+    {
+        for (int i=0;i<count;i++)
+            job(i);
+        return;
+    }
+
+    ZoeThreadPool::instance().parallelFor(count, priority, job);
 }
 
 template <typename T, int UsedBits, int Channels>
 ZoeHuffmanCodec<T, UsedBits, Channels>::ZoeHuffmanCodec(int width, int height)
 	: image_width(width),
-	  image_height(height)
+	  image_height(height),
+	  codec_stats(0),
+	  src_stride(0),
+	  dest_stride(0),
+	  band_begin(0),
+	  band_end(height),
+	  region_x(0),
+	  region_y(0),
+	  region_width(width),
+	  region_height(height),
+	  colors_transformed(false),
+	  chroma_rows(0),
+	  chroma_pitch(0)
+{
+    sink.base = 0;
+    sink.stride = 0;
+    sink.bottom_up = false;
+    sink.first = 0;
+    sink.pitch = 0;
+
+    for (int c=0;c<Channels;c++)
+    {
+        sample_map[c].shift = 0;
+        sample_map[c].low_bits = 0;
+        sample_map[c].code_bits = UsedBits;
+    }
+}
+
+template <typename T, int UsedBits, int Channels>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::setStats(ZoeCodecStats * stats)
+{
+    codec_stats = stats;
+}
+
+template <typename T, int UsedBits, int Channels>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::setOptions(const ZoeCodecOptions & new_options)
+{
+    options = new_options;
+}
+
+template <typename T, int UsedBits, int Channels>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::setChromaRows(const T * rows, size_t pitch)
+{
+    chroma_rows = rows;
+    chroma_pitch = pitch;
+}
+
+template <typename T, int UsedBits, int Channels>
+int ZoeHuffmanCodec<T, UsedBits, Channels>::thumbnailWidth(int width)
+{
+    const int block = ThumbnailScale*ThumbnailPeriod;
+    return ThumbnailPeriod * ((width + block - 1) / block);
+}
+
+template <typename T, int UsedBits, int Channels>
+int ZoeHuffmanCodec<T, UsedBits, Channels>::thumbnailHeight(int height)
+{
+    return (height + ThumbnailScale - 1) / ThumbnailScale;
+}
+
+// Adds one row of the frame to the column sums of the thumbnail row it falls in. Rows are summed
+// column by column, the blocks are only summed up once per thumbnail row.
+template <typename T, int UsedBits, int Channels>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::accumulateThumbnail(const T * row, unsigned * sums) const
+{
+    // Samples are loaded 16 at a time before any sum is stored, so that the compiler can vectorize
+    // without proving that row and sums do not overlap
+    const int samples = image_width*Channels;
+    int i = 0;
+    for (;i+16<=samples;i+=16)
+    {
+        unsigned chunk[16];
+        for (int k=0;k<16;k++)
+            chunk[k] = ((typename std::make_unsigned<T>::type)row[i+k])&BitMask;
+        for (int k=0;k<16;k++)
+            sums[i+k] += chunk[k];
+    }
+    for (;i<samples;i++)
+        sums[i] += ((typename std::make_unsigned<T>::type)row[i])&BitMask;
+}
+
+// Averages the column sums of the block ending with frame row y into its thumbnail row, and clears them
+template <typename T, int UsedBits, int Channels>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::finishThumbnailRow(int y, unsigned * sums, T * thumbnail_dest) const
+{
+    const int block = ThumbnailScale*ThumbnailPeriod;
+    const int width = thumbnailWidth(image_width);
+    const unsigned rows = y%ThumbnailScale + 1;
+    T * dest = thumbnail_dest + (size_t)(y/ThumbnailScale)*width*Channels;
+
+    for (int tx=0;tx<width;tx++)
+    {
+        // Columns of the block with the parity of tx, fewer on the right edge
+        const int x_begin = (tx/ThumbnailPeriod)*block + tx%ThumbnailPeriod;
+        const int x_end = std::min((tx/ThumbnailPeriod+1)*block, image_width);
+        const unsigned count = rows * (x_end > x_begin ? (x_end - x_begin + ThumbnailPeriod - 1)/ThumbnailPeriod : 0);
+
+        for (int c=0;c<Channels;c++)
+        {
+            unsigned sum = 0;
+            for (int x=x_begin;x<x_end;x+=ThumbnailPeriod)
+                sum += sums[x*Channels+c];
+            // Whole blocks divide by a constant, a shift rather than a division per sample
+            const int full = ThumbnailScale*ThumbnailScale;
+            dest[tx*Channels+c] = (T)(count == full ? (sum + full/2)/full : count ? (sum + count/2)/count : 0);
+        }
+    }
+
+    memset(sums, 0, (size_t)image_width*Channels*sizeof(unsigned));
+}
+
+template <typename T, int UsedBits, int Channels>
+bool ZoeHuffmanCodec<T, UsedBits, Channels>::parallelFrame() const
+{
+    return options.parallel && image_width*image_height*Channels >= ParallelMinSamples;
+}
+
+template <typename T, int UsedBits, int Channels>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::setSize(int width, int height)
+{
+    image_width = width;
+    image_height = height;
+}
+
+template <typename T, int UsedBits, int Channels>
+template <typename ReaderT>
+ReaderT ZoeHuffmanCodec<T, UsedBits, Channels>::rowReader(const T * image_src, int y, int c, int step) const
+{
+    // Packed rows follow each other without padding, possibly in the middle of a byte
+    if (src_stride == 0)
+    {
+        ReaderT reader(image_src + c, step);
+        reader.seek((size_t)y*image_width*Channels/step);
+        return reader;
+    }
+
+    return ReaderT((const T *)((const char *)image_src + (ptrdiff_t)y*src_stride) + c, step);
+}
+
+template <typename T, int UsedBits, int Channels>
+template <typename ReaderT>
+const T * ZoeHuffmanCodec<T, UsedBits, Channels>::rowSamples(const T * image_src, int y, T * scratch) const
+{
+    // Unpacked samples are used in place, packed rows are expanded into scratch first
+    if (!ReaderT::Packed)
+    {
+        if (src_stride == 0)
+            return image_src + (size_t)y*image_width*Channels;
+        return (const T *)((const char *)image_src + (ptrdiff_t)y*src_stride);
+    }
+
+    ReaderT reader = rowReader<ReaderT>(image_src, y, 0, 1);
+    reader.read(scratch, (size_t)image_width*Channels);
+    return scratch;
+}
+
+// Bits needed to write value, 0 for 0
+static unsigned bitLength(unsigned value)
+{
+    unsigned bits = 0;
+    while (value)
+    {
+        value >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+template <typename T, int UsedBits, int Channels>
+inline T ZoeHuffmanCodec<T, UsedBits, Channels>::codedSample(const T * pixel, int c) const
+{
+    if (TransformsColor && options.transform_colors && (c==0 || c==2))
+        return (T)(pixel[c] - pixel[1]);
+    return pixel[c];
+}
+
+template <typename T, int UsedBits, int Channels>
+inline unsigned ZoeHuffmanCodec<T, UsedBits, Channels>::sampleCode(const SampleMap& map, T sample)
+{
+    const unsigned value = (unsigned)(typename std::make_unsigned<T>::type)sample & BitMask;
+    if (!MapsSamples)
+        return value;
+    return map.values.empty() ? value>>map.shift : map.codes[value>>map.shift];
+}
+
+template <typename T, int UsedBits, int Channels>
+inline unsigned ZoeHuffmanCodec<T, UsedBits, Channels>::wrapResidual(const SampleMap& map, unsigned d)
+{
+    if (!MapsSamples)
+        return d & BitMask;
+
+    // Closest way around between the two codes: [-half, half)
+    const unsigned half = (1u<<map.code_bits)>>1;
+    return (((d + half) & ((1u<<map.code_bits)-1)) - half) & BitMask;
+}
+
+// Sets sample_map from the values of every sample of the frame, true when any channel is not coded
+// as is. Bands of rows record the values they see, merged into the last table of value_bits.
+template <typename T, int UsedBits, int Channels>
+template <typename ReaderT>
+bool ZoeHuffmanCodec<T, UsedBits, Channels>::buildSampleMaps(const T * image_src, int band_count, bool parallel)
+{
+    const size_t words = ((size_t)1<<UsedBits)/64;
+    const size_t band_words = Channels*words;
+    if (value_bits.size() < (band_count+1)*band_words)
+        value_bits.resize((band_count+1)*band_words);
+    unsigned long long * frame_bits = &value_bits[band_count*band_words];
+    memset(frame_bits, 0, band_words*sizeof(unsigned long long));
+
+    // Bits set in every sample, and in any sample
+    unsigned and_bits[Channels];
+    unsigned or_bits[Channels];
+    for (int c=0;c<Channels;c++)
+    {
+        and_bits[c] = BitMask;
+        or_bits[c] = 0;
+    }
+
+    const size_t row_samples = (size_t)image_width*Channels;
+    std::mutex merge_lock;
+
+    runParallel(band_count, parallel, ZoeThreadPool::Normal, [&](int band) {
+        const int y_begin = (int)((long long)image_height*band/band_count);
+        const int y_end = (int)((long long)image_height*(band+1)/band_count);
+
+        unsigned long long * band_bits = &value_bits[band*band_words];
+        memset(band_bits, 0, band_words*sizeof(unsigned long long));
+        T * scratch = ReaderT::Packed ? &unpack_rows[(Channels+band)*row_samples] : 0;
+        unsigned band_and[Channels];
+        unsigned band_or[Channels];
+        for (int c=0;c<Channels;c++)
+        {
+            band_and[c] = BitMask;
+            band_or[c] = 0;
+        }
+
+        for (int y=y_begin;y<y_end;y++)
+        {
+            const T * row = rowSamples<ReaderT>(image_src, y, scratch);
+            for (size_t i=0;i<row_samples;i++)
+            {
+                const int c = (int)(i%Channels);
+                const unsigned value = (unsigned)(typename std::make_unsigned<T>::type)codedSample(row + i - c, c) & BitMask;
+                band_and[c] &= value;
+                band_or[c] |= value;
+                band_bits[c*words + value/64] |= 1ULL<<(value%64);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(merge_lock);
+        for (int c=0;c<Channels;c++)
+        {
+            and_bits[c] &= band_and[c];
+            or_bits[c] |= band_or[c];
+        }
+        for (size_t i=0;i<band_words;i++)
+            frame_bits[i] |= band_bits[i];
+    });
+
+    bool mapped = false;
+    for (int c=0;c<Channels;c++)
+    {
+        SampleMap& map = sample_map[c];
+        map.values.clear();
+
+        const unsigned constant_bits = ~(and_bits[c] ^ or_bits[c]) & BitMask;
+        map.shift = 0;
+        while (map.shift < (unsigned)UsedBits && (constant_bits>>map.shift & 1))
+            map.shift++;
+        map.low_bits = and_bits[c] & ((1u<<map.shift)-1);
+        map.code_bits = bitLength(or_bits[c]>>map.shift);
+
+        // Values used, shifted. Only worth a table when their index takes fewer bits, and the table
+        // is small next to the samples.
+        const unsigned long long * channel_bits = frame_bits + c*words;
+        for (size_t w=0;w<words;w++)
+        {
+            if (channel_bits[w] == 0)
+                continue;
+            for (unsigned bit=0;bit<64;bit++)
+                if ((channel_bits[w]>>bit) & 1)
+                    map.values.push_back((unsigned short)((w*64 + bit)>>map.shift));
+        }
+
+        const unsigned index_bits = map.values.empty() ? 0 : bitLength((unsigned)map.values.size()-1);
+        if (index_bits < map.code_bits && map.values.size()*16 <= (size_t)image_width*image_height)
+        {
+            map.code_bits = index_bits;
+            map.codes.resize((size_t)1<<(UsedBits-map.shift));
+            for (size_t i=0;i<map.values.size();i++)
+                map.codes[map.values[i]] = (unsigned short)i;
+        }
+        else
+            map.values.clear();
+
+        if (map.shift != 0 || map.code_bits != (unsigned)UsedBits || !map.values.empty())
+            mapped = true;
+    }
+
+    return mapped;
+}
+
+// Bytes of the FrameFlags::SampleMap section for sample_map
+template <typename T, int UsedBits, int Channels>
+size_t ZoeHuffmanCodec<T, UsedBits, Channels>::sampleMapBytes() const
+{
+    size_t bytes = 0;
+    for (int c=0;c<Channels;c++)
+        bytes += 16 + ((sample_map[c].values.size()*2 + 3) & ~(size_t)3);
+    return bytes;
+}
+
+template <typename T, int UsedBits, int Channels>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::writeSampleMaps(char * dest) const
+{
+    for (int c=0;c<Channels;c++)
+    {
+        const SampleMap& map = sample_map[c];
+        const unsigned header[4] = { map.shift, map.low_bits, map.code_bits, (unsigned)map.values.size() };
+        memcpy(dest, header, sizeof(header));
+        dest += sizeof(header);
+
+        const size_t value_bytes = (map.values.size()*2 + 3) & ~(size_t)3;
+        memset(dest, 0, value_bytes);
+        if (!map.values.empty())
+            memcpy(dest, &map.values[0], map.values.size()*2);
+        dest += value_bytes;
+    }
+}
+
+// Reads the section written by writeSampleMaps and moves src past it, false when it makes no sense
+template <typename T, int UsedBits, int Channels>
+bool ZoeHuffmanCodec<T, UsedBits, Channels>::readSampleMaps(const char *& src, const char * src_end)
 {
+    for (int c=0;c<Channels;c++)
+    {
+        SampleMap& map = sample_map[c];
+        unsigned header[4];
+        if (src_end - src < (ptrdiff_t)sizeof(header))
+            return false;
+        memcpy(header, src, sizeof(header));
+        src += sizeof(header);
+
+        map.shift = header[0];
+        map.low_bits = header[1];
+        map.code_bits = header[2];
+        const unsigned value_count = header[3];
+        if (map.shift > (unsigned)UsedBits || map.code_bits > (unsigned)UsedBits || value_count > (1u<<map.code_bits) ||
+            (size_t)(src_end - src) < ((value_count*2 + 3) & ~3u))
+            return false;
+
+        map.values.assign((const unsigned short *)src, (const unsigned short *)src + value_count);
+        src += (value_count*2 + 3) & ~3u;
+
+        // Codes past the last value cannot come from the encoder, they still decode to something
+        if (value_count > 0)
+            map.values.resize((size_t)1<<map.code_bits, map.values.back());
+    }
+    return true;
 }
 
 template <typename T, int UsedBits, int Channels>
 template <typename ReaderT>
-unsigned ZoeHuffmanCodec<T, UsedBits, Channels>::encode(const T * image_src, char * image_dest)
+unsigned ZoeHuffmanCodec<T, UsedBits, Channels>::encode(const T * image_src, char * image_dest, int stride)
 {
+    src_stride = stride;
+
 	// Character usage count
     for (int c=0;c<Channels;c++)
-	    for (int i=0;i<(1<<UsedBits);i++)
+    {
+	    for (int i=0;i<SymbolCount;i++)
 		    encoder_data[c].char_count[i] = std::make_pair(i,0);
+        encoder_data[c].char_count_used = SymbolCount;
+    }
 
-    ReaderT reader(image_src);
-		
-	// Run predictor + accumulate usage stats
-	for (int y=0;y<image_height;y++)
-	{
-        T prev[Channels] = {0};
-		for (int i=0;i<image_width*Channels;i++)
-		{
-            const int c = i%Channels;
-			const T b = reader.next();
-			const T d = (b-prev[c]); // Simple left-predictor
+    const bool parallel = parallelFrame();
+
+    // Run predictor + accumulate usage stats. Large frames are split in bands of rows, each band
+    // counts into its own table which is then merged.
+    const int band_count = parallel ? std::max(std::min(ZoeThreadPool::instance().workerCount()+1, image_height), 1) : 1;
+    std::mutex merge_lock;
+
+    const size_t band_table_size = Channels*SymbolCount;
+    if (band_counts.size() < band_count*band_table_size)
+        band_counts.resize(band_count*band_table_size);
+
+    // Rows of packed input: one for each channel coder, then one for each band
+    const size_t row_samples = (size_t)image_width*Channels;
+    if (ReaderT::Packed && unpack_rows.size() < (Channels+band_count)*row_samples)
+        unpack_rows.resize((Channels+band_count)*row_samples);
+
+    // The thumbnail is summed up with the statistics, while the rows are in cache
+    const size_t thumbnail_row = (size_t)thumbnailWidth(image_width)*Channels;
+    const size_t thumbnail_samples = thumbnail_row*thumbnailHeight(image_height);
+    if (options.store_thumbnails)
+    {
+        if (thumbnail_sums.size() < band_count*row_samples)
+            thumbnail_sums.resize(band_count*row_samples);
+        if (thumbnail.size() < thumbnail_samples)
+            thumbnail.resize(thumbnail_samples);
+    }
+
+    const bool mapped = MapsSamples && buildSampleMaps<ReaderT>(image_src, band_count, parallel);
+
+    runParallel(band_count, parallel, ZoeThreadPool::Normal, [&](int band) {
+        // Bands start on a thumbnail block, each block is summed by a single band
+        const int y_begin = (int)((long long)image_height*band/band_count) / ThumbnailScale * ThumbnailScale;
+        const int y_end = (band+1 == band_count) ? image_height : (int)((long long)image_height*(band+1)/band_count) / ThumbnailScale * ThumbnailScale;
+
+        unsigned * band_count_table = &band_counts[band*band_table_size];
+        memset(band_count_table, 0, band_table_size*sizeof(unsigned));
+        T * scratch = ReaderT::Packed ? &unpack_rows[(Channels+band)*row_samples] : 0;
+        unsigned * sums = options.store_thumbnails ? &thumbnail_sums[band*row_samples] : 0;
+        if (sums)
+        {
+            memset(sums, 0, row_samples*sizeof(unsigned));
+        }
+
+	    for (int y=y_begin;y<y_end;y++)
+	    {
+            const T * row = rowSamples<ReaderT>(image_src, y, scratch);
+            T prev[Channels] = {0};
+		    for (int i=0;i<image_width*Channels;i++)
+		    {
+                const int c = i%Channels;
+			    const T b = (T)sampleCode(sample_map[c], codedSample(row + i - c, c));
+			    const T d = (b-prev[c]); // Simple left-predictor
             
-			std::make_unsigned<T>::type du = ((std::make_unsigned<T>::type)d)&BitMask;
+			    const unsigned du = wrapResidual(sample_map[c], (unsigned)(typename std::make_unsigned<T>::type)d);
 
-			encoder_data[c].char_count[du].second++;
-			prev[c] = b;
-		}
-	}
+			    band_count_table[c*SymbolCount + residualSymbol(du)]++;
+			    prev[c] = b;
+		    }
+
+            if (sums)
+            {
+                accumulateThumbnail(row, sums);
+                if (y%ThumbnailScale == ThumbnailScale-1 || y+1 == image_height)
+                    finishThumbnailRow(y, sums, &thumbnail[0]);
+            }
+	    }
 
-    size_t compressed_size = 0;
+        std::lock_guard<std::mutex> lock(merge_lock);
+        for (int c=0;c<Channels;c++)
+            for (int i=0;i<SymbolCount;i++)
+                encoder_data[c].char_count[i].second += band_count_table[c*SymbolCount + i];
+    });
+
+    // Build every table first: the exact frame size is known before anything is written
+    const size_t index_rows = (image_height + RowIndexInterval - 1) / RowIndexInterval;
+    const size_t thumbnail_bytes = options.store_thumbnails ? (thumbnail_samples*sizeof(T) + 3) & ~(size_t)3 : 0;
+    size_t compressed_size = 4 + sizeof(unsigned int)*Channels + 4 + Channels*index_rows*8; // flags, stream sizes and row index
+    if (options.store_thumbnails)
+        compressed_size += 8 + thumbnail_bytes;
+    if (mapped)
+        compressed_size += sampleMapBytes();
+    unsigned stream_size[Channels];
+    int stored_tree_used[Channels];
+    bool empty_stream[Channels];
 
     for (int c=0;c<Channels;c++)
     {
-        // Sort symbol frequency
+        // Magnitude classes are followed by as many bits of the residual
+        unsigned long long residual_bits = 0;
+        if (LargeAlphabet)
+        {
+            for (int i=0;i<SymbolCount;i++)
+                residual_bits += (unsigned long long)encoder_data[c].char_count[i].second * i;
+        }
+
+        // Remove symbols with zero occurrences, then sort the rest by frequency: a reduced alphabet
+        // only sorts the symbols it uses
+        std::pair<int, unsigned> * used_end = std::partition(&encoder_data[c].char_count[0], &encoder_data[c].char_count[encoder_data[c].char_count_used],
+            [](const std::pair<int, unsigned>& a){return a.second > 0;});
+        encoder_data[c].char_count_used = std::max((int)(used_end - &encoder_data[c].char_count[0]), 1);
+
+        // A single symbol without residual bits needs no bitstream: reads past the end of a stream
+        // give zeros, and any bit decodes to the symbol (constant alpha, constant mapped channels)
+        empty_stream[c] = encoder_data[c].char_count_used == 1 && (!LargeAlphabet || encoder_data[c].char_count[0].first == 0);
         std::sort(&encoder_data[c].char_count[0], &encoder_data[c].char_count[encoder_data[c].char_count_used], 
             [](std::pair<int, unsigned>& a, std::pair<int, unsigned>& b){return a.second > b.second;});
 
-        // remove symbols with zero occurrences
-        while (encoder_data[c].char_count[encoder_data[c].char_count_used-1].second==0)
-            encoder_data[c].char_count_used--;
+        // Build Huffman tables from stats
+    	const unsigned long long bits = residual_bits + buildHuffmanTables<T, UsedBits>(encoder_data[c].char_count, encoder_data[c].char_count_used, encoder_data[c].huff_bits, encoder_data[c].huff_length, huff_nodes, stored_tree_used[c], stored_tree[c]);
+
+        // The bitstream is written in 32 bit words, its size is known before packing
+        stream_size[c] = empty_stream[c] ? 0 : (unsigned)((bits + 31) / 32) * 4;
 
-        // Store huffman tables in the compressed stream
-        StoredTreeNode storedTree[(1<<UsedBits) * 2]; // TODO check if we use all of them, maybe the size should be 1<<UsedBits
-        int storedTreeUsed = 0;
+        compressed_size += 8 + sizeof(StoredTreeNode)*stored_tree_used[c] + stream_size[c];
+    }
 
-        // Build Huffman tables from stats
-    	buildHuffmanTables<T, UsedBits>(encoder_data[c].char_count, encoder_data[c].char_count_used, encoder_data[c].huff_bits, encoder_data[c].huff_length, storedTreeUsed, storedTree);
+    // Not worth it (noise, tiny frames): store the samples as they are
+    if (compressed_size >= maxEncodedSize(image_width, image_height))
+        return encodeRaw<ReaderT>(image_src, image_dest);
+
+    compressed_size = 0;
+
+    unsigned int flags = FrameFlags::Tagged | FrameFlags::Planar | FrameFlags::RowIndex;
+    if (options.store_thumbnails)
+        flags |= FrameFlags::Thumbnail;
+    if (mapped)
+        flags |= FrameFlags::SampleMap;
+    if (TransformsColor && options.transform_colors)
+        flags |= FrameFlags::ColorTransform;
+    *((unsigned int *)&image_dest[compressed_size]) = flags;
+    compressed_size += 4;
+
+    if (options.store_thumbnails)
+    {
+        *((unsigned int *)&image_dest[compressed_size]) = thumbnailWidth(image_width);
+        *((unsigned int *)&image_dest[compressed_size+4]) = thumbnailHeight(image_height);
+        compressed_size += 8;
+        memset(&image_dest[compressed_size], 0, thumbnail_bytes);
+        memcpy(&image_dest[compressed_size], &thumbnail[0], thumbnail_samples*sizeof(T));
+        compressed_size += thumbnail_bytes;
+    }
+
+    if (mapped)
+    {
+        writeSampleMaps(&image_dest[compressed_size]);
+        compressed_size += sampleMapBytes();
+    }
 
+    for (int c=0;c<Channels;c++)
+    {
         // Store huffman tables in the compressed stream
-        *((unsigned int *)&image_dest[compressed_size]) = storedTreeUsed;
+        *((unsigned int *)&image_dest[compressed_size]) = stored_tree_used[c];
         compressed_size+= 4;
         *((unsigned int *)&image_dest[compressed_size]) = encoder_data[c].char_count[0].first - 0x8000; // root index
         compressed_size+= 4;
-        memcpy(&image_dest[compressed_size], storedTree, sizeof(StoredTreeNode)*storedTreeUsed);
-        compressed_size += sizeof(StoredTreeNode)*storedTreeUsed;
+        memcpy(&image_dest[compressed_size], stored_tree[c], sizeof(StoredTreeNode)*stored_tree_used[c]);
+        compressed_size += sizeof(StoredTreeNode)*stored_tree_used[c];
+    }
+
+    // Size of each channel bitstream, so the decoder can start all of them at once
+    char * stream_dest[Channels];
+    memcpy(&image_dest[compressed_size], stream_size, sizeof(stream_size));
+    compressed_size += sizeof(stream_size);
+
+    // Row index, filled in by each channel coder
+    *((unsigned int *)&image_dest[compressed_size]) = RowIndexInterval;
+    compressed_size += 4;
+    char * row_index = &image_dest[compressed_size];
+    compressed_size += Channels*index_rows*8;
+    for (int c=0;c<Channels;c++)
+    {
+        stream_dest[c] = &image_dest[compressed_size];
+        compressed_size += stream_size[c];
+    }
+
+    runParallel(Channels, parallel, ZoeThreadPool::Normal, [&](int c) {
+        if (empty_stream[c])
+            memset(row_index + c*index_rows*8, 0, index_rows*8);
+        else
+            encodeChannel<ReaderT>(c, image_src, stream_dest[c], row_index + c*index_rows*8);
+    });
+
+	return (unsigned)compressed_size;
+}
+
+template <typename T, int UsedBits, int Channels>
+unsigned ZoeHuffmanCodec<T, UsedBits, Channels>::maxEncodedSize(int width, int height)
+{
+    return 4 + (unsigned)width*height*Channels*sizeof(T);
+}
+
+template <typename T, int UsedBits, int Channels>
+template <typename ReaderT>
+unsigned ZoeHuffmanCodec<T, UsedBits, Channels>::encodeRaw(const T * image_src, char * image_dest)
+{
+    *((unsigned int *)image_dest) = FrameFlags::Tagged | FrameFlags::Raw;
+
+    T * samples = (T *)(image_dest + 4);
+    const size_t row_samples = (size_t)image_width*Channels;
+
+    if (std::is_same<ReaderT, TrivialBitReader<T> >::value && (src_stride == 0 || src_stride == (int)(row_samples*sizeof(T))))
+        memcpy(samples, image_src, row_samples*image_height*sizeof(T));
+    else if (std::is_same<ReaderT, TrivialBitReader<T> >::value)
+    {
+        for (int y=0;y<image_height;y++)
+            memcpy(samples + y*row_samples, (const char *)image_src + (ptrdiff_t)y*src_stride, row_samples*sizeof(T));
+    }
+    else
+    {
+        for (int y=0;y<image_height;y++)
+        {
+            ReaderT reader = rowReader<ReaderT>(image_src, y, 0, 1);
+            reader.read(samples + y*row_samples, row_samples);
+        }
     }
 
+    return maxEncodedSize(image_width, image_height);
+}
+
+template <typename T, int UsedBits, int Channels>
+template <typename ReaderT>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::encodeChannel(int c, const T * image_src, char * stream_dest, char * row_index)
+{
 	// For each line, build compressed stream by concatenating bits
-	BitPacker<unsigned> bitPacker(&image_dest[compressed_size]);
+	BitPacker<unsigned> bitPacker(stream_dest);
 
-    reader.reset();
+    const unsigned * huff_length = encoder_data[c].huff_length;
+    const unsigned * huff_bits = encoder_data[c].huff_bits;
+    const SampleMap& map = sample_map[c];
+    T * scratch = ReaderT::Packed ? &unpack_rows[c*(size_t)image_width*Channels] : 0;
 
 	for (int y=0;y<image_height;y++)
 	{
-        T prev[Channels] = {0};
-		for (int x=0;x<image_width*Channels;x++)
+        if (y%RowIndexInterval == 0)
+        {
+            const unsigned long long position = bitPacker.position();
+            memcpy(row_index + (y/RowIndexInterval)*8, &position, 8);
+        }
+
+        const T * row = rowSamples<ReaderT>(image_src, y, scratch);
+        T prev = 0;
+		for (int x=0;x<image_width;x++)
 		{
-            const int c = x%Channels;
-            const T b = reader.next();
-            const T d = (b-prev[c]); // Simple left-predictor
-            unsigned int du = ((unsigned int)(std::make_unsigned<T>::type)d)&BitMask;
+            const T b = (T)sampleCode(map, codedSample(row + x*Channels, c));
+            const T d = (b-prev); // Simple left-predictor
+            const unsigned du = wrapResidual(map, (unsigned)(typename std::make_unsigned<T>::type)d);
 
-            bitPacker.pack(encoder_data[c].huff_length[du], encoder_data[c].huff_bits[du]);
-            prev[c] = b;
+            const unsigned symbol = residualSymbol(du);
+            bitPacker.pack(huff_length[symbol], huff_bits[symbol]);
+            if (LargeAlphabet && symbol)
+            {
+                // Low bits of the residual, minus one for the negative ones (their class has a 0 on top)
+                const unsigned magnitude_bits = (du < (1u<<(UsedBits-1)) ? du : du-1) & ((1u<<symbol)-1);
+                bitPacker.pack(symbol, magnitude_bits);
+            }
+            prev = b;
 		}
 	}
-	compressed_size += bitPacker.flush();
-
-	return (unsigned)compressed_size;
+	bitPacker.flush();
 }
 
+// Reads past the end of the stream give zeros
 template <typename T>
 class BitReader
 {
 public:
-    BitReader(const char * src_ptr) : ptr((const T *)src_ptr), pos(0)
+    BitReader(const char * src_ptr, const char * src_end) : ptr((const T *)src_ptr), end(ptr + (src_end-src_ptr)/sizeof(T)), pos(0)
     {
-        current = *ptr++;
+        current = (ptr<end) ? *ptr++ : 0;
     }
     bool next()
     {
         if (pos==sizeof(T)*8)
         {
-            current = *ptr++;
+            current = (ptr<end) ? *ptr++ : 0;
             pos = 0;
         }
 
@@ -244,28 +825,237 @@ public:
     }
 private:
     const T * ptr;
+    const T * end;
     int pos;
     T current;
 };
 
-class HuffmanTree
+// Reads the 32 bit words written by BitPacker<unsigned> through a 64 bit buffer, so several bits
+// can be looked at before deciding how many to consume. Reads past the end of the stream give zeros.
+class StreamBitReader
 {
 public:
-    HuffmanTree(int rootIndex, const StoredTreeNode * storedTree) : m_rootIndex(rootIndex), m_storedTree(storedTree), m_currentIndex(rootIndex)
+    StreamBitReader() : ptr(0), end(0), buffer(0), count(0)
     {
     }
-    HuffmanTree() : m_rootIndex(0), m_storedTree(0), m_currentIndex(0)
+    void init(const char * src_ptr, unsigned size, unsigned long long bit = 0)
     {
+        // Start on the word holding the given bit, then drop the bits before it
+        ptr = (const unsigned *)src_ptr;
+        end = ptr + size/4;
+        ptr += std::min<unsigned long long>(bit/32, size/4);
+        buffer = 0;
+        count = 0;
+        refill();
+        skip((int)(bit%32));
     }
-    void init(int rootIndex, const StoredTreeNode * storedTree)
+    // Make at least 33 bits available
+    void refill()
     {
-        m_rootIndex = rootIndex; 
-        m_storedTree = storedTree; 
-        m_currentIndex = rootIndex;
+        while (count <= 32)
+        {
+            const unsigned long long word = (ptr<end) ? *ptr++ : 0;
+            buffer |= word << (32-count);
+            count += 32;
+        }
     }
-    unsigned int next(bool bit)
+    unsigned peek(int bitcount) const
     {
-        // return 0xFFFFFFFF if we have to continue searching
+        return (unsigned)(buffer >> (64-bitcount));
+    }
+    void skip(int bitcount)
+    {
+        buffer <<= bitcount;
+        count -= bitcount;
+    }
+    bool next()
+    {
+        if (count==0)
+            refill();
+        const bool r = (buffer >> 63) != 0;
+        skip(1);
+        return r;
+    }
+private:
+    const unsigned * ptr;
+    const unsigned * end;
+    unsigned long long buffer; // next bits, MSB first
+    int count;                 // valid bits in buffer
+};
+
+static inline unsigned decodeSymbol(const HuffmanDecodeTableCache::Table& table, StreamBitReader& reader)
+{
+    reader.refill();
+    const HuffmanDecodeTableCache::Entry entry = table.lookup[reader.peek(HuffmanDecodeTableCache::LookupBits)];
+    if (entry.length)
+    {
+        reader.skip(entry.length);
+        return entry.value;
+    }
+
+    // Long code, walk the rest of the tree bit by bit
+    reader.skip(HuffmanDecodeTableCache::LookupBits);
+    unsigned node = entry.value;
+    for (;;)
+    {
+        const unsigned side = reader.next() ? table.tree[node].right : table.tree[node].left;
+        if (side<0x8000)
+            return side;
+        node = side-0x8000;
+    }
+}
+
+template <typename T, int UsedBits, int Channels>
+inline unsigned ZoeHuffmanCodec<T, UsedBits, Channels>::residualSymbol(unsigned du)
+{
+    if (!LargeAlphabet)
+        return du;
+
+    // Bit count of the magnitude, the upper half of du is the negative residuals
+    unsigned magnitude = du < (1u<<(UsedBits-1)) ? du : (1u<<UsedBits) - du;
+    unsigned bits = 0;
+    if (magnitude >= 1u<<8) { magnitude >>= 8; bits += 8; }
+    if (magnitude >= 1u<<4) { magnitude >>= 4; bits += 4; }
+    if (magnitude >= 1u<<2) { magnitude >>= 2; bits += 2; }
+    if (magnitude >= 1u<<1) { magnitude >>= 1; bits += 1; }
+    return bits + magnitude;
+}
+
+template <typename T, int UsedBits, int Channels>
+inline unsigned ZoeHuffmanCodec<T, UsedBits, Channels>::decodeResidual(const HuffmanDecodeTableCache::Table& table, StreamBitReader& reader)
+{
+    const unsigned symbol = decodeSymbol(table, reader);
+    if (!LargeAlphabet || symbol==0)
+        return symbol;
+
+    // Class k residuals are [2^(k-1), 2^k) as is, and the negative ones [-(2^k-1), -2^(k-1)] minus one
+    reader.refill();
+    const unsigned bits = reader.peek(symbol);
+    reader.skip(symbol);
+    return bits >= (1u<<(symbol-1)) ? bits : bits - (1u<<symbol) + 1;
+}
+
+HuffmanDecodeTableCache::HuffmanDecodeTableCache()
+    : table_count(0),
+      use_counter(0)
+{
+}
+
+bool HuffmanDecodeTableCache::validTree(const StoredTreeNode * tree, int tree_used, unsigned root, unsigned symbol_count)
+{
+    // The encoder stores at most one node less than there are symbols, children before parents
+    if (tree_used < 1 || tree_used > (int)symbol_count || root >= (unsigned)tree_used)
+        return false;
+    for (int i=0;i<tree_used;i++)
+        for (int side=0;side<2;side++)
+        {
+            const unsigned child = side ? tree[i].right : tree[i].left;
+            if (child>=0x8000 ? child-0x8000 >= (unsigned)i : child >= symbol_count)
+                return false;
+        }
+    return true;
+}
+
+const HuffmanDecodeTableCache::Table * HuffmanDecodeTableCache::get(const StoredTreeNode * tree, int tree_used, unsigned root, unsigned symbol_count, ZoeCodecStats * stats)
+{
+    // FNV-1a over the root index and the serialized nodes
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned char * bytes = (const unsigned char *)tree;
+    for (size_t i=0;i<sizeof(StoredTreeNode)*tree_used;i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    hash = (hash ^ root) * 1099511628211ULL;
+
+    use_counter++;
+
+    for (int i=0;i<table_count;i++)
+    {
+        Table& table = tables[i];
+        if (table.hash==hash && table.root==root && table.tree.size()==(size_t)tree_used &&
+            memcmp(&table.tree[0], tree, sizeof(StoredTreeNode)*tree_used)==0)
+        {
+            table.last_use = use_counter;
+            if (stats)
+                stats->table_cache_hits++;
+            return &table;
+        }
+    }
+
+    // Miss: the tree is checked once, then take a free table or the least recently used one
+    if (!validTree(tree, tree_used, root, symbol_count))
+        return 0;
+    int slot = table_count;
+    if (table_count<Size)
+        table_count++;
+    else
+    {
+        slot = 0;
+        for (int i=1;i<Size;i++)
+            if (tables[i].last_use<tables[slot].last_use)
+                slot = i;
+    }
+
+    Table& table = tables[slot];
+    table.tree.assign(tree, tree+tree_used);
+    table.root = root;
+    table.hash = hash;
+    table.last_use = use_counter;
+    build(table, root, 0, 0);
+
+    if (stats)
+        stats->table_cache_misses++;
+    return &table;
+}
+
+void HuffmanDecodeTableCache::build(Table& table, unsigned node, unsigned depth, unsigned code)
+{
+    if (depth==LookupBits)
+    {
+        // Internal node at the end of the lookup window, decoding continues from it
+        table.lookup[code].value = (unsigned short)node;
+        table.lookup[code].length = 0;
+        return;
+    }
+
+    for (int side=0;side<2;side++)
+    {
+        const unsigned child = side ? table.tree[node].right : table.tree[node].left;
+        const unsigned child_code = (code<<1) | side;
+
+        if (child>=0x8000)
+        {
+            if (child-0x8000 < table.tree.size())
+                build(table, child-0x8000, depth+1, child_code);
+            continue;
+        }
+
+        // Leaf: every lookup index starting with this code resolves to the symbol
+        const unsigned shift = LookupBits-(depth+1);
+        Entry entry;
+        entry.value = (unsigned short)child;
+        entry.length = (unsigned short)(depth+1);
+        for (unsigned i=0;i<(1u<<shift);i++)
+            table.lookup[(child_code<<shift) | i] = entry;
+    }
+}
+
+class HuffmanTree
+{
+public:
+    HuffmanTree(int rootIndex, const StoredTreeNode * storedTree) : m_rootIndex(rootIndex), m_storedTree(storedTree), m_currentIndex(rootIndex)
+    {
+    }
+    HuffmanTree() : m_rootIndex(0), m_storedTree(0), m_currentIndex(0)
+    {
+    }
+    void init(int rootIndex, const StoredTreeNode * storedTree)
+    {
+        m_rootIndex = rootIndex; 
+        m_storedTree = storedTree; 
+        m_currentIndex = rootIndex;
+    }
+    unsigned int next(bool bit)
+    {
+        // return 0xFFFFFFFF if we have to continue searching
         // return char value if we read a leaf
 
         int side = bit?m_storedTree[m_currentIndex].right:m_storedTree[m_currentIndex].left;
@@ -287,152 +1077,1098 @@ private:
     const StoredTreeNode * m_storedTree;
 };
 
-unsigned char Clip(int clr)
+// The parts of a SampleMap the decode loops need, copied to locals so output stores cannot alias them
+struct SampleRestore
+{
+    explicit SampleRestore(const SampleMap& map)
+        : code_mask((1u<<map.code_bits)-1), shift(map.shift), low_bits(map.low_bits), values(map.values.empty() ? 0 : &map.values[0])
+    {}
+
+    // Sample of the code (only its code_bits low bits count)
+    unsigned operator()(unsigned code) const
+    {
+        code &= code_mask;
+        return ((values ? values[code] : code) << shift) | low_bits;
+    }
+
+    unsigned code_mask;
+    unsigned shift;
+    unsigned low_bits;
+    const unsigned short * values;
+};
+
+// Sample of UsedBits to an output value, the top 8 bits for 8 bit outputs
+template <typename To, int UsedBits>
+static inline To narrowSample(unsigned du)
+{
+    return (sizeof(To)*8<UsedBits) ? static_cast<To>((du>>(UsedBits-sizeof(To)*8))&0xFF) : static_cast<To>(du);
+}
+
+// Output ops as policies: everything an op changes in the decode is a compile-time constant or a
+// static function of its policy, so each decode<To, op> instance gets inner loops without any
+// test of the op. A new op is one more specialization.
+//
+// write() stores channel c of pixel x for the ops writing samples one at a time. The ops that
+// convert whole rows (ConvertsRows) go through convertRow() instead.
+//
+// Default: each channel as is, interleaved like the frame
+template <int op>
+struct OutputOp
+{
+    enum {
+        BottomUp = 0,       // RGB rows bottom-up, like a DIB, unless the output is flipped
+        Planar = 0,         // one plane per channel, destRow() gives the row in the first plane
+        ConvertsRows = 0,   // needs the samples of every channel of a row at once, decoded first then converted
+        Half = 0,           // float planes stored as float16
+        IntegerPlanes = 0,  // planes of the samples as they are instead of floats, 4:2:2 chroma at half width
+        PacksV210 = 0,      // rows of U Y V Y samples packed as v210
+        RestoresRGB = 0,    // B G R (A) pixels of 16 bit frames, through writePixel()
+        SplitsChroma = 0,   // 4:2:0 U V pairs to a U plane and the V plane right after it
+        AddsChroma = 0      // 4:2:0 luma to RGB, with the U V pairs given by setChromaRows()
+    };
+
+    // Output values written for each pixel
+    template <typename To, int Channels>
+    static size_t pixelLength() { return Channels; }
+
+    template <typename T, int UsedBits, int Channels, typename To>
+    static void write(To * dest_row, int x, int c, unsigned du)
+    {
+        dest_row[x*Channels+c] = narrowSample<To, UsedBits>(du);
+    }
+
+    // Stores pixel x from all its channels, for the ops that RestoresRGB
+    template <typename T, int UsedBits, int Channels, typename To>
+    static void writePixel(To * dest_row, int x, unsigned b, unsigned g, unsigned r, unsigned a) {}
+};
+
+// Gray to UYVY with neutral chroma: bytes, or the 16 bit words of both as one value
+template <>
+struct OutputOp<OutputProcessing::interleave_yuyv> : OutputOp<OutputProcessing::Default>
+{
+    template <typename To, int Channels>
+    static size_t pixelLength() { return sizeof(To)==1 ? 2 : 1; }
+
+    template <typename T, int UsedBits, int Channels, typename To>
+    static void write(To * dest_row, int x, int c, unsigned du)
+    {
+        if (sizeof(To)==1)
+        {
+            dest_row[x*2] = (To)0x80;
+            dest_row[x*2+1] = narrowSample<To, UsedBits>(du);
+        }
+        else
+            dest_row[x] = static_cast<To>(((du<<(sizeof(T)*8-UsedBits))&0xFF00) | 0x0080); // interleave for 10 bit
+    }
+};
+
+template <>
+struct OutputOp<OutputProcessing::gray_to_rgb24> : OutputOp<OutputProcessing::Default>
+{
+    enum { BottomUp = 1 };
+
+    template <typename To, int Channels>
+    static size_t pixelLength() { return 3; }
+
+    template <typename T, int UsedBits, int Channels, typename To>
+    static void write(To * dest_row, int x, int c, unsigned du)
+    {
+        const To value = narrowSample<To, UsedBits>(du);
+        dest_row[x*3+0] = value;
+        dest_row[x*3+1] = value;
+        dest_row[x*3+2] = value;
+    }
+};
+
+template <>
+struct OutputOp<OutputProcessing::gray_to_rgb32> : OutputOp<OutputProcessing::Default>
+{
+    enum { BottomUp = 1 };
+
+    template <typename To, int Channels>
+    static size_t pixelLength() { return 4; }
+
+    template <typename T, int UsedBits, int Channels, typename To>
+    static void write(To * dest_row, int x, int c, unsigned du)
+    {
+        const To value = narrowSample<To, UsedBits>(du);
+        dest_row[x*4+0] = value;
+        dest_row[x*4+1] = value;
+        dest_row[x*4+2] = value;
+        dest_row[x*4+3] = (To)0xFF;
+    }
+};
+
+template <>
+struct OutputOp<OutputProcessing::gray_to_y16> : OutputOp<OutputProcessing::Default>
+{
+    template <typename T, int UsedBits, int Channels, typename To>
+    static void write(To * dest_row, int x, int c, unsigned du)
+    {
+        dest_row[x] = static_cast<To>(du<<(16-UsedBits)); // MSB aligned, the low bits are 0
+    }
+};
+
+template <>
+struct OutputOp<OutputProcessing::gray_to_rgb48> : OutputOp<OutputProcessing::Default>
+{
+    template <typename To, int Channels>
+    static size_t pixelLength() { return 3; }
+
+    template <typename T, int UsedBits, int Channels, typename To>
+    static void write(To * dest_row, int x, int c, unsigned du)
+    {
+        const To msb_value = static_cast<To>(du<<(16-UsedBits));
+        dest_row[x*3+0] = msb_value;
+        dest_row[x*3+1] = msb_value;
+        dest_row[x*3+2] = msb_value;
+    }
+};
+
+template <>
+struct OutputOp<OutputProcessing::rgb24_to_rgb32> : OutputOp<OutputProcessing::Default>
+{
+    template <typename To, int Channels>
+    static size_t pixelLength() { return 4; }
+
+    template <typename T, int UsedBits, int Channels, typename To>
+    static void write(To * dest_row, int x, int c, unsigned du)
+    {
+        dest_row[x*4+c] = narrowSample<To, UsedBits>(du);
+        if (c==2)
+            dest_row[x*4+3] = (To)0xFF;
+    }
+};
+
+template <>
+struct OutputOp<OutputProcessing::uyvy_to_rgb24> : OutputOp<OutputProcessing::Default>
+{
+    enum { BottomUp = 1, ConvertsRows = 1 };
+
+    template <typename To, int Channels>
+    static size_t pixelLength() { return 3; }
+};
+
+template <>
+struct OutputOp<OutputProcessing::uyvy_to_rgb32> : OutputOp<OutputProcessing::Default>
+{
+    enum { BottomUp = 1, ConvertsRows = 1 };
+
+    template <typename To, int Channels>
+    static size_t pixelLength() { return 4; }
+};
+
+template <>
+struct OutputOp<OutputProcessing::planar_f32> : OutputOp<OutputProcessing::Default>
+{
+    enum { Planar = 1, ConvertsRows = 1 };
+
+    template <typename To, int Channels>
+    static size_t pixelLength() { return 1; }
+};
+
+template <>
+struct OutputOp<OutputProcessing::planar_f16> : OutputOp<OutputProcessing::planar_f32>
+{
+    enum { Half = 1 };
+};
+
+// Y plane, then U and V planes of half the width and half the row stride
+template <>
+struct OutputOp<OutputProcessing::uyvy_to_yuv422p> : OutputOp<OutputProcessing::planar_f32>
+{
+    enum { IntegerPlanes = 1 };
+};
+
+template <>
+struct OutputOp<OutputProcessing::uyvy_to_v210> : OutputOp<OutputProcessing::Default>
+{
+    enum { ConvertsRows = 1, PacksV210 = 1 };
+};
+
+// 16 bit B G R (A) rows as they were coded, with the colour transform of the frame undone
+template <>
+struct OutputOp<OutputProcessing::rgb16_to_rgb16> : OutputOp<OutputProcessing::Default>
 {
-    return (unsigned char)(clr < 0 ? 0 : ( clr > 255 ? 255 : clr ));
+    enum { ConvertsRows = 1, RestoresRGB = 1 };
+
+    template <typename T, int UsedBits, int Channels, typename To>
+    static void writePixel(To * dest_row, int x, unsigned b, unsigned g, unsigned r, unsigned a)
+    {
+        To * pixel = dest_row + x*Channels;
+        pixel[0] = (To)b;
+        pixel[1] = (To)g;
+        pixel[2] = (To)r;
+        if (Channels==4)
+            pixel[3] = (To)a;
+    }
+};
+
+// The top 8 bits of each channel as RGB32, for previews. Frames without alpha get 0xFF. The 16 bit
+// frames are top-down, RGB32 is a DIB.
+template <>
+struct OutputOp<OutputProcessing::rgb16_to_rgb32> : OutputOp<OutputProcessing::rgb16_to_rgb16>
+{
+    enum { BottomUp = 1 };
+
+    template <typename To, int Channels>
+    static size_t pixelLength() { return 4; }
+
+    template <typename T, int UsedBits, int Channels, typename To>
+    static void writePixel(To * dest_row, int x, unsigned b, unsigned g, unsigned r, unsigned a)
+    {
+        dest_row[x*4+0] = narrowSample<To, UsedBits>(b);
+        dest_row[x*4+1] = narrowSample<To, UsedBits>(g);
+        dest_row[x*4+2] = narrowSample<To, UsedBits>(r);
+        dest_row[x*4+3] = narrowSample<To, UsedBits>(a);
+    }
+};
+
+// U V pairs of 4:2:0 chroma to the U plane, V to the plane that follows it
+template <>
+struct OutputOp<OutputProcessing::uv_to_yuv420p> : OutputOp<OutputProcessing::Default>
+{
+    enum { ConvertsRows = 1, SplitsChroma = 1 };
+
+    template <typename To, int Channels>
+    static size_t pixelLength() { return 1; }
+};
+
+template <>
+struct OutputOp<OutputProcessing::yuv420_to_rgb32> : OutputOp<OutputProcessing::Default>
+{
+    enum { BottomUp = 1, ConvertsRows = 1, AddsChroma = 1 };
+
+    template <typename To, int Channels>
+    static size_t pixelLength() { return 4; }
+};
+
+template <typename T, int UsedBits, int Channels>
+int ZoeHuffmanCodec<T, UsedBits, Channels>::bandRows() const
+{
+    return (options.band_output && options.band_output->rows>0) ? options.band_output->rows : region_height;
+}
+
+template <typename T, int UsedBits, int Channels>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::beginBand(int y)
+{
+    band_begin = y;
+    band_end = std::min(y+bandRows(), region_y+region_height);
+
+    // Each band starts over at the start of the output (the whole region when there are no bands)
+    sink.first = sink.bottom_up ? sink.base + (ptrdiff_t)(band_end-band_begin-1)*sink.stride : sink.base;
+    sink.pitch = sink.bottom_up ? -sink.stride : sink.stride;
+}
+
+// Hands the band just written to the band output, false when the caller wants no more rows
+template <typename T, int UsedBits, int Channels>
+bool ZoeHuffmanCodec<T, UsedBits, Channels>::endBand() const
+{
+    if (!options.band_output)
+        return true;
+
+    const int first_row = sink.bottom_up ? image_height-band_end : band_begin;
+    return options.band_output->written(options.band_output->user, first_row, band_end-band_begin);
 }
 
 template <typename T, int UsedBits, int Channels>
 template <typename To, int op>
-bool ZoeHuffmanCodec<T, UsedBits, Channels>::decode(const char * image_src, To * image_dest)
+size_t ZoeHuffmanCodec<T, UsedBits, Channels>::pixelLength()
 {
-    HuffmanTree tree[Channels];
+    return OutputOp<op>::template pixelLength<To, Channels>();
+}
+
+// Output of the following rows, rows as wide as the region. The orientation of the op and the
+// flip setting are resolved here once, every row after that is a multiply-add away.
+template <typename T, int UsedBits, int Channels>
+template <typename To, int op>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::openSink(To * image_dest)
+{
+    sink.base = (char *)image_dest;
+    const size_t row_bytes = OutputOp<op>::PacksV210 ? V210RowBytes(region_width) : region_width * pixelLength<To, op>() * sizeof(To);
+    sink.stride = dest_stride ? (ptrdiff_t)dest_stride : (ptrdiff_t)row_bytes;
+    sink.bottom_up = OutputOp<op>::BottomUp != options.flip_output;
+}
+
+// Output row of image row y, in the current band
+template <typename T, int UsedBits, int Channels>
+template <typename To>
+To * ZoeHuffmanCodec<T, UsedBits, Channels>::destRow(int y) const
+{
+    return (To *)(sink.first + (ptrdiff_t)(y-band_begin)*sink.pitch);
+}
+
+template <typename T, int UsedBits, int Channels>
+template <typename To, int op>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::writeSample(To * dest_row, int x, int c, unsigned du)
+{
+    OutputOp<op>::template write<T, UsedBits, Channels, To>(dest_row, x, c, du);
+}
+
+template <typename T, int UsedBits, int Channels>
+template <typename To, int op>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::writeUYVYAsRGB(const T * uyvy_row, To * dest_row, int width) const
+{
+    ConvertUYVYToRGB((const unsigned char*)uyvy_row, (unsigned char*)dest_row, width, pixelLength<To, op>()==4, options.color_matrix);
+}
+
+// Output row of image row y of the region from samples of every channel of the row, starting at
+// the region. Sample x of channel c is samples[c*channel_pitch + x], or samples[x*Channels + c]
+// when channel_pitch is 0.
+template <typename T, int UsedBits, int Channels>
+template <typename To, int op>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::convertRow(const T * samples, size_t channel_pitch, int y, To * dest_row)
+{
+    if (OutputOp<op>::PacksV210)
+    {
+        PackV210((const unsigned short *)samples, (unsigned char *)dest_row, (size_t)region_width*Channels);
+        return;
+    }
+    if (OutputOp<op>::RestoresRGB)
+    {
+        // Blue and red are added back to green when the frame was coded with the colour transform
+        typedef typename std::make_unsigned<T>::type U;
+        for (int x=0;x<region_width;x++)
+        {
+            const T * pixel = samples + x*Channels;
+            const unsigned g = (U)pixel[1] & BitMask;
+            const unsigned offset = colors_transformed ? g : 0;
+            const unsigned b = ((U)pixel[0] + offset) & BitMask;
+            const unsigned r = ((U)pixel[2] + offset) & BitMask;
+            const unsigned a = Channels==4 ? (U)pixel[Channels-1] & BitMask : BitMask;
+            OutputOp<op>::template writePixel<T, UsedBits, Channels, To>(dest_row, x, b, g, r, a);
+        }
+        return;
+    }
+    if (OutputOp<op>::SplitsChroma)
+    {
+        To * v_row = (To *)((char *)dest_row + sink.stride*region_height);
+        for (int x=0;x<region_width;x++)
+        {
+            dest_row[x] = (To)samples[x*2];
+            v_row[x] = (To)samples[x*2+1];
+        }
+        return;
+    }
+    if (OutputOp<op>::AddsChroma)
+    {
+        // The U V pair of two rows goes with two pixels of each, as UYVY for the conversion
+        const T * pairs = chroma_rows + (size_t)((y-region_y)/2)*chroma_pitch;
+        if (planar_row.size() < (size_t)region_width*2)
+            planar_row.resize((size_t)region_width*2);
+        for (int x=0;x<region_width;x++)
+        {
+            planar_row[x*2] = pairs[x];
+            planar_row[x*2+1] = samples[x];
+        }
+        writeUYVYAsRGB<To, op>(&planar_row[0], dest_row, region_width);
+        return;
+    }
+    if (!OutputOp<op>::Planar)
+    {
+        writeUYVYAsRGB<To, op>(samples, dest_row, region_width);
+        return;
+    }
+
+    const int width = region_width;
+    if (channel_pitch == 0)
+    {
+        // Interleaved samples (raw frames, older frames), each channel is gathered apart first.
+        // Raw frames keep the unused bits of the input, they are dropped like writeSample does.
+        if (planar_row.size() < (size_t)width*(Channels+2))
+            planar_row.resize((size_t)width*(Channels+2));
+        for (int x=0;x<width;x++)
+            for (int c=0;c<Channels;c++)
+                planar_row[c*width + x] = (T)(samples[x*Channels + c] & BitMask);
+        samples = &planar_row[0];
+        channel_pitch = width;
+    }
+
+    if (OutputOp<op>::IntegerPlanes)
+    {
+        // Rows of the chroma planes are as far from their plane as the luma row is, halved
+        const T * chroma = samples;
+        const T * luma = samples + (Channels==2 ? channel_pitch : 0);
+        const ptrdiff_t luma_plane = sink.stride*region_height;
+        const ptrdiff_t chroma_offset = ((char *)dest_row - sink.base)/2;
+        To * u_row = (To *)(sink.base + luma_plane + chroma_offset);
+        To * v_row = (To *)(sink.base + luma_plane + luma_plane/2 + chroma_offset);
+        for (int x=0;x<width;x++)
+            dest_row[x] = (To)luma[x];
+        for (int x=0;x<width/2;x++)
+        {
+            u_row[x] = (To)chroma[x*2];
+            v_row[x] = (To)chroma[x*2+1];
+        }
+        return;
+    }
+
+    const ZoeTensorLayout default_layout = { 1.0f, 0.0f, 0, false };
+    const ZoeTensorLayout& layout = options.tensor_layout ? *options.tensor_layout : default_layout;
+    const ptrdiff_t plane_stride = layout.plane_stride ? layout.plane_stride : sink.stride*region_height;
+    const int planes = (Channels==2) ? 3 : Channels;
+    To * plane_row[4];
+    for (int p=0;p<planes;p++)
+        plane_row[p] = (To *)((char *)dest_row + p*plane_stride);
+
+    if (Channels != 2)
+    {
+        // Channels are stored B G R A, planes come R G B A
+        for (int p=0;p<planes;p++)
+            writePlane<To, op>(samples + ((Channels>=3 && p<3) ? 2-p : p)*channel_pitch, plane_row[p]);
+        return;
+    }
+
+    // UYVY: channel 0 alternates U and V from an even x, each pair of pixels shares them
+    if (planar_row.size() < (size_t)width*(Channels+2))
+        planar_row.resize((size_t)width*(Channels+2));
+    T * cb = &planar_row[Channels*width];
+    T * cr = cb + width;
+    const T * chroma = samples;
+    const T * luma = samples + channel_pitch;
+    for (int x=0;x<width;x++)
+    {
+        cb[x] = chroma[x & ~1];
+        cr[x] = chroma[x | 1];
+    }
+
+    if (!layout.rgb)
+    {
+        writePlane<To, op>(luma, plane_row[0]);
+        writePlane<To, op>(cb, plane_row[1]);
+        writePlane<To, op>(cr, plane_row[2]);
+        return;
+    }
+
+    typedef typename std::make_unsigned<T>::type Sample;
+    if (float_row.size() < (size_t)width*6)
+        float_row.resize((size_t)width*6);
+    float * yuv = &float_row[0];
+    ConvertSamplesToFloat((const Sample *)luma, width, 1.0f, 0.0f, yuv);
+    ConvertSamplesToFloat((const Sample *)cb, width, 1.0f, 0.0f, yuv + width);
+    ConvertSamplesToFloat((const Sample *)cr, width, 1.0f, 0.0f, yuv + 2*width);
+
+    if (!OutputOp<op>::Half)
+        ConvertYuvToRgbFloat(yuv, yuv + width, yuv + 2*width, width, options.color_matrix, layout.scale, layout.offset,
+            (float *)plane_row[0], (float *)plane_row[1], (float *)plane_row[2]);
+    else
+    {
+        float * rgb = yuv + 3*width;
+        ConvertYuvToRgbFloat(yuv, yuv + width, yuv + 2*width, width, options.color_matrix, layout.scale, layout.offset,
+            rgb, rgb + width, rgb + 2*width);
+        for (int p=0;p<3;p++)
+            ConvertFloatToHalf(rgb + p*width, width, (unsigned short *)plane_row[p]);
+    }
+}
+
+// region_width samples of one channel to a row of a float plane
+template <typename T, int UsedBits, int Channels>
+template <typename To, int op>
+void ZoeHuffmanCodec<T, UsedBits, Channels>::writePlane(const T * samples, To * plane_row)
+{
+    typedef typename std::make_unsigned<T>::type Sample;
+    const float scale = options.tensor_layout ? options.tensor_layout->scale : 1.0f;
+    const float offset = options.tensor_layout ? options.tensor_layout->offset : 0.0f;
+
+    if (!OutputOp<op>::Half)
+        ConvertSamplesToFloat((const Sample *)samples, region_width, scale, offset, (float *)plane_row);
+    else
+    {
+        if (float_row.size() < (size_t)region_width)
+            float_row.resize(region_width);
+        ConvertSamplesToFloat((const Sample *)samples, region_width, scale, offset, &float_row[0]);
+        ConvertFloatToHalf(&float_row[0], region_width, (unsigned short *)plane_row);
+    }
+}
+
+template <typename T, int UsedBits, int Channels>
+template <typename To, int op>
+bool ZoeHuffmanCodec<T, UsedBits, Channels>::decode(const char * image_src, unsigned src_size, To * image_dest, int stride)
+{
+    dest_stride = stride;
+
+    // Each section is checked to lie within the frame before it is read
+    const char * const src_end = image_src + src_size;
+    auto fits = [src_end](const char * src, unsigned long long bytes) {
+        return bytes <= (unsigned long long)(src_end - src);
+    };
+    if (src_size < 4)
+        return false;
+
+    // Whole frame unless a region was given
+    region_x = options.output_region ? options.output_region->x : 0;
+    region_y = options.output_region ? options.output_region->y : 0;
+    region_width = options.output_region ? options.output_region->width : image_width;
+    region_height = options.output_region ? options.output_region->height : image_height;
+    openSink<To, op>(image_dest);
+    colors_transformed = false; // thumbnails and raw frames hold the samples as they are
+
+    if ((*((const unsigned int*)image_src) & FrameFlags::Tagged) == 0)
+        return options.thumbnail_output ? false : decodeInterleaved<To, op>(image_src, src_end);
+
+    const unsigned flags = *((const unsigned int*)image_src);
+    image_src += 4;
+    if ((flags & FrameFlags::ColorTransform) && !OutputOp<op>::RestoresRGB)
+        return false;
+
+    const T * thumbnail_src = 0;
+    if (flags & FrameFlags::Thumbnail)
+    {
+        if (!fits(image_src, 8))
+            return false;
+        const int thumbnail_width = ((const int*)image_src)[0];
+        const int thumbnail_height = ((const int*)image_src)[1];
+        if (thumbnail_width != thumbnailWidth(image_width) || thumbnail_height != thumbnailHeight(image_height))
+            return false;
+        const unsigned long long thumbnail_bytes = ((unsigned long long)thumbnail_width*thumbnail_height*Channels*sizeof(T) + 3) & ~3ULL;
+        if (!fits(image_src, 8 + thumbnail_bytes))
+            return false;
+        thumbnail_src = (const T *)(image_src + 8);
+        image_src += 8 + thumbnail_bytes;
+    }
+
+    const unsigned long long raw_bytes = (unsigned long long)image_width*image_height*Channels*sizeof(T);
+    if ((flags & FrameFlags::Raw) && !fits(image_src, raw_bytes))
+        return false;
+
+    if (options.thumbnail_output)
+    {
+        if (thumbnail_src)
+            return decodeThumbnail<To, op>(thumbnail_src, image_dest);
+        if ((flags & FrameFlags::Raw) == 0)
+            return false;
+
+        // Raw frames have the samples at hand, sum them up like the encoder does
+        const size_t row_samples = (size_t)image_width*Channels;
+        const size_t thumbnail_row = (size_t)thumbnailWidth(image_width)*Channels;
+        thumbnail_sums.assign(row_samples, 0);
+        if (thumbnail.size() < thumbnail_row*thumbnailHeight(image_height))
+            thumbnail.resize(thumbnail_row*thumbnailHeight(image_height));
+        for (int y=0;y<image_height;y++)
+        {
+            accumulateThumbnail((const T *)image_src + y*row_samples, &thumbnail_sums[0]);
+            if (y%ThumbnailScale == ThumbnailScale-1 || y+1 == image_height)
+                finishThumbnailRow(y, &thumbnail_sums[0], &thumbnail[0]);
+        }
+        return decodeThumbnail<To, op>(&thumbnail[0], image_dest);
+    }
+
+    if (flags & FrameFlags::Raw)
+        return decodeRaw<To, op>((const T *)image_src);
+
+    if ((flags & FrameFlags::Planar) == 0)
+        return false;
+    colors_transformed = (flags & FrameFlags::ColorTransform) != 0;
+
+    if (flags & FrameFlags::SampleMap)
+    {
+        if (!MapsSamples || !readSampleMaps(image_src, src_end))
+            return false;
+    }
+    else
+    {
+        for (int c=0;c<Channels;c++)
+        {
+            sample_map[c].shift = 0;
+            sample_map[c].low_bits = 0;
+            sample_map[c].code_bits = UsedBits;
+            sample_map[c].values.clear();
+        }
+    }
+
+    const HuffmanDecodeTableCache::Table * table[Channels];
 
     for (int c=0;c<Channels;c++)
     {
         // Read Huffman tables
-        int storedTreeUsed = *((const unsigned int*)image_src);
+        if (!fits(image_src, 8))
+            return false;
+        const unsigned storedTreeUsed = *((const unsigned int*)image_src);
         image_src += 4;
-        int storedTreeRootIndex = *((const unsigned int*)image_src);
+        const unsigned storedTreeRootIndex = *((const unsigned int*)image_src);
         image_src += 4;
+        if (storedTreeUsed > SymbolCount || !fits(image_src, sizeof(StoredTreeNode)*storedTreeUsed))
+            return false;
         const StoredTreeNode * storedTree = (const StoredTreeNode *)image_src;
         image_src += sizeof(StoredTreeNode)*storedTreeUsed;
 
-        tree[c].init(storedTreeRootIndex, storedTree);
+        // The cache holds more tables than there are channels, earlier channels stay valid
+        table[c] = table_cache.get(storedTree, (int)storedTreeUsed, storedTreeRootIndex, SymbolCount, codec_stats);
+        if (!table[c])
+            return false;
     }
 
-    const char * src_ptr = image_src;
-    BitReader<unsigned> reader(src_ptr);
-
-    for (int y=0;y<image_height;y++)
-    {
-        int output_mult = 1;
-        if ((op==OutputProcessing::rgb24_to_rgb32 || op==OutputProcessing::rgb24_to_rgb32_revY || op==OutputProcessing::gray_to_rgb32 || op==OutputProcessing::uyvy_to_rgb32)&&sizeof(To)==1)
-            output_mult = 4;
-        if ((op==OutputProcessing::gray_to_rgb24 || op==OutputProcessing::uyvy_to_rgb24)&&sizeof(To)==1)
-            output_mult = 3;
-        else if (op==OutputProcessing::interleave_yuyv&&sizeof(To)==1)
-            output_mult = 2;
-
-        To * dest_ptr;
-
-        if (op==OutputProcessing::rgb24_to_rgb32)
-            dest_ptr = image_dest + y * image_width * output_mult; // no reverse-y, but 4 bytes instead of 3
-        else if (op==OutputProcessing::rgb24_to_rgb32_revY)
-            dest_ptr = image_dest + (image_height-y-1) * image_width * output_mult; // no reverse-y, but 4 bytes instead of 3
-        else if (op==OutputProcessing::gray_to_rgb24 || op==OutputProcessing::uyvy_to_rgb24 || op==OutputProcessing::gray_to_rgb32 || op==OutputProcessing::uyvy_to_rgb32)
-            dest_ptr = image_dest + (image_height-y-1) * image_width * output_mult; // reverse Y for rgb formats
-        else
-            dest_ptr = image_dest + y * image_width * Channels * output_mult;
+    // Locate each channel bitstream
+    const char * stream_src[Channels];
+    if (!fits(image_src, sizeof(unsigned int)*Channels))
+        return false;
+    const unsigned int * stream_size = (const unsigned int*)image_src;
+    image_src += sizeof(unsigned int)*Channels;
 
-        int nb_read = 0;
-        T prev[Channels] = {0};
-        unsigned int x;
-        while (nb_read<image_width*Channels)
-        {
-            const int chan = nb_read%Channels;
+    // Bitstream offsets of every index_interval-th row, older frames have none
+    int index_interval = 0;
+    size_t index_rows = 0;
+    const char * row_index = 0;
+    if (flags & FrameFlags::RowIndex)
+    {
+        if (!fits(image_src, 4))
+            return false;
+        index_interval = *((const int*)image_src);
+        image_src += 4;
+        if (index_interval <= 0)
+            return false;
+        index_rows = (image_height + index_interval - 1) / index_interval;
+        if (!fits(image_src, (unsigned long long)Channels*index_rows*8))
+            return false;
+        row_index = image_src;
+        image_src += Channels*index_rows*8;
+    }
 
-            // advance in tree bit by bit, until leaf
-            while ((x=tree[chan].next(reader.next()))==0xFFFFFFFF) {}
+    unsigned long long streams_size = 0;
+    for (int c=0;c<Channels;c++)
+        streams_size += stream_size[c];
+    if (!fits(image_src, streams_size))
+        return false;
+    for (int c=0;c<Channels;c++)
+    {
+        stream_src[c] = image_src;
+        image_src += stream_size[c];
+    }
 
-            prev[chan] = (T)x + prev[chan];
+    // Each bitstream starts at the closest indexed row above the region, the rows up to the region
+    // are decoded and dropped. Readers then continue from one band to the next.
+    const int start_row = index_interval ? region_y - region_y%index_interval : 0;
+    const bool parallel = parallelFrame();
+    StreamBitReader reader[Channels];
+    runParallel(Channels, parallel && region_y > start_row, ZoeThreadPool::High, [&](int c) {
+        unsigned long long position = 0;
+        if (row_index)
+            memcpy(&position, row_index + (c*index_rows + start_row/index_interval)*8, 8);
+        reader[c].init(stream_src[c], stream_size[c], position);
 
-            std::make_unsigned<T>::type du = ((std::make_unsigned<T>::type)prev[chan])&BitMask;
+        for (size_t i=0;i<(size_t)(region_y-start_row)*image_width;i++)
+            decodeResidual(*table[c], reader[c]);
+    });
 
-            if (op==OutputProcessing::interleave_yuyv && sizeof(To)==1) 
-                *dest_ptr++ = (To)0x80;
-            if (op==OutputProcessing::interleave_yuyv && sizeof(To)==2) 
-                du = ((du<<BitShift)&0xFF00) | 0x0080; // interleave for 10 bit 
+    const int region_end = region_y+region_height;
 
-            if (op==OutputProcessing::uyvy_to_rgb24 || op==OutputProcessing::uyvy_to_rgb32)
+    if (OutputOp<op>::ConvertsRows)
+    {
+        // The conversion needs every channel of a row: ConvertRows rows of each channel are decoded
+        // (in parallel), then converted. UYVY to RGB takes the samples interleaved, planar outputs
+        // take each channel row apart.
+        const size_t row_samples = (size_t)image_width*Channels;
+        const size_t sample_step = OutputOp<op>::Planar ? 1 : Channels;
+        const size_t channel_pitch = OutputOp<op>::Planar ? image_width : 1;
+        if (row_buffer.size() < row_samples*ConvertRows)
+            row_buffer.resize(row_samples*ConvertRows);
+
+        for (int band=region_y;band<region_end;band+=bandRows())
+        {
+            beginBand(band);
+            for (int rows=band_begin;rows<band_end;rows+=ConvertRows)
             {
-                // Convert UYVY to RGB24 while decompressing
-                *dest_ptr++ = static_cast<To>(du);
+                const int rows_end = std::min(rows+ConvertRows, band_end);
+
+                runParallel(Channels, parallel, ZoeThreadPool::High, [&](int c) {
+                    const HuffmanDecodeTableCache::Table& channel_table = *table[c];
+                    StreamBitReader channel_reader = reader[c]; // local copy, the row stores cannot alias it
+                    const SampleRestore restore(sample_map[c]);
+                    const int width = image_width;
 
-                if (nb_read%4==3) // when we have decoded UYVY, convert two RGB24 pixels
+                    for (int y=rows;y<rows_end;y++)
+                    {
+                        T * row = &row_buffer[(y-rows)*row_samples + c*channel_pitch];
+                        T prev = 0;
+                        for (int i=0;i<width;i++)
+                        {
+                            prev = (T)decodeResidual(channel_table, channel_reader) + prev;
+                            row[i*sample_step] = MapsSamples ? (T)restore((typename std::make_unsigned<T>::type)prev) : (T)(prev & BitMask);
+                        }
+                    }
+                    reader[c] = channel_reader;
+                });
+
+                for (int y=rows;y<rows_end;y++)
                 {
-                    // dest_ptr is currently pointing to the second G in RGBRGB
-                    dest_ptr -= 4; // return to beginning of this pixel
-
-                    // Convert two pixels of UYVY to two RGB24
-                    const int y0 = ((unsigned char*)dest_ptr)[1] - 16;
-                    const int y1 = ((unsigned char*)dest_ptr)[3] - 16;
-                    const int cb = ((unsigned char*)dest_ptr)[0] - 128;
-                    const int cr = ((unsigned char*)dest_ptr)[2] - 128;
-                    *dest_ptr++ = Clip(( 298 * y0 + 516 * cb            + 128) >> 8); // B0
-                    *dest_ptr++ = Clip(( 298 * y0 - 100 * cb - 208 * cr + 128) >> 8); // G0
-                    *dest_ptr++ = Clip(( 298 * y0            + 409 * cr + 128) >> 8); // R0
-                    if (op==OutputProcessing::uyvy_to_rgb32)
-                        *dest_ptr++ = 0xFF;
-                    *dest_ptr++ = Clip(( 298 * y1 + 516 * cb            + 128) >> 8); // B1
-                    *dest_ptr++ = Clip(( 298 * y1 - 100 * cb - 208 * cr + 128) >> 8); // G1
-                    *dest_ptr++ = Clip(( 298 * y1            + 409 * cr + 128) >> 8); // R1
-                    if (op==OutputProcessing::uyvy_to_rgb32)
-                        *dest_ptr++ = 0xFF;
+                    const T * row = &row_buffer[(y-rows)*row_samples];
+                    if (OutputOp<op>::Planar)
+                        convertRow<To, op>(row + region_x, image_width, y, destRow<To>(y));
+                    else
+                        convertRow<To, op>(row + region_x*Channels, 0, y, destRow<To>(y));
                 }
             }
-            else
+            if (!endBand())
+                break;
+        }
+
+        return true;
+    }
+
+    for (int band=region_y;band<region_end;band+=bandRows())
+    {
+        beginBand(band);
+
+        // Decoding is what a player waits on, it goes ahead of queued encode work
+        runParallel(Channels, parallel, ZoeThreadPool::High, [&](int c) {
+            const HuffmanDecodeTableCache::Table& channel_table = *table[c];
+            StreamBitReader channel_reader = reader[c]; // local copies, output stores cannot alias them
+            const SampleRestore restore(sample_map[c]);
+            const int width = image_width;
+            const int x_begin = region_x;
+            const int x_count = region_width;
+
+            for (int y=band_begin;y<band_end;y++)
             {
-                for (int c=0;c<((op==OutputProcessing::gray_to_rgb32 || op==OutputProcessing::gray_to_rgb24)?3:1);c++)
+                To * dest_row = destRow<To>(y);
+
+                // Every sample of the row is decoded, only the ones of the region are written
+                T prev = 0;
+                for (int i=0;i<x_begin;i++)
+                    prev = (T)decodeResidual(channel_table, channel_reader) + prev;
+                for (int i=0;i<x_count;i++)
                 {
-                    if (sizeof(To)*8<UsedBits)
-                        *dest_ptr++ = static_cast<To>((du>>(UsedBits-sizeof(To)*8))&0xFF);
-                    else
-                        *dest_ptr++ = static_cast<To>(du);
+                    prev = (T)decodeResidual(channel_table, channel_reader) + prev;
+
+                    const unsigned du = MapsSamples ? restore((typename std::make_unsigned<T>::type)prev) : ((typename std::make_unsigned<T>::type)prev)&BitMask;
+                    writeSample<To, op>(dest_row, i, c, du);
                 }
-                if (op==OutputProcessing::gray_to_rgb32)
-                    *dest_ptr++ = 0xFF;
-                if ((op==OutputProcessing::rgb24_to_rgb32 || op==OutputProcessing::rgb24_to_rgb32_revY) && chan==2)
-                    *dest_ptr++ = 0xFF;
+                for (int i=x_begin+x_count;i<width;i++)
+                    prev = (T)decodeResidual(channel_table, channel_reader) + prev;
+            }
+
+            reader[c] = channel_reader;
+        });
+
+        if (!endBand())
+            break;
+    }
+
+    return true;
+}
+
+template <typename T, int UsedBits, int Channels>
+template <typename To, int op>
+bool ZoeHuffmanCodec<T, UsedBits, Channels>::decodeRaw(const T * samples)
+{
+    const size_t row_samples = (size_t)image_width*Channels;
+    const size_t region_samples = (size_t)region_width*Channels;
+    samples += region_x*Channels;
+
+    for (int band=region_y;band<region_y+region_height;band+=bandRows())
+    {
+        beginBand(band);
+
+        if (OutputOp<op>::ConvertsRows)
+        {
+            for (int y=band_begin;y<band_end;y++)
+                convertRow<To, op>(samples + y*row_samples, 0, y, destRow<To>(y));
+        }
+        else if (op==OutputProcessing::Default && sizeof(To)==sizeof(T) && UsedBits==sizeof(T)*8)
+        {
+            if (region_samples == row_samples && sink.pitch == (ptrdiff_t)(row_samples*sizeof(T)))
+                memcpy(destRow<To>(band_begin), samples + band_begin*row_samples, row_samples*(band_end-band_begin)*sizeof(T));
+            else
+            {
+                for (int y=band_begin;y<band_end;y++)
+                    memcpy(destRow<To>(y), samples + y*row_samples, region_samples*sizeof(T));
             }
+        }
+        else
+        {
+            for (int y=band_begin;y<band_end;y++)
+            {
+                const T * row = samples + y*row_samples;
+                To * dest_row = destRow<To>(y);
 
-            nb_read++;
+                for (int x=0;x<region_width;x++)
+                    for (int c=0;c<Channels;c++)
+                        writeSample<To, op>(dest_row, x, c, ((typename std::make_unsigned<T>::type)row[x*Channels+c])&BitMask);
+            }
         }
+
+        if (!endBand())
+            break;
     }
 
     return true;
 }
 
-// Manual instantiation of template function
-template bool ZoeHuffmanCodec<char, 8, 1>::decode<char, OutputProcessing::interleave_yuyv>(const char * image_src, char * image_dest);
-template bool ZoeHuffmanCodec<char, 8, 1>::decode<char, OutputProcessing::Default>(const char * image_src, char * image_dest);
-template bool ZoeHuffmanCodec<short, 10, 1>::decode<short, OutputProcessing::interleave_yuyv>(const char * image_src, short * image_dest);
-template bool ZoeHuffmanCodec<short, 10, 1>::decode<short, OutputProcessing::Default>(const char * image_src, short * image_dest);
-template bool ZoeHuffmanCodec<short, 10, 1>::decode<char, OutputProcessing::Default>(const char * image_src, char * image_dest);
-template bool ZoeHuffmanCodec<char, 8, 1>::decode<char, OutputProcessing::gray_to_rgb24>(const char * image_src, char * image_dest); // Y8 decoded directly to RGB24
-template bool ZoeHuffmanCodec<short, 10, 1>::decode<char, OutputProcessing::gray_to_rgb24>(const char * image_src, char * image_dest); // Y10 decoded directly to RGB24
-template bool ZoeHuffmanCodec<char, 8, 2>::decode<char, OutputProcessing::Default>(const char * image_src, char * image_dest);
-template bool ZoeHuffmanCodec<char, 8, 3>::decode<char, OutputProcessing::Default>(const char * image_src, char * image_dest);
-template bool ZoeHuffmanCodec<char, 8, 4>::decode<char, OutputProcessing::Default>(const char * image_src, char * image_dest);
-template bool ZoeHuffmanCodec<char, 8, 2>::decode<char, OutputProcessing::uyvy_to_rgb24>(const char * image_src, char * image_dest); // UYVY decoded directly to RGB24
-template bool ZoeHuffmanCodec<char, 8, 3>::decode<char, OutputProcessing::rgb24_to_rgb32>(const char * image_src, char * image_dest); // RGB24 converted to RGB32
-template bool ZoeHuffmanCodec<char, 8, 3>::decode<char, OutputProcessing::rgb24_to_rgb32_revY>(const char * image_src, char * image_dest); // RGB24 converted to RGB32, reverse Y
-template bool ZoeHuffmanCodec<char, 8, 1>::decode<char, OutputProcessing::gray_to_rgb32>(const char * image_src, char * image_dest); // Y8 decoded directly to RGB32
-template bool ZoeHuffmanCodec<short, 10, 1>::decode<char, OutputProcessing::gray_to_rgb32>(const char * image_src, char * image_dest); // Y10 decoded directly to RGB32
-template bool ZoeHuffmanCodec<char, 8, 2>::decode<char, OutputProcessing::uyvy_to_rgb32>(const char * image_src, char * image_dest); // UYVY decoded directly to RGB32
-
-template unsigned int ZoeHuffmanCodec<char,8,1>::encode<TrivialBitReader<char> >(char const *,char *);
-template unsigned int ZoeHuffmanCodec<short,10,1>::encode<TrivialBitReader<short> >(short const *,char *);
-template unsigned int ZoeHuffmanCodec<short,10,1>::encode<UnpackBitReader<10,short> >(short const *,char *);
-template unsigned int ZoeHuffmanCodec<char,8,3>::encode<TrivialBitReader<char> >(char const *,char *);
-template unsigned int ZoeHuffmanCodec<char,8,4>::encode<TrivialBitReader<char> >(char const *,char *);
-template unsigned int ZoeHuffmanCodec<char,8,2>::encode<TrivialBitReader<char> >(char const *,char *);
-template unsigned int ZoeHuffmanCodec<short,12,1>::encode<TrivialBitReader<short> >(short const *,char *);
-template unsigned int ZoeHuffmanCodec<short,12,1>::encode<UnpackBitReader<12,short> >(short const *,char *);
-
-template bool ZoeHuffmanCodec<short, 12, 1>::decode<short, OutputProcessing::interleave_yuyv>(const char * image_src, short * image_dest);
-template bool ZoeHuffmanCodec<short, 12, 1>::decode<short, OutputProcessing::Default>(const char * image_src, short * image_dest);
-template bool ZoeHuffmanCodec<short, 12, 1>::decode<char, OutputProcessing::Default>(const char * image_src, char * image_dest);
-template bool ZoeHuffmanCodec<short, 12, 1>::decode<char, OutputProcessing::gray_to_rgb24>(const char * image_src, char * image_dest); // Y12 decoded directly to RGB24
-template bool ZoeHuffmanCodec<short, 12, 1>::decode<char, OutputProcessing::gray_to_rgb32>(const char * image_src, char * image_dest); // Y12 decoded directly to RGB32
+// The thumbnail goes through the output conversions of raw frames, as a small frame of its own
+template <typename T, int UsedBits, int Channels>
+template <typename To, int op>
+bool ZoeHuffmanCodec<T, UsedBits, Channels>::decodeThumbnail(const T * thumbnail_src, To * image_dest)
+{
+    const int width = image_width;
+    const int height = image_height;
+    setSize(thumbnailWidth(width), thumbnailHeight(height));
+    region_x = 0;
+    region_y = 0;
+    region_width = image_width;
+    region_height = image_height;
+    openSink<To, op>(image_dest);
+
+    const bool result = decodeRaw<To, op>(thumbnail_src);
+
+    setSize(width, height);
+    return result;
+}
+
+// Frames written before the planar layout, all channels interleaved in a single bitstream
+template <typename T, int UsedBits, int Channels>
+template <typename To, int op>
+bool ZoeHuffmanCodec<T, UsedBits, Channels>::decodeInterleaved(const char * image_src, const char * src_end)
+{
+    // Samples wider than 12 bits and 10 bit 4:2:2 came after the planar layout
+    if (LargeAlphabet || (Channels==2 && sizeof(T)>1))
+        return false;
+
+    HuffmanTree tree[Channels];
+
+    for (int c=0;c<Channels;c++)
+    {
+        // Read Huffman tables
+        if (src_end - image_src < 8)
+            return false;
+        const unsigned storedTreeUsed = *((const unsigned int*)image_src);
+        image_src += 4;
+        const unsigned storedTreeRootIndex = *((const unsigned int*)image_src);
+        image_src += 4;
+        if (storedTreeUsed > SymbolCount || (size_t)(src_end - image_src) < sizeof(StoredTreeNode)*storedTreeUsed)
+            return false;
+        const StoredTreeNode * storedTree = (const StoredTreeNode *)image_src;
+        image_src += sizeof(StoredTreeNode)*storedTreeUsed;
+
+        if (!HuffmanDecodeTableCache::validTree(storedTree, (int)storedTreeUsed, storedTreeRootIndex, SymbolCount))
+            return false;
+        tree[c].init(storedTreeRootIndex, storedTree);
+    }
+
+    const char * src_ptr = image_src;
+    BitReader<unsigned> reader(src_ptr, src_end);
+
+    // No row index: decoding starts from the first row. Rows outside the region go through a
+    // scratch row, then the columns of the region are copied out. Rows converted at once (UYVY to
+    // RGB, planar outputs) are decoded to a row of samples first.
+    const bool to_rows = OutputOp<op>::ConvertsRows;
+    const bool whole_rows = region_x==0 && region_width==image_width;
+    const size_t row_bytes = (size_t)image_width*pixelLength<To, op>()*sizeof(To);
+    if (output_row.size() < row_bytes)
+        output_row.resize(row_bytes);
+    if (to_rows && row_buffer.size() < (size_t)image_width*Channels)
+        row_buffer.resize(image_width*Channels);
+
+    for (int y=0;y<region_y+region_height;y++)
+    {
+        if (y == region_y || (y > region_y && y == band_end))
+            beginBand(y);
+        const bool staged = y<region_y || !whole_rows;
+        To * dest_row = (to_rows || staged) ? (To *)&output_row[0] : destRow<To>(y);
+
+        T prev[Channels] = {0};
+        unsigned int x;
+        for (int pixel=0;pixel<image_width;pixel++)
+            for (int chan=0;chan<Channels;chan++)
+            {
+                // advance in tree bit by bit, until leaf
+                while ((x=tree[chan].next(reader.next()))==0xFFFFFFFF) {}
+
+                prev[chan] = (T)x + prev[chan];
+
+                const unsigned du = ((typename std::make_unsigned<T>::type)prev[chan])&BitMask;
+                if (to_rows)
+                    row_buffer[pixel*Channels+chan] = static_cast<T>(du);
+                else
+                    writeSample<To, op>(dest_row, pixel, chan, du);
+            }
+
+        if (y<region_y)
+            continue;
+        if (to_rows)
+            convertRow<To, op>(&row_buffer[region_x*Channels], 0, y, destRow<To>(y));
+        else if (staged)
+            memcpy(destRow<To>(y), (const To *)&output_row[0] + region_x*pixelLength<To, op>(), region_width*pixelLength<To, op>()*sizeof(To));
+        if (y+1 == band_end && !endBand())
+            break;
+    }
+
+    return true;
+}
+
+ZoeYuv420Codec::ZoeYuv420Codec(int width, int height)
+    : luma(width, height),
+      chroma(width/2, height/2),
+      image_width(width),
+      image_height(height),
+      codec_stats(0),
+      chroma_stats()
+{
+    chroma.setStats(&chroma_stats);
+}
+
+void ZoeYuv420Codec::setSize(int width, int height)
+{
+    image_width = width;
+    image_height = height;
+    luma.setSize(width, height);
+    chroma.setSize(width/2, height/2);
+}
+
+void ZoeYuv420Codec::setStats(ZoeCodecStats * stats)
+{
+    codec_stats = stats;
+    luma.setStats(stats);
+}
+
+void ZoeYuv420Codec::setOptions(const ZoeCodecOptions & new_options)
+{
+    options = new_options;
+    options.store_thumbnails = false;
+    options.tensor_layout = 0;
+    luma.setOptions(options);
+    setChromaOptions(0, options.flip_output);
+}
+
+void ZoeYuv420Codec::setChromaOptions(const ZoeRegion * region, bool flip)
+{
+    ZoeCodecOptions chroma_options = options;
+    chroma_options.band_output = 0;
+    chroma_options.output_region = region;
+    chroma_options.flip_output = flip;
+    chroma.setOptions(chroma_options);
+}
+
+unsigned ZoeYuv420Codec::maxEncodedSize(int width, int height)
+{
+    return 4 + ZoeHuffmanCodec<char, 8, 1>::maxEncodedSize(width, height) + ZoeHuffmanCodec<char, 8, 2>::maxEncodedSize(width/2, height/2);
+}
+
+unsigned ZoeYuv420Codec::encode(const char * src, Layout layout, char * dest, int stride)
+{
+    const ptrdiff_t pitch = stride ? stride : image_width;
+    const char * planes = src + pitch*image_height;
+
+    const unsigned luma_size = luma.encode<TrivialBitReader<char> >(src, dest + 4, stride);
+    *((unsigned int *)dest) = luma_size;
+    char * chroma_dest = dest + 4 + luma_size;
+
+    if (layout == NV12)
+        return 4 + luma_size + chroma.encode<TrivialBitReader<char> >(planes, chroma_dest, stride);
+
+    // The U and V planes are interleaved into pairs first, like NV12
+    const int chroma_width = image_width/2;
+    const int chroma_height = image_height/2;
+    const ptrdiff_t chroma_pitch = pitch/2;
+    const char * v_plane = planes + chroma_pitch*chroma_height;
+    if (chroma_pairs.size() < (size_t)chroma_width*chroma_height*2)
+        chroma_pairs.resize((size_t)chroma_width*chroma_height*2);
+    for (int y=0;y<chroma_height;y++)
+    {
+        const char * u_row = planes + y*chroma_pitch;
+        const char * v_row = v_plane + y*chroma_pitch;
+        char * pairs = &chroma_pairs[(size_t)y*chroma_width*2];
+        for (int x=0;x<chroma_width;x++)
+        {
+            pairs[x*2] = u_row[x];
+            pairs[x*2+1] = v_row[x];
+        }
+    }
+    return 4 + luma_size + chroma.encode<TrivialBitReader<char> >(&chroma_pairs[0], chroma_dest, 0);
+}
+
+bool ZoeYuv420Codec::beginDecode(const char * src, unsigned size, bool chroma_flip, const char ** chroma_src, unsigned * luma_size)
+{
+    if (options.thumbnail_output || size < 8)
+        return false;
+
+    // The chroma frame takes the rest of the frame after the luma one
+    *luma_size = *((const unsigned int*)src);
+    if (*luma_size < 4 || *luma_size > size-8 || *luma_size%4 != 0)
+        return false;
+    *chroma_src = src + 4 + *luma_size;
+
+    if (options.output_region)
+    {
+        if (options.output_region->x%2 != 0 || options.output_region->y%2 != 0 || options.output_region->width%2 != 0 || options.output_region->height%2 != 0)
+            return false;
+        chroma_region.x = options.output_region->x/2;
+        chroma_region.y = options.output_region->y/2;
+        chroma_region.width = options.output_region->width/2;
+        chroma_region.height = options.output_region->height/2;
+    }
+    setChromaOptions(options.output_region ? &chroma_region : 0, chroma_flip);
+    return true;
+}
+
+void ZoeYuv420Codec::endDecode()
+{
+    if (codec_stats)
+    {
+        codec_stats->table_cache_hits += chroma_stats.table_cache_hits;
+        codec_stats->table_cache_misses += chroma_stats.table_cache_misses;
+    }
+    chroma_stats = ZoeCodecStats();
+}
+
+bool ZoeYuv420Codec::decode(const char * src, unsigned size, Layout layout, char * dest, int stride)
+{
+    const char * chroma_src;
+    unsigned luma_size;
+    if (options.band_output || !beginDecode(src, size, options.flip_output, &chroma_src, &luma_size))
+        return false;
+
+    const int height = options.output_region ? options.output_region->height : image_height;
+    const ptrdiff_t pitch = stride ? stride : (options.output_region ? options.output_region->width : image_width);
+    char * planes = dest + pitch*height;
+
+    // Y on its own and the U V channels in parallel: the three planes decode at the same time
+    bool ok[2];
+    const bool parallel = options.parallel && (size_t)image_width*image_height >= (size_t)ParallelMinSamples;
+    runParallel(2, parallel, ZoeThreadPool::High, [&](int plane) {
+        if (plane == 0)
+            ok[0] = luma.decode<char, OutputProcessing::Default>(src + 4, luma_size, dest, stride);
+        else if (layout == NV12)
+            ok[1] = chroma.decode<char, OutputProcessing::Default>(chroma_src, size-4-luma_size, planes, stride);
+        else
+            ok[1] = chroma.decode<char, OutputProcessing::uv_to_yuv420p>(chroma_src, size-4-luma_size, planes, stride/2);
+    });
+    endDecode();
+    return ok[0] && ok[1];
+}
+
+bool ZoeYuv420Codec::decodeToRGB32(const char * src, unsigned size, char * dest, int stride)
+{
+    const char * chroma_src;
+    unsigned luma_size;
+    if (!beginDecode(src, size, false, &chroma_src, &luma_size))
+        return false;
+
+    // The chroma of the region first, then the Y rows are converted with it, band after band
+    const int chroma_width = (options.output_region ? options.output_region->width : image_width)/2;
+    const int chroma_height = (options.output_region ? options.output_region->height : image_height)/2;
+    if (chroma_pairs.size() < (size_t)chroma_width*chroma_height*2)
+        chroma_pairs.resize((size_t)chroma_width*chroma_height*2);
+    const bool chroma_ok = chroma.decode<char, OutputProcessing::Default>(chroma_src, size-4-luma_size, &chroma_pairs[0], 0);
+    endDecode();
+    if (!chroma_ok)
+        return false;
+
+    luma.setChromaRows(&chroma_pairs[0], (size_t)chroma_width*2);
+    return luma.decode<char, OutputProcessing::yuv420_to_rgb32>(src + 4, luma_size, dest, stride);
+}
+
+// Kernels of the Huffman encoders and decoders, one per row of the tables in formats.h
+#define IGNORE_CUSTOM(...)
+#define INSTANTIATE_ENCODER(format, input, Reader) \
+    template unsigned int ZoeHuffmanCodec<ZOE_HUFFMAN_CODEC_##format>::encode<Reader>(const Reader::typeT *, char *, int);
+#define INSTANTIATE_DECODER(format, output, options, To, op) \
+    template bool ZoeHuffmanCodec<ZOE_HUFFMAN_CODEC_##format>::decode<To, OutputProcessing::op>(const char *, unsigned, To *, int);
+ZOE_ENCODERS(IGNORE_CUSTOM, INSTANTIATE_ENCODER)
+ZOE_DECODERS(IGNORE_CUSTOM, INSTANTIATE_DECODER)
+#undef IGNORE_CUSTOM
+#undef INSTANTIATE_ENCODER
+#undef INSTANTIATE_DECODER
 
+// 4:2:0, the Y plane and the U V pairs (see ZoeYuv420Codec)
+template bool ZoeHuffmanCodec<char, 8, 1>::decode<char, OutputProcessing::yuv420_to_rgb32>(const char * image_src, unsigned src_size, char * image_dest, int dest_stride);
+template bool ZoeHuffmanCodec<char, 8, 2>::decode<char, OutputProcessing::uv_to_yuv420p>(const char * image_src, unsigned src_size, char * image_dest, int dest_stride);
@@ -24,40 +24,76 @@
 
 #pragma once
 
+#include "codec_context.h"
+#include "tensor_output.h"
+#include "unpack.h"
+#include "yuv_to_rgb.h"
+
+#include <stddef.h>
 #include <vector>
 
 namespace OutputProcessing 
 {
-    enum {Default, interleave_yuyv, gray_to_rgb24, uyvy_to_rgb24, rgb24_to_rgb32, gray_to_rgb32, uyvy_to_rgb32, rgb24_to_rgb32_revY};
+    enum {Default, interleave_yuyv, gray_to_rgb24, uyvy_to_rgb24, rgb24_to_rgb32, gray_to_rgb32, uyvy_to_rgb32, gray_to_y16, gray_to_rgb48, planar_f32, planar_f16, uyvy_to_v210, uyvy_to_yuv422p, rgb16_to_rgb16, rgb16_to_rgb32, uv_to_yuv420p, yuv420_to_rgb32};
+}
+
+namespace FrameFlags
+{
+    // Frames start with a flags word that has the Tagged bit set. Older frames start directly with
+    // the node count of the first Huffman tree, which is always below 0x8000, and interleave all
+    // channels in a single bitstream.
+    enum {
+        Tagged = 0x80000000,
+        Planar = 0x00000001, // one bitstream per channel, preceded by the byte size of each stream
+        Raw    = 0x00000002, // samples stored as is, interleaved, sizeof(T) bytes each
+        RowIndex = 0x00000004, // after the stream sizes: row interval, then the 64 bit offset of every interval-th row in each bitstream [channel][row/interval]
+        Thumbnail = 0x00000008, // after the flags: thumbnail width and height, then its samples like a raw frame, padded to 4 bytes
+        SampleMap = 0x00000010, // after the thumbnail, for each channel: shift, low bits, code bits and value count, then the values as 16 bit words, padded to 4 bytes (see SampleMap)
+        ColorTransform = 0x00000020, // RGB frames of more than 8 bits: blue and red are coded as their difference to green, modulo 1<<UsedBits
+    };
 }
 
 template <typename T>
 class TrivialBitReader
 {
 public:
-    TrivialBitReader(const T * ptr) : cur_ptr(ptr), org_ptr(ptr)
+    TrivialBitReader(const T * ptr, int step=1) : cur_ptr(ptr), org_ptr(ptr), step(step)
     {}
     T next() 
     {
         T value = *cur_ptr;
-        cur_ptr++;
+        cur_ptr += step;
         return value;
     }
     void reset()
     {
         cur_ptr = org_ptr;
     }
+    // Position on the index-th value read by next()
+    void seek(size_t index)
+    {
+        cur_ptr = org_ptr + index*step;
+    }
+    // Same as count calls to next()
+    void read(T * dest, size_t count)
+    {
+        for (size_t i=0;i<count;i++)
+            dest[i] = next();
+    }
     typedef T typeT;
+    enum { Packed = 0 };
 private:
     const T* cur_ptr;
     const T* org_ptr;
+    int step;
 };
 
 template <int bitCount, typename outputT>
 class UnpackBitReader
 {
 public:
-    UnpackBitReader(const outputT * ptr) : cur_ptr((const char *)ptr), org_ptr((const char *)ptr), bits(8)
+    // Packed data is always single channel, step is only there to match TrivialBitReader
+    UnpackBitReader(const outputT * ptr, int step=1) : cur_ptr((const char *)ptr), org_ptr((const char *)ptr), bits(8)
     {}
     outputT next() 
     {
@@ -89,43 +125,411 @@ public:
     void reset()
     {
         cur_ptr = org_ptr;
+        bits = 8;
+    }
+    // Position on the index-th packed value
+    void seek(size_t index)
+    {
+        const size_t offset = index*bitCount;
+        cur_ptr = org_ptr + offset/8;
+        bits = 8 - (int)(offset%8);
+    }
+    // Same as count calls to next(). Once on a byte boundary, whole groups of values are
+    // unpacked in bulk.
+    void read(outputT * dest, size_t count)
+    {
+        while (count>0 && bits!=8)
+        {
+            *dest++ = next();
+            count--;
+        }
+
+        const size_t bulk = count - count%UnpackGroupSize(bitCount);
+        UnpackSamples(bitCount, (const unsigned char *)cur_ptr, (unsigned short *)dest, bulk);
+        cur_ptr += bulk*bitCount/8;
+        dest += bulk;
+        count -= bulk;
+
+        while (count-->0)
+            *dest++ = next();
     }
     typedef outputT typeT;
+    enum { Packed = 1 };
 private:
     int bits;
     const char* cur_ptr;
     const char* org_ptr;
 };
 
+// Readers of the packed gray inputs, named for the format tables (see formats.h)
+typedef UnpackBitReader<10, short> PY10Reader;
+typedef UnpackBitReader<12, short> PY12Reader;
+
+// 4:2:2 10 bit rows packed as v210 (see UnpackV210), read as U Y V Y samples like UYVY. Rows are
+// padded, so frames are always read with a stride.
+class V210Reader
+{
+public:
+    // step is only there to match TrivialBitReader, the samples are read in stream order
+    V210Reader(const short * ptr, int step=1) : org_ptr((const unsigned char *)ptr), index(0)
+    {}
+    short next()
+    {
+        const unsigned char* word = org_ptr + index/3*4;
+        const unsigned value = word[0] | (word[1]<<8) | (word[2]<<16) | ((unsigned)word[3]<<24);
+        const short sample = (short)((value >> (10*(index%3))) & 0x3FF);
+        index++;
+        return sample;
+    }
+    void reset()
+    {
+        index = 0;
+    }
+    void seek(size_t i)
+    {
+        index = i;
+    }
+    // Same as count calls to next(). From a group boundary, whole groups are unpacked in bulk.
+    void read(short * dest, size_t count)
+    {
+        while (count>0 && index%12!=0)
+        {
+            *dest++ = next();
+            count--;
+        }
+
+        UnpackV210(org_ptr + index/12*16, (unsigned short *)dest, count);
+        index += count;
+    }
+    typedef short typeT;
+    enum { Packed = 1 };
+private:
+    const unsigned char* org_ptr;
+    size_t index;
+};
+
+struct HuffNode {
+	unsigned freq;
+	unsigned left;
+	unsigned right;
+};
+
+struct StoredTreeNode
+{
+    StoredTreeNode() : left(-1), right(-1) {}
+
+    unsigned short left;
+    unsigned short right;
+};
+
+class StreamBitReader;
+
+// Where a decode writes its rows. Every output op goes through it, whatever its orientation: row y
+// of the image is at first + (y-band_begin)*pitch, bottom-up outputs start from the last row of
+// the band and walk back with a negative pitch.
+struct OutputSink
+{
+    char * base;        // output buffer of the decode, its first row in memory
+    ptrdiff_t stride;   // bytes from one row of the buffer to the next, negative for bottom-up buffers
+    bool bottom_up;     // the top image row goes to the last row of the buffer (or of the band)
+    char * first;       // row band_begin of the image
+    ptrdiff_t pitch;    // from one image row to the next: stride, or -stride when bottom_up
+};
+
+// How the samples of a channel are coded in a frame. Many high bit depth sources use fewer bits
+// than their format: 8 bit video scaled up to 10 bits, 12 bit sensors in the top bits of 16 bit
+// words. The encoder looks at every sample first: low bits that never change are dropped (shift),
+// and when the remaining values are few and far between they are replaced by their index in the
+// sorted list of values. The residuals between codes wrap around at code_bits, the Huffman code
+// only ever sees 1<<code_bits residual values.
+struct SampleMap
+{
+    unsigned shift;     // low bits equal in every sample
+    unsigned low_bits;  // their value
+    unsigned code_bits; // width of the codes: the shifted samples, or their index in values
+    std::vector<unsigned short> values; // shifted sample of each code when remapped, else empty
+    std::vector<unsigned short> codes;  // encoder only: code of each shifted sample when remapped
+};
+
+// Decode tables built from the trees stored in the frames. A table resolves codes of up to
+// LookupBits bits with a single lookup, longer codes continue down the tree from the node found
+// in the table. Tables are cached by a hash of the serialized tree, so frames that reuse a
+// codebook only pay for hashing it.
+class HuffmanDecodeTableCache
+{
+public:
+    enum { LookupBits = 11, Size = 8 };
+
+    struct Entry
+    {
+        unsigned short value;  // symbol, or tree node to continue from when length is 0
+        unsigned short length; // code length in bits
+    };
+
+    struct Table
+    {
+        Entry lookup[1<<LookupBits];
+        std::vector<StoredTreeNode> tree;
+        unsigned root;
+        unsigned long long hash;
+        unsigned long long last_use;
+    };
+
+    HuffmanDecodeTableCache();
+
+    // Table for a tree read from a frame, null when the tree does not make sense for an alphabet
+    // of symbol_count symbols. Stays valid until Size other trees were looked up.
+    const Table * get(const StoredTreeNode * tree, int tree_used, unsigned root, unsigned symbol_count, ZoeCodecStats * stats);
+
+    // Every node of a tree from a frame must lead to symbols of the alphabet through nodes stored
+    // before it, so that decoding can neither leave the tree nor loop in it
+    static bool validTree(const StoredTreeNode * tree, int tree_used, unsigned root, unsigned symbol_count);
+
+private:
+    void build(Table& table, unsigned node, unsigned depth, unsigned code);
+
+    Table tables[Size];
+    int table_count;
+    unsigned long long use_counter;
+};
+
+// Instances hold every table and scratch buffer of the codec, several hundred KB for the larger
+// alphabets. Keep them on the heap (see ZoeCodecContext) and reuse them from frame to frame.
 template <typename T, int UsedBits, int Channels >
 class ZoeHuffmanCodec
 {
 public:
 	ZoeHuffmanCodec(int width, int height);
 
+    // Frame size of the following encode/decode calls
+    void setSize(int width, int height);
+
+    // Counters updated by the following calls, may be NULL
+    void setStats(ZoeCodecStats * stats);
+
+    // Settings of the following encodes and decodes (see ZoeCodecOptions). The colour transform
+    // only applies to encodes of RGB frames of more than 8 bits, decodes follow the flags of each
+    // frame. Thumbnail outputs of frames stored raw are computed from the samples, other frames
+    // without a thumbnail fail. Flipped outputs write the top-down formats (gray, UYVY, RGB from
+    // RGB) bottom-up and the bottom-up ones (RGB from gray or UYVY, RGB32 from 16 bit RGB) top-down.
+    // Planar float outputs of gray, RGB and RGBA frames come in R G B A order, UYVY frames give
+    // three planes.
+    void setOptions(const ZoeCodecOptions & options);
+
+    // Chroma of the following 4:2:0 luma decodes to RGB: U V pairs at half the width and height of
+    // the region, the pair of region row y at rows + (y/2)*pitch samples (see ZoeYuv420Codec)
+    void setChromaRows(const T * rows, size_t pitch);
+
+    // Thumbnails are 1/8 of the frame in each direction, each sample the rounded average of a block
+    // of the frame. Two channel frames are UYVY: a thumbnail pixel pair averages the U Y and V Y
+    // samples of 16 pixels.
+    static int thumbnailWidth(int width);
+    static int thumbnailHeight(int height);
+
+    // Row strides are in bytes, 0 for tightly packed rows. Row y starts at image + y*stride, a
+    // negative stride walks a bottom-up image from its top row.
     template <typename ReaderT>
-	unsigned encode(const T * src, char * dest);
+	unsigned encode(const T * src, char * dest, int stride = 0);
     
+    // Frames come from files: every section of the src_size bytes is checked before it is read,
+    // false for frames that do not fit or make no sense
     template <typename To, int op>
-    bool decode(const char * image_src, To * image_dest);
+    bool decode(const char * image_src, unsigned src_size, To * image_dest, int stride = 0);
+
+    // No frame is larger than this: frames that would not compress are stored raw
+    static unsigned maxEncodedSize(int width, int height);
 
 private:
+    template <typename ReaderT>
+    unsigned encodeRaw(const T * src, char * dest);
+    template <typename To, int op>
+    bool decodeRaw(const T * samples);
+    template <typename To, int op>
+    bool decodeThumbnail(const T * thumbnail, To * image_dest);
+
+    void accumulateThumbnail(const T * row, unsigned * sums) const;
+    void finishThumbnailRow(int y, unsigned * sums, T * thumbnail) const;
+
+    template <typename ReaderT>
+    bool buildSampleMaps(const T * image_src, int band_count, bool parallel);
+    size_t sampleMapBytes() const;
+    void writeSampleMaps(char * dest) const;
+    bool readSampleMaps(const char *& src, const char * src_end);
+    template <typename ReaderT>
+    void encodeChannel(int c, const T * image_src, char * stream_dest, char * row_index);
+    template <typename ReaderT>
+    ReaderT rowReader(const T * image_src, int y, int c, int step) const;
+    template <typename ReaderT>
+    const T * rowSamples(const T * image_src, int y, T * scratch) const;
+
+    template <typename To, int op>
+    bool decodeInterleaved(const char * image_src, const char * src_end);
+    template <typename To, int op>
+    static size_t pixelLength();
+    template <typename To, int op>
+    void openSink(To * image_dest);
+    template <typename To>
+    To * destRow(int y) const;
+    int bandRows() const;
+    void beginBand(int y);
+    bool endBand() const;
+    template <typename To, int op>
+    static void writeSample(To * dest_row, int x, int c, unsigned du);
+    template <typename To, int op>
+    void writeUYVYAsRGB(const T * uyvy_row, To * dest_row, int width) const;
+    template <typename To, int op>
+    void convertRow(const T * samples, size_t channel_pitch, int y, To * dest_row);
+    template <typename To, int op>
+    void writePlane(const T * samples, To * plane_row);
 
     static const int BitShift = sizeof(T)*8 - UsedBits;
     static const int BitMask = (1<<UsedBits)-1;
 
+    // Up to 12 bits, every residual value is a symbol of the Huffman code. Wider samples code the
+    // magnitude class of the residual (its bit count, 0 to UsedBits) followed by the bits of the
+    // residual as they are, like lossless JPEG: the code has UsedBits+1 symbols instead of 64K,
+    // and the tables built for each frame stay as small as for 8 bit samples.
+    static const bool LargeAlphabet = UsedBits > 12;
+    static const int SymbolCount = LargeAlphabet ? UsedBits+1 : 1<<UsedBits;
+
+    // Huffman symbol of the residual du (modulo 1<<UsedBits)
+    static unsigned residualSymbol(unsigned du);
+    // Residual coded next in the bitstream, modulo 1<<UsedBits
+    static unsigned decodeResidual(const HuffmanDecodeTableCache::Table& table, StreamBitReader& reader);
+
+    // Samples of more than 8 bits go through a SampleMap, 8 bit samples are always coded as is
+    static const bool MapsSamples = UsedBits > 8;
+
+    // Blue and red go through the colour transform in 16 bit RGB(A) frames only (B G R A order)
+    static const bool TransformsColor = Channels >= 3 && sizeof(T) > 1;
+
+    // Sample of channel c of the pixel as coded in the frame
+    T codedSample(const T * pixel, int c) const;
+    // Code of a sample in the map of its channel
+    static unsigned sampleCode(const SampleMap& map, T sample);
+    // Residual of two codes of the map, modulo 1<<UsedBits
+    static unsigned wrapResidual(const SampleMap& map, unsigned d);
+
+    bool parallelFrame() const;
+
 	int image_width;
 	int image_height;
+    ZoeCodecStats * codec_stats;
+    ZoeCodecOptions options;
+
+    // Strides of the current encode or decode call
+    int src_stride;
+    int dest_stride;
+
+    // Image rows [band_begin, band_end) of the current decode are written to the output buffer
+    int band_begin;
+    int band_end;
+
+    // Rectangle of the image written by the current decode
+    int region_x;
+    int region_y;
+    int region_width;
+    int region_height;
+
+    // Bit offset of every RowIndexInterval-th row in each bitstream, so decoding can start near any row
+    static const int RowIndexInterval = 16;
+
+    static const int ThumbnailScale = 8;
+    static const int ThumbnailPeriod = (Channels==2) ? 2 : 1; // UYVY alternates U and V in channel 0
+    bool colors_transformed; // frame being decoded has FrameFlags::ColorTransform
+
+    OutputSink sink;
+    const T * chroma_rows;
+    size_t chroma_pitch;
+
+    // Sample coding of each channel in the current frame, identity unless the frame has FrameFlags::SampleMap
+    SampleMap sample_map[Channels];
+
+    // Decoders converting whole rows decode this many rows of every channel, then convert them
+    static const int ConvertRows = 16;
 
     // Encoder only
     struct EncoderData {
-        EncoderData() : char_count_used(1<<UsedBits) {}
+        EncoderData() : char_count_used(SymbolCount) {}
 
-	    std::pair<int, unsigned> char_count[1<<UsedBits]; // first represents the symbol, or if >0x8000, it is huffNode index+0x8000
+	    std::pair<int, unsigned> char_count[SymbolCount]; // first represents the symbol, or if >0x8000, it is huffNode index+0x8000
         int char_count_used;
-	    unsigned huff_bits[1<<UsedBits];
-	    unsigned huff_length[1<<UsedBits];
+	    unsigned huff_bits[SymbolCount];
+	    unsigned huff_length[SymbolCount];
     } encoder_data[Channels];
+
+    // Tree construction
+    HuffNode huff_nodes[SymbolCount * 2];
+    StoredTreeNode stored_tree[Channels][SymbolCount * 2];
+
+    // Scratch reused between frames, only grows when the frame gets larger
+    std::vector<unsigned> band_counts; // symbol counts of each band of rows [band][channel][symbol]
+    std::vector<T> row_buffer; // decoded rows of every channel, for the outputs converted a row at a time
+    std::vector<T> planar_row; // one row of each channel apart, then chroma repeated for each pixel
+    std::vector<float> float_row; // float values of one row of each plane
+    std::vector<char> output_row; // one full output row, for frames without a row index decoded to a region
+    std::vector<T> unpack_rows; // packed input unpacked one row at a time, one row per band and per channel
+    std::vector<unsigned> thumbnail_sums; // column sums of the thumbnail row in progress, one frame row per band
+    std::vector<T> thumbnail; // thumbnail of the frame being encoded, or of a raw frame being decoded
+    std::vector<unsigned long long> value_bits; // sample values seen by each band, then by the frame [band][channel][value/64]
+
+    // Decoder only
+    HuffmanDecodeTableCache table_cache;
+};
+
+// 4:2:0 8 bit frames: the Y plane coded like HY8, the U and V planes at half the width and height
+// as one two channel frame, so each plane has its own predictor and table. A frame is the byte
+// size of the Y frame (a multiple of 4, width and height are even), the Y frame, then the chroma
+// frame. Both decode at the same time. Regions and bands follow the Y plane, their rows and
+// columns must be even.
+class ZoeYuv420Codec
+{
+public:
+    // Layout of the planes: Y, then U and V planes at half the stride (I420) or one plane of U V
+    // pairs at the stride (NV12). Planes of an output region are laid out like a frame of the
+    // region size.
+    enum Layout { I420, NV12 };
+
+    ZoeYuv420Codec(int width, int height);
+
+    // Same settings as ZoeHuffmanCodec. 4:2:0 frames store no thumbnail and have no float outputs,
+    // the colour matrix is the one of the RGB32 decodes.
+    void setSize(int width, int height);
+    void setStats(ZoeCodecStats * stats);
+    void setOptions(const ZoeCodecOptions & options);
+
+    // Y rows are stride bytes apart, width when 0
+    unsigned encode(const char * src, Layout layout, char * dest, int stride = 0);
+
+    // Band outputs are only for RGB32: a band of the planar layouts would hold rows of every plane
+    bool decode(const char * src, unsigned size, Layout layout, char * dest, int stride = 0);
+
+    // Bottom-up like the other RGB outputs, each U V pair shared by 2x2 pixels
+    bool decodeToRGB32(const char * src, unsigned size, char * dest, int stride = 0);
+
+    static unsigned maxEncodedSize(int width, int height);
+
+private:
+    // Chroma frame of a frame of size bytes and the size of the luma one before it. Sets up the
+    // chroma codec for the region of the chroma planes, its rows flipped with chroma_flip. False
+    // when the frame is too small or the region splits a U V pair.
+    bool beginDecode(const char * src, unsigned size, bool chroma_flip, const char ** chroma_src, unsigned * luma_size);
+    // Counts the chroma decode in the stats
+    void endDecode();
+    // The chroma frame is coded whole, without bands: region is the one of the chroma planes
+    void setChromaOptions(const ZoeRegion * region, bool flip);
+
+    ZoeHuffmanCodec<char, 8, 1> luma;
+    ZoeHuffmanCodec<char, 8, 2> chroma;
+
+    int image_width;
+    int image_height;
+    ZoeCodecStats * codec_stats;
+    ZoeCodecStats chroma_stats; // counters of the chroma codec, added to codec_stats after each decode
+    ZoeCodecOptions options;
+    ZoeRegion chroma_region;
+
+    std::vector<char> chroma_pairs; // I420 chroma interleaved for the encoder, or the decoded pairs of the RGB32 decodes
 };
 
 template <typename T>
@@ -133,7 +537,7 @@ class BitPacker
 {
 public:
     BitPacker(char* bufferStart) : next((T*)bufferStart), start((T*)bufferStart), current(0), current_bitcount(0) { }
-    __inline void pack(int bitcount, unsigned bits) // relevant bits are in the LSB of bits
+    inline void pack(int bitcount, unsigned bits) // relevant bits are in the LSB of bits
     {
         if (current_bitcount+bitcount > (sizeof(T)*8))
         {
@@ -152,6 +556,11 @@ public:
             current_bitcount += bitcount;
         }
     }
+    // Bits packed so far
+    unsigned long long position() const
+    {
+        return (unsigned long long)(next-start)*sizeof(T)*8 + current_bitcount;
+    }
     unsigned flush()
     {
         if (current_bitcount>0)
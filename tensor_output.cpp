@@ -0,0 +1,175 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "tensor_output.h"
+
+#include <string.h>
+
+#include "cpu_features.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ZOE_TENSOR_SIMD
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define ZOE_TARGET_SSE2 __attribute__((target("sse2")))
+#define ZOE_TARGET_F16C __attribute__((target("avx,f16c")))
+#else
+#define ZOE_TARGET_SSE2
+#define ZOE_TARGET_F16C
+#endif
+
+template <typename S>
+static void ConvertScalar(const S* samples, int count, float scale, float offset, float* dest)
+{
+    for (int i=0;i<count;i++)
+        dest[i] = (float)samples[i] * scale + offset;
+}
+
+static unsigned short HalfOf(float value)
+{
+    unsigned bits;
+    memcpy(&bits, &value, 4);
+    const unsigned short sign = (unsigned short)((bits >> 16) & 0x8000);
+    const unsigned magnitude = bits & 0x7FFFFFFF;
+
+    if (magnitude > 0x7F800000)
+        return sign | 0x7E00; // NaN, quiet
+    if (magnitude >= 0x477FF000)
+        return sign | 0x7C00; // infinity, or rounds above 65504
+    if (magnitude >= 0x38800000)
+    {
+        // Normal: drop 13 mantissa bits, ties to even, a carry moves on to the exponent
+        const unsigned rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+        return sign | (unsigned short)((rounded - 0x38000000) >> 13);
+    }
+    if (magnitude <= 0x33000000)
+        return sign; // half of the smallest denormal or less, ties to even give 0
+
+    // Denormal: the mantissa with its implicit bit, in units of 2^-24
+    const unsigned mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+    const int shift = 126 - (int)(magnitude >> 23);
+    unsigned result = mantissa >> shift;
+    const unsigned remainder = mantissa & ((1u << shift) - 1);
+    const unsigned half = 1u << (shift - 1);
+    if (remainder > half || (remainder == half && (result & 1)))
+        result++;
+    return sign | (unsigned short)result;
+}
+
+#ifdef ZOE_TENSOR_SIMD
+
+ZOE_TARGET_SSE2
+static void Store(float* dest, __m128i lanes, __m128 scale, __m128 offset)
+{
+    _mm_storeu_ps(dest, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(lanes), scale), offset));
+}
+
+ZOE_TARGET_SSE2
+static int ConvertSSE2(const unsigned char* samples, int count, float scale, float offset, float* dest)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 k_scale = _mm_set1_ps(scale);
+    const __m128 k_offset = _mm_set1_ps(offset);
+
+    int i = 0;
+    for (;i+16<=count;i+=16)
+    {
+        const __m128i bytes = _mm_loadu_si128((const __m128i*)(samples + i));
+        const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        Store(dest + i, _mm_unpacklo_epi16(lo, zero), k_scale, k_offset);
+        Store(dest + i + 4, _mm_unpackhi_epi16(lo, zero), k_scale, k_offset);
+        Store(dest + i + 8, _mm_unpacklo_epi16(hi, zero), k_scale, k_offset);
+        Store(dest + i + 12, _mm_unpackhi_epi16(hi, zero), k_scale, k_offset);
+    }
+    return i;
+}
+
+ZOE_TARGET_SSE2
+static int ConvertSSE2(const unsigned short* samples, int count, float scale, float offset, float* dest)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 k_scale = _mm_set1_ps(scale);
+    const __m128 k_offset = _mm_set1_ps(offset);
+
+    int i = 0;
+    for (;i+8<=count;i+=8)
+    {
+        const __m128i words = _mm_loadu_si128((const __m128i*)(samples + i));
+        Store(dest + i, _mm_unpacklo_epi16(words, zero), k_scale, k_offset);
+        Store(dest + i + 4, _mm_unpackhi_epi16(words, zero), k_scale, k_offset);
+    }
+    return i;
+}
+
+ZOE_TARGET_F16C
+static int ConvertF16C(const float* values, int count, unsigned short* dest)
+{
+    int i = 0;
+    for (;i+8<=count;i+=8)
+        _mm_storeu_si128((__m128i*)(dest + i), _mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT));
+    return i;
+}
+
+#endif
+
+template <typename S>
+static void Convert(const S* samples, int count, float scale, float offset, float* dest)
+{
+    int done = 0;
+
+#ifdef ZOE_TENSOR_SIMD
+    static const bool has_sse2 = CpuHasSSE2();
+    if (has_sse2)
+        done = ConvertSSE2(samples, count, scale, offset, dest);
+#endif
+
+    ConvertScalar(samples + done, count - done, scale, offset, dest + done);
+}
+
+void ConvertSamplesToFloat(const unsigned char* samples, int count, float scale, float offset, float* dest)
+{
+    Convert(samples, count, scale, offset, dest);
+}
+
+void ConvertSamplesToFloat(const unsigned short* samples, int count, float scale, float offset, float* dest)
+{
+    Convert(samples, count, scale, offset, dest);
+}
+
+void ConvertFloatToHalf(const float* values, int count, unsigned short* dest)
+{
+    int done = 0;
+
+#ifdef ZOE_TENSOR_SIMD
+    static const bool has_f16c = CpuHasF16C();
+    if (has_f16c)
+        done = ConvertF16C(values, count, dest);
+#endif
+
+    for (int i=done;i<count;i++)
+        dest[i] = HalfOf(values[i]);
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stddef.h>
+
+// Planar float outputs, for loaders feeding frames to neural networks: one plane per channel, each
+// sample written as sample*scale + offset. Gray frames give one plane, RGB frames give R G B (A)
+// planes, UYVY frames give Y U V planes with U and V repeated for both pixels of a pair, or R G B
+// planes through the color matrix.
+struct ZoeTensorLayout
+{
+    float scale;
+    float offset;
+    ptrdiff_t plane_stride;     // bytes between the starts of two planes, 0 for planes back to back
+    bool rgb;                   // UYVY frames to R G B planes instead of Y U V
+};
+
+// count samples to sample*scale + offset. Groups of 8 or 16 samples go through SSE2 when the CPU
+// has it, the tail through the same float arithmetic.
+void ConvertSamplesToFloat(const unsigned char* samples, int count, float scale, float offset, float* dest);
+void ConvertSamplesToFloat(const unsigned short* samples, int count, float scale, float offset, float* dest);
+
+// count floats to IEEE 754 half floats, rounded to nearest even, with F16C when the CPU has it.
+// Values beyond the half range become infinities.
+void ConvertFloatToHalf(const float* values, int count, unsigned short* dest);
@@ -0,0 +1,312 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "thread_pool.h"
+
+#include <algorithm>
+
+// Index of the pool worker running on this thread, -1 for threads that do not belong to the pool
+static thread_local int current_worker = -1;
+
+static int requested_workers = 0;
+
+bool ZoeThreadPool::TaskQueue::pushBack(const Task& task)
+{
+    if (tail-head == Capacity)
+        return false;
+    tasks[tail++ % Capacity] = task;
+    return true;
+}
+
+bool ZoeThreadPool::TaskQueue::popBack(Task& task)
+{
+    if (tail == head)
+        return false;
+    task = tasks[--tail % Capacity];
+    return true;
+}
+
+bool ZoeThreadPool::TaskQueue::popFront(Task& task)
+{
+    if (tail == head)
+        return false;
+    task = tasks[head++ % Capacity];
+    return true;
+}
+
+int ZoeThreadPool::TaskQueue::cancel(void* arg)
+{
+    unsigned kept = head;
+    for (unsigned i=head;i!=tail;i++)
+    {
+        if (tasks[i % Capacity].arg != arg)
+            tasks[kept++ % Capacity] = tasks[i % Capacity];
+    }
+    const int removed = (int)(tail-kept);
+    tail = kept;
+    return removed;
+}
+
+ZoeThreadPool& ZoeThreadPool::instance()
+{
+    // Never destroyed: at process exit the workers may already be gone, DRV_FREE stops them cleanly
+    static ZoeThreadPool* pool = new ZoeThreadPool();
+    return *pool;
+}
+
+void ZoeThreadPool::configure(int worker_count)
+{
+    ZoeThreadPool& pool = instance();
+    std::lock_guard<std::mutex> lock(pool.state_mutex);
+    requested_workers = std::max(worker_count, 0);
+}
+
+void ZoeThreadPool::shutdown()
+{
+    instance().stop();
+}
+
+ZoeThreadPool::ZoeThreadPool()
+    : started(false),
+      stopping(false),
+      configured_workers(0),
+      next_queue(0),
+      queued_tasks(0)
+{
+}
+
+ZoeThreadPool::~ZoeThreadPool()
+{
+    stop();
+}
+
+void ZoeThreadPool::start()
+{
+    std::lock_guard<std::mutex> lock(state_mutex);
+    if (started.load())
+        return;
+
+    // The thread calling parallelFor works too, leave its core to it
+    int count = requested_workers;
+    if (count == 0)
+        count = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+
+    configured_workers = count;
+    for (int i=0;i<count;i++)
+        workers.push_back(new Worker());
+    for (int i=0;i<count;i++)
+        workers[i]->thread = std::thread(&ZoeThreadPool::workerLoop, this, i);
+
+    started.store(true);
+}
+
+void ZoeThreadPool::stop()
+{
+    std::lock_guard<std::mutex> lock(state_mutex);
+    if (!started.load())
+        return;
+
+    {
+        std::lock_guard<std::mutex> wake_lock(wake_mutex);
+        stopping.store(true);
+    }
+    wake.notify_all();
+
+    for (size_t i=0;i<workers.size();i++)
+    {
+        workers[i]->thread.join();
+        delete workers[i];
+    }
+    workers.clear();
+
+    stopping.store(false);
+    started.store(false);
+}
+
+int ZoeThreadPool::workerCount()
+{
+    if (!started.load())
+        start();
+    return configured_workers;
+}
+
+bool ZoeThreadPool::push(Priority priority, const Task& task)
+{
+    if (!started.load())
+        start();
+
+    // Tasks created by a worker stay on its own queue, others are spread round-robin
+    const int count = (int)workers.size();
+    const int index = (current_worker >= 0) ? current_worker : (int)(next_queue.fetch_add(1) % count);
+
+    queued_tasks.fetch_add(1);
+
+    bool pushed;
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->lock);
+        pushed = workers[index]->queues[priority].pushBack(task);
+    }
+
+    if (!pushed)
+    {
+        queued_tasks.fetch_sub(1);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+    }
+    wake.notify_one();
+    return true;
+}
+
+bool ZoeThreadPool::findTask(int self, Task& task)
+{
+    const int count = (int)workers.size();
+
+    for (int priority=0;priority<PriorityCount;priority++)
+    {
+        if (self >= 0)
+        {
+            std::lock_guard<std::mutex> lock(workers[self]->lock);
+            if (workers[self]->queues[priority].popBack(task))
+                return true;
+        }
+
+        for (int i=1;i<=count;i++)
+        {
+            const int victim = (self+i) % count;
+            if (victim == self)
+                continue;
+
+            std::lock_guard<std::mutex> lock(workers[victim]->lock);
+            if (workers[victim]->queues[priority].popFront(task))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void ZoeThreadPool::workerLoop(int index)
+{
+    current_worker = index;
+
+    for (;;)
+    {
+        Task task;
+        if (findTask(index, task))
+        {
+            queued_tasks.fetch_sub(1);
+            task.func(task.arg);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake.wait(lock, [this]() { return stopping.load() || queued_tasks.load() > 0; });
+
+        if (stopping.load() && queued_tasks.load() <= 0)
+            return;
+    }
+}
+
+void ZoeThreadPool::submit(Priority priority, TaskFunc func, void* arg)
+{
+    Task task = { func, arg };
+    if (!push(priority, task))
+        func(arg);
+}
+
+namespace
+{
+    struct ParallelState
+    {
+        ZoeParallelJob* job;
+        int count;
+        std::atomic<int> next;
+        std::atomic<int> pending; // runner tasks queued or running
+        std::mutex lock;
+        std::condition_variable done;
+    };
+}
+
+void ZoeThreadPool::runParallelIterations(void* arg)
+{
+    ParallelState* state = (ParallelState*)arg;
+
+    for (int i=state->next.fetch_add(1);i<state->count;i=state->next.fetch_add(1))
+        state->job->run(i);
+
+    std::lock_guard<std::mutex> lock(state->lock);
+    if (state->pending.fetch_sub(1) == 1)
+        state->done.notify_all();
+}
+
+void ZoeThreadPool::parallelFor(int count, Priority priority, ZoeParallelJob& job)
+{
+    if (count <= 0)
+        return;
+
+    const int runners = std::min(count-1, workerCount());
+    if (runners <= 0)
+    {
+        for (int i=0;i<count;i++)
+            job.run(i);
+        return;
+    }
+
+    ParallelState state;
+    state.job = &job;
+    state.count = count;
+    state.next.store(0);
+    state.pending.store(runners);
+
+    Task task = { &ZoeThreadPool::runParallelIterations, &state };
+    for (int i=0;i<runners;i++)
+    {
+        if (!push(priority, task))
+            state.pending.fetch_sub(1);
+    }
+
+    // Work on the iterations too, then take back the runners that did not start yet
+    for (int i=state.next.fetch_add(1);i<count;i=state.next.fetch_add(1))
+        job.run(i);
+
+    for (size_t w=0;w<workers.size();w++)
+    {
+        int cancelled;
+        {
+            std::lock_guard<std::mutex> lock(workers[w]->lock);
+            cancelled = workers[w]->queues[priority].cancel(&state);
+        }
+        if (cancelled > 0)
+        {
+            queued_tasks.fetch_sub(cancelled);
+            state.pending.fetch_sub(cancelled);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(state.lock);
+    state.done.wait(lock, [&state]() { return state.pending.load() == 0; });
+}
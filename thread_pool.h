@@ -0,0 +1,140 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ZoeParallelJob
+{
+    virtual void run(int index) = 0;
+};
+
+// Process-wide work-stealing pool shared by every codec instance.
+//
+// Workers are started on first use, one per hardware thread minus the calling thread, unless
+// configure() asked for a different count. Every worker owns a small queue per priority; it pops
+// its own queue from the back and steals from the front of the others. High priority tasks (playback
+// decode) always run before Normal ones (encode, background transcode).
+//
+// Threads that wait on parallelFor() run the iterations themselves, so nested calls from a task
+// never deadlock and never start more threads than the pool already has.
+class ZoeThreadPool
+{
+public:
+    enum Priority { High, Normal, PriorityCount };
+
+    typedef void (*TaskFunc)(void* arg);
+
+    static ZoeThreadPool& instance();
+
+    // Worker count for the next start of the pool, 0 to size it to the hardware
+    static void configure(int worker_count);
+
+    // Stop and join all workers. Must only be called when no codec is running, the pool starts
+    // again on the next use.
+    static void shutdown();
+
+    int workerCount();
+
+    // Run job(0) ... job(count-1) on the pool and the calling thread, return when all are done
+    void parallelFor(int count, Priority priority, ZoeParallelJob& job);
+
+    template <typename Job>
+    void parallelFor(int count, Priority priority, const Job& job)
+    {
+        JobAdapter<Job> adapter(job);
+        parallelFor(count, priority, (ZoeParallelJob&)adapter);
+    }
+
+    // Fire and forget. Runs func on the calling thread if the queues are full.
+    void submit(Priority priority, TaskFunc func, void* arg);
+
+private:
+    ZoeThreadPool();
+    ~ZoeThreadPool();
+    ZoeThreadPool(const ZoeThreadPool&);
+    ZoeThreadPool& operator=(const ZoeThreadPool&);
+
+    template <typename Job>
+    struct JobAdapter : public ZoeParallelJob
+    {
+        JobAdapter(const Job& job) : job(job) {}
+        virtual void run(int index) { job(index); }
+        const Job& job;
+    };
+
+    struct Task
+    {
+        TaskFunc func;
+        void* arg;
+    };
+
+    // Fixed size ring, pushed and popped at the back by its owner, stolen from the front
+    struct TaskQueue
+    {
+        static const int Capacity = 256;
+
+        TaskQueue() : head(0), tail(0) {}
+        bool pushBack(const Task& task);
+        bool popBack(Task& task);
+        bool popFront(Task& task);
+        int cancel(void* arg); // drop queued tasks with this argument, returns how many
+
+        Task tasks[Capacity];
+        unsigned head;
+        unsigned tail;
+    };
+
+    struct Worker
+    {
+        std::mutex lock;
+        TaskQueue queues[PriorityCount];
+        std::thread thread;
+    };
+
+    void start();
+    void stop();
+    void workerLoop(int index);
+    bool push(Priority priority, const Task& task);
+    bool findTask(int self, Task& task);
+
+    static void runParallelIterations(void* arg);
+
+    std::mutex state_mutex; // start and stop
+    std::atomic<bool> started;
+    std::atomic<bool> stopping;
+    int configured_workers;
+
+    std::vector<Worker*> workers;
+    std::atomic<unsigned> next_queue;
+    std::atomic<int> queued_tasks;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+};
@@ -0,0 +1,225 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "unpack.h"
+
+#include "cpu_features.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ZOE_UNPACK_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define ZOE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define ZOE_TARGET_SSSE3
+#endif
+
+static void UnpackGeneric(int bit_count, const unsigned char* src, unsigned short* dest, size_t count)
+{
+    size_t bit = 0;
+    for (size_t i=0;i<count;i++)
+    {
+        unsigned value = 0;
+        for (int b=0;b<bit_count;b++, bit++)
+            value = (value<<1) | ((src[bit/8]>>(7-bit%8))&1);
+        dest[i] = (unsigned short)value;
+    }
+}
+
+static void Unpack10Scalar(const unsigned char* src, unsigned short* dest, size_t groups)
+{
+    for (size_t g=0;g<groups;g++, src+=5, dest+=4)
+    {
+        dest[0] = (unsigned short)((src[0]<<2) | (src[1]>>6));
+        dest[1] = (unsigned short)(((src[1]&0x3F)<<4) | (src[2]>>4));
+        dest[2] = (unsigned short)(((src[2]&0x0F)<<6) | (src[3]>>2));
+        dest[3] = (unsigned short)(((src[3]&0x03)<<8) | src[4]);
+    }
+}
+
+static void Unpack12Scalar(const unsigned char* src, unsigned short* dest, size_t groups)
+{
+    for (size_t g=0;g<groups;g++, src+=3, dest+=2)
+    {
+        dest[0] = (unsigned short)((src[0]<<4) | (src[1]>>4));
+        dest[1] = (unsigned short)(((src[1]&0x0F)<<8) | src[2]);
+    }
+}
+
+#ifdef ZOE_UNPACK_SSSE3
+
+// 8 samples per step. Each 16 bit lane gets the two bytes holding its sample, most significant
+// first; a per-lane multiply moves the sample to the top of the lane and a shift brings it down.
+// Loads are 16 bytes wide, the steps stop while 16 bytes are still left in the source.
+ZOE_TARGET_SSSE3
+static size_t Unpack10SSSE3(const unsigned char* src, unsigned short* dest, size_t count, size_t src_size)
+{
+    const __m128i gather = _mm_setr_epi8(1,0, 2,1, 3,2, 4,3, 6,5, 7,6, 8,7, 9,8);
+    const __m128i align = _mm_setr_epi16(1, 4, 16, 64, 1, 4, 16, 64);
+
+    size_t done = 0;
+    for (;done+8<=count && (done/8)*10+16<=src_size;done+=8)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + (done/8)*10));
+        __m128i lanes = _mm_shuffle_epi8(bytes, gather);
+        lanes = _mm_srli_epi16(_mm_mullo_epi16(lanes, align), 6);
+        _mm_storeu_si128((__m128i*)(dest + done), lanes);
+    }
+    return done;
+}
+
+ZOE_TARGET_SSSE3
+static size_t Unpack12SSSE3(const unsigned char* src, unsigned short* dest, size_t count, size_t src_size)
+{
+    const __m128i gather = _mm_setr_epi8(1,0, 2,1, 4,3, 5,4, 7,6, 8,7, 10,9, 11,10);
+    const __m128i align = _mm_setr_epi16(1, 16, 1, 16, 1, 16, 1, 16);
+
+    size_t done = 0;
+    for (;done+8<=count && (done/8)*12+16<=src_size;done+=8)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + (done/8)*12));
+        __m128i lanes = _mm_shuffle_epi8(bytes, gather);
+        lanes = _mm_srli_epi16(_mm_mullo_epi16(lanes, align), 4);
+        _mm_storeu_si128((__m128i*)(dest + done), lanes);
+    }
+    return done;
+}
+
+#endif
+
+void UnpackSamples(int bit_count, const unsigned char* src, unsigned short* dest, size_t count)
+{
+    if (bit_count != 10 && bit_count != 12)
+    {
+        UnpackGeneric(bit_count, src, dest, count);
+        return;
+    }
+
+    const size_t src_size = (count*bit_count + 7) / 8;
+    size_t done = 0;
+
+#ifdef ZOE_UNPACK_SSSE3
+    static const bool has_ssse3 = CpuHasSSSE3();
+    if (has_ssse3)
+        done = (bit_count == 10) ? Unpack10SSSE3(src, dest, count, src_size) : Unpack12SSSE3(src, dest, count, src_size);
+#endif
+
+    // Remaining whole groups, then the last partial group
+    const size_t group = UnpackGroupSize(bit_count);
+    const size_t groups = (count - done) / group;
+    if (bit_count == 10)
+        Unpack10Scalar(src + done*10/8, dest + done, groups);
+    else
+        Unpack12Scalar(src + done*12/8, dest + done, groups);
+    done += groups*group;
+
+    if (done < count)
+        UnpackGeneric(bit_count, src + done*bit_count/8, dest + done, count - done);
+}
+
+// Sample i of a v210 row
+static unsigned short V210Sample(const unsigned char* src, size_t i)
+{
+    const unsigned char* word = src + i/3*4;
+    const unsigned value = word[0] | (word[1]<<8) | (word[2]<<16) | ((unsigned)word[3]<<24);
+    return (unsigned short)((value >> (10*(i%3))) & 0x3FF);
+}
+
+static void UnpackV210Scalar(const unsigned char* src, unsigned short* dest, size_t groups)
+{
+    for (size_t g=0;g<groups;g++, src+=16, dest+=12)
+        for (size_t i=0;i<12;i++)
+            dest[i] = V210Sample(src, i);
+}
+
+#ifdef ZOE_UNPACK_SSSE3
+
+// One group of 16 bytes per step. The three samples of each word are masked out into three
+// vectors, narrowed to 16 bits next to each other, then shuffled back into stream order: the
+// first 8 samples from the A B lanes and C lanes, the last 4 the same way.
+ZOE_TARGET_SSSE3
+static size_t UnpackV210SSSE3(const unsigned char* src, unsigned short* dest, size_t groups)
+{
+    const __m128i mask = _mm_set1_epi32(0x3FF);
+    const __m128i first_ab = _mm_setr_epi8(0,1, 8,9, -1,-1, 2,3, 10,11, -1,-1, 4,5, 12,13);
+    const __m128i first_c = _mm_setr_epi8(-1,-1, -1,-1, 0,1, -1,-1, -1,-1, 2,3, -1,-1, -1,-1);
+    const __m128i last_ab = _mm_setr_epi8(-1,-1, 6,7, 14,15, -1,-1, -1,-1, -1,-1, -1,-1, -1,-1);
+    const __m128i last_c = _mm_setr_epi8(4,5, -1,-1, -1,-1, 6,7, -1,-1, -1,-1, -1,-1, -1,-1);
+
+    for (size_t g=0;g<groups;g++, src+=16, dest+=12)
+    {
+        const __m128i words = _mm_loadu_si128((const __m128i*)src);
+        const __m128i a = _mm_and_si128(words, mask);
+        const __m128i b = _mm_and_si128(_mm_srli_epi32(words, 10), mask);
+        const __m128i c = _mm_and_si128(_mm_srli_epi32(words, 20), mask);
+        const __m128i ab = _mm_packs_epi32(a, b);
+        const __m128i cc = _mm_packs_epi32(c, c);
+
+        _mm_storeu_si128((__m128i*)dest, _mm_or_si128(_mm_shuffle_epi8(ab, first_ab), _mm_shuffle_epi8(cc, first_c)));
+        _mm_storel_epi64((__m128i*)(dest + 8), _mm_or_si128(_mm_shuffle_epi8(ab, last_ab), _mm_shuffle_epi8(cc, last_c)));
+    }
+    return groups;
+}
+
+#endif
+
+void UnpackV210(const unsigned char* src, unsigned short* dest, size_t count)
+{
+    const size_t groups = count / 12;
+    size_t done = 0;
+
+#ifdef ZOE_UNPACK_SSSE3
+    static const bool has_ssse3 = CpuHasSSSE3();
+    if (has_ssse3)
+        done = UnpackV210SSSE3(src, dest, groups);
+#endif
+
+    UnpackV210Scalar(src + done*16, dest + done*12, groups - done);
+
+    for (size_t i=groups*12;i<count;i++)
+        dest[i] = V210Sample(src, i);
+}
+
+void PackV210(const unsigned short* src, unsigned char* dest, size_t count)
+{
+    const size_t row_bytes = V210RowBytes(count / 2);
+    size_t offset = 0;
+    for (size_t i=0;i<count;i+=3, offset+=4)
+    {
+        unsigned word = src[i] & 0x3FF;
+        if (i+1 < count)
+            word |= (unsigned)(src[i+1] & 0x3FF) << 10;
+        if (i+2 < count)
+            word |= (unsigned)(src[i+2] & 0x3FF) << 20;
+        dest[offset+0] = (unsigned char)word;
+        dest[offset+1] = (unsigned char)(word>>8);
+        dest[offset+2] = (unsigned char)(word>>16);
+        dest[offset+3] = (unsigned char)(word>>24);
+    }
+
+    for (;offset<row_bytes;offset++)
+        dest[offset] = 0;
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stddef.h>
+
+// Expand count samples of bit_count bits, packed MSB first with no padding (PY10: 4 samples in 5
+// bytes, PY12: 2 samples in 3 bytes), into 16 bit words. src must be on a group boundary. Whole
+// groups of 10 and 12 bit samples are converted with SSSE3 shuffles when the CPU has them.
+void UnpackSamples(int bit_count, const unsigned char* src, unsigned short* dest, size_t count);
+
+// Samples in the smallest run that starts and ends on a byte boundary
+inline int UnpackGroupSize(int bit_count)
+{
+    int group = 8;
+    while (group % 2 == 0 && (bit_count * (group / 2)) % 8 == 0)
+        group /= 2;
+    return group;
+}
+
+// v210: 4:2:2 10 bit, three samples in the low 30 bits of each little endian 32 bit word, in U Y V
+// Y order: 6 pixels in a group of 16 bytes. Rows are padded to a multiple of 128 bytes.
+inline size_t V210RowBytes(size_t width)
+{
+    return (width + 47) / 48 * 128;
+}
+
+// Expand count samples of a v210 row (two per pixel, U Y V Y) into 16 bit words. src must be on a
+// group boundary. Whole groups are converted with SSSE3 shuffles when the CPU has them.
+void UnpackV210(const unsigned char* src, unsigned short* dest, size_t count);
+
+// Pack count U Y V Y samples (their low 10 bits) into a v210 row, then zeros up to the end of the
+// row padding
+void PackV210(const unsigned short* src, unsigned char* dest, size_t count);
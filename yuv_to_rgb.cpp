@@ -0,0 +1,233 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "yuv_to_rgb.h"
+
+#include "cpu_features.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ZOE_YUV_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define ZOE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define ZOE_TARGET_SSSE3
+#endif
+
+// Fixed point coefficients, 8 fraction bits: 1.164 for Y', then the chroma terms of each color
+struct YuvCoefficients
+{
+    int y;
+    int b_u;
+    int g_u;
+    int g_v;
+    int r_v;
+};
+
+static const YuvCoefficients matrices[] =
+{
+    { 298, 516, 100, 208, 409 },    // BT.601
+    { 298, 541,  55, 136, 459 },    // BT.709
+};
+
+static unsigned char Clip(int value)
+{
+    return (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+static void ConvertScalar(const unsigned char* uyvy, unsigned char* dest, int width, bool alpha, const YuvCoefficients& k)
+{
+    for (int x=0;x<width;x+=2, uyvy+=4)
+    {
+        const int y0 = k.y * (uyvy[1] - 16) + 128;
+        const int y1 = k.y * (uyvy[3] - 16) + 128;
+        const int cb = uyvy[0] - 128;
+        const int cr = uyvy[2] - 128;
+        const int b = k.b_u * cb;
+        const int g = -k.g_u * cb - k.g_v * cr;
+        const int r = k.r_v * cr;
+
+        *dest++ = Clip((y0 + b) >> 8);
+        *dest++ = Clip((y0 + g) >> 8);
+        *dest++ = Clip((y0 + r) >> 8);
+        if (alpha)
+            *dest++ = 0xFF;
+        *dest++ = Clip((y1 + b) >> 8);
+        *dest++ = Clip((y1 + g) >> 8);
+        *dest++ = Clip((y1 + r) >> 8);
+        if (alpha)
+            *dest++ = 0xFF;
+    }
+}
+
+#ifdef ZOE_YUV_SSSE3
+
+// Two 16 bit multipliers for _mm_madd_epi16, lo for the even lanes and hi for the odd ones
+static __m128i Pair(int lo, int hi)
+{
+    return _mm_set1_epi32((int)(((unsigned)hi << 16) | ((unsigned)lo & 0xFFFF)));
+}
+
+// One color of 8 pixels as 16 bit lanes: (y term + chroma term) >> 8, both in 32 bits so nothing
+// overflows (298*239 does not fit 16 bits)
+ZOE_TARGET_SSSE3
+static __m128i Color(__m128i y_lo, __m128i y_hi, __m128i c_lo, __m128i c_hi, __m128i k)
+{
+    const __m128i lo = _mm_srai_epi32(_mm_add_epi32(y_lo, _mm_madd_epi16(c_lo, k)), 8);
+    const __m128i hi = _mm_srai_epi32(_mm_add_epi32(y_hi, _mm_madd_epi16(c_hi, k)), 8);
+    return _mm_packs_epi32(lo, hi);
+}
+
+// 8 pixels (16 bytes of UYVY) per step. Y' lanes are paired with 1 so one multiply-add gives
+// 298*(Y'-16) + 128, the Cb Cr pair of each pixel is repeated for its two pixels. The unsigned
+// saturation of the final pack is the clip. RGB24 steps store 16 bytes for 12, they stop while
+// 2 pixels are still left.
+ZOE_TARGET_SSSE3
+static int ConvertSSSE3(const unsigned char* uyvy, unsigned char* dest, int width, bool alpha, const YuvCoefficients& k)
+{
+    const __m128i y_lanes = _mm_setr_epi8(1,-1, 3,-1, 5,-1, 7,-1, 9,-1, 11,-1, 13,-1, 15,-1);
+    const __m128i c_lanes_lo = _mm_setr_epi8(0,-1, 2,-1, 0,-1, 2,-1, 4,-1, 6,-1, 4,-1, 6,-1);
+    const __m128i c_lanes_hi = _mm_setr_epi8(8,-1, 10,-1, 8,-1, 10,-1, 12,-1, 14,-1, 12,-1, 14,-1);
+    const __m128i drop_alpha = _mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+    const __m128i y_offset = _mm_set1_epi16(16);
+    const __m128i c_offset = _mm_set1_epi16(128);
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i opaque = _mm_set1_epi16(0xFF);
+    const __m128i k_y = Pair(k.y, 128);
+    const __m128i k_b = Pair(k.b_u, 0);
+    const __m128i k_g = Pair(-k.g_u, -k.g_v);
+    const __m128i k_r = Pair(0, k.r_v);
+
+    const int step_end = alpha ? width - 8 : width - 10;
+    int x = 0;
+    for (;x<=step_end;x+=8)
+    {
+        const __m128i src = _mm_loadu_si128((const __m128i*)(uyvy + x*2));
+        const __m128i y = _mm_sub_epi16(_mm_shuffle_epi8(src, y_lanes), y_offset);
+        const __m128i y_lo = _mm_madd_epi16(_mm_unpacklo_epi16(y, one), k_y);
+        const __m128i y_hi = _mm_madd_epi16(_mm_unpackhi_epi16(y, one), k_y);
+        const __m128i c_lo = _mm_sub_epi16(_mm_shuffle_epi8(src, c_lanes_lo), c_offset);
+        const __m128i c_hi = _mm_sub_epi16(_mm_shuffle_epi8(src, c_lanes_hi), c_offset);
+
+        // B0..B7 G0..G7 and R0..R7 A0..A7, then interleaved to B G R A
+        const __m128i bg = _mm_packus_epi16(Color(y_lo, y_hi, c_lo, c_hi, k_b), Color(y_lo, y_hi, c_lo, c_hi, k_g));
+        const __m128i ra = _mm_packus_epi16(Color(y_lo, y_hi, c_lo, c_hi, k_r), opaque);
+        const __m128i bg_pairs = _mm_unpacklo_epi8(bg, _mm_srli_si128(bg, 8));
+        const __m128i ra_pairs = _mm_unpacklo_epi8(ra, _mm_srli_si128(ra, 8));
+        const __m128i bgra_lo = _mm_unpacklo_epi16(bg_pairs, ra_pairs);
+        const __m128i bgra_hi = _mm_unpackhi_epi16(bg_pairs, ra_pairs);
+
+        if (alpha)
+        {
+            _mm_storeu_si128((__m128i*)(dest + x*4), bgra_lo);
+            _mm_storeu_si128((__m128i*)(dest + x*4 + 16), bgra_hi);
+        }
+        else
+        {
+            _mm_storeu_si128((__m128i*)(dest + x*3), _mm_shuffle_epi8(bgra_lo, drop_alpha));
+            _mm_storeu_si128((__m128i*)(dest + x*3 + 12), _mm_shuffle_epi8(bgra_hi, drop_alpha));
+        }
+    }
+    return x;
+}
+
+// Same matrix, 4 pixels per step, clipped with min and max
+ZOE_TARGET_SSSE3
+static int ConvertFloatSSE(const float* y, const float* cb, const float* cr, int width, const YuvCoefficients& k,
+                           float scale, float offset, float* r, float* g, float* b)
+{
+    const __m128 y_offset = _mm_set1_ps(16.0f);
+    const __m128 c_offset = _mm_set1_ps(128.0f);
+    const __m128 k_y = _mm_set1_ps(k.y / 256.0f);
+    const __m128 k_b_u = _mm_set1_ps(k.b_u / 256.0f);
+    const __m128 k_g_u = _mm_set1_ps(k.g_u / 256.0f);
+    const __m128 k_g_v = _mm_set1_ps(k.g_v / 256.0f);
+    const __m128 k_r_v = _mm_set1_ps(k.r_v / 256.0f);
+    const __m128 low = _mm_setzero_ps();
+    const __m128 high = _mm_set1_ps(255.0f);
+    const __m128 k_scale = _mm_set1_ps(scale);
+    const __m128 k_offset = _mm_set1_ps(offset);
+
+    int x = 0;
+    for (;x+4<=width;x+=4)
+    {
+        const __m128 luma = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(y + x), y_offset), k_y);
+        const __m128 u = _mm_sub_ps(_mm_loadu_ps(cb + x), c_offset);
+        const __m128 v = _mm_sub_ps(_mm_loadu_ps(cr + x), c_offset);
+        const __m128 blue = _mm_add_ps(luma, _mm_mul_ps(u, k_b_u));
+        const __m128 green = _mm_sub_ps(_mm_sub_ps(luma, _mm_mul_ps(u, k_g_u)), _mm_mul_ps(v, k_g_v));
+        const __m128 red = _mm_add_ps(luma, _mm_mul_ps(v, k_r_v));
+        _mm_storeu_ps(r + x, _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(red, low), high), k_scale), k_offset));
+        _mm_storeu_ps(g + x, _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(green, low), high), k_scale), k_offset));
+        _mm_storeu_ps(b + x, _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(blue, low), high), k_scale), k_offset));
+    }
+    return x;
+}
+
+#endif
+
+static float ClipFloat(float value)
+{
+    return value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+}
+
+void ConvertUYVYToRGB(const unsigned char* uyvy, unsigned char* dest, int width, bool alpha, ZoeColorMatrix matrix)
+{
+    const YuvCoefficients& k = matrices[matrix == ZoeColorBT709 ? 1 : 0];
+    int done = 0;
+
+#ifdef ZOE_YUV_SSSE3
+    static const bool has_ssse3 = CpuHasSSSE3();
+    if (has_ssse3)
+        done = ConvertSSSE3(uyvy, dest, width, alpha, k);
+#endif
+
+    ConvertScalar(uyvy + done*2, dest + done*(alpha ? 4 : 3), width - done, alpha, k);
+}
+
+void ConvertYuvToRgbFloat(const float* y, const float* cb, const float* cr, int width, ZoeColorMatrix matrix,
+                          float scale, float offset, float* r, float* g, float* b)
+{
+    const YuvCoefficients& k = matrices[matrix == ZoeColorBT709 ? 1 : 0];
+    int x = 0;
+
+#ifdef ZOE_YUV_SSSE3
+    // Plain SSE2, behind the check of the integer path
+    static const bool has_ssse3 = CpuHasSSSE3();
+    if (has_ssse3)
+        x = ConvertFloatSSE(y, cb, cr, width, k, scale, offset, r, g, b);
+#endif
+
+    const float k_y = k.y / 256.0f, k_b_u = k.b_u / 256.0f, k_g_u = k.g_u / 256.0f, k_g_v = k.g_v / 256.0f, k_r_v = k.r_v / 256.0f;
+    for (;x<width;x++)
+    {
+        const float luma = (y[x] - 16.0f) * k_y;
+        const float u = cb[x] - 128.0f;
+        const float v = cr[x] - 128.0f;
+        r[x] = ClipFloat(luma + v * k_r_v) * scale + offset;
+        g[x] = ClipFloat(luma - u * k_g_u - v * k_g_v) * scale + offset;
+        b[x] = ClipFloat(luma + u * k_b_u) * scale + offset;
+    }
+}
@@ -0,0 +1,42 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+// Y'CbCr to R'G'B' matrices of UYVY frames decoded to RGB, video range (Y' 16-235, Cb Cr 16-240)
+enum ZoeColorMatrix
+{
+    ZoeColorBT601,      // standard definition, the default
+    ZoeColorBT709       // high definition
+};
+
+// Convert width pixels (even) of a UYVY row to B G R, or B G R A with an opaque alpha. Whole
+// groups of 8 pixels are converted with SSSE3 when the CPU has it, with the same fixed point
+// arithmetic as the scalar code: both give the same bytes.
+void ConvertUYVYToRGB(const unsigned char* uyvy, unsigned char* dest, int width, bool alpha, ZoeColorMatrix matrix);
+
+// Convert width pixels of Y' Cb Cr floats (one Cb Cr per pixel, 0-255) to R' G' B' planes, the same
+// matrix in floating point, clipped to 0-255 then written as value*scale + offset. Groups of 4
+// pixels go through SSE2 when the CPU has it.
+void ConvertYuvToRgbFloat(const float* y, const float* cb, const float* cr, int width, ZoeColorMatrix matrix,
+                          float scale, float offset, float* r, float* g, float* b);
@@ -0,0 +1,773 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "zoe.h"
+#include "codecs.h"
+#include "codec_context.h"
+#include "formats.h"
+#include "thread_pool.h"
+#include "unpack.h"
+
+#include <algorithm>
+#include <new>
+
+namespace
+{
+    typedef unsigned (*EncodeFunc)(unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int in_stride);
+    typedef bool (*DecodeFunc)(unsigned inSize, unsigned width, unsigned height, const unsigned char* in_frame, unsigned char* out_frame, ZoeCodecContext* ctx, int out_stride);
+
+    struct EncodeRoute
+    {
+        zoe_format format;
+        zoe_pixel_format input;
+        EncodeFunc encode;
+    };
+
+    struct DecodeRoute
+    {
+        zoe_format format;
+        zoe_pixel_format output;
+        unsigned options;           // ZOE_DECODE_xxx flags accepted besides ZOE_DECODE_FLIP
+        DecodeFunc decode;
+    };
+
+    // What libzoe needs to know of a stream format besides its routes (see ZOE_STREAM_FORMATS)
+    struct FormatInfo
+    {
+        zoe_format format;
+        bool huffman;
+        bool paired;
+        unsigned bytes_per_pixel;
+        unsigned planes;
+        unsigned encode_flags;
+    };
+
+#define ENCODE_ROUTE(format, input) { ZOE_FORMAT_##format, ZOE_PIXEL_##input, Compress_##input##_To_##format },
+#define HUFFMAN_ENCODE_ROUTE(format, input, reader) ENCODE_ROUTE(format, input)
+#define DECODE_ROUTE(format, output, options) { ZOE_FORMAT_##format, ZOE_PIXEL_##output, options, Decompress_##format##_To_##output },
+#define HUFFMAN_DECODE_ROUTE(format, output, options, type, op) DECODE_ROUTE(format, output, options)
+#define FORMAT_INFO(format, huffman, paired, bytes_per_pixel, planes, encode_flags, output, rgb_output) \
+    { ZOE_FORMAT_##format, huffman != 0, paired != 0, bytes_per_pixel, planes, encode_flags },
+
+    const EncodeRoute encode_routes[] =
+    {
+        ZOE_ENCODERS(ENCODE_ROUTE, HUFFMAN_ENCODE_ROUTE)
+    };
+
+    const DecodeRoute decode_routes[] =
+    {
+        ZOE_DECODERS(DECODE_ROUTE, HUFFMAN_DECODE_ROUTE)
+    };
+
+    const FormatInfo format_infos[] =
+    {
+        ZOE_STREAM_FORMATS(FORMAT_INFO)
+    };
+
+#undef ENCODE_ROUTE
+#undef HUFFMAN_ENCODE_ROUTE
+#undef DECODE_ROUTE
+#undef HUFFMAN_DECODE_ROUTE
+#undef FORMAT_INFO
+
+    const FormatInfo* FindFormat(zoe_format format)
+    {
+        for (size_t i=0;i<sizeof(format_infos)/sizeof(format_infos[0]);i++)
+            if (format_infos[i].format == format)
+                return &format_infos[i];
+        return 0;
+    }
+
+    // Frames above 2 GB do not fit the 32 bit sizes of the codecs
+    const unsigned long long MaxFrameBytes = 0x7FFFFFFF;
+
+    unsigned long long PixelFrameSize(zoe_pixel_format pixels, unsigned width, unsigned height)
+    {
+        const unsigned long long count = (unsigned long long)width * height;
+        switch (pixels)
+        {
+        case ZOE_PIXEL_Y8:    return count;
+        case ZOE_PIXEL_Y10:   return count*2;
+        case ZOE_PIXEL_Y12:   return count*2;
+        case ZOE_PIXEL_Y14:   return count*2;
+        case ZOE_PIXEL_PY10:  return (count*10 + 7) / 8;
+        case ZOE_PIXEL_PY12:  return (count*12 + 7) / 8;
+        case ZOE_PIXEL_UYVY:  return count*2;
+        case ZOE_PIXEL_RGB24: return count*3;
+        case ZOE_PIXEL_RGB32: return count*4;
+        case ZOE_PIXEL_Y16:   return count*2;
+        case ZOE_PIXEL_RGB48: return count*6;
+        case ZOE_PIXEL_RGBA64: return count*8;
+        case ZOE_PIXEL_F32_PLANAR: return count*4; // one plane
+        case ZOE_PIXEL_F16_PLANAR: return count*2;
+        case ZOE_PIXEL_V210:  return (unsigned long long)V210RowBytes(width) * height;
+        case ZOE_PIXEL_YUV422P10: return count*4; // Y, then U and V at half the width
+        case ZOE_PIXEL_I420:
+        case ZOE_PIXEL_NV12:  return count*3/2; // Y, then U and V at half the width and height
+        default:              return 0;
+        }
+    }
+
+    // 4:2:0 layouts, the Y plane then the chroma at half the height
+    bool IsYuv420Pixels(zoe_pixel_format pixels)
+    {
+        return pixels == ZOE_PIXEL_I420 || pixels == ZOE_PIXEL_NV12;
+    }
+
+    // Bytes of one row, of the first plane for YUV422P10 and the 4:2:0 layouts
+    unsigned long long PixelRowSize(zoe_pixel_format pixels, unsigned width)
+    {
+        if (pixels == ZOE_PIXEL_YUV422P10)
+            return (unsigned long long)width * 2;
+        if (IsYuv420Pixels(pixels))
+            return width;
+        return PixelFrameSize(pixels, width, 1);
+    }
+
+    // Bytes spanned by a frame with the given stride, and offset of its row 0 in the buffer
+    unsigned long long StridedFrameSize(zoe_pixel_format pixels, unsigned width, unsigned height, int stride, size_t* row0_offset)
+    {
+        *row0_offset = 0;
+        if (stride == 0)
+            return PixelFrameSize(pixels, width, height);
+
+        const unsigned long long pitch = (unsigned long long)(stride < 0 ? -(long long)stride : (long long)stride);
+        if (pixels == ZOE_PIXEL_YUV422P10)
+            return pitch * height * 2; // the chroma planes have half the stride
+        if (IsYuv420Pixels(pixels))
+            return pitch * height * 3/2; // and half the height
+        if (stride < 0)
+            *row0_offset = (size_t)(pitch * (height-1));
+        return pitch * (height-1) + PixelRowSize(pixels, width);
+    }
+
+    // Bytes per pixel of the samples coded in the stream, unpacked
+    unsigned StreamBytesPerPixel(zoe_format format)
+    {
+        const FormatInfo* info = FindFormat(format);
+        return info ? info->bytes_per_pixel : 0;
+    }
+
+    bool IsHuffmanFormat(zoe_format format)
+    {
+        const FormatInfo* info = FindFormat(format);
+        return info && info->huffman;
+    }
+
+    // Formats coding U Y V Y groups, their pixels come in pairs
+    bool IsPairedFormat(zoe_format format)
+    {
+        const FormatInfo* info = FindFormat(format);
+        return info && info->paired;
+    }
+
+    // The largest frames of the format, raw, must stay within MaxFrameBytes
+    bool IsValidFrameSize(zoe_format format, unsigned width, unsigned height)
+    {
+        const unsigned bytes_per_pixel = std::max(StreamBytesPerPixel(format), 4u);
+        return width > 0 && height > 0 && (unsigned long long)width * height * bytes_per_pixel + 4 <= MaxFrameBytes;
+    }
+
+    bool IsPlanarOutput(zoe_pixel_format pixels)
+    {
+        return pixels == ZOE_PIXEL_F32_PLANAR || pixels == ZOE_PIXEL_F16_PLANAR;
+    }
+
+    unsigned SampleSize(zoe_pixel_format pixels)
+    {
+        if (pixels == ZOE_PIXEL_F32_PLANAR)
+            return 4;
+        if (pixels == ZOE_PIXEL_V210 || pixels == ZOE_PIXEL_YUV422P10)
+            return 4; // 32 bit words, or 16 bit samples in rows of half the stride
+        if (pixels == ZOE_PIXEL_I420)
+            return 2; // chroma rows of half the stride
+        return (pixels == ZOE_PIXEL_Y10 || pixels == ZOE_PIXEL_Y12 || pixels == ZOE_PIXEL_Y14 || pixels == ZOE_PIXEL_Y16 || pixels == ZOE_PIXEL_RGB48 || pixels == ZOE_PIXEL_RGBA64 || pixels == ZOE_PIXEL_F16_PLANAR) ? 2 : 1;
+    }
+
+    // Planes of the float outputs of the format
+    unsigned PlaneCount(zoe_format format)
+    {
+        const FormatInfo* info = FindFormat(format);
+        return info ? info->planes : 0;
+    }
+
+    // Bytes spanned by the planes of a planar frame, rows pitch bytes apart (0 for packed rows) and
+    // planes plane_stride bytes apart (0 for planes back to back)
+    unsigned long long TensorFrameSize(zoe_pixel_format pixels, unsigned planes, unsigned width, unsigned height,
+                                       unsigned long long pitch, unsigned long long plane_stride)
+    {
+        const unsigned long long row_size = PixelRowSize(pixels, width);
+        if (pitch == 0)
+            pitch = row_size;
+        if (plane_stride == 0)
+            plane_stride = pitch * height;
+        return plane_stride * (planes-1) + pitch * (height-1) + row_size;
+    }
+
+    // Rows must not overlap, and 16 bit samples stay aligned
+    bool IsValidStride(zoe_pixel_format pixels, unsigned width, unsigned height, int stride)
+    {
+        size_t row0_offset;
+        const unsigned long long pitch = (unsigned long long)(stride < 0 ? -(long long)stride : (long long)stride);
+        const unsigned sample_size = SampleSize(pixels);
+        return (stride == 0 || (pitch >= PixelRowSize(pixels, width) && pitch % sample_size == 0)) &&
+            StridedFrameSize(pixels, width, height, stride, &row0_offset) <= MaxFrameBytes;
+    }
+
+    // Forwards the bands written through the codec context to the caller's callback
+    struct BandForward
+    {
+        zoe_band_callback callback;
+        void* user;
+        const void* band;
+
+        static bool written(void* self, int first_row, int row_count)
+        {
+            const BandForward* forward = (const BandForward*)self;
+            return forward->callback(forward->user, forward->band, first_row, row_count) != 0;
+        }
+    };
+}
+
+namespace
+{
+    // One entry per format pair, picked once when the encoder or decoder is created: the frames
+    // then run the kernel of the route, its inner loops specialized for the pair.
+    const EncodeRoute* FindEncodeRoute(zoe_format format, zoe_pixel_format input, unsigned flags)
+    {
+        const FormatInfo* info = FindFormat(format);
+        if (!info || (flags & ~info->encode_flags))
+            return 0;
+        for (size_t i=0;i<sizeof(encode_routes)/sizeof(encode_routes[0]);i++)
+            if (encode_routes[i].format == format && encode_routes[i].input == input)
+                return &encode_routes[i];
+        return 0;
+    }
+
+    // Huffman decoders write their rows in either order, the flip is not part of the route. The
+    // matrix only applies to conversions to RGB: float planes of YUV frames need ZOE_DECODE_PLANAR_RGB.
+    const DecodeRoute* FindDecodeRoute(zoe_format format, zoe_pixel_format output, unsigned flags)
+    {
+        if ((flags & ZOE_DECODE_FLIP) && !IsHuffmanFormat(format))
+            return 0;
+        flags &= ~(unsigned)ZOE_DECODE_FLIP;
+        if ((flags & ZOE_DECODE_BT709) && IsPlanarOutput(output) && !(flags & ZOE_DECODE_PLANAR_RGB))
+            return 0;
+        for (size_t i=0;i<sizeof(decode_routes)/sizeof(decode_routes[0]);i++)
+            if (decode_routes[i].format == format && decode_routes[i].output == output && !(flags & ~decode_routes[i].options))
+                return &decode_routes[i];
+        return 0;
+    }
+}
+
+struct zoe_encoder
+{
+    const EncodeRoute* route;
+    unsigned width;
+    unsigned height;
+    int input_stride;
+    size_t input_row0;
+    size_t input_size;
+    size_t max_output_size;
+    ZoeCodecContext context;
+};
+
+struct zoe_decoder
+{
+    const DecodeRoute* route;
+    unsigned width;
+    unsigned height;
+    int output_stride;
+    size_t output_row0;
+    size_t output_size;
+    unsigned planes;                // planar outputs, 0 otherwise
+    ZoeTensorLayout tensor;
+    ZoeCodecContext context;
+};
+
+zoe_status zoe_encoder_create(const zoe_encoder_config* config, zoe_encoder** encoder)
+{
+    if (!config || !encoder)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    *encoder = 0;
+
+    if (!IsValidFrameSize(config->format, config->width, config->height))
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if (config->threads != ZOE_THREADS_SHARED_POOL && config->threads != ZOE_THREADS_CALLER)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if (config->flags & ~(unsigned)(ZOE_ENCODE_THUMBNAIL | ZOE_ENCODE_COLOR_TRANSFORM))
+        return ZOE_ERROR_INVALID_ARGUMENT;
+
+    const EncodeRoute* route = FindEncodeRoute(config->format, config->input, config->flags);
+    if (!route)
+        return ZOE_ERROR_UNSUPPORTED;
+    if (!IsValidStride(config->input, config->width, config->height, config->input_stride))
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if (config->format == ZOE_FORMAT_HV210 && config->width % 2 != 0)
+        return ZOE_ERROR_INVALID_ARGUMENT; // v210 pixels come in U Y V Y pairs
+    if (config->format == ZOE_FORMAT_HYUV420 && (config->width % 2 != 0 || config->height % 2 != 0 || config->input_stride < 0))
+        return ZOE_ERROR_INVALID_ARGUMENT; // chroma of 2x2 pixels, planes top-down
+
+    zoe_encoder* instance = new (std::nothrow) zoe_encoder;
+    if (!instance)
+        return ZOE_ERROR_OUT_OF_MEMORY;
+
+    instance->route = route;
+    instance->width = config->width;
+    instance->height = config->height;
+    instance->input_stride = config->input_stride;
+    instance->input_size = (size_t)StridedFrameSize(config->input, config->width, config->height, config->input_stride, &instance->input_row0);
+    instance->max_output_size = IsHuffmanFormat(config->format)
+        ? HuffmanFrameBound(config->width, config->height, StreamBytesPerPixel(config->format))
+        : (size_t)PixelFrameSize(config->input, config->width, config->height);
+    if (config->format == ZOE_FORMAT_HYUV420)
+        instance->max_output_size = HuffmanYuv420FrameBound(config->width, config->height);
+    instance->context.setParallel(config->threads == ZOE_THREADS_SHARED_POOL);
+    instance->context.setThumbnails((config->flags & ZOE_ENCODE_THUMBNAIL) != 0);
+    instance->context.setColorTransform((config->flags & ZOE_ENCODE_COLOR_TRANSFORM) != 0);
+
+    *encoder = instance;
+    return ZOE_OK;
+}
+
+void zoe_encoder_destroy(zoe_encoder* encoder)
+{
+    delete encoder;
+}
+
+size_t zoe_encoder_input_size(const zoe_encoder* encoder)
+{
+    return encoder ? encoder->input_size : 0;
+}
+
+size_t zoe_encoder_max_output_size(const zoe_encoder* encoder)
+{
+    return encoder ? encoder->max_output_size : 0;
+}
+
+zoe_status zoe_encode(zoe_encoder* encoder, const void* input, size_t input_size,
+                      void* output, size_t output_capacity, size_t* output_size)
+{
+    if (!encoder || !input || !output || !output_size)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    *output_size = 0;
+
+    // The codecs write without bounds checks, the worst case must fit
+    if (input_size < encoder->input_size || output_capacity < encoder->max_output_size)
+        return ZOE_ERROR_BUFFER_TOO_SMALL;
+
+    try
+    {
+        *output_size = encoder->route->encode(encoder->width, encoder->height,
+            (const unsigned char*)input + encoder->input_row0, (unsigned char*)output, &encoder->context, encoder->input_stride);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return ZOE_ERROR_OUT_OF_MEMORY;
+    }
+
+    return ZOE_OK;
+}
+
+zoe_status zoe_decoder_create(const zoe_decoder_config* config, zoe_decoder** decoder)
+{
+    if (!config || !decoder)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    *decoder = 0;
+
+    if (!IsValidFrameSize(config->format, config->width, config->height))
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if (config->threads != ZOE_THREADS_SHARED_POOL && config->threads != ZOE_THREADS_CALLER)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+
+    const bool flip = (config->flags & ZOE_DECODE_FLIP) != 0;
+    const DecodeRoute* route = FindDecodeRoute(config->format, config->output, config->flags);
+    if (!route)
+        return ZOE_ERROR_UNSUPPORTED;
+    if (!IsValidStride(config->output, config->width, config->height, config->output_stride))
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if ((IsPlanarOutput(config->output) || config->output == ZOE_PIXEL_YUV422P10 || IsYuv420Pixels(config->output)) && config->output_stride < 0)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if (config->format == ZOE_FORMAT_HV210 && config->width % 2 != 0)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if (config->format == ZOE_FORMAT_HYUV420 && (config->width % 2 != 0 || config->height % 2 != 0))
+        return ZOE_ERROR_INVALID_ARGUMENT;
+
+    zoe_decoder* instance = new (std::nothrow) zoe_decoder;
+    if (!instance)
+        return ZOE_ERROR_OUT_OF_MEMORY;
+
+    instance->route = route;
+    instance->width = config->width;
+    instance->height = config->height;
+    instance->output_stride = config->output_stride;
+    instance->output_size = (size_t)StridedFrameSize(config->output, config->width, config->height, config->output_stride, &instance->output_row0);
+    instance->planes = 0;
+    if (IsPlanarOutput(config->output))
+    {
+        instance->planes = PlaneCount(config->format);
+        instance->output_size = (size_t)TensorFrameSize(config->output, instance->planes, config->width, config->height, config->output_stride, 0);
+    }
+    const ZoeTensorLayout tensor = { 1.0f, 0.0f, 0, (config->flags & ZOE_DECODE_PLANAR_RGB) != 0 };
+    instance->tensor = tensor;
+    instance->context.setParallel(config->threads == ZOE_THREADS_SHARED_POOL);
+    instance->context.setColorMatrix((config->flags & ZOE_DECODE_BT709) ? ZoeColorBT709 : ZoeColorBT601);
+    instance->context.setTensorLayout(&instance->tensor);
+    instance->context.setFlipOutput(flip);
+
+    *decoder = instance;
+    return ZOE_OK;
+}
+
+void zoe_decoder_destroy(zoe_decoder* decoder)
+{
+    delete decoder;
+}
+
+size_t zoe_decoder_output_size(const zoe_decoder* decoder)
+{
+    return decoder ? decoder->output_size : 0;
+}
+
+zoe_status zoe_decode(zoe_decoder* decoder, const void* input, size_t input_size,
+                      void* output, size_t output_capacity)
+{
+    if (!decoder || !input || !output)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if (output_capacity < decoder->output_size)
+        return ZOE_ERROR_BUFFER_TOO_SMALL;
+
+    // Every encoded frame starts with a 32 bit word (flags or first tree size)
+    if (input_size < 4 || input_size > MaxFrameBytes)
+        return ZOE_ERROR_CORRUPT_FRAME;
+
+    try
+    {
+        if (!decoder->route->decode((unsigned)input_size, decoder->width, decoder->height,
+                (const unsigned char*)input, (unsigned char*)output + decoder->output_row0, &decoder->context, decoder->output_stride))
+            return ZOE_ERROR_CORRUPT_FRAME;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return ZOE_ERROR_OUT_OF_MEMORY;
+    }
+
+    return ZOE_OK;
+}
+
+size_t zoe_decoder_region_size(const zoe_decoder* decoder, unsigned width, unsigned height)
+{
+    if (!decoder || width == 0 || height == 0 || width > decoder->width || height > decoder->height)
+        return 0;
+
+    if (decoder->planes)
+        return (size_t)TensorFrameSize(decoder->route->output, decoder->planes, width, height, decoder->output_stride, 0);
+
+    size_t row0_offset;
+    return (size_t)StridedFrameSize(decoder->route->output, width, height, decoder->output_stride, &row0_offset);
+}
+
+zoe_status zoe_decode_region(zoe_decoder* decoder, const void* input, size_t input_size,
+                             unsigned x, unsigned y, unsigned width, unsigned height,
+                             void* output, size_t output_capacity)
+{
+    if (!decoder || !input || !output || width == 0 || height == 0 ||
+        x >= decoder->width || width > decoder->width - x || y >= decoder->height || height > decoder->height - y)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+
+    // HUYVY and HV210 samples are coded as U Y and V Y pairs, a region cannot split a U Y V Y group
+    if (IsPairedFormat(decoder->route->format) && (x % 2 != 0 || width % 2 != 0))
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    // HYUV420 chroma covers 2x2 pixels
+    if (decoder->route->format == ZOE_FORMAT_HYUV420 && (x % 2 != 0 || width % 2 != 0 || y % 2 != 0 || height % 2 != 0))
+        return ZOE_ERROR_INVALID_ARGUMENT;
+
+    if (output_capacity < zoe_decoder_region_size(decoder, width, height))
+        return ZOE_ERROR_BUFFER_TOO_SMALL;
+    if (input_size < 4 || input_size > MaxFrameBytes)
+        return ZOE_ERROR_CORRUPT_FRAME;
+
+    size_t row0_offset;
+    StridedFrameSize(decoder->route->output, width, height, decoder->output_stride, &row0_offset);
+    unsigned char* region_dest = (unsigned char*)output + row0_offset;
+
+    ZoeRegion region = { (int)x, (int)y, (int)width, (int)height };
+    zoe_status status = ZOE_OK;
+
+    try
+    {
+        if (IsHuffmanFormat(decoder->route->format))
+        {
+            decoder->context.setRegion(&region);
+            if (!decoder->route->decode((unsigned)input_size, decoder->width, decoder->height,
+                    (const unsigned char*)input, region_dest, &decoder->context, decoder->output_stride))
+                status = ZOE_ERROR_CORRUPT_FRAME;
+        }
+        else
+        {
+            // Uncompressed: each row of the region is a one row frame of its own
+            const size_t pixel_size = StreamBytesPerPixel(decoder->route->format);
+            if (input_size != pixel_size * decoder->width * decoder->height)
+                return ZOE_ERROR_CORRUPT_FRAME;
+
+            const ptrdiff_t pitch = decoder->output_stride ? decoder->output_stride : (ptrdiff_t)PixelRowSize(decoder->route->output, width);
+            for (unsigned row=0;row<height;row++)
+            {
+                const unsigned char* in_row = (const unsigned char*)input + pixel_size * ((size_t)(y+row) * decoder->width + x);
+                if (!decoder->route->decode((unsigned)(pixel_size * width), width, 1, in_row, region_dest + (ptrdiff_t)row * pitch, &decoder->context, 0))
+                {
+                    status = ZOE_ERROR_CORRUPT_FRAME;
+                    break;
+                }
+            }
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        status = ZOE_ERROR_OUT_OF_MEMORY;
+    }
+
+    decoder->context.setRegion(0);
+    return status;
+}
+
+size_t zoe_decoder_thumbnail_size(const zoe_decoder* decoder, unsigned* width, unsigned* height)
+{
+    if (!decoder || !width || !height)
+        return 0;
+
+    HuffmanThumbnailSize(decoder->width, decoder->height, IsPairedFormat(decoder->route->format) ? 2 : 1, width, height);
+    if (decoder->planes)
+        return (size_t)TensorFrameSize(decoder->route->output, decoder->planes, *width, *height, 0, 0);
+    return (size_t)PixelFrameSize(decoder->route->output, *width, *height);
+}
+
+zoe_status zoe_decode_thumbnail(zoe_decoder* decoder, const void* input, size_t input_size,
+                                void* output, size_t output_capacity)
+{
+    if (!decoder || !input || !output)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+
+    unsigned width, height;
+    if (output_capacity < zoe_decoder_thumbnail_size(decoder, &width, &height))
+        return ZOE_ERROR_BUFFER_TOO_SMALL;
+    if (input_size < 4 || input_size > MaxFrameBytes)
+        return ZOE_ERROR_CORRUPT_FRAME;
+    if (!IsHuffmanFormat(decoder->route->format) || !HuffmanFrameHasThumbnail((unsigned)input_size, (const unsigned char*)input))
+        return ZOE_ERROR_NO_THUMBNAIL;
+
+    zoe_status status = ZOE_OK;
+
+    try
+    {
+        decoder->context.setThumbnailOutput(true);
+        if (!decoder->route->decode((unsigned)input_size, decoder->width, decoder->height,
+                (const unsigned char*)input, (unsigned char*)output, &decoder->context, 0))
+            status = ZOE_ERROR_CORRUPT_FRAME;
+    }
+    catch (const std::bad_alloc&)
+    {
+        status = ZOE_ERROR_OUT_OF_MEMORY;
+    }
+
+    decoder->context.setThumbnailOutput(false);
+    return status;
+}
+
+size_t zoe_decoder_band_size(const zoe_decoder* decoder, unsigned band_rows)
+{
+    if (!decoder || band_rows == 0)
+        return 0;
+
+    size_t row0_offset;
+    const unsigned rows = band_rows < decoder->height ? band_rows : decoder->height;
+    return (size_t)StridedFrameSize(decoder->route->output, decoder->width, rows, decoder->output_stride, &row0_offset);
+}
+
+zoe_status zoe_decode_bands(zoe_decoder* decoder, const void* input, size_t input_size,
+                            void* band, size_t band_capacity, unsigned band_rows,
+                            zoe_band_callback callback, void* user)
+{
+    if (!decoder || !input || !band || !callback || band_rows == 0)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if (decoder->planes || decoder->route->output == ZOE_PIXEL_YUV422P10 || IsYuv420Pixels(decoder->route->output))
+        return ZOE_ERROR_UNSUPPORTED; // a band holds rows of every plane, no layout fits it
+    if (band_capacity < zoe_decoder_band_size(decoder, band_rows))
+        return ZOE_ERROR_BUFFER_TOO_SMALL;
+    if (input_size < 4 || input_size > MaxFrameBytes)
+        return ZOE_ERROR_CORRUPT_FRAME;
+
+    if (band_rows > decoder->height)
+        band_rows = decoder->height;
+
+    size_t band_row0;
+    StridedFrameSize(decoder->route->output, decoder->width, band_rows, decoder->output_stride, &band_row0);
+    unsigned char* band_dest = (unsigned char*)band + band_row0;
+
+    BandForward forward = { callback, user, band };
+    ZoeBandOutput bands = { (int)band_rows, &BandForward::written, &forward };
+    zoe_status status = ZOE_OK;
+
+    try
+    {
+        if (IsHuffmanFormat(decoder->route->format))
+        {
+            decoder->context.setBandOutput(&bands);
+            if (!decoder->route->decode((unsigned)input_size, decoder->width, decoder->height,
+                    (const unsigned char*)input, band_dest, &decoder->context, decoder->output_stride))
+                status = ZOE_ERROR_CORRUPT_FRAME;
+        }
+        else
+        {
+            // Uncompressed: each band of the input is a smaller frame of its own
+            const size_t row_size = (size_t)StreamBytesPerPixel(decoder->route->format) * decoder->width;
+            if (input_size != row_size * decoder->height)
+                return ZOE_ERROR_CORRUPT_FRAME;
+
+            for (unsigned y=0;y<decoder->height;y+=band_rows)
+            {
+                const unsigned rows = (decoder->height-y < band_rows) ? decoder->height-y : band_rows;
+                if (!decoder->route->decode((unsigned)(row_size * rows), decoder->width, rows,
+                        (const unsigned char*)input + row_size * y, band_dest, &decoder->context, decoder->output_stride))
+                {
+                    status = ZOE_ERROR_CORRUPT_FRAME;
+                    break;
+                }
+                if (!callback(user, band, y, rows))
+                    break;
+            }
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        status = ZOE_ERROR_OUT_OF_MEMORY;
+    }
+
+    decoder->context.setBandOutput(0);
+    return status;
+}
+
+unsigned zoe_decoder_planes(const zoe_decoder* decoder)
+{
+    return decoder ? decoder->planes : 0;
+}
+
+size_t zoe_decoder_tensor_size(const zoe_decoder* decoder, const zoe_tensor_layout* layout)
+{
+    if (!decoder || !layout || !decoder->planes)
+        return 0;
+
+    const unsigned sample_size = SampleSize(decoder->route->output);
+    const unsigned long long row_size = PixelRowSize(decoder->route->output, decoder->width);
+    const unsigned long long pitch = layout->row_stride ? (unsigned long long)layout->row_stride : row_size;
+    const unsigned long long plane_stride = layout->plane_stride ? (unsigned long long)layout->plane_stride : pitch * decoder->height;
+    if (layout->row_stride < 0 || pitch < row_size || pitch % sample_size != 0)
+        return 0;
+    if (plane_stride % sample_size != 0)
+        return 0;
+
+    // Row y of plane p starts at p*plane_stride + y*pitch: either each plane ends before the next
+    // one, or the rows of every plane fit between two rows
+    const bool separate_planes = plane_stride >= pitch * (decoder->height-1) + row_size;
+    const bool interleaved_rows = plane_stride >= row_size && plane_stride * (decoder->planes-1) + row_size <= pitch;
+    if (decoder->planes > 1 && !separate_planes && !interleaved_rows)
+        return 0;
+
+    const unsigned long long size = TensorFrameSize(decoder->route->output, decoder->planes, decoder->width, decoder->height, pitch, plane_stride);
+    return size <= MaxFrameBytes ? (size_t)size : 0;
+}
+
+zoe_status zoe_decode_tensor(zoe_decoder* decoder, const void* input, size_t input_size,
+                             const zoe_tensor_layout* layout, void* output, size_t output_capacity)
+{
+    if (!decoder || !input || !layout || !output)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if (!decoder->planes)
+        return ZOE_ERROR_UNSUPPORTED;
+
+    const size_t tensor_size = zoe_decoder_tensor_size(decoder, layout);
+    if (tensor_size == 0)
+        return ZOE_ERROR_INVALID_ARGUMENT;
+    if (output_capacity < tensor_size)
+        return ZOE_ERROR_BUFFER_TOO_SMALL;
+    if (input_size < 4 || input_size > MaxFrameBytes)
+        return ZOE_ERROR_CORRUPT_FRAME;
+
+    const ptrdiff_t pitch = layout->row_stride ? layout->row_stride : (ptrdiff_t)PixelRowSize(decoder->route->output, decoder->width);
+    decoder->tensor.scale = layout->scale;
+    decoder->tensor.offset = layout->offset;
+    decoder->tensor.plane_stride = layout->plane_stride ? (ptrdiff_t)layout->plane_stride : pitch * decoder->height;
+    zoe_status status = ZOE_OK;
+
+    try
+    {
+        if (!decoder->route->decode((unsigned)input_size, decoder->width, decoder->height,
+                (const unsigned char*)input, (unsigned char*)output, &decoder->context, (int)pitch))
+            status = ZOE_ERROR_CORRUPT_FRAME;
+    }
+    catch (const std::bad_alloc&)
+    {
+        status = ZOE_ERROR_OUT_OF_MEMORY;
+    }
+
+    decoder->tensor.scale = 1.0f;
+    decoder->tensor.offset = 0.0f;
+    decoder->tensor.plane_stride = 0;
+    return status;
+}
+
+int zoe_encode_supported(zoe_format format, zoe_pixel_format input, unsigned flags)
+{
+    return FindEncodeRoute(format, input, flags) != 0;
+}
+
+int zoe_decode_supported(zoe_format format, zoe_pixel_format output, unsigned flags)
+{
+    return FindDecodeRoute(format, output, flags) != 0;
+}
+
+void zoe_set_worker_threads(int count)
+{
+    ZoeThreadPool::configure(count < 0 ? 0 : count);
+}
+
+void zoe_shutdown(void)
+{
+    ZoeThreadPool::shutdown();
+}
+
+const char* zoe_status_string(zoe_status status)
+{
+    switch (status)
+    {
+    case ZOE_OK:                        return "ok";
+    case ZOE_ERROR_INVALID_ARGUMENT:    return "invalid argument";
+    case ZOE_ERROR_UNSUPPORTED:         return "unsupported format conversion";
+    case ZOE_ERROR_BUFFER_TOO_SMALL:    return "buffer too small";
+    case ZOE_ERROR_CORRUPT_FRAME:       return "corrupt frame";
+    case ZOE_ERROR_OUT_OF_MEMORY:       return "out of memory";
+    case ZOE_ERROR_NO_THUMBNAIL:        return "frame has no thumbnail";
+    }
+    return "unknown error";
+}
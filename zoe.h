@@ -0,0 +1,278 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+// libzoe: portable C interface of the codec, independent of Video for Windows.
+//
+// An encoder or decoder object holds the codec tables and scratch buffers of one stream; create one
+// per stream and reuse it for every frame. An object must only be used by one thread at a time,
+// different objects may be used concurrently. Large frames are spread over a thread pool shared by
+// all objects of the process unless the object was created with threads = 1.
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stream formats, same values as the buffer type stored in the VfW format header
+typedef enum zoe_format
+{
+    ZOE_FORMAT_NONE = 0,
+    ZOE_FORMAT_RGB24,       // uncompressed
+    ZOE_FORMAT_RGB32,       // uncompressed
+    ZOE_FORMAT_Y8,          // uncompressed
+    ZOE_FORMAT_Y10,         // uncompressed
+    ZOE_FORMAT_HY8,
+    ZOE_FORMAT_HY10,
+    ZOE_FORMAT_HRGB24,
+    ZOE_FORMAT_HRGB32,
+    ZOE_FORMAT_HUYVY,
+    ZOE_FORMAT_PY10,        // not a stream format, reserved
+    ZOE_FORMAT_Y12,         // uncompressed
+    ZOE_FORMAT_HY12,
+    ZOE_FORMAT_HY14,        // 14 and 16 bit gray, each residual coded as its magnitude class and its bits
+    ZOE_FORMAT_HY16,
+    ZOE_FORMAT_HV210,       // 4:2:2 10 bit, coded like HUYVY
+    ZOE_FORMAT_HRGB48,      // 16 bit RGB and RGBA, each channel coded like HY16
+    ZOE_FORMAT_HRGBA64,
+    ZOE_FORMAT_HYUV420,     // 4:2:0 8 bit, the Y plane coded like HY8 and the U V planes apart (even width and height)
+
+    ZOE_FORMAT_COUNT
+} zoe_format;
+
+// Layout of the uncompressed frames given to the encoder or produced by the decoder
+typedef enum zoe_pixel_format
+{
+    ZOE_PIXEL_NONE = 0,
+    ZOE_PIXEL_Y8,           // 8 bit gray
+    ZOE_PIXEL_Y10,          // 10 bit gray in 16 bit little endian words
+    ZOE_PIXEL_Y12,          // 12 bit gray in 16 bit little endian words
+    ZOE_PIXEL_PY10,         // 10 bit gray, packed MSB first (4 pixels in 5 bytes)
+    ZOE_PIXEL_PY12,         // 12 bit gray, packed MSB first (2 pixels in 3 bytes)
+    ZOE_PIXEL_UYVY,         // 4:2:2, U0 Y0 V0 Y1
+    ZOE_PIXEL_RGB24,        // B G R
+    ZOE_PIXEL_RGB32,        // B G R A
+    ZOE_PIXEL_Y16,          // 16 bit gray, or fewer bits in the MSB of 16 bit little endian words with the low bits 0 (HY10/HY12/HY14 output)
+    ZOE_PIXEL_RGB48,        // B G R in 16 bit little endian words, top-down; gray in the MSB for HY10/HY12/HY14/HY16 outputs
+    ZOE_PIXEL_F32_PLANAR,   // one plane of 32 bit floats per channel, see zoe_decode_tensor
+    ZOE_PIXEL_F16_PLANAR,   // one plane of IEEE half floats per channel, see zoe_decode_tensor
+    ZOE_PIXEL_Y14,          // 14 bit gray in 16 bit little endian words
+    ZOE_PIXEL_V210,         // 4:2:2 10 bit, 6 pixels in 4 little endian 32 bit words, rows padded to 128 bytes (even width)
+    ZOE_PIXEL_YUV422P10,    // 4:2:2 10 bit in 16 bit little endian words: Y plane, then U and V planes at half the width and half the row stride (HV210 output)
+    ZOE_PIXEL_RGBA64,       // B G R A in 16 bit little endian words, top-down
+    ZOE_PIXEL_I420,         // 4:2:0 8 bit: Y plane, then U and V planes at half the width and height and half the row stride
+    ZOE_PIXEL_NV12,         // 4:2:0 8 bit: Y plane, then a plane of U V pairs at half the height with the row stride of Y
+
+    ZOE_PIXEL_COUNT
+} zoe_pixel_format;
+
+typedef enum zoe_status
+{
+    ZOE_OK = 0,
+    ZOE_ERROR_INVALID_ARGUMENT,
+    ZOE_ERROR_UNSUPPORTED,          // no conversion between the stream and pixel formats
+    ZOE_ERROR_BUFFER_TOO_SMALL,
+    ZOE_ERROR_CORRUPT_FRAME,
+    ZOE_ERROR_OUT_OF_MEMORY,
+    ZOE_ERROR_NO_THUMBNAIL          // the frame was encoded without ZOE_ENCODE_THUMBNAIL
+} zoe_status;
+
+enum
+{
+    ZOE_THREADS_SHARED_POOL = 0,    // spread large frames over the shared thread pool
+    ZOE_THREADS_CALLER = 1          // code every frame on the calling thread only
+};
+
+enum
+{
+    ZOE_ENCODE_THUMBNAIL = 0x1,     // store a 1/8 scale thumbnail in each frame (Huffman formats other than HYUV420)
+    ZOE_ENCODE_COLOR_TRANSFORM = 0x2 // HRGB48/HRGBA64: code blue and red as their difference to green, smaller for most images
+};
+
+enum
+{
+    ZOE_DECODE_FLIP = 0x1,          // output rows in the other order: RGB32 from gray, YUV or 16 bit RGB top-down, the others bottom-up (Huffman formats only)
+    ZOE_DECODE_BT709 = 0x2,         // HUYVY and HYUV420 to RGB with the BT.709 matrix instead of BT.601
+    ZOE_DECODE_PLANAR_RGB = 0x4     // HUYVY to float planes: R G B instead of Y U V
+};
+
+// Row strides: 0 for tightly packed rows, otherwise the byte distance between the starts of two rows
+// (padded DIB rows, capture buffers with a pitch), a multiple of 2 for the 16 bit formats. With a
+// negative stride the buffer is bottom-up: it still points to the lowest address, where the last row is.
+// Rows of packed formats (PY10/PY12) start on a byte boundary when a stride is given.
+
+typedef struct zoe_encoder_config
+{
+    zoe_format format;              // stream format to produce
+    zoe_pixel_format input;         // layout of the frames given to zoe_encode
+    unsigned width;
+    unsigned height;
+    int threads;                    // ZOE_THREADS_SHARED_POOL or ZOE_THREADS_CALLER
+    int input_stride;               // bytes between input rows, see below
+    unsigned flags;                 // ZOE_ENCODE_xxx
+} zoe_encoder_config;
+
+typedef struct zoe_decoder_config
+{
+    zoe_format format;              // stream format of the frames given to zoe_decode
+    zoe_pixel_format output;        // layout of the decoded frames
+    unsigned width;
+    unsigned height;
+    int threads;                    // ZOE_THREADS_SHARED_POOL or ZOE_THREADS_CALLER
+    unsigned flags;                 // ZOE_DECODE_xxx
+    int output_stride;              // bytes between output rows, see below
+} zoe_decoder_config;
+
+typedef struct zoe_encoder zoe_encoder;
+typedef struct zoe_decoder zoe_decoder;
+
+// Non-zero when an encoder or decoder can be created for this format pair and these flags
+int zoe_encode_supported(zoe_format format, zoe_pixel_format input, unsigned flags);
+int zoe_decode_supported(zoe_format format, zoe_pixel_format output, unsigned flags);
+
+// Encoder
+
+zoe_status zoe_encoder_create(const zoe_encoder_config* config, zoe_encoder** encoder);
+void zoe_encoder_destroy(zoe_encoder* encoder);
+
+// Bytes of one input frame, including the row padding of the stride
+size_t zoe_encoder_input_size(const zoe_encoder* encoder);
+
+// No encoded frame is larger than this
+size_t zoe_encoder_max_output_size(const zoe_encoder* encoder);
+
+// Encode one frame. input_size and output_capacity must be at least zoe_encoder_input_size() and
+// zoe_encoder_max_output_size(), *output_size receives the size of the encoded frame.
+zoe_status zoe_encode(zoe_encoder* encoder, const void* input, size_t input_size,
+                      void* output, size_t output_capacity, size_t* output_size);
+
+// Decoder
+
+zoe_status zoe_decoder_create(const zoe_decoder_config* config, zoe_decoder** decoder);
+void zoe_decoder_destroy(zoe_decoder* decoder);
+
+// Bytes of one decoded frame, including the row padding of the stride
+size_t zoe_decoder_output_size(const zoe_decoder* decoder);
+
+// Decode one encoded frame of input_size bytes into output, output_capacity must be at least
+// zoe_decoder_output_size(). Frames may come from damaged files: every table, index and
+// bitstream is checked to lie within the input_size bytes, and frames that do not fit or hold
+// invalid Huffman trees give ZOE_ERROR_CORRUPT_FRAME. Damaged bitstreams still decode to some pixels.
+zoe_status zoe_decode(zoe_decoder* decoder, const void* input, size_t input_size,
+                      void* output, size_t output_capacity);
+
+// Bytes of the output of a width x height region, with the output stride of the decoder
+size_t zoe_decoder_region_size(const zoe_decoder* decoder, unsigned width, unsigned height);
+
+// Decode only the pixels [x, x+width) x [y, y+height) of a frame, bit-exact with the same pixels
+// of zoe_decode. output is laid out like a width x height frame with the output stride of the
+// decoder, bottom-up outputs keep the region bottom-up. Frames store the bitstream position of
+// every 16th row, so the cost follows the height of the region rather than the frame; frames of
+// older versions are decoded from their first row. x and width must be even for HUYVY and HV210,
+// x, y, width and height for HYUV420.
+zoe_status zoe_decode_region(zoe_decoder* decoder, const void* input, size_t input_size,
+                             unsigned x, unsigned y, unsigned width, unsigned height,
+                             void* output, size_t output_capacity);
+
+// Size in pixels of the thumbnail of a frame, returns the bytes of its output: thumbnail rows are
+// tightly packed whatever the output stride of the decoder. The thumbnail is 1/8 of the frame in
+// each direction, rounded up; HUYVY and HV210 thumbnails keep whole U Y V Y groups (an even width).
+size_t zoe_decoder_thumbnail_size(const zoe_decoder* decoder, unsigned* width, unsigned* height);
+
+// Decode the thumbnail stored in a frame by an encoder created with ZOE_ENCODE_THUMBNAIL, in the
+// output format of the decoder. Each thumbnail pixel is the rounded average of the 8x8 frame pixels
+// it covers (U and V of HUYVY are averaged separately). The thumbnail sits right after the frame
+// header, so the bitstreams are never read. Frames stored raw (incompressible) have their
+// thumbnail computed from the samples; other frames without one give ZOE_ERROR_NO_THUMBNAIL, as do
+// uncompressed formats and HYUV420. Bottom-up outputs keep the thumbnail bottom-up.
+zoe_status zoe_decode_thumbnail(zoe_decoder* decoder, const void* input, size_t input_size,
+                                void* output, size_t output_capacity);
+
+// Receives each band decoded by zoe_decode_bands: output rows [first_row, first_row+row_count) of
+// the frame, as zoe_decode would have placed them. Return 0 to stop decoding the frame.
+typedef int (*zoe_band_callback)(void* user, const void* band, unsigned first_row, unsigned row_count);
+
+// Bytes of a band buffer holding band_rows rows, with the output stride of the decoder
+size_t zoe_decoder_band_size(const zoe_decoder* decoder, unsigned band_rows);
+
+// Decode one encoded frame band_rows rows at a time into the same small band buffer, calling
+// callback after each band. Only one band of output exists at a time, and the first rows are
+// available long before the frame is complete. Bands follow the image from its top, so the output
+// rows of bottom-up outputs (RGB from gray, YUV or 16 bit RGB, the other outputs with
+// ZOE_DECODE_FLIP) come last to first. The band buffer is laid out like band_rows rows of the output
+// (a shorter last band fills its first rows), band_capacity must be at least zoe_decoder_band_size().
+// Stopping from the callback is not an error. Outputs made of planes (float planes, YUV422P10,
+// I420, NV12) are not supported.
+zoe_status zoe_decode_bands(zoe_decoder* decoder, const void* input, size_t input_size,
+                            void* band, size_t band_capacity, unsigned band_rows,
+                            zoe_band_callback callback, void* user);
+
+// Planar float outputs
+
+// ZOE_PIXEL_F32_PLANAR and ZOE_PIXEL_F16_PLANAR decode Huffman frames straight to the planes of a
+// tensor, for training data loaders. Each channel goes to a top-down plane of width x height values:
+// one plane for the gray formats, R G B (A) planes for HRGB24 (HRGB32), Y U V planes for HUYVY with
+// U and V repeated for both pixels of a pair. With ZOE_DECODE_PLANAR_RGB, HUYVY gives R G B planes
+// through the color matrix (ZOE_DECODE_BT709 selects it) clipped to 0-255, without rounding.
+// zoe_decode and zoe_decode_region write the sample values, rows with the output stride of the
+// decoder (not negative) and planes back to back, zoe_decode_thumbnail packed planes.
+// zoe_decode_tensor normalizes the values and places the planes. Band decodes are not supported.
+typedef struct zoe_tensor_layout
+{
+    float scale;                    // each value is sample*scale + offset, e.g. 1/255 and 0 for 8 bit samples in [0, 1]
+    float offset;
+    int row_stride;                 // bytes between the starts of two rows of a plane, 0 for packed rows
+    size_t plane_stride;            // bytes between the starts of two planes, 0 for planes back to back
+} zoe_tensor_layout;
+
+// Planes of a decoded frame, 0 when the output of the decoder is not planar
+unsigned zoe_decoder_planes(const zoe_decoder* decoder);
+
+// Bytes spanned by the planes of a frame with this layout, 0 when the layout is not valid: strides
+// must be multiples of the value size, and rows must not overlap. Planes must not overlap either,
+// rows of the planes may be interleaved.
+size_t zoe_decoder_tensor_size(const zoe_decoder* decoder, const zoe_tensor_layout* layout);
+
+// Decode one encoded frame to planes normalized and placed as layout says, output_capacity must be
+// at least zoe_decoder_tensor_size(). The samples go from the decoded rows to the planes through
+// SSE2 (F16C for half floats) when the CPU has it.
+zoe_status zoe_decode_tensor(zoe_decoder* decoder, const void* input, size_t input_size,
+                             const zoe_tensor_layout* layout, void* output, size_t output_capacity);
+
+// Process
+
+// Worker count of the shared thread pool, 0 to size it to the hardware. Takes effect the next time
+// the pool starts.
+void zoe_set_worker_threads(int count);
+
+// Stop the shared thread pool. No encoder or decoder may be running.
+void zoe_shutdown(void);
+
+const char* zoe_status_string(zoe_status status);
+
+#ifdef __cplusplus
+}
+#endif
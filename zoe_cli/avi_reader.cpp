@@ -0,0 +1,347 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "avi_reader.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    unsigned FourCC(const char* code)
+    {
+        return (unsigned)(unsigned char)code[0] | ((unsigned)(unsigned char)code[1] << 8) |
+            ((unsigned)(unsigned char)code[2] << 16) | ((unsigned)(unsigned char)code[3] << 24);
+    }
+
+    // Little endian values at any alignment
+    unsigned short Read16(const unsigned char* p) { return (unsigned short)(p[0] | (p[1] << 8)); }
+    unsigned Read32(const unsigned char* p) { return (unsigned)p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16) | ((unsigned)p[3] << 24); }
+    unsigned long long Read64(const unsigned char* p) { return Read32(p) | ((unsigned long long)Read32(p + 4) << 32); }
+
+    // Stream format of AZCL streams: BITMAPINFOHEADER then the codec header (see ZoeCodec.cpp)
+    const unsigned BitmapInfoHeaderSize = 40;
+    const unsigned ZoeCodecHeaderSize = 4;
+
+    // OpenDML index types (bIndexType)
+    const unsigned char IndexOfIndexes = 0x00;
+    const unsigned char IndexOfChunks = 0x01;
+}
+
+AviReader::AviReader()
+    : stream_format(ZOE_FORMAT_NONE),
+      frame_width(0),
+      frame_height(0),
+      frame_rate(0),
+      index_kind(""),
+      video_stream(-1),
+      super_index(0),
+      super_index_size(0)
+{
+}
+
+bool AviReader::detect(const MappedFile& file)
+{
+    return file.size() >= 12 && Read32(file.data()) == FourCC("RIFF") && Read32(file.data() + 8) == FourCC("AVI ");
+}
+
+bool AviReader::readChunk(unsigned long long offset, unsigned long long end, Chunk& chunk) const
+{
+    if (end > mapping.size())
+        end = mapping.size();
+    // Offsets read from indexes can be anything, offset + 8 could wrap
+    if (offset > end || end - offset < 8)
+        return false;
+
+    chunk.id = Read32(mapping.data() + offset);
+    chunk.data = offset + 8;
+    chunk.size = Read32(mapping.data() + offset + 4);
+
+    // A capture cut short leaves list sizes past the end of the file. Other chunks keep their size
+    // so that a partly written frame fails the bounds check of addFrame.
+    if (chunk.data + chunk.size > end && (chunk.id == FourCC("RIFF") || chunk.id == FourCC("LIST")))
+        chunk.size = (unsigned)(end - chunk.data);
+    return true;
+}
+
+unsigned long long AviReader::mappedBytes(unsigned long long offset, unsigned long long size) const
+{
+    if (offset > mapping.size())
+        return 0;
+    return std::min<unsigned long long>(size, mapping.size() - offset);
+}
+
+bool AviReader::parseStreamList(const Chunk& list, int stream)
+{
+    bool video = false;
+    unsigned scale = 0, rate = 0;
+    unsigned long long index = 0;
+    unsigned index_size = 0;
+
+    Chunk chunk;
+    for (unsigned long long offset = list.data + 4; readChunk(offset, list.data + list.size, chunk); offset = chunk.data + chunk.size + (chunk.size & 1))
+    {
+        const unsigned char* data = mapping.data() + chunk.data;
+        const unsigned long long size = mappedBytes(chunk.data, chunk.size);
+        if (chunk.id == FourCC("strh") && size >= 28)
+        {
+            video = Read32(data) == FourCC("vids");
+            scale = Read32(data + 20);
+            rate = Read32(data + 24);
+        }
+        else if (chunk.id == FourCC("strf") && video && size >= BitmapInfoHeaderSize)
+        {
+            // Only AZCL streams with the codec header tell the stream format
+            if (Read32(data + 16) != FourCC("AZCL") || size < BitmapInfoHeaderSize + ZoeCodecHeaderSize)
+                video = false;
+            else
+            {
+                const int height = (int)Read32(data + 8);
+                frame_width = Read32(data + 4);
+                frame_height = height < 0 ? -height : height;
+                stream_format = (zoe_format)data[BitmapInfoHeaderSize + 1];
+            }
+        }
+        else if (chunk.id == FourCC("indx"))
+        {
+            index = chunk.data;
+            index_size = (unsigned)size;
+        }
+    }
+
+    if (!video || stream_format == ZOE_FORMAT_NONE)
+        return false;
+
+    video_stream = stream;
+    frame_rate = scale ? (double)rate / scale : 0;
+    super_index = index;
+    super_index_size = index_size;
+    return true;
+}
+
+bool AviReader::addFrame(unsigned long long data, unsigned size)
+{
+    // The base offset of ix## chunks is 64 bit, data + size could wrap
+    if (data > mapping.size() || size > mapping.size() - data)
+        return false;
+    frame_offsets.push_back(data);
+    frame_sizes.push_back(size);
+    return true;
+}
+
+bool AviReader::indexFromSuperIndex()
+{
+    // wLongsPerEntry, bIndexSubType, bIndexType, nEntriesInUse, dwChunkId, dwReserved[3], entries
+    const unsigned char* index = mapping.data() + super_index;
+    const unsigned long long index_size = mappedBytes(super_index, super_index_size);
+    if (index_size < 24 || Read16(index) != 4 || index[3] != IndexOfIndexes)
+        return false;
+
+    // A writer that did not get to close the file leaves the super index empty
+    const unsigned entry_count = Read32(index + 4);
+    if (entry_count == 0 || 24 + (unsigned long long)entry_count * 16 > index_size)
+        return false;
+
+    for (unsigned i=0;i<entry_count;i++)
+    {
+        // Each entry points to an ix## chunk: the same header, qwBaseOffset, dwReserved, then
+        // dwOffset (from the base to the chunk data) and dwSize (bit 31 set on delta frames)
+        Chunk chunk;
+        if (!readChunk(Read64(index + 24 + i*16), mapping.size(), chunk))
+            return false;
+        const unsigned long long chunk_size = mappedBytes(chunk.data, chunk.size);
+        if (chunk_size < 24)
+            return false;
+
+        const unsigned char* chunks = mapping.data() + chunk.data;
+        if (Read16(chunks) != 2 || chunks[3] != IndexOfChunks)
+            return false;
+
+        const unsigned chunk_count = Read32(chunks + 4);
+        const unsigned long long base = Read64(chunks + 12);
+        if (24 + (unsigned long long)chunk_count * 8 > chunk_size)
+            return false;
+
+        for (unsigned j=0;j<chunk_count;j++)
+            if (!addFrame(base + Read32(chunks + 24 + j*8), Read32(chunks + 28 + j*8) & 0x7FFFFFFF))
+                return false;
+    }
+
+    index_kind = "indx";
+    return true;
+}
+
+bool AviReader::isFrameChunk(unsigned id) const
+{
+    // Two digits of the stream number, then 'dc' (compressed) or 'db' (uncompressed)
+    const unsigned stream_id = ('0' + video_stream / 10) | (('0' + video_stream % 10) << 8);
+    const unsigned type = id >> 16;
+    return (id & 0xFFFF) == stream_id && (type == (FourCC("00dc") >> 16) || type == (FourCC("00db") >> 16));
+}
+
+bool AviReader::indexFromIdx1(const Chunk& idx1)
+{
+    // Entries: ckid, dwFlags, dwChunkOffset, dwChunkLength
+    const unsigned entry_count = (unsigned)(mappedBytes(idx1.data, idx1.size) / 16);
+    const unsigned char* entries = mapping.data() + idx1.data;
+
+    // Offsets are from the 'movi' list type, or from the start of the file for some writers:
+    // the first frame tells which
+    unsigned long long base = 0;
+    bool base_known = false;
+
+    for (unsigned i=0;i<entry_count;i++)
+    {
+        const unsigned char* entry = entries + i*16;
+        const unsigned id = Read32(entry);
+        if (!isFrameChunk(id))
+            continue;
+
+        const unsigned long long offset = Read32(entry + 8);
+        if (!base_known)
+        {
+            const unsigned long long relative = movi_lists[0].data + offset;
+            base = (relative + 4 <= mapping.size() && Read32(mapping.data() + relative) == id) ? movi_lists[0].data : 0;
+            base_known = true;
+        }
+
+        if (!addFrame(base + offset + 8, Read32(entry + 12)))
+            return false;
+    }
+
+    index_kind = "idx1";
+    return base_known;
+}
+
+void AviReader::indexFromMovi()
+{
+    for (size_t i=0;i<movi_lists.size();i++)
+    {
+        // Frames are directly in the list, or grouped in 'rec ' lists
+        std::vector<Chunk> lists(1, movi_lists[i]);
+        while (!lists.empty())
+        {
+            const Chunk list = lists.back();
+            lists.pop_back();
+
+            Chunk chunk;
+            for (unsigned long long offset = list.data + 4; readChunk(offset, list.data + list.size, chunk); offset = chunk.data + chunk.size + (chunk.size & 1))
+            {
+                if (chunk.id == FourCC("LIST") && chunk.size >= 4 && Read32(mapping.data() + chunk.data) == FourCC("rec "))
+                    lists.push_back(chunk);
+                else if (isFrameChunk(chunk.id))
+                    addFrame(chunk.data, chunk.size);
+            }
+        }
+    }
+
+    index_kind = "movi";
+}
+
+bool AviReader::open(const char* path)
+{
+    frame_offsets.clear();
+    frame_sizes.clear();
+    movi_lists.clear();
+    video_stream = -1;
+
+    if (!mapping.open(path))
+        return false;
+    if (!detect(mapping))
+    {
+        fprintf(stderr, "%s is not an AVI file\n", path);
+        return false;
+    }
+
+    // RIFF 'AVI ' then, in OpenDML files, RIFF 'AVIX' chunks each with a movi list
+    Chunk idx1 = { 0, 0, 0 };
+    Chunk riff;
+    for (unsigned long long offset = 0; readChunk(offset, mapping.size(), riff) && riff.id == FourCC("RIFF"); offset = riff.data + riff.size + (riff.size & 1))
+    {
+        int stream = 0;
+        Chunk chunk;
+        for (unsigned long long child = riff.data + 4; readChunk(child, riff.data + riff.size, chunk); child = chunk.data + chunk.size + (chunk.size & 1))
+        {
+            const unsigned list_type = (chunk.id == FourCC("LIST") && chunk.size >= 4) ? Read32(mapping.data() + chunk.data) : 0;
+            if (list_type == FourCC("hdrl"))
+            {
+                Chunk header;
+                for (unsigned long long item = chunk.data + 4; readChunk(item, chunk.data + chunk.size, header); item = header.data + header.size + (header.size & 1))
+                    if (header.id == FourCC("LIST") && header.size >= 4 && Read32(mapping.data() + header.data) == FourCC("strl"))
+                    {
+                        if (video_stream < 0)
+                            parseStreamList(header, stream);
+                        stream++;
+                    }
+            }
+            else if (list_type == FourCC("movi"))
+                movi_lists.push_back(chunk);
+            else if (chunk.id == FourCC("idx1") && idx1.size == 0)
+                idx1 = chunk;
+        }
+
+        if (riff.size == 0)
+            break;
+    }
+
+    if (video_stream < 0)
+    {
+        fprintf(stderr, "%s has no AZCL video stream\n", path);
+        return false;
+    }
+    if (movi_lists.empty())
+    {
+        fprintf(stderr, "%s has no movi list\n", path);
+        return false;
+    }
+
+    // The super index covers every RIFF chunk, idx1 only the first one
+    bool indexed = super_index && indexFromSuperIndex();
+    if (!indexed && idx1.size && movi_lists.size() == 1)
+    {
+        frame_offsets.clear();
+        frame_sizes.clear();
+        indexed = indexFromIdx1(idx1);
+    }
+    if (!indexed)
+    {
+        frame_offsets.clear();
+        frame_sizes.clear();
+        indexFromMovi();
+    }
+
+    return true;
+}
+
+void AviReader::prefetch(unsigned first, unsigned count)
+{
+    if (first >= frameCount() || count == 0)
+        return;
+
+    const unsigned last = (count > frameCount() - first) ? frameCount() - 1 : first + count - 1;
+    const unsigned long long begin = frame_offsets[first];
+    const unsigned long long end = frame_offsets[last] + frame_sizes[last];
+    if (end > begin)
+        mapping.prefetch((size_t)begin, (size_t)(end - begin));
+}
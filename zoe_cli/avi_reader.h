@@ -0,0 +1,99 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <vector>
+
+#include "mapped_file.h"
+#include "../zoe.h"
+
+// Reader of the AZCL video stream of AVI files: AVI 1.0 (idx1) and OpenDML (AVI 2.0, RIFF-AVIX
+// extensions and indx super indexes, files past 4 GB). The file is memory mapped and indexed once
+// when opened; frames are then pointers into the mapping, any frame is reached in constant time.
+class AviReader
+{
+public:
+    AviReader();
+
+    // Returns false and prints the reason when the file has no AZCL stream that can be indexed
+    bool open(const char* path);
+
+    zoe_format format() const { return stream_format; }
+    unsigned width() const { return frame_width; }
+    unsigned height() const { return frame_height; }
+    double frameRate() const { return frame_rate; }
+    unsigned frameCount() const { return (unsigned)frame_sizes.size(); }
+
+    // Frame index of the stream, *size is 0 for dropped frames (the previous frame repeats)
+    const unsigned char* frame(unsigned index, unsigned* size) const
+    {
+        *size = frame_sizes[index];
+        return mapping.data() + frame_offsets[index];
+    }
+
+    // Ask the kernel to read frames [first, first+count) ahead of their use
+    void prefetch(unsigned first, unsigned count);
+
+    // Which index the frame table came from: "indx", "idx1" or "movi" (chunks walked)
+    const char* indexKind() const { return index_kind; }
+
+    MappedFile& file() { return mapping; }
+
+    // Whether the file starts like an AVI file
+    static bool detect(const MappedFile& file);
+
+private:
+    struct Chunk
+    {
+        unsigned id;
+        unsigned long long data;   // offset of the chunk data in the file
+        unsigned size;
+    };
+
+    bool readChunk(unsigned long long offset, unsigned long long end, Chunk& chunk) const;
+    // Bytes of the size bytes at offset that are in the file, sizes read from it are not trusted
+    unsigned long long mappedBytes(unsigned long long offset, unsigned long long size) const;
+    bool parseStreamList(const Chunk& list, int stream);
+    bool isFrameChunk(unsigned id) const;
+    bool indexFromSuperIndex();
+    bool indexFromIdx1(const Chunk& idx1);
+    void indexFromMovi();
+    bool addFrame(unsigned long long data, unsigned size);
+
+    MappedFile mapping;
+    zoe_format stream_format;
+    unsigned frame_width;
+    unsigned frame_height;
+    double frame_rate;
+    const char* index_kind;
+
+    int video_stream;                               // stream number of the AZCL stream
+    unsigned long long super_index;                 // offset of its indx chunk data, 0 if none
+    unsigned super_index_size;
+    std::vector<Chunk> movi_lists;                  // movi list of each RIFF chunk, data after the 'movi' type
+
+    // Frame table, 12 bytes per frame
+    std::vector<unsigned long long> frame_offsets;
+    std::vector<unsigned> frame_sizes;
+};
@@ -0,0 +1,516 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "avi_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace
+{
+    // O_DIRECT transfers start and end on blocks of the device, 4 KB covers the usual ones
+    const unsigned BlockSize = 4096;
+    const size_t BufferSize = 8 << 20;
+    const unsigned long long ExtentSize = 256ull << 20;
+
+    // The header (RIFF, hdrl, JUNK and the movi list header) fills the first 64 KB, so that it is
+    // rewritten as whole blocks and the frames start on a block boundary
+    const unsigned HeaderSize = 64 << 10;
+    const unsigned HeaderFixedSize = 536;    // everything but the indx entries and the JUNK data
+    const unsigned SuperIndexCapacity = (HeaderSize - HeaderFixedSize) / 16;
+
+    const unsigned long long RiffLimit = 1ull << 30;
+
+    // Size of the chunks still being written, readers clamp it to the end of the file
+    const unsigned OpenSize = 0xFFFFFFFE;
+
+    const unsigned AVIF_HASINDEX = 0x10;
+    const unsigned AVIF_TRUSTCKTYPE = 0x800;
+    const unsigned AVIIF_KEYFRAME = 0x10;
+
+    // Codec header following the BITMAPINFOHEADER of the stream format (see ZoeCodec.cpp),
+    // version 2 for tagged frames
+    const unsigned char ZoeCodecHeaderVersion = 2;
+
+    unsigned FourCC(const char* code)
+    {
+        return (unsigned)(unsigned char)code[0] | ((unsigned)(unsigned char)code[1] << 8) |
+            ((unsigned)(unsigned char)code[2] << 16) | ((unsigned)(unsigned char)code[3] << 24);
+    }
+
+    // Little endian values written in sequence
+    struct Output
+    {
+        unsigned char* p;
+
+        void u8(unsigned value) { *p++ = (unsigned char)value; }
+        void u16(unsigned value) { u8(value); u8(value >> 8); }
+        void u32(unsigned value) { u16(value); u16(value >> 16); }
+        void u64(unsigned long long value) { u32((unsigned)value); u32((unsigned)(value >> 32)); }
+        void fourcc(const char* code) { u32(FourCC(code)); }
+    };
+
+    const unsigned char zeros[BlockSize] = { 0 };
+}
+
+AviWriter::AviWriter()
+    : fd(-1),
+      direct_io(false),
+      failed(false),
+      error(0),
+      current(0),
+      fill(0),
+      buffer_offset(0),
+      position(0),
+      job_data(0),
+      job_size(0),
+      job_offset(0),
+      allocated(0),
+      write_error(0),
+      stopping(false)
+{
+    buffers[0] = buffers[1] = 0;
+}
+
+AviWriter::~AviWriter()
+{
+    close();
+}
+
+bool AviWriter::open(const char* path, zoe_format format, unsigned width, unsigned height, unsigned rate, unsigned scale)
+{
+    close();
+
+    // tmpfs and some network file systems refuse O_DIRECT, they get the same aligned writes
+    direct_io = true;
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+    if (fd < 0 && errno == EINVAL)
+    {
+        direct_io = false;
+        fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    }
+    if (fd < 0)
+    {
+        perror(path);
+        return false;
+    }
+
+    for (int i=0;i<2;i++)
+    {
+        if (posix_memalign((void**)&buffers[i], BlockSize, BufferSize) != 0)
+        {
+            fprintf(stderr, "Out of memory for the buffers of %s\n", path);
+            close();
+            return false;
+        }
+        memset(buffers[i], 0, BufferSize); // fault the pages in now rather than on the first frames
+    }
+
+    stream_format = format;
+    frame_width = width;
+    frame_height = height;
+    frame_rate = rate ? rate : 30;
+    frame_scale = rate && scale ? scale : 1;
+
+    failed = false;
+    error = 0;
+    current = 0;
+    buffer_offset = 0;
+    riff_offset = 0;
+    movi_offset = HeaderSize - 12;
+    riff_frames.clear();
+    super_index.clear();
+    first_riff_frames = 0;
+    first_riff_size = OpenSize;
+    first_movi_size = OpenSize;
+    total_frames = 0;
+    largest_frame = 0;
+
+    job_data = 0;
+    allocated = 0;
+    write_error = 0;
+    stopping = false;
+    writer = std::thread(&AviWriter::writerLoop, this);
+
+    // The header goes first with the counts unknown, close() rewrites it
+    buildHeader(buffers[0]);
+    fill = HeaderSize;
+    position = HeaderSize;
+    return true;
+}
+
+void AviWriter::buildHeader(unsigned char* header) const
+{
+    memset(header, 0, HeaderSize);
+    Output out = { header };
+
+    out.fourcc("RIFF"); out.u32(first_riff_size); out.fourcc("AVI ");
+    out.fourcc("LIST"); out.u32(0); out.fourcc("hdrl");
+
+    const unsigned long long bytes_per_second = (unsigned long long)largest_frame * frame_rate / frame_scale;
+    out.fourcc("avih"); out.u32(56);
+    out.u32((unsigned)(1000000ull * frame_scale / frame_rate));
+    out.u32((unsigned)std::min(bytes_per_second, 0xFFFFFFFFull));
+    out.u32(0);
+    out.u32(AVIF_HASINDEX | AVIF_TRUSTCKTYPE);
+    out.u32(first_riff_frames);
+    out.u32(0);
+    out.u32(1);
+    out.u32(largest_frame);
+    out.u32(frame_width);
+    out.u32(frame_height);
+    out.p += 16;
+
+    unsigned char* const strl = out.p;
+    out.fourcc("LIST"); out.u32(0); out.fourcc("strl");
+    out.fourcc("strh"); out.u32(56);
+    out.fourcc("vids"); out.fourcc("AZCL");
+    out.u32(0); out.u16(0); out.u16(0); out.u32(0);
+    out.u32(frame_scale); out.u32(frame_rate);
+    out.u32(0); out.u32(total_frames);
+    out.u32(largest_frame); out.u32(0xFFFFFFFF); out.u32(0);
+    out.u16(0); out.u16(0); out.u16(frame_width); out.u16(frame_height);
+
+    // BITMAPINFOHEADER as CompressGetFormat fills it, then the codec header
+    out.fourcc("strf"); out.u32(44);
+    out.u32(44); out.u32(frame_width); out.u32(frame_height); out.u16(1); out.u16(32);
+    out.fourcc("AZCL"); out.u32(0); out.u32(0); out.u32(0); out.u32(0); out.u32(0);
+    out.u8(ZoeCodecHeaderVersion); out.u8(stream_format); out.u8(0); out.u8(0);
+
+    // Super index: wLongsPerEntry, bIndexSubType, bIndexType, nEntriesInUse, dwChunkId,
+    // dwReserved[3], then qwOffset, dwSize, dwDuration of each ix## chunk
+    out.fourcc("indx"); out.u32(24 + SuperIndexCapacity*16);
+    out.u16(4); out.u8(0); out.u8(0); out.u32((unsigned)super_index.size()); out.fourcc("00dc");
+    out.p += 12;
+    for (size_t i=0;i<super_index.size();i++)
+    {
+        out.u64(super_index[i].offset);
+        out.u32(super_index[i].size);
+        out.u32(super_index[i].frame_count);
+    }
+    out.p += (SuperIndexCapacity - super_index.size()) * 16;
+    Output strl_size = { strl + 4 };
+    strl_size.u32((unsigned)(out.p - strl - 8));
+
+    out.fourcc("LIST"); out.u32(4 + 256); out.fourcc("odml");
+    out.fourcc("dmlh"); out.u32(248); out.u32(total_frames);
+    out.p += 244;
+    Output hdrl_size = { header + 16 };
+    hdrl_size.u32((unsigned)(out.p - header - 20));
+
+    const unsigned junk_size = (unsigned)(header + HeaderSize - 12 - out.p - 8);
+    out.fourcc("JUNK"); out.u32(junk_size);
+    out.p = header + HeaderSize - 12;
+    out.fourcc("LIST"); out.u32(first_movi_size); out.fourcc("movi");
+}
+
+void AviWriter::append(const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    while (size)
+    {
+        const size_t count = std::min(size, BufferSize - fill);
+        memcpy(buffers[current] + fill, bytes, count);
+        fill += count;
+        position += count;
+        bytes += count;
+        size -= count;
+        if (fill == BufferSize)
+            submit(BufferSize);
+    }
+}
+
+void AviWriter::appendChunk(unsigned id, const void* data, unsigned size)
+{
+    const unsigned header[2] = { id, size };
+    append(header, 8);
+    append(data, size);
+    if (size & 1)
+        append(zeros, 1);
+}
+
+void AviWriter::padTo(unsigned alignment)
+{
+    if (position % alignment == 0)
+        return;
+
+    // A JUNK chunk, at least its 8 bytes of header
+    const unsigned size = (unsigned)((alignment - (position + 8) % alignment) % alignment);
+    const unsigned header[2] = { FourCC("JUNK"), size };
+    append(header, 8);
+    append(zeros, size);
+}
+
+void AviWriter::beginRiff()
+{
+    riff_offset = position;
+    movi_offset = position + 12;
+
+    unsigned char header[24];
+    Output out = { header };
+    out.fourcc("RIFF"); out.u32(OpenSize); out.fourcc("AVIX");
+    out.fourcc("LIST"); out.u32(OpenSize); out.fourcc("movi");
+    append(header, sizeof(header));
+}
+
+void AviWriter::endRiff(bool last)
+{
+    const unsigned frame_count = (unsigned)riff_frames.size();
+
+    // The standard index of the RIFF chunk closes its movi list: wLongsPerEntry, bIndexSubType,
+    // bIndexType, nEntriesInUse, dwChunkId, qwBaseOffset, dwReserved, then the frames. Keyframes
+    // have bit 31 of their size clear, all frames are.
+    unsigned char header[32];
+    Output out = { header };
+    out.fourcc("ix00"); out.u32(24 + frame_count*8);
+    out.u16(2); out.u8(0); out.u8(1); out.u32(frame_count); out.fourcc("00dc");
+    out.u64(movi_offset); out.u32(0);
+
+    const SuperIndexEntry entry = { position, 32 + frame_count*8, frame_count };
+    append(header, sizeof(header));
+    if (frame_count)
+        append(&riff_frames[0], frame_count*sizeof(IndexEntry));
+    super_index.push_back(entry);
+
+    const unsigned movi_size = (unsigned)(position - movi_offset - 8);
+    if (riff_offset == 0)
+    {
+        // idx1 of AVI 1.0 readers, offsets from the 'movi' list type
+        std::vector<unsigned> idx1(frame_count*4);
+        for (unsigned i=0;i<frame_count;i++)
+        {
+            idx1[i*4] = FourCC("00dc");
+            idx1[i*4+1] = AVIIF_KEYFRAME;
+            idx1[i*4+2] = riff_frames[i].offset - 16;
+            idx1[i*4+3] = riff_frames[i].size;
+        }
+        appendChunk(FourCC("idx1"), frame_count ? &idx1[0] : 0, frame_count*16);
+        first_riff_frames = frame_count;
+        first_movi_size = movi_size;
+    }
+
+    // The next RIFF chunk starts on a block, its sizes are patched in place when it ends
+    if (!last)
+        padTo(BlockSize);
+    const unsigned riff_size = (unsigned)(position - riff_offset - 8);
+    if (riff_offset == 0)
+        first_riff_size = riff_size;
+
+    patch32(riff_offset + 4, riff_size);
+    patch32(movi_offset + 4, movi_size);
+    riff_frames.clear();
+}
+
+bool AviWriter::writeFrame(const unsigned char* frame, unsigned size)
+{
+    if (fd < 0 || failed)
+        return false;
+    // Start a new RIFF chunk when this one cannot take the frame and its indexes
+    const unsigned long long count = riff_frames.size() + 1;
+    const unsigned long long index_bytes = 32 + count*8 + (riff_offset == 0 ? 8 + count*16 : 0) + BlockSize;
+    if (!riff_frames.empty() && position - riff_offset + 12 + size + index_bytes > RiffLimit)
+    {
+        if (super_index.size() + 2 > SuperIndexCapacity)
+        {
+            errno = EFBIG;
+            return false;
+        }
+        endRiff(false);
+        beginRiff();
+    }
+
+    // Frames start on 4 byte boundaries so the decoders can read their words in place
+    padTo(4);
+    const IndexEntry entry = { (unsigned)(position + 8 - movi_offset), size };
+    appendChunk(FourCC("00dc"), frame, size);
+
+    riff_frames.push_back(entry);
+    total_frames++;
+    largest_frame = std::max(largest_frame, size);
+    return !failed;
+}
+
+void AviWriter::patch32(unsigned long long offset, unsigned value)
+{
+    if (offset >= buffer_offset)
+    {
+        memcpy(buffers[current] + (offset - buffer_offset), &value, 4);
+        return;
+    }
+
+    // Written already: read, modify and write back its block, through the idle buffer
+    waitForWriter();
+    unsigned char* block = buffers[current ^ 1];
+    const unsigned long long block_offset = offset & ~(unsigned long long)(BlockSize - 1);
+    if (pread(fd, block, BlockSize, block_offset) != (ssize_t)BlockSize)
+    {
+        failed = true;
+        error = errno ? errno : EIO;
+        return;
+    }
+    memcpy(block + (offset - block_offset), &value, 4);
+    if (!writeAt(block, BlockSize, block_offset))
+    {
+        failed = true;
+        error = errno;
+    }
+}
+
+bool AviWriter::close()
+{
+    if (fd < 0)
+        return true;
+
+    if (writer.joinable())
+    {
+        endRiff(true);
+
+        // The last buffer is written as whole blocks, the file is cut to its size after
+        const size_t tail = (fill + BlockSize - 1) & ~(size_t)(BlockSize - 1);
+        memset(buffers[current] + fill, 0, tail - fill);
+        if (tail)
+            submit(tail);
+        waitForWriter();
+
+        buildHeader(buffers[current]);
+        if (!failed && !writeAt(buffers[current], HeaderSize, 0))
+        {
+            failed = true;
+            error = errno;
+        }
+        if (!failed && ftruncate(fd, position) != 0)
+        {
+            failed = true;
+            error = errno;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+    }
+
+    if (::close(fd) != 0 && !failed)
+    {
+        failed = true;
+        error = errno;
+    }
+    fd = -1;
+    for (int i=0;i<2;i++)
+    {
+        free(buffers[i]);
+        buffers[i] = 0;
+    }
+
+    errno = error;
+    return !failed;
+}
+
+void AviWriter::submit(size_t size)
+{
+    waitForWriter();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        job_data = buffers[current];
+        job_size = size;
+        job_offset = buffer_offset;
+    }
+    wake.notify_one();
+
+    current ^= 1;
+    fill = 0;
+    buffer_offset += size;
+}
+
+void AviWriter::waitForWriter()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [this] { return job_data == 0; });
+    if (write_error && !failed)
+    {
+        failed = true;
+        error = write_error;
+    }
+}
+
+void AviWriter::writerLoop()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;)
+    {
+        wake.wait(guard, [this] { return job_data != 0 || stopping; });
+        if (!job_data)
+            return;
+
+        const unsigned char* data = job_data;
+        const size_t size = job_size;
+        const unsigned long long offset = job_offset;
+        guard.unlock();
+
+        // Extents are reserved ahead of the writes so that they do not allocate blocks one by one
+        if (offset + size > allocated)
+        {
+            const unsigned long long length = std::max(offset + size - allocated, ExtentSize);
+            allocated = fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t)allocated, (off_t)length) == 0 ? allocated + length : ~0ull;
+        }
+        const bool written = writeAt(data, size, offset);
+        const int write_errno = errno;
+
+        guard.lock();
+        if (!written && !write_error)
+            write_error = write_errno ? write_errno : EIO;
+        job_data = 0;
+        done.notify_all();
+    }
+}
+
+bool AviWriter::writeAt(const unsigned char* data, size_t size, unsigned long long offset)
+{
+    while (size)
+    {
+        const ssize_t written = pwrite(fd, data, size, (off_t)offset);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0 && errno == EINVAL && direct_io)
+        {
+            // The file system took the open flag but not the transfer, go through the page cache
+            direct_io = false;
+            if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT) == 0)
+                continue;
+        }
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= (size_t)written;
+        offset += (unsigned long long)written;
+    }
+    return true;
+}
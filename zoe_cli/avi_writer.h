@@ -0,0 +1,133 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../zoe.h"
+
+// Writer of AZCL streams to OpenDML (AVI 2.0) files, readable by the VfW decoder and AviReader.
+//
+// Frames go through two aligned buffers: while a thread writes one with O_DIRECT, the caller fills
+// the other, so the page cache never holds the stream and a slow flush never stalls the encoder
+// unless the disk is slower than it. The file grows by preallocated extents. The indexes are kept
+// in memory and written as each RIFF chunk ends: an ix## chunk per RIFF chunk, idx1 for AVI 1.0
+// readers after the first one, and the indx super index in the header when the file is closed.
+//
+// RIFF chunks are capped at 1 GB and start on block boundaries. Their sizes are written when they
+// end, the last one is left open (as long as possible) until close() so that readers of a capture
+// cut short by a crash find every complete frame by walking the movi lists.
+class AviWriter
+{
+public:
+    AviWriter();
+    ~AviWriter();
+
+    // rate/scale is the frame rate in frames per second
+    bool open(const char* path, zoe_format format, unsigned width, unsigned height, unsigned rate, unsigned scale);
+    bool writeFrame(const unsigned char* frame, unsigned size);
+
+    // Writes the indexes and the header. Returns false if any write failed, errno tells why.
+    bool close();
+
+    unsigned long long bytesWritten() const { return position; }
+
+    // Whether the writes bypass the page cache (not every file system allows O_DIRECT)
+    bool direct() const { return direct_io; }
+
+private:
+    AviWriter(const AviWriter&);
+    AviWriter& operator=(const AviWriter&);
+
+    struct IndexEntry
+    {
+        unsigned offset;   // of the frame data from the movi list
+        unsigned size;
+    };
+
+    struct SuperIndexEntry
+    {
+        unsigned long long offset;   // of the ix## chunk
+        unsigned size;
+        unsigned frame_count;
+    };
+
+    void append(const void* data, size_t size);
+    void appendChunk(unsigned id, const void* data, unsigned size);
+    void padTo(unsigned alignment);
+    void beginRiff();
+    void endRiff(bool last);
+    void patch32(unsigned long long offset, unsigned value);
+    void buildHeader(unsigned char* header) const;
+
+    // Writer thread
+    void submit(size_t size);
+    void waitForWriter();
+    void writerLoop();
+    bool writeAt(const unsigned char* data, size_t size, unsigned long long offset);
+
+    int fd;
+    bool direct_io;
+    bool failed;
+    int error;
+
+    // Stream format
+    zoe_format stream_format;
+    unsigned frame_width;
+    unsigned frame_height;
+    unsigned frame_rate;
+    unsigned frame_scale;
+
+    // buffers[current] holds the bytes from buffer_offset to position
+    unsigned char* buffers[2];
+    int current;
+    size_t fill;
+    unsigned long long buffer_offset;
+    unsigned long long position;
+
+    // Indexes
+    unsigned long long riff_offset;          // of the RIFF chunk being written
+    unsigned long long movi_offset;          // of its movi list
+    std::vector<IndexEntry> riff_frames;     // frames of the RIFF chunk being written
+    std::vector<SuperIndexEntry> super_index;
+    unsigned first_riff_frames;
+    unsigned first_riff_size;
+    unsigned first_movi_size;
+    unsigned total_frames;
+    unsigned largest_frame;
+
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const unsigned char* job_data;           // buffer being written, 0 when the writer is idle
+    size_t job_size;
+    unsigned long long job_offset;
+    unsigned long long allocated;            // end of the preallocated extents
+    int write_error;                         // errno of the first failed write
+    bool stopping;
+};
@@ -0,0 +1,135 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "frame_file.h"
+
+#include <string.h>
+
+static const char FrameFileMagic[4] = { 'Z', 'O', 'E', 'F' };
+static const unsigned FrameFileVersion = 1;
+
+FrameFileWriter::FrameFileWriter()
+    : file(0),
+      bytes_written(0),
+      failed(false)
+{
+}
+
+FrameFileWriter::~FrameFileWriter()
+{
+    close();
+}
+
+bool FrameFileWriter::open(const char* path, zoe_format format, unsigned width, unsigned height)
+{
+    close();
+
+    file = fopen(path, "wb");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+    setvbuf(file, 0, _IOFBF, 1 << 20);
+
+    memcpy(header.magic, FrameFileMagic, 4);
+    header.version = FrameFileVersion;
+    header.format = format;
+    header.width = width;
+    header.height = height;
+    header.frame_count = 0;
+
+    failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    bytes_written = sizeof(header);
+    return !failed;
+}
+
+bool FrameFileWriter::writeFrame(const unsigned char* frame, unsigned size)
+{
+    static const unsigned char padding[4] = { 0, 0, 0, 0 };
+    const unsigned pad = (4 - size % 4) % 4;
+
+    if (fwrite(&size, 4, 1, file) != 1 || fwrite(frame, 1, size, file) != size || fwrite(padding, 1, pad, file) != pad)
+        failed = true;
+
+    header.frame_count++;
+    bytes_written += 4 + size + pad;
+    return !failed;
+}
+
+bool FrameFileWriter::close()
+{
+    if (!file)
+        return true;
+
+    if (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1)
+        failed = true;
+    if (fclose(file) != 0)
+        failed = true;
+    file = 0;
+
+    return !failed;
+}
+
+bool FrameFileReader::open(const char* path)
+{
+    frames.clear();
+    if (!mapping.open(path))
+        return false;
+
+    if (mapping.size() < sizeof(header) || memcmp(mapping.data(), FrameFileMagic, 4) != 0)
+    {
+        fprintf(stderr, "%s is not a .zoe file\n", path);
+        return false;
+    }
+    memcpy(&header, mapping.data(), sizeof(header));
+    if (header.version != FrameFileVersion)
+    {
+        fprintf(stderr, "%s: unsupported version %u\n", path, header.version);
+        return false;
+    }
+
+    // Walk the size words, a truncated last frame (interrupted capture) is dropped
+    frames.reserve(header.frame_count);
+    unsigned long long offset = sizeof(header);
+    while (offset + 4 <= mapping.size())
+    {
+        FrameEntry entry;
+        memcpy(&entry.size, mapping.data() + offset, 4);
+        entry.offset = offset + 4;
+        if (entry.offset + entry.size > mapping.size())
+            break;
+        frames.push_back(entry);
+        offset = entry.offset + ((entry.size + 3) & ~3ull);
+    }
+
+    if (frames.size() != header.frame_count)
+        fprintf(stderr, "%s: header counts %u frames, found %u\n", path, header.frame_count, (unsigned)frames.size());
+    return true;
+}
+
+const unsigned char* FrameFileReader::frame(unsigned index, unsigned* size) const
+{
+    *size = frames[index].size;
+    return mapping.data() + frames[index].offset;
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+#include "mapped_file.h"
+#include "../zoe.h"
+
+// .zoe files hold the compressed frames of one stream, without any container overhead:
+//
+//   header     "ZOEF", u32 version (1), u32 zoe_format, u32 width, u32 height, u32 frame count
+//   per frame  u32 size, the frame, zero padding to a multiple of 4 bytes
+//
+// All values are little endian. Frames start on 4 byte boundaries so the decoders can read their
+// words in place from a mapping of the file.
+struct FrameFileHeader
+{
+    char magic[4];
+    unsigned version;
+    unsigned format;
+    unsigned width;
+    unsigned height;
+    unsigned frame_count;
+};
+
+class FrameFileWriter
+{
+public:
+    FrameFileWriter();
+    ~FrameFileWriter();
+
+    bool open(const char* path, zoe_format format, unsigned width, unsigned height);
+    bool writeFrame(const unsigned char* frame, unsigned size);
+
+    // Writes the frame count in the header. Returns false if any write failed.
+    bool close();
+
+    unsigned long long bytesWritten() const { return bytes_written; }
+
+private:
+    FrameFileWriter(const FrameFileWriter&);
+    FrameFileWriter& operator=(const FrameFileWriter&);
+
+    FILE* file;
+    FrameFileHeader header;
+    unsigned long long bytes_written;
+    bool failed;
+};
+
+class FrameFileReader
+{
+public:
+    // Maps the file and indexes its frames
+    bool open(const char* path);
+
+    zoe_format format() const { return (zoe_format)header.format; }
+    unsigned width() const { return header.width; }
+    unsigned height() const { return header.height; }
+    unsigned frameCount() const { return (unsigned)frames.size(); }
+
+    const unsigned char* frame(unsigned index, unsigned* size) const;
+
+    MappedFile& file() { return mapping; }
+
+private:
+    struct FrameEntry
+    {
+        unsigned long long offset;
+        unsigned size;
+    };
+
+    MappedFile mapping;
+    FrameFileHeader header;
+    std::vector<FrameEntry> frames;
+};
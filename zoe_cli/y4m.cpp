@@ -0,0 +1,159 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "y4m.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static const char Y4MSignature[] = "YUV4MPEG2 ";
+
+bool Y4MReader::detect(const MappedFile& file)
+{
+    return file.size() >= sizeof(Y4MSignature)-1 && memcmp(file.data(), Y4MSignature, sizeof(Y4MSignature)-1) == 0;
+}
+
+bool Y4MReader::open(const char* path)
+{
+    frame_offsets.clear();
+    if (!mapping.open(path))
+        return false;
+
+    const char* data = (const char*)mapping.data();
+    const size_t size = mapping.size();
+    const char* header_end = (const char*)memchr(data, '\n', size);
+    if (!detect(mapping) || !header_end)
+    {
+        fprintf(stderr, "%s is not a YUV4MPEG2 file\n", path);
+        return false;
+    }
+
+    // Header parameters are single letters followed by their value, separated by spaces
+    std::string colorspace = "420jpeg";
+    frame_width = 0;
+    frame_height = 0;
+    rate_numerator = 0;
+    rate_denominator = 0;
+    for (const char* p = data + sizeof(Y4MSignature)-1; p < header_end; )
+    {
+        const char* end = p;
+        while (end < header_end && *end != ' ')
+            end++;
+        if (end > p)
+        {
+            const std::string value(p+1, end);
+            switch (*p)
+            {
+            case 'W': frame_width = (unsigned)strtoul(value.c_str(), 0, 10); break;
+            case 'H': frame_height = (unsigned)strtoul(value.c_str(), 0, 10); break;
+            case 'C': colorspace = value; break;
+            case 'F':
+                if (sscanf(value.c_str(), "%u:%u", &rate_numerator, &rate_denominator) != 2 || rate_denominator == 0)
+                    rate_numerator = rate_denominator = 0;
+                break;
+            default: break; // interlacing, aspect ratio and extensions do not matter here
+            }
+        }
+        p = end + 1;
+    }
+
+    const unsigned long long pixel_count = (unsigned long long)frame_width * frame_height;
+    unsigned long long plane_bytes = 0;
+    if (colorspace == "mono")
+    {
+        pixel_format = ZOE_PIXEL_Y8;
+        plane_bytes = pixel_count;
+    }
+    else if (colorspace == "mono10" || colorspace == "mono12" || colorspace == "mono14" || colorspace == "mono16")
+    {
+        pixel_format = colorspace == "mono10" ? ZOE_PIXEL_Y10 : colorspace == "mono12" ? ZOE_PIXEL_Y12 :
+                       colorspace == "mono14" ? ZOE_PIXEL_Y14 : ZOE_PIXEL_Y16;
+        plane_bytes = pixel_count * 2;
+    }
+    else if (colorspace == "422")
+    {
+        pixel_format = ZOE_PIXEL_UYVY;
+        plane_bytes = pixel_count * 2;
+    }
+    else if (colorspace == "420" || colorspace == "420jpeg" || colorspace == "420mpeg2" || colorspace == "420paldv")
+    {
+        // The chroma siting only matters for display
+        pixel_format = ZOE_PIXEL_I420;
+        plane_bytes = pixel_count * 3/2;
+    }
+    else
+    {
+        fprintf(stderr, "%s: unsupported colorspace C%s (mono, mono10 to mono16, 420 and 422 are)\n", path, colorspace.c_str());
+        return false;
+    }
+
+    if (pixel_count == 0 || plane_bytes > 0x7FFFFFFF || (pixel_format == ZOE_PIXEL_UYVY && frame_width % 2 != 0) ||
+        (pixel_format == ZOE_PIXEL_I420 && (frame_width % 2 != 0 || frame_height % 2 != 0)))
+    {
+        fprintf(stderr, "%s: unsupported frame size %ux%u\n", path, frame_width, frame_height);
+        return false;
+    }
+    frame_size = (unsigned)plane_bytes;
+
+    // Frame lines may carry parameters of their own, walk them all
+    size_t offset = header_end + 1 - data;
+    while (offset + 5 < size && memcmp(data + offset, "FRAME", 5) == 0)
+    {
+        const char* line_end = (const char*)memchr(data + offset, '\n', size - offset);
+        if (!line_end || (size_t)(line_end + 1 - data) + frame_size > size)
+            break;
+        frame_offsets.push_back(line_end + 1 - data);
+        offset = line_end + 1 - data + frame_size;
+    }
+
+    if (offset != size)
+        fprintf(stderr, "%s: ignoring %llu bytes after frame %u\n", path, (unsigned long long)(size - offset), frameCount());
+    return true;
+}
+
+const unsigned char* Y4MReader::frame(unsigned index, unsigned char* dest) const
+{
+    const unsigned char* planes = mapping.data() + frame_offsets[index];
+    if (!converts())
+        return planes;
+
+    // 4:2:2 planes to U Y V Y
+    const unsigned chroma_width = frame_width / 2;
+    for (unsigned y=0;y<frame_height;y++)
+    {
+        const unsigned char* luma = planes + (size_t)y * frame_width;
+        const unsigned char* u = planes + (size_t)frame_width * frame_height + (size_t)y * chroma_width;
+        const unsigned char* v = u + (size_t)chroma_width * frame_height;
+        unsigned char* row = dest + (size_t)y * frame_width * 2;
+        for (unsigned x=0;x<chroma_width;x++)
+        {
+            row[x*4+0] = u[x];
+            row[x*4+1] = luma[x*2];
+            row[x*4+2] = v[x];
+            row[x*4+3] = luma[x*2+1];
+        }
+    }
+    return dest;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <vector>
+
+#include "mapped_file.h"
+#include "../zoe.h"
+
+// YUV4MPEG2 sequences: a text header line, then each frame as a "FRAME" line followed by its planes.
+// Gray and 4:2:0 sequences (C mono, mono10 to mono16, 420) are read in place from the mapping as
+// Y8 to Y16 and I420; 4:2:2 sequences (C 422) have their planes interleaved to UYVY.
+class Y4MReader
+{
+public:
+    // Returns false and prints the reason when the file is not a supported Y4M sequence
+    bool open(const char* path);
+
+    unsigned width() const { return frame_width; }
+    unsigned height() const { return frame_height; }
+    zoe_pixel_format pixels() const { return pixel_format; }
+    unsigned frameCount() const { return (unsigned)frame_offsets.size(); }
+
+    // Bytes of a frame in the pixel format
+    unsigned frameSize() const { return frame_size; }
+
+    // Frame rate as frames per second numerator:denominator, 0:0 when the header has none
+    unsigned rateNumerator() const { return rate_numerator; }
+    unsigned rateDenominator() const { return rate_denominator; }
+
+    // Whether frame() writes to dest rather than pointing into the file
+    bool converts() const { return pixel_format == ZOE_PIXEL_UYVY; }
+
+    // Frame index in the pixel format. Gray and I420 frames point into the mapping, UYVY frames are
+    // written to dest (frameSize() bytes) which is returned.
+    const unsigned char* frame(unsigned index, unsigned char* dest) const;
+
+    MappedFile& file() { return mapping; }
+
+    // Whether the file starts like a Y4M sequence
+    static bool detect(const MappedFile& file);
+
+private:
+    MappedFile mapping;
+    unsigned frame_width;
+    unsigned frame_height;
+    zoe_pixel_format pixel_format;
+    unsigned frame_size;
+    unsigned rate_numerator;
+    unsigned rate_denominator;
+    std::vector<unsigned long long> frame_offsets; // first byte of the planes of each frame
+};
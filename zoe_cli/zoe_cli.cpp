@@ -0,0 +1,664 @@
+// Copyright (c) 2014, Activision
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted provided 
+// that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of conditions and 
+//    the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and 
+// the following disclaimer in the documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or 
+// promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED 
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A 
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR 
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// zoe: command line encoder and decoder for Linux.
+//
+//   zoe encode [-p pixels -s WxH] [-j jobs] [-n frames] [-r rate] input output.zoe|output.avi
+//   zoe decode [-p pixels] [-k first] [-n frames] input.zoe|input.avi [output]
+//   zoe info input.zoe|input.avi
+//
+// Raw inputs are a sequence of frames of the given pixel layout and size, Y4M inputs describe
+// themselves. AVI inputs are read through their index (see AviReader). Inputs are memory mapped
+// and frames go to the codecs straight from the mapping. AVI outputs are written with direct I/O
+// (see AviWriter).
+// Encoding runs several frames at once on the shared thread pool, frames are written in order.
+
+#include <algorithm>
+#include <chrono>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <thread>
+#include <vector>
+
+#include "avi_reader.h"
+#include "avi_writer.h"
+#include "frame_file.h"
+#include "mapped_file.h"
+#include "y4m.h"
+#include "../async_encoder.h"
+#include "../zoe.h"
+
+namespace
+{
+    struct NamedPixels
+    {
+        const char* name;
+        zoe_pixel_format pixels;
+    };
+
+    const NamedPixels pixel_names[] =
+    {
+        { "y8",    ZOE_PIXEL_Y8 },
+        { "y10",   ZOE_PIXEL_Y10 },
+        { "y12",   ZOE_PIXEL_Y12 },
+        { "y14",   ZOE_PIXEL_Y14 },
+        { "py10",  ZOE_PIXEL_PY10 },
+        { "py12",  ZOE_PIXEL_PY12 },
+        { "uyvy",  ZOE_PIXEL_UYVY },
+        { "rgb24", ZOE_PIXEL_RGB24 },
+        { "rgb32", ZOE_PIXEL_RGB32 },
+        { "y16",   ZOE_PIXEL_Y16 },
+        { "rgb48", ZOE_PIXEL_RGB48 },
+        { "v210",  ZOE_PIXEL_V210 },
+        { "yuv422p10", ZOE_PIXEL_YUV422P10 },
+        { "rgba64", ZOE_PIXEL_RGBA64 },
+        { "i420",  ZOE_PIXEL_I420 },
+        { "nv12",  ZOE_PIXEL_NV12 },
+    };
+
+    // Stream format of each input layout. 16 bit RGB(A) is coded with the colour transform, render
+    // outputs have correlated channels.
+    const struct { zoe_pixel_format input; zoe_format format; unsigned flags; } encode_formats[] =
+    {
+        { ZOE_PIXEL_Y8,    ZOE_FORMAT_HY8,    0 },
+        { ZOE_PIXEL_Y10,   ZOE_FORMAT_HY10,   0 },
+        { ZOE_PIXEL_PY10,  ZOE_FORMAT_HY10,   0 },
+        { ZOE_PIXEL_Y12,   ZOE_FORMAT_HY12,   0 },
+        { ZOE_PIXEL_PY12,  ZOE_FORMAT_HY12,   0 },
+        { ZOE_PIXEL_Y14,   ZOE_FORMAT_HY14,   0 },
+        { ZOE_PIXEL_Y16,   ZOE_FORMAT_HY16,   0 },
+        { ZOE_PIXEL_UYVY,  ZOE_FORMAT_HUYVY,  0 },
+        { ZOE_PIXEL_V210,  ZOE_FORMAT_HV210,  0 },
+        { ZOE_PIXEL_RGB48, ZOE_FORMAT_HRGB48, ZOE_ENCODE_COLOR_TRANSFORM },
+        { ZOE_PIXEL_RGBA64, ZOE_FORMAT_HRGBA64, ZOE_ENCODE_COLOR_TRANSFORM },
+        { ZOE_PIXEL_I420,  ZOE_FORMAT_HYUV420, 0 },
+        { ZOE_PIXEL_NV12,  ZOE_FORMAT_HYUV420, 0 },
+        { ZOE_PIXEL_RGB24, ZOE_FORMAT_HRGB24, 0 },
+        { ZOE_PIXEL_RGB32, ZOE_FORMAT_HRGB32, 0 },
+    };
+
+    // Decoded layout when none is asked for: the one the stream was coded from
+    const struct { zoe_format format; zoe_pixel_format pixels; } native_pixels[] =
+    {
+        { ZOE_FORMAT_RGB24,  ZOE_PIXEL_RGB24 },
+        { ZOE_FORMAT_RGB32,  ZOE_PIXEL_RGB32 },
+        { ZOE_FORMAT_Y8,     ZOE_PIXEL_Y8 },
+        { ZOE_FORMAT_Y10,    ZOE_PIXEL_Y10 },
+        { ZOE_FORMAT_Y12,    ZOE_PIXEL_Y12 },
+        { ZOE_FORMAT_HY8,    ZOE_PIXEL_Y8 },
+        { ZOE_FORMAT_HY10,   ZOE_PIXEL_Y10 },
+        { ZOE_FORMAT_HY12,   ZOE_PIXEL_Y12 },
+        { ZOE_FORMAT_HY14,   ZOE_PIXEL_Y14 },
+        { ZOE_FORMAT_HY16,   ZOE_PIXEL_Y16 },
+        { ZOE_FORMAT_HRGB24, ZOE_PIXEL_RGB24 },
+        { ZOE_FORMAT_HRGB32, ZOE_PIXEL_RGB32 },
+        { ZOE_FORMAT_HUYVY,  ZOE_PIXEL_UYVY },
+        { ZOE_FORMAT_HV210,  ZOE_PIXEL_V210 },
+        { ZOE_FORMAT_HRGB48, ZOE_PIXEL_RGB48 },
+        { ZOE_FORMAT_HRGBA64, ZOE_PIXEL_RGBA64 },
+        { ZOE_FORMAT_HYUV420, ZOE_PIXEL_I420 },
+    };
+
+    const char* format_names[ZOE_FORMAT_COUNT] =
+    {
+        "none", "RGB24", "RGB32", "Y8", "Y10", "HY8", "HY10", "HRGB24", "HRGB32", "HUYVY", "PY10", "Y12", "HY12", "HY14", "HY16", "HV210", "HRGB48", "HRGBA64", "HYUV420"
+    };
+
+    const char* FormatName(zoe_format format)
+    {
+        return (unsigned)format < ZOE_FORMAT_COUNT ? format_names[format] : "unknown";
+    }
+
+    zoe_pixel_format ParsePixels(const char* name)
+    {
+        for (size_t i=0;i<sizeof(pixel_names)/sizeof(pixel_names[0]);i++)
+            if (strcmp(pixel_names[i].name, name) == 0)
+                return pixel_names[i].pixels;
+        return ZOE_PIXEL_NONE;
+    }
+
+    // Settings of the encoder of width x height frames of these pixels, false when there is none
+    bool EncoderConfig(zoe_pixel_format pixels, unsigned width, unsigned height, zoe_encoder_config* config)
+    {
+        for (size_t i=0;i<sizeof(encode_formats)/sizeof(encode_formats[0]);i++)
+            if (encode_formats[i].input == pixels)
+            {
+                const zoe_encoder_config encoder_config = { encode_formats[i].format, pixels, width, height, ZOE_THREADS_SHARED_POOL, 0, encode_formats[i].flags };
+                *config = encoder_config;
+                return true;
+            }
+        return false;
+    }
+
+    // Bytes of one input frame as libzoe takes it, 0 with a message when libzoe cannot encode it
+    unsigned long long EncoderFrameBytes(const char* path, const zoe_encoder_config& config)
+    {
+        zoe_encoder* encoder = 0;
+        const zoe_status status = zoe_encoder_create(&config, &encoder);
+        if (status != ZOE_OK)
+        {
+            fprintf(stderr, "%s: cannot encode %ux%u frames of these pixels as %s (%s)\n", path, config.width, config.height, FormatName(config.format), zoe_status_string(status));
+            return 0;
+        }
+        const unsigned long long bytes = zoe_encoder_input_size(encoder);
+        zoe_encoder_destroy(encoder);
+        return bytes;
+    }
+
+    // Bytes of one frame decoded to these pixels, 0 when libzoe has no such output
+    unsigned long long DecodedFrameBytes(zoe_format format, zoe_pixel_format pixels, unsigned width, unsigned height)
+    {
+        const zoe_decoder_config config = { format, pixels, width, height, ZOE_THREADS_CALLER, 0, 0 };
+        zoe_decoder* decoder = 0;
+        if (zoe_decoder_create(&config, &decoder) != ZOE_OK)
+            return 0;
+        const unsigned long long bytes = zoe_decoder_output_size(decoder);
+        zoe_decoder_destroy(decoder);
+        return bytes;
+    }
+
+    double Seconds(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Throughput is counted on the uncompressed side, which is what the frames cost to move around
+    void PrintStats(const char* what, unsigned frames, unsigned long long raw_bytes, unsigned long long coded_bytes, double seconds)
+    {
+        const double mb = 1024.0 * 1024.0;
+        printf("%s %u frames in %.3f s: %.1f MB -> %.1f MB, ratio %.3f, %.1f MB/s, %.1f fps\n",
+            what, frames, seconds, raw_bytes / mb, coded_bytes / mb,
+            coded_bytes ? (double)raw_bytes / coded_bytes : 0.0,
+            seconds > 0 ? raw_bytes / mb / seconds : 0.0, seconds > 0 ? frames / seconds : 0.0);
+    }
+
+    void Usage()
+    {
+        fprintf(stderr,
+            "usage: zoe encode [options] input output.zoe|output.avi\n"
+            "         -p, --pixels FMT   layout of raw input frames: y8 y10 y12 y14 y16 py10 py12 uyvy v210 rgb24 rgb32\n"
+            "                            rgb48 rgba64 (16 bit, coded with the colour transform) i420 nv12\n"
+            "         -s, --size WxH     size of raw input frames\n"
+            "         -j, --jobs N       frames encoded at the same time (default: hardware threads)\n"
+            "         -n, --frames N     stop after N frames\n"
+            "         -r, --rate N[/D]   frame rate of AVI outputs (default: the Y4M rate, or 30)\n"
+            "       Y4M inputs (C mono, mono10, mono12, mono14, mono16, 420, 422) need no -p or -s.\n"
+            "\n"
+            "       zoe decode [options] input.zoe|input.avi [output]\n"
+            "         -p, --pixels FMT   layout of the decoded frames (default: the coded layout)\n"
+            "                            y16 and rgb48 give HY10/HY12/HY14 samples in the MSB of 16 bits,\n"
+            "                            yuv422p10 gives the planes of HV210 frames, HYUV420 decodes to i420, nv12 or rgb32\n"
+            "         -k, --start N      first frame to decode\n"
+            "         -n, --frames N     stop after N frames\n"
+            "       Without output the frames are decoded and dropped, to measure the decoder.\n"
+            "\n"
+            "       zoe info input.zoe|input.avi\n");
+    }
+
+    // Raw frames or a Y4M sequence, mapped, and the encoder settings for its frames
+    struct EncoderInput
+    {
+        MappedFile raw;
+        Y4MReader y4m;
+        bool is_y4m;
+        zoe_encoder_config config;
+        zoe_pixel_format pixels;
+        unsigned width;
+        unsigned height;
+        unsigned frame_size;
+        unsigned frame_count;
+        unsigned rate;          // frames per second rate/scale, 0/0 when unknown
+        unsigned scale;
+
+        bool open(const char* path, zoe_pixel_format raw_pixels, unsigned raw_width, unsigned raw_height)
+        {
+            if (!raw.open(path))
+                return false;
+
+            is_y4m = Y4MReader::detect(raw);
+            if (is_y4m)
+            {
+                raw.close();
+                if (!y4m.open(path))
+                    return false;
+                y4m.file().adviseSequential();
+                pixels = y4m.pixels();
+                width = y4m.width();
+                height = y4m.height();
+                frame_size = y4m.frameSize();
+                frame_count = y4m.frameCount();
+                rate = y4m.rateNumerator();
+                scale = y4m.rateDenominator();
+                const unsigned long long bytes = encoderFrameBytes(path);
+                if (bytes != 0 && bytes != frame_size)
+                    fprintf(stderr, "%s: Y4M frames of %u bytes, the encoder takes %llu\n", path, frame_size, bytes);
+                return bytes != 0 && bytes == frame_size;
+            }
+
+            if (raw_pixels == ZOE_PIXEL_NONE || raw_width == 0 || raw_height == 0)
+            {
+                fprintf(stderr, "%s: raw input needs --pixels and --size\n", path);
+                return false;
+            }
+            pixels = raw_pixels;
+            width = raw_width;
+            height = raw_height;
+            const unsigned long long bytes = encoderFrameBytes(path);
+            if (bytes == 0)
+                return false;
+            if (bytes > 0x7FFFFFFF || raw.size() < bytes)
+            {
+                fprintf(stderr, "%s: smaller than one %ux%u frame\n", path, raw_width, raw_height);
+                return false;
+            }
+            if (raw.size() % bytes != 0)
+                fprintf(stderr, "%s: ignoring %llu bytes after the last whole frame\n", path, (unsigned long long)(raw.size() % bytes));
+
+            raw.adviseSequential();
+            frame_size = (unsigned)bytes;
+            frame_count = (unsigned)(raw.size() / bytes);
+            rate = 0;
+            scale = 0;
+            return true;
+        }
+
+        // Encoder settings for the frames, and the bytes libzoe takes of each. 0 with a message
+        // when there is no encoder for them.
+        unsigned long long encoderFrameBytes(const char* path)
+        {
+            if (!EncoderConfig(pixels, width, height, &config))
+            {
+                fprintf(stderr, "%s: no encoder for these pixels\n", path);
+                return 0;
+            }
+            return EncoderFrameBytes(path, config);
+        }
+    };
+
+    // Compressed frames to a .zoe file, or to an AVI file when the name ends in .avi
+    struct EncoderOutput
+    {
+        FrameFileWriter frames;
+        AviWriter avi;
+        bool is_avi;
+
+        bool open(const char* path, zoe_format format, unsigned width, unsigned height, unsigned rate, unsigned scale)
+        {
+            const size_t length = strlen(path);
+            is_avi = length >= 4 && strcasecmp(path + length - 4, ".avi") == 0;
+            return is_avi ? avi.open(path, format, width, height, rate, scale) : frames.open(path, format, width, height);
+        }
+
+        bool writeFrame(const unsigned char* frame, unsigned size) { return is_avi ? avi.writeFrame(frame, size) : frames.writeFrame(frame, size); }
+        bool close() { return is_avi ? avi.close() : frames.close(); }
+        unsigned long long bytesWritten() const { return is_avi ? avi.bytesWritten() : frames.bytesWritten(); }
+    };
+
+    // Compressed frames of a .zoe or AVI file, mapped
+    struct DecoderInput
+    {
+        FrameFileReader frames;
+        AviReader avi;
+        bool is_avi;
+
+        bool open(const char* path)
+        {
+            MappedFile probe;
+            if (!probe.open(path))
+                return false;
+            is_avi = AviReader::detect(probe);
+            probe.close();
+            return is_avi ? avi.open(path) : frames.open(path);
+        }
+
+        zoe_format format() const { return is_avi ? avi.format() : frames.format(); }
+        unsigned width() const { return is_avi ? avi.width() : frames.width(); }
+        unsigned height() const { return is_avi ? avi.height() : frames.height(); }
+        unsigned frameCount() const { return is_avi ? avi.frameCount() : frames.frameCount(); }
+        MappedFile& file() { return is_avi ? avi.file() : frames.file(); }
+
+        const unsigned char* frame(unsigned index, unsigned* size) const
+        {
+            return is_avi ? avi.frame(index, size) : frames.frame(index, size);
+        }
+    };
+
+    int Encode(int argc, char** argv)
+    {
+        static const option options[] =
+        {
+            { "pixels", required_argument, 0, 'p' },
+            { "size",   required_argument, 0, 's' },
+            { "jobs",   required_argument, 0, 'j' },
+            { "frames", required_argument, 0, 'n' },
+            { "rate",   required_argument, 0, 'r' },
+            { 0, 0, 0, 0 }
+        };
+
+        zoe_pixel_format raw_pixels = ZOE_PIXEL_NONE;
+        unsigned raw_width = 0, raw_height = 0;
+        int jobs = (int)std::thread::hardware_concurrency();
+        unsigned max_frames = ~0u;
+        unsigned rate = 0, scale = 1;
+        for (int opt; (opt = getopt_long(argc, argv, "p:s:j:n:r:", options, 0)) != -1; )
+        {
+            switch (opt)
+            {
+            case 'p':
+                raw_pixels = ParsePixels(optarg);
+                if (raw_pixels == ZOE_PIXEL_NONE)
+                {
+                    fprintf(stderr, "Unknown pixel format %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 's':
+                if (sscanf(optarg, "%ux%u", &raw_width, &raw_height) != 2)
+                {
+                    fprintf(stderr, "Bad frame size %s, expected WxH\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'j': jobs = atoi(optarg); break;
+            case 'n': max_frames = (unsigned)strtoul(optarg, 0, 10); break;
+            case 'r':
+                scale = 1;
+                if (sscanf(optarg, "%u/%u", &rate, &scale) < 1 || rate == 0 || scale == 0)
+                {
+                    fprintf(stderr, "Bad frame rate %s, expected N or N/D\n", optarg);
+                    return 2;
+                }
+                break;
+            default: Usage(); return 2;
+            }
+        }
+        if (argc - optind != 2)
+        {
+            Usage();
+            return 2;
+        }
+        jobs = std::max(jobs, 1);
+
+        EncoderInput input;
+        if (!input.open(argv[optind], raw_pixels, raw_width, raw_height))
+            return 1;
+
+        if (rate == 0)
+        {
+            rate = input.rate;
+            scale = input.scale;
+        }
+        EncoderOutput output;
+        if (!output.open(argv[optind+1], input.config.format, input.width, input.height, rate, scale))
+            return 1;
+
+        // Two frames per job keep every job busy while the finished ones are written
+        const unsigned frame_count = std::min(input.frame_count, max_frames);
+        ZoeAsyncEncoder encoder(input.config, 2*jobs, jobs);
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        unsigned submitted = 0;
+        unsigned written = 0;
+        double slowest_write = 0;
+        while (written < frame_count)
+        {
+            // Fill the free slots, straight from the mapping unless the frame needs converting
+            while (submitted < frame_count)
+            {
+                if (input.is_y4m && input.y4m.converts())
+                {
+                    unsigned long long index;
+                    unsigned char* slot = encoder.reserve(&index);
+                    if (!slot)
+                        break;
+                    input.y4m.frame(submitted, slot);
+                    encoder.commit(index);
+                }
+                else
+                {
+                    const unsigned char* frame = input.is_y4m ? input.y4m.frame(submitted, 0) : input.raw.data() + (size_t)submitted * input.frame_size;
+                    if (encoder.submit(frame) != ZoeAsyncEncoder::Submitted)
+                        break;
+                }
+                submitted++;
+            }
+
+            ZoeEncodedFrame frame;
+            if (!encoder.nextCompleted(frame, true))
+                continue;
+            if (frame.size == 0)
+            {
+                fprintf(stderr, "Out of memory encoding frame %u\n", written);
+                return 1;
+            }
+            const std::chrono::steady_clock::time_point write_start = std::chrono::steady_clock::now();
+            const bool ok = output.writeFrame(frame.data, frame.size);
+            slowest_write = std::max(slowest_write, Seconds(write_start));
+            encoder.release();
+            written++;
+            if (!ok)
+            {
+                perror(argv[optind+1]);
+                return 1;
+            }
+        }
+
+        if (!output.close())
+        {
+            perror(argv[optind+1]);
+            return 1;
+        }
+
+        printf("%s %ux%u -> %s, %d jobs\n", argv[optind], input.width, input.height, FormatName(input.config.format), jobs);
+        PrintStats("Encoded", written, (unsigned long long)written * input.frame_size, output.bytesWritten(), Seconds(start));
+        printf("Slowest frame write %.3f ms%s\n", slowest_write * 1000,
+            output.is_avi ? (output.avi.direct() ? ", direct I/O" : ", through the page cache") : "");
+        return 0;
+    }
+
+    int Decode(int argc, char** argv)
+    {
+        static const option options[] =
+        {
+            { "pixels", required_argument, 0, 'p' },
+            { "start",  required_argument, 0, 'k' },
+            { "frames", required_argument, 0, 'n' },
+            { 0, 0, 0, 0 }
+        };
+
+        zoe_pixel_format pixels = ZOE_PIXEL_NONE;
+        unsigned first_frame = 0;
+        unsigned max_frames = ~0u;
+        for (int opt; (opt = getopt_long(argc, argv, "p:k:n:", options, 0)) != -1; )
+        {
+            switch (opt)
+            {
+            case 'p':
+                pixels = ParsePixels(optarg);
+                if (pixels == ZOE_PIXEL_NONE)
+                {
+                    fprintf(stderr, "Unknown pixel format %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'k': first_frame = (unsigned)strtoul(optarg, 0, 10); break;
+            case 'n': max_frames = (unsigned)strtoul(optarg, 0, 10); break;
+            default: Usage(); return 2;
+            }
+        }
+        if (argc - optind != 1 && argc - optind != 2)
+        {
+            Usage();
+            return 2;
+        }
+
+        DecoderInput input;
+        if (!input.open(argv[optind]))
+            return 1;
+        input.file().adviseSequential();
+        if (first_frame > input.frameCount())
+        {
+            fprintf(stderr, "%s has %u frames\n", argv[optind], input.frameCount());
+            return 1;
+        }
+        if (input.is_avi)
+            input.avi.prefetch(first_frame, 16); // readahead starts at the seek point
+
+        if (pixels == ZOE_PIXEL_NONE)
+            for (size_t i=0;i<sizeof(native_pixels)/sizeof(native_pixels[0]);i++)
+                if (native_pixels[i].format == input.format())
+                    pixels = native_pixels[i].pixels;
+
+        const zoe_decoder_config config = { input.format(), pixels, input.width(), input.height(), ZOE_THREADS_SHARED_POOL, 0, 0 };
+        zoe_decoder* decoder = 0;
+        const zoe_status status = zoe_decoder_create(&config, &decoder);
+        if (status != ZOE_OK)
+        {
+            fprintf(stderr, "Cannot decode %s %ux%u: %s\n", FormatName(input.format()), input.width(), input.height(), zoe_status_string(status));
+            return 1;
+        }
+
+        FILE* output = 0;
+        if (argc - optind == 2)
+        {
+            output = fopen(argv[optind+1], "wb");
+            if (!output)
+            {
+                perror(argv[optind+1]);
+                zoe_decoder_destroy(decoder);
+                return 1;
+            }
+            setvbuf(output, 0, _IOFBF, 1 << 20);
+        }
+
+        std::vector<unsigned char> frame_buffer(zoe_decoder_output_size(decoder));
+        std::vector<unsigned char> staging;
+        const unsigned frame_count = std::min(input.frameCount() - first_frame, max_frames);
+        unsigned long long coded_bytes = 0;
+        int result = 0;
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned i=first_frame;i<first_frame+frame_count && result == 0;i++)
+        {
+            unsigned size;
+            const unsigned char* frame = input.frame(i, &size);
+            coded_bytes += size;
+
+            // AVI chunks are only 2-byte aligned while the bitstreams are read in whole words
+            if ((reinterpret_cast<uintptr_t>(frame) & 3) || (size & 3))
+            {
+                staging.assign(frame, frame + size);
+                staging.resize((size + 3) & ~3u);
+                frame = &staging[0];
+            }
+
+            // Dropped frames of a capture repeat the previous one
+            const zoe_status decoded = size ? zoe_decode(decoder, frame, size, &frame_buffer[0], frame_buffer.size()) : ZOE_OK;
+            if (decoded != ZOE_OK)
+            {
+                fprintf(stderr, "Frame %u: %s\n", i, zoe_status_string(decoded));
+                result = 1;
+            }
+            else if (output && fwrite(&frame_buffer[0], 1, frame_buffer.size(), output) != frame_buffer.size())
+            {
+                perror(argv[optind+1]);
+                result = 1;
+            }
+        }
+        const double seconds = Seconds(start);
+
+        if (output && fclose(output) != 0 && result == 0)
+        {
+            perror(argv[optind+1]);
+            result = 1;
+        }
+        zoe_decoder_destroy(decoder);
+
+        if (result == 0)
+            PrintStats("Decoded", frame_count, (unsigned long long)frame_count * frame_buffer.size(), coded_bytes, seconds);
+        return result;
+    }
+
+    int Info(int argc, char** argv)
+    {
+        if (argc != 2)
+        {
+            Usage();
+            return 2;
+        }
+
+        DecoderInput input;
+        if (!input.open(argv[1]))
+            return 1;
+
+        unsigned long long coded_bytes = 0;
+        unsigned largest = 0;
+        for (unsigned i=0;i<input.frameCount();i++)
+        {
+            unsigned size;
+            input.frame(i, &size);
+            coded_bytes += size;
+            largest = std::max(largest, size);
+        }
+
+        unsigned long long raw_bytes = 0;
+        for (size_t i=0;i<sizeof(native_pixels)/sizeof(native_pixels[0]);i++)
+            if (native_pixels[i].format == input.format())
+                raw_bytes = DecodedFrameBytes(input.format(), native_pixels[i].pixels, input.width(), input.height()) * input.frameCount();
+
+        printf("%s: %s %ux%u, %u frames, %llu bytes coded, largest frame %u bytes, ratio %.3f\n",
+            argv[1], FormatName(input.format()), input.width(), input.height(), input.frameCount(),
+            coded_bytes, largest, coded_bytes ? (double)raw_bytes / coded_bytes : 0.0);
+        if (input.is_avi)
+            printf("  %.3f fps, frames indexed from %s\n", input.avi.frameRate(), input.avi.indexKind());
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        Usage();
+        return 2;
+    }
+
+    // Each command parses its own options, argv[0] becomes the command name
+    const char* command = argv[1];
+    int result = 2;
+    if (strcmp(command, "encode") == 0)
+        result = Encode(argc-1, argv+1);
+    else if (strcmp(command, "decode") == 0)
+        result = Decode(argc-1, argv+1);
+    else if (strcmp(command, "info") == 0)
+        result = Info(argc-1, argv+1);
+    else
+        Usage();
+
+    zoe_shutdown();
+    return result;
+}